@@ -68,7 +68,8 @@ AudioEngine::AudioEngine() {
 void AudioEngine::Update() {
 
     
-    for (auto it = GameObject::SystemGetComponents<AudioPlayerComponent, TransformComponent, RigidbodyComponent>({ ComponentBitIndex::AudioPlayer });  it.Valid(); it++) {
+    static GameObject::SystemQuery<AudioPlayerComponent, TransformComponent, RigidbodyComponent> audioPlayerQuery({ ComponentBitIndex::AudioPlayer });
+    for (auto it = audioPlayerQuery.Iterate(); it.Valid(); it++) {
         auto& [audioPlayerComponent, transformComponent, rigidbodyComponent] = *it;
 
         if (audioPlayerComponent->sound != nullptr) {
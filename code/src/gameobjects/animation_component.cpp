@@ -35,6 +35,13 @@ void AnimationComponent::StopAnimation(std::string animName) {
     std::erase_if(currentlyPlaying, [&animName](const PlayingAnimation& a) {return a.anim->name == animName;});
 }
 
+AnimationComponent::AnimationComponent(AnimationComponent&& old) noexcept:
+    currentlyPlaying(std::move(old.currentlyPlaying)),
+    renderComponent(old.renderComponent),
+    mesh(std::move(old.mesh))
+{
+}
+
 AnimationComponent::~AnimationComponent() {
     renderComponent = nullptr;
     mesh = nullptr;
@@ -25,10 +25,13 @@ class AnimationComponent: public BaseComponent {
 
     AnimationComponent(const AnimationComponent&) = delete;
     AnimationComponent(RenderComponent*);
+    // Used when compaction moves the component to a different slot. GameObject points renderComponent at the render component's new address afterwards.
+    AnimationComponent(AnimationComponent&& old) noexcept;
     ~AnimationComponent();
 
     private:
     friend class GraphicsEngine;
+    friend class GameObject;
 
     struct PlayingAnimation {
         const Animation* anim; // should always be valid
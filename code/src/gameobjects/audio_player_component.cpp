@@ -30,7 +30,25 @@ AudioPlayerComponent::AudioPlayerComponent(std::optional<std::shared_ptr<Sound>>
     isPlaying = false;
 }
 
+AudioPlayerComponent::AudioPlayerComponent(AudioPlayerComponent&& old) noexcept:
+    positional(old.positional),
+    doppler(old.doppler),
+    pitch(old.pitch),
+    volume(old.volume),
+    rolloff(old.rolloff),
+    maxDistance(old.maxDistance),
+    looped(old.looped),
+    sound(std::move(old.sound)),
+    isPlaying(old.isPlaying),
+    audioSourceId(old.audioSourceId)
+{
+    old.audioSourceId = 0;
+}
+
 AudioPlayerComponent::~AudioPlayerComponent() {
+    if (audioSourceId == 0) { // moved somewhere else, the new component owns the source now
+        return;
+    }
     Stop();
     sound = nullptr;
     CheckedOpenALCall(alDeleteSources(1, &audioSourceId));
@@ -16,6 +16,8 @@ public:
 
     AudioPlayerComponent(const AudioPlayerComponent&) = delete;
     AudioPlayerComponent(std::optional<std::shared_ptr<Sound>> soundToUse = std::nullopt);
+    // Used when compaction moves the component to a different slot; takes over the old component's OpenAL source.
+    AudioPlayerComponent(AudioPlayerComponent&& old) noexcept;
     ~AudioPlayerComponent();
 
     //GameObject* const object; no longer needed
@@ -60,5 +62,7 @@ private:
 
     std::shared_ptr<Sound> sound;
     bool isPlaying;
+
+    // 0 if the component was moved somewhere else and is just waiting to be destroyed (OpenAL never gives out 0 as a source name).
     unsigned int audioSourceId;
 };
\ No newline at end of file
@@ -3,15 +3,20 @@
 #include "gameobjects/gameobject.hpp"
 
 #include "physics/gjk.hpp"
+#include "physics/primitive_collisions.hpp"
+#include "physics/heightfield.hpp"
 
-ColliderComponent::ColliderComponent(GameObject* gameobj, std::shared_ptr<PhysicsMesh>& physMesh):
+ColliderComponent::ColliderComponent(GameObject* gameobj, std::shared_ptr<PhysicsMesh>& physMesh, ColliderShape colliderShape):
     gameobject(gameobj),
-    physicsMesh(physMesh)
+    physicsMesh(physMesh),
+    shape(colliderShape),
+    heightfield(nullptr)
 {
     Assert(gameobject);
+    Assert(shape != ColliderShapeHeightfield);
 
     aabbType = AABBBoundingCube;
-    node = nullptr;
+    node = SpatialAccelerationStructure::NULL_NODE;
     
     elasticity = 1.0f;
     friction = 0.2f;
@@ -20,6 +25,24 @@ ColliderComponent::ColliderComponent(GameObject* gameobj, std::shared_ptr<Physic
 
 }
 
+ColliderComponent::ColliderComponent(GameObject* gameobj, const std::shared_ptr<Heightfield>& colliderHeightfield):
+    gameobject(gameobj),
+    physicsMesh(nullptr),
+    shape(ColliderShapeHeightfield),
+    heightfield(colliderHeightfield)
+{
+    Assert(gameobject);
+    Assert(heightfield);
+
+    aabbType = AABBBoundingCube;
+    node = SpatialAccelerationStructure::NULL_NODE;
+
+    elasticity = 1.0f;
+    friction = 0.2f;
+    density = 1.0f;
+    SpatialAccelerationStructure::Get().AddCollider(this, *gameobject->RawGet<TransformComponent>());
+}
+
 //ColliderComponent::ColliderComponent() {
 //    // no point in initializing but makes msvc shut up
 //    density = 0;
@@ -30,8 +53,36 @@ ColliderComponent::ColliderComponent(GameObject* gameobj, std::shared_ptr<Physic
 //    node = nullptr;
 //}
 
+ColliderComponent::ColliderComponent(ColliderComponent&& old) noexcept:
+    aabbType(old.aabbType),
+    elasticity(old.elasticity),
+    density(old.density),
+    friction(old.friction),
+    physicsMesh(old.physicsMesh),
+    shape(old.shape),
+    heightfield(old.heightfield),
+    gameobject(old.gameobject),
+    layer(old.layer),
+    aabb(old.aabb),
+    node(old.node)
+{
+    if (node != SpatialAccelerationStructure::NULL_NODE) {
+        auto& sas = SpatialAccelerationStructure::Get();
+        sas.nodes[node].collider = this;
+
+        // queries hand out colliders straight from leafBounds, so it has to know we moved too
+        if (!sas.leafBoundsDirty) {
+            sas.leafBounds.colliders[sas.nodes[node].firstLeafSlot] = this;
+        }
+    }
+
+    old.node = SpatialAccelerationStructure::NULL_NODE;
+}
+
 ColliderComponent::~ColliderComponent() {
-    RemoveFromSas(); // TODO: confusion: even without this line Query() doesn't pick up these components???
+    if (node != SpatialAccelerationStructure::NULL_NODE) {
+        RemoveFromSas(); // TODO: confusion: even without this line Query() doesn't pick up these components???
+    }
 }
 
 std::shared_ptr<GameObject> ColliderComponent::GetGameObject() {
@@ -48,7 +99,14 @@ std::shared_ptr<GameObject> ColliderComponent::GetGameObject() {
     // If we ever use a second SAS for accelerating visibility queries too, then don't do it for that
 void ColliderComponent::RecalculateAABB(const TransformComponent& colliderTransform) {
     // std::cout << "Reacalculating AABB of " << this << "\n";
-    if (aabbType == AABBBoundingCube) {
+    if (shape == ColliderShapeHeightfield) {
+        aabb = heightfield->GetAABB(colliderTransform);
+    }
+    else if (shape != ColliderShapeMesh) {
+        // primitives can always have a tight AABB, no matter what aabbType is
+        aabb = PrimitiveAABB(Primitive(shape, colliderTransform));
+    }
+    else if (aabbType == AABBBoundingCube) {
         glm::dvec3 min = {-std::sqrt(0.75), -std::sqrt(0.75), -std::sqrt(0.75)};
         glm::dvec3 max = {std::sqrt(0.75), std::sqrt(0.75), std::sqrt(0.75)};
         
@@ -68,6 +126,35 @@ void ColliderComponent::RecalculateAABB(const TransformComponent& colliderTransf
     }
 }
 
+void ColliderComponent::SetHeightfieldCell(int x, int z, float height) {
+    Assert(shape == ColliderShapeHeightfield);
+    if (heightfield->GetHeight(x, z) == height) {
+        return;
+    }
+
+    const TransformComponent& transform = *gameobject->RawGet<TransformComponent>();
+    AABB oldAabb = heightfield->GetAABB(transform);
+    heightfield->SetHeight(x, z, height);
+    AABB newAabb = heightfield->GetAABB(transform);
+    if (oldAabb.min != newAabb.min || oldAabb.max != newAabb.max) {
+        SpatialAccelerationStructure::Get().UpdateCollider(*this, transform);
+    }
+
+    // the cell's neighbours count too, since whether their sides push things depends on this cell's height
+    AABB nearby = heightfield->CellAABB(transform, x - 1, z - 1);
+    nearby.Grow(heightfield->CellAABB(transform, x + 1, z + 1));
+    nearby.min.y = std::min(oldAabb.min.y, newAabb.min.y);
+    nearby.max.y = std::max(oldAabb.max.y, newAabb.max.y);
+    // visited in place instead of copied into a vector, since terrain edits and world generation call this for lots of cells at once (Wake() doesn't touch the SAS, so it's fine to do in here)
+    SpatialAccelerationStructure::Get().QueryVisit(nearby, ALL_COLLISION_LAYERS, [](ColliderComponent* other) {
+        RigidbodyComponent* rigidbody = other->gameobject->MaybeRawGet<RigidbodyComponent>();
+        if (rigidbody) {
+            rigidbody->Wake();
+        }
+        return true;
+    });
+}
+
 const AABB& ColliderComponent::GetAABB() {
     return aabb;
 }
@@ -1,9 +1,11 @@
 #pragma once
 #include "physics/aabb.hpp"
 #include "physics/spatial_acceleration_structure.hpp"
+#include "physics/collider_shape.hpp"
 #include <bitset>
 
 class PhysicsMesh;
+class Heightfield;
 class GameObject;
 
 // Represents what kind of AABB to generate for a collider.
@@ -32,7 +34,11 @@ class ColliderComponent: public BaseComponent {
     //void Init(GameObject* gameobject, std::shared_ptr<PhysicsMesh>& physMesh);
 
     ColliderComponent(const ColliderComponent&) = delete;
-    ColliderComponent(GameObject* gameobject, std::shared_ptr<PhysicsMesh>& physMesh);
+    ColliderComponent(GameObject* gameobject, std::shared_ptr<PhysicsMesh>& physMesh, ColliderShape colliderShape = ColliderShapeMesh);
+    // Makes a ColliderShapeHeightfield collider, which has no physics mesh.
+    ColliderComponent(GameObject* gameobject, const std::shared_ptr<Heightfield>& heightfield);
+    // Used when compaction moves the component to a different slot; replaces the old component with this one in its SAS leaf node.
+    ColliderComponent(ColliderComponent&& old) noexcept;
     ~ColliderComponent();
 
     // Called before component is returned from pool
@@ -50,8 +56,20 @@ class ColliderComponent: public BaseComponent {
     std::shared_ptr<GameObject> GetGameObject();
 
     // pointer to accurate collider for object
+    // Primitive colliders (see shape) still keep one around for raycasts and for the rigidbody's moment of inertia, but collide as their primitive.
+    // nullptr for heightfield colliders.
     const std::shared_ptr<PhysicsMesh> physicsMesh;
 
+    // Whether the collider is its physics mesh, or a sphere/box/capsule sized by its transform's scale (see primitive_collisions.hpp), or a heightfield.
+    const ColliderShape shape;
+
+    // heightfield colliders only, nullptr otherwise. Use SetHeightfieldCell() instead of changing it directly.
+    const std::shared_ptr<Heightfield> heightfield;
+
+    // Heightfield colliders only. Changes the height of one of the heightfield's cells (see Heightfield::SetHeight()), updating the collider's AABB if it has to,
+        // and waking up any rigidbodies near the cell so that they don't stay asleep on ground that isn't there anymore.
+    void SetHeightfieldCell(int x, int z, float height);
+
     const AABB& GetAABB();
 
     // Returns true if the object is colliding with the given other object.
@@ -73,8 +91,8 @@ class ColliderComponent: public BaseComponent {
 
     AABB aabb;
 
-    // pointer to node the component is stored in
-    SpatialAccelerationStructure::SasNode* node;
+    // index of the SAS leaf node the component is stored in (NULL_NODE if the component was removed from the SAS, or moved somewhere else and is just waiting to be destroyed)
+    SpatialAccelerationStructure::NodeIndex node;
 
     
     
@@ -0,0 +1,55 @@
+#include "command_buffer.hpp"
+
+void GameObjectCommandBuffer::Create(const GameobjectCreateParams& params, unsigned int count, std::function<void(const std::vector<std::shared_ptr<GameObject>>&)> onCreated) {
+	std::lock_guard lock(mutex);
+	commands.emplace_back(CreateCommand{ .params = params, .count = count, .onCreated = std::move(onCreated) });
+}
+
+void GameObjectCommandBuffer::Destroy(GameObjectHandle gameobject) {
+	std::lock_guard lock(mutex);
+	commands.emplace_back(DestroyCommand{ .gameobject = gameobject });
+}
+
+void GameObjectCommandBuffer::AddComponents(GameObjectHandle gameobject, const GameobjectCreateParams& params) {
+	std::lock_guard lock(mutex);
+	commands.emplace_back(AddComponentsCommand{ .gameobject = gameobject, .params = params });
+}
+
+void GameObjectCommandBuffer::RemoveComponents(GameObjectHandle gameobject, std::vector<ComponentBitIndex::ComponentBitIndex> components) {
+	std::lock_guard lock(mutex);
+	commands.emplace_back(RemoveComponentsCommand{ .gameobject = gameobject, .components = std::move(components) });
+}
+
+void GameObjectCommandBuffer::Apply() {
+	// take the commands out so that other threads can keep recording (and so onCreated callbacks can record more) without deadlocking
+	std::vector<Command> toApply;
+	{
+		std::lock_guard lock(mutex);
+		toApply.swap(commands);
+	}
+
+	for (auto& command : toApply) {
+		if (auto create = std::get_if<CreateCommand>(&command)) {
+			auto gameobjects = GameObject::NewBatch(create->params, create->count);
+			if (create->onCreated) {
+				create->onCreated(gameobjects);
+			}
+		}
+		else if (auto destroy = std::get_if<DestroyCommand>(&command)) {
+			// the same gameobject could have been destroyed twice, or by someone else
+			if (GameObject* gameobject = GameObject::Resolve(destroy->gameobject)) {
+				gameobject->Destroy();
+			}
+		}
+		else if (auto add = std::get_if<AddComponentsCommand>(&command)) {
+			if (GameObject* gameobject = GameObject::Resolve(add->gameobject)) {
+				gameobject->AddComponents(add->params);
+			}
+		}
+		else if (auto remove = std::get_if<RemoveComponentsCommand>(&command)) {
+			if (GameObject* gameobject = GameObject::Resolve(remove->gameobject)) {
+				gameobject->RemoveComponents(remove->components);
+			}
+		}
+	}
+}
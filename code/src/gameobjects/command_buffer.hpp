@@ -0,0 +1,60 @@
+#pragma once
+#include "gameobject.hpp"
+#include <mutex>
+#include <variant>
+#include <functional>
+
+// Records changes to gameobjects that aren't safe to make while a system is iterating through components (creating/destroying gameobjects, adding/removing components),
+	// and makes them later when you call Apply().
+// Recording is thread safe, so systems running on several threads can share one command buffer.
+// Commands are applied in the order they were recorded.
+class GameObjectCommandBuffer {
+public:
+	GameObjectCommandBuffer() = default;
+	GameObjectCommandBuffer(const GameObjectCommandBuffer&) = delete;
+
+	// Creates count gameobjects with the given params (using GameObject::NewBatch()) when applied.
+	// If given, onCreated is called with the new gameobjects right after they're created, since that's the only way you can get to them.
+	void Create(const GameobjectCreateParams& params, unsigned int count = 1, std::function<void(const std::vector<std::shared_ptr<GameObject>>&)> onCreated = nullptr);
+
+	// Calls Destroy() on the gameobject when applied, unless something else already destroyed it.
+	void Destroy(GameObjectHandle gameobject);
+
+	// Calls AddComponents() on the gameobject when applied, unless it's been destroyed.
+	void AddComponents(GameObjectHandle gameobject, const GameobjectCreateParams& params);
+
+	// Calls RemoveComponents() on the gameobject when applied, unless it's been destroyed.
+	void RemoveComponents(GameObjectHandle gameobject, std::vector<ComponentBitIndex::ComponentBitIndex> components);
+
+	// Makes all the recorded changes and clears the buffer. This is the sync point: call it from one thread, when nothing is iterating through components.
+	// Commands recorded while this is running (e.g. by onCreated callbacks) are left for the next call.
+	void Apply();
+
+private:
+	struct CreateCommand {
+		GameobjectCreateParams params;
+		unsigned int count;
+		std::function<void(const std::vector<std::shared_ptr<GameObject>>&)> onCreated;
+	};
+
+	struct DestroyCommand {
+		GameObjectHandle gameobject;
+	};
+
+	struct AddComponentsCommand {
+		GameObjectHandle gameobject;
+		GameobjectCreateParams params;
+	};
+
+	struct RemoveComponentsCommand {
+		GameObjectHandle gameobject;
+		std::vector<ComponentBitIndex::ComponentBitIndex> components;
+	};
+
+	using Command = std::variant<CreateCommand, DestroyCommand, AddComponentsCommand, RemoveComponentsCommand>;
+
+	std::mutex mutex;
+
+	// protected by mutex
+	std::vector<Command> commands;
+};
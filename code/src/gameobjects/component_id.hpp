@@ -21,13 +21,17 @@ namespace ComponentBitIndex {
 		RenderNoFO = 5,
 		AudioPlayer = 6,
 		Animation = 7,
-		Spotlight = 8
+		Spotlight = 8,
+
+		// Ids from here up to N_COMPONENT_TYPES - 1 are free for game code/modules to use for their own components (see RegisterComponentType()).
+		FirstUserComponent = 9
 	};
 };
 
 // How many different component classes there are. (can be greater just not less)
 static inline const unsigned int N_COMPONENT_TYPES = 16;
 
+// Specialize this for your own components too, returning an id between ComponentBitIndex::FirstUserComponent and N_COMPONENT_TYPES - 1.
 template<std::derived_from<BaseComponent> T>
 static constexpr ComponentBitIndex::ComponentBitIndex ComponentIdFromType();
 
@@ -1,4 +1,9 @@
 #include "component_pool.hpp"
+#include "component_registry.hpp"
+#include "debug/log.hpp"
+#include <new>
+#include <bit>
+#include <algorithm>
 
 //namespace {
 //	constexpr std::array<short, N_COMPONENT_TYPES> BaseOffsetArray() {
@@ -22,53 +27,43 @@
 //	}
 //}
 
+// rounds offset up to the next multiple of ComponentPool::COLUMN_ALIGNMENT
+unsigned int AlignColumn(unsigned int offset) {
+	return (offset + ComponentPool::COLUMN_ALIGNMENT - 1) / ComponentPool::COLUMN_ALIGNMENT * ComponentPool::COLUMN_ALIGNMENT;
+}
+
+// Returns the size of a page and the column layout of the given archetype.
 std::pair<unsigned int, std::vector<ComponentPool::ComponentMemoryInfo>> GetArchetypeLayoutAndSize(const std::bitset<N_COMPONENT_TYPES>& components) {
 
-	unsigned int currentOffset = sizeof(void*);
+	// the owner column comes first
+	unsigned int currentOffset = AlignColumn(sizeof(GameObject*) * ComponentPool::COMPONENTS_PER_PAGE);
 	std::vector<ComponentPool::ComponentMemoryInfo> layout;
 
-	// NOTE: VERY IMPORTANT THAT THIS IS SORTED BY BIT INDEX. (TODO might not actually matter lol)
-	if (components[ComponentBitIndex::Transform]) {
-		layout.push_back(ComponentPool::ComponentMemoryInfo{ .size = sizeof(TransformComponent), .offset = currentOffset, .componentId = ComponentBitIndex::Transform });
-		currentOffset += sizeof(TransformComponent);
-	}
-	if (components[ComponentBitIndex::Render]) {
-		layout.push_back(ComponentPool::ComponentMemoryInfo{ .size = sizeof(RenderComponent), .offset = currentOffset, .componentId = ComponentBitIndex::Render });
-		currentOffset += sizeof(TransformComponent);
-	}
-	if (components[ComponentBitIndex::Collider]) {
-		layout.push_back(ComponentPool::ComponentMemoryInfo{ .size = sizeof(ColliderComponent), .offset = currentOffset, .componentId = ComponentBitIndex::Collider });
-		currentOffset += sizeof(TransformComponent);
-	}
-	if (components[ComponentBitIndex::Rigidbody]) {
-		layout.push_back(ComponentPool::ComponentMemoryInfo{ .size = sizeof(RigidbodyComponent), .offset = currentOffset, .componentId = ComponentBitIndex::Rigidbody });
-		currentOffset += sizeof(TransformComponent);
-	}
-	if (components[ComponentBitIndex::Pointlight]) {
-		layout.push_back(ComponentPool::ComponentMemoryInfo{ .size = sizeof(PointLightComponent), .offset = currentOffset, .componentId = ComponentBitIndex::Pointlight });
-		currentOffset += sizeof(TransformComponent);
-	}
-	if (components[ComponentBitIndex::RenderNoFO]) {
-		layout.push_back(ComponentPool::ComponentMemoryInfo{ .size = sizeof(RenderComponentNoFO), .offset = currentOffset, .componentId = ComponentBitIndex::RenderNoFO });
-		currentOffset += sizeof(RenderComponentNoFO);
-	}
-	if (components[ComponentBitIndex::AudioPlayer]) {
-		layout.push_back(ComponentPool::ComponentMemoryInfo{ .size = sizeof(AudioPlayerComponent), .offset = currentOffset, .componentId = ComponentBitIndex::AudioPlayer });
-		currentOffset += sizeof(AudioPlayerComponent);
-	}
-	if (components[ComponentBitIndex::Animation]) {
-		layout.push_back(ComponentPool::ComponentMemoryInfo{ .size = sizeof(AnimationComponent), .offset = currentOffset, .componentId = ComponentBitIndex::Animation });
-		currentOffset += sizeof(AnimationComponent);
-	}
-	if (components[ComponentBitIndex::Spotlight]) {
-		layout.push_back(ComponentPool::ComponentMemoryInfo{ .size = sizeof(SpotLightComponent), .offset = currentOffset, .componentId = ComponentBitIndex::Spotlight });
-		currentOffset += sizeof(SpotLightComponent);
+	// sorted by component id, which ComponentPool::columnIndices and change versions rely on
+	for (unsigned int id = 0; id < N_COMPONENT_TYPES; id++) {
+		if (!components[id]) {
+			continue;
+		}
+
+		const ComponentTypeInfo* info = GetComponentTypeInfo(id);
+		if (info == nullptr) {
+			DebugLogError("Component id ", id, " was requested for a gameobject, but no component type was registered with that id. Call RegisterComponentType() first.");
+			abort();
+		}
+
+		// every column starts on a multiple of COLUMN_ALIGNMENT (and pages are allocated with that alignment), and sizeof is always a multiple of alignof, 
+			// so every component is correctly aligned as long as its alignment isn't any bigger than that.
+		Assert(info->alignment <= ComponentPool::COLUMN_ALIGNMENT);
+		Assert(info->size % info->alignment == 0);
+
+		layout.push_back(ComponentPool::ComponentMemoryInfo{ .size = info->size, .offset = currentOffset, .componentId = static_cast<int>(id) });
+		currentOffset = AlignColumn(currentOffset + info->size * ComponentPool::COMPONENTS_PER_PAGE);
 	}
 
 	return { currentOffset, layout };
 }
 
-unsigned int GetArchetypeSize(const std::bitset<N_COMPONENT_TYPES>& components) {
+unsigned int GetArchetypePageSize(const std::bitset<N_COMPONENT_TYPES>& components) {
 	return GetArchetypeLayoutAndSize(components).first;
 }
 
@@ -76,76 +71,250 @@ std::vector<ComponentPool::ComponentMemoryInfo> GetArchetypeLayout(const std::bi
 	return GetArchetypeLayoutAndSize(components).second;
 }
 
+std::array<int, N_COMPONENT_TYPES> GetColumnOffsets(const std::vector<ComponentPool::ComponentMemoryInfo>& layout) {
+	std::array<int, N_COMPONENT_TYPES> offsets;
+	offsets.fill(-1);
+	for (auto& info : layout) {
+		offsets[info.componentId] = info.offset;
+	}
+	return offsets;
+}
+
+std::array<int, N_COMPONENT_TYPES> GetColumnIndices(const std::vector<ComponentPool::ComponentMemoryInfo>& layout) {
+	std::array<int, N_COMPONENT_TYPES> indices;
+	indices.fill(-1);
+	for (unsigned int i = 0; i < layout.size(); i++) {
+		indices[layout[i].componentId] = i;
+	}
+	return indices;
+}
+
 ComponentPool::ComponentPool(const std::bitset<N_COMPONENT_TYPES>& components):
 	componentLayout(GetArchetypeLayout(components)),
-	objectSize(GetArchetypeSize(components))
+	archetype(components),
+	columnOffsets(GetColumnOffsets(componentLayout)),
+	columnIndices(GetColumnIndices(componentLayout)),
+	pageSize(GetArchetypePageSize(components)),
+	firstNonFullPage(0),
+	totalLive(0)
 {
 	AddPage();
 }
 
 ComponentPool::~ComponentPool() {
+	auto& ranges = PAGE_RANGES();
+	std::erase_if(ranges, [this](const PageRange& range) { return range.pool == this; });
+
 	for (auto & ptr: pages) {
-		delete ptr;
+		::operator delete[](ptr, std::align_val_t(COLUMN_ALIGNMENT));
 	}
 }
 
-std::tuple<void*, int, int> ComponentPool::GetObject() {
-	uint8_t* foundComponents = nullptr;
-	unsigned int pageI = 0;
-
-	// We use something called a "free list" to find a component set. If a component is not in use, the start of its memory is a pointer to the next unallocated component.
-	for (pageI = 0; pageI < firstFree.size(); pageI++) {
-		auto ptr = firstFree[pageI];
-		if (ptr != nullptr && ptr != LAST_COMPONENT) {
-			// then this component will work
-			foundComponents = ptr;
-
-			// this ptr is pointing to a ptr to the next component set on this page (or LAST_COMPONENT if none); update firstAvailable which that
-			firstFree[pageI] = *(uint8_t**)foundComponents;
+std::pair<int, int> ComponentPool::GetObject(GameObject* owner) {
 
-			break;
-		}
+	// find a page with room; firstNonFullPage means we don't have to look at every full page before it.
+	unsigned int pageI = firstNonFullPage;
+	while (pageI < pages.size() && liveCounts[pageI] == COMPONENTS_PER_PAGE) {
+		pageI++;
 	}
 
 	// if none of the pages have any space, make a new one
-	if (!foundComponents) {
+	if (pageI == pages.size()) {
 		AddPage();
-		pageI = static_cast<unsigned int>(pages.size() - 1);
-		foundComponents = firstFree.back();
-		firstFree.back() = *(uint8_t**)foundComponents;
 	}
 
-	// mark the ptr we got as in use
-	*(void**)foundComponents = nullptr;
+	// find the first clear bit in the page's occupancy bitmap
+	auto& bitmap = occupancy[pageI];
+	unsigned int wordI = 0;
+	while (bitmap[wordI] == ~uint64_t(0)) {
+		wordI++;
+	}
+	Assert(wordI < OCCUPANCY_WORDS_PER_PAGE);
+	unsigned int bitI = std::countr_zero(~bitmap[wordI]);
+
+	// mark the object as in use
+	bitmap[wordI] |= uint64_t(1) << bitI;
+	liveCounts[pageI]++;
+	totalLive++;
+	firstNonFullPage = pageI;
+
+	unsigned int objectIndex = wordI * 64 + bitI;
+	((GameObject**)pages[pageI])[objectIndex] = owner;
+
+	// new components count as changed
+	MarkAllChanged(pageI, objectIndex);
+
+	return std::make_pair(pageI, objectIndex);
+}
+
+void ComponentPool::GetObjects(unsigned int count, std::vector<std::pair<int, int>>& slots) {
+	slots.reserve(slots.size() + count);
+
+	unsigned int pageI = firstNonFullPage;
+	while (count > 0) {
+		if (pageI == pages.size()) {
+			AddPage();
+		}
+
+		// take every free slot on this page (or as many as we still need), a word of the occupancy bitmap at a time
+		auto& bitmap = occupancy[pageI];
+		for (unsigned int wordI = 0; wordI < OCCUPANCY_WORDS_PER_PAGE && count > 0 && liveCounts[pageI] != COMPONENTS_PER_PAGE; wordI++) {
+			uint64_t freeBits = ~bitmap[wordI];
+			while (freeBits != 0 && count > 0) {
+				unsigned int bitI = std::countr_zero(freeBits);
+				freeBits &= freeBits - 1; // clear lowest set bit
+
+				bitmap[wordI] |= uint64_t(1) << bitI;
+				liveCounts[pageI]++;
+				totalLive++;
+				count--;
 
-	unsigned int index = static_cast<int>(((char*)foundComponents - (char*)pages[pageI]) / objectSize);
-	Assert(foundComponents != nullptr);
+				unsigned int objectIndex = wordI * 64 + bitI;
+				((GameObject**)pages[pageI])[objectIndex] = nullptr;
+				MarkAllChanged(pageI, objectIndex);
+				slots.emplace_back(pageI, objectIndex);
+			}
+		}
 
-	return std::make_tuple(foundComponents, pageI, index);
+		if (liveCounts[pageI] == COMPONENTS_PER_PAGE) {
+			pageI++;
+		}
+	}
+
+	// everything before pageI is full now
+	firstNonFullPage = std::min(pageI, static_cast<unsigned int>(pages.size() - 1));
 }
 
 void ComponentPool::ReturnObject(int pageIndex, int objectIndex) {
-	// call object destructors
-	uint8_t* components = pages.at(pageIndex) + (objectIndex * objectSize);
+	Assert(IsLive(pageIndex, objectIndex));
+
+	occupancy.at(pageIndex)[objectIndex / 64] &= ~(uint64_t(1) << (objectIndex % 64));
+	liveCounts.at(pageIndex)--;
+	totalLive--;
 
-	// make the components the first node in the free list and have it point to what was previously the first node
-	*(uint8_t**)components = firstFree.at(pageIndex);
-	firstFree.at(pageIndex) = components;
+	if (static_cast<unsigned int>(pageIndex) < firstNonFullPage) {
+		firstNonFullPage = pageIndex;
+	}
 }
 
-void ComponentPool::AddPage() {
+unsigned int ComponentPool::NextLive(int pageIndex, unsigned int objectIndex) const {
+	if (objectIndex >= COMPONENTS_PER_PAGE) {
+		return COMPONENTS_PER_PAGE;
+	}
+
+	auto& bitmap = occupancy[pageIndex];
+	unsigned int wordI = objectIndex / 64;
+
+	// ignore the objects in the first word that come before objectIndex
+	uint64_t word = bitmap[wordI] & (~uint64_t(0) << (objectIndex % 64));
+	while (word == 0) {
+		wordI++;
+		if (wordI == OCCUPANCY_WORDS_PER_PAGE) {
+			return COMPONENTS_PER_PAGE;
+		}
+		word = bitmap[wordI];
+	}
+
+	return wordI * 64 + std::countr_zero(word);
+}
+
+int ComponentPool::LastLive(int pageIndex) const {
+	auto& bitmap = occupancy[pageIndex];
+	for (int wordI = OCCUPANCY_WORDS_PER_PAGE - 1; wordI >= 0; wordI--) {
+		if (bitmap[wordI] != 0) {
+			return wordI * 64 + 63 - std::countl_zero(bitmap[wordI]);
+		}
+	}
+	return -1;
+}
+
+void ComponentPool::ReleaseEmptyPages() {
+	while (pages.size() > 1 && liveCounts.back() == 0) {
+		auto& ranges = PAGE_RANGES();
+		ranges.erase(std::find_if(ranges.begin(), ranges.end(), [this](const PageRange& range) { return range.start == pages.back(); }));
+
+		::operator delete[](pages.back(), std::align_val_t(COLUMN_ALIGNMENT));
+		pages.pop_back();
+		occupancy.pop_back();
+		liveCounts.pop_back();
+		slotVersions.pop_back();
+		pageVersions.resize(pageVersions.size() - componentLayout.size());
+	}
 
-	unsigned int index = static_cast<int>(pages.size());
-	uint8_t* newPage = new uint8_t[COMPONENTS_PER_PAGE * objectSize];
+	if (firstNonFullPage >= pages.size()) {
+		firstNonFullPage = static_cast<unsigned int>(pages.size() - 1);
+	}
+}
+
+void ComponentPool::AddPage() {
+	uint8_t* newPage = static_cast<uint8_t*>(::operator new[](pageSize, std::align_val_t(COLUMN_ALIGNMENT)));
 
-	firstFree.push_back(newPage);
 	pages.push_back(newPage);
 
-	// for free list, we have to, for each location a set of components would be written, write a pointer to the next such location
-	for (unsigned int i = 0; i < COMPONENTS_PER_PAGE - 1; i++) {
+	// every object on a new page is free
+	occupancy.emplace_back();
+	occupancy.back().fill(0);
+	liveCounts.push_back(0);
 
-		*((uint8_t**)(newPage + (objectSize * i))) = ((uint8_t*)newPage + (objectSize * (i + 1)));
+	slotVersions.emplace_back(new uint32_t[componentLayout.size() * COMPONENTS_PER_PAGE]());
+	pageVersions.resize(pageVersions.size() + componentLayout.size(), 0);
+
+	auto& ranges = PAGE_RANGES();
+	PageRange range{ .start = newPage, .end = newPage + pageSize, .pool = this, .pageIndex = static_cast<unsigned int>(pages.size() - 1) };
+	ranges.insert(std::upper_bound(ranges.begin(), ranges.end(), range, [](const PageRange& a, const PageRange& b) { return a.start < b.start; }), range);
+}
+
+ComponentSlot ComponentPool::FindSlot(const void* component, int componentId) {
+	auto& ranges = PAGE_RANGES();
+	const uint8_t* address = static_cast<const uint8_t*>(component);
+
+	// find the last page that starts at or before the component
+	auto it = std::upper_bound(ranges.begin(), ranges.end(), address, [](const uint8_t* a, const PageRange& range) { return a < range.start; });
+	if (it == ranges.begin() || address >= (--it)->end) {
+		return ComponentSlot(); // not in a pool
+	}
+
+	ComponentPool* pool = it->pool;
+	int columnIndex = pool->columnIndices[componentId];
+	Assert(columnIndex != -1);
+	auto& info = pool->componentLayout[columnIndex];
+	unsigned int objectIndex = static_cast<unsigned int>(address - it->start - info.offset) / info.size;
+	Assert(objectIndex < COMPONENTS_PER_PAGE);
+
+	return ComponentSlot { .pool = pool, .columnIndex = columnIndex, .pageIndex = static_cast<int>(it->pageIndex), .objectIndex = static_cast<int>(objectIndex) };
+}
+
+void ComponentPool::MarkChangedAt(const void* component, int componentId) {
+	MarkChanged(FindSlot(component, componentId));
+}
+
+void ComponentPool::MarkObjectChangedAt(const void* component, int changedComponentId) {
+	auto& ranges = PAGE_RANGES();
+	const uint8_t* address = static_cast<const uint8_t*>(component);
+
+	auto it = std::upper_bound(ranges.begin(), ranges.end(), address, [](const uint8_t* a, const PageRange& range) { return a < range.start; });
+	if (it == ranges.begin() || address >= (--it)->end) {
+		return;
+	}
+
+	ComponentPool* pool = it->pool;
+	int changedColumnIndex = pool->columnIndices[changedComponentId];
+	if (changedColumnIndex == -1) {
+		return; // object doesn't have one
+	}
+
+	// we don't know which column the component is in, so find the one containing its address
+	unsigned int byteOffset = static_cast<unsigned int>(address - it->start);
+	for (auto& info : pool->componentLayout) {
+		if (byteOffset >= info.offset && byteOffset < info.offset + info.size * COMPONENTS_PER_PAGE) {
+			pool->MarkChanged(changedColumnIndex, it->pageIndex, (byteOffset - info.offset) / info.size);
+			return;
+		}
 	}
-	// last location just has LAST_COMPONENT/end of free list
-	*((uint8_t**)(newPage + (objectSize * (COMPONENTS_PER_PAGE - 1)))) = LAST_COMPONENT;
-}
\ No newline at end of file
+}
+
+std::vector<ComponentPool::PageRange>& ComponentPool::PAGE_RANGES() {
+	// never freed, because pools (and their destructors, which use this) are destroyed during static destruction in an unspecified order
+	static std::vector<PageRange>* ranges = new std::vector<PageRange>();
+	return *ranges;
+}
@@ -1,54 +1,217 @@
 #pragma once
 #include <vector>
 #include <bitset>
+#include <utility>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <atomic>
 #include "component_id.hpp"
+#include "component_slot.hpp"
+
+class GameObject;
 
 // Stores a specfic combination/archetype of components. So all gameobjects with just a transform would store their components in ComponentGroup<TransformComponent>,
 // while those with transform and render would store them in ComponentGroup<TransformComponent, RenderComponent>.
-// Uses a free list/bucket list combo to store components for rapid resizing + data locality
+// Uses a bucket list of pages + per-page occupancy bitmaps to store components for rapid resizing + data locality.
+// Each page is laid out as a struct of arrays: every component type gets its own contiguous column of COMPONENTS_PER_PAGE components,
+	// so a system that only reads transforms only pulls transforms through the cache instead of the whole object.
+// Every page also starts with an owner column storing a GameObject* for each object, so that compaction can tell gameobjects that their components moved.
 class ComponentPool {
 public:
 	struct ComponentMemoryInfo {
-		unsigned int size; // size of the component in bytes
-		unsigned int offset;
+		unsigned int size; // size of the component in bytes. Also the stride between consecutive components in its column.
+		unsigned int offset; // byte offset from the start of a page to the start of this component's column
 		int componentId;
 	};
 
 	constexpr static inline unsigned int COMPONENTS_PER_PAGE = 4096;
 
-	// used to get individual components from the void* returned by GetObject(). Sorted by component id.
+	// Number of 64-bit words in each page's occupancy bitmap.
+	constexpr static inline unsigned int OCCUPANCY_WORDS_PER_PAGE = COMPONENTS_PER_PAGE / 64;
+	static_assert(COMPONENTS_PER_PAGE % 64 == 0);
+
+	// Columns start on a multiple of this many bytes, so that the first component of every column begins on its own cache line.
+	constexpr static inline unsigned int COLUMN_ALIGNMENT = 64;
+
+	// used to find individual component columns on a page. Sorted by component id.
 	const std::vector<ComponentMemoryInfo> componentLayout;
 
+	// the combination of components stored in this pool
+	const std::bitset<N_COMPONENT_TYPES> archetype;
+
+	// For each component id, the byte offset from the start of a page to that component's column, or -1 if this archetype doesn't have that component.
+	// Same information as componentLayout, but you don't have to search for it.
+	const std::array<int, N_COMPONENT_TYPES> columnOffsets;
+
+	// For each component id, the index of that component's entry in componentLayout (which is also its column index for change versions), or -1 if this archetype doesn't have that component.
+	const std::array<int, N_COMPONENT_TYPES> columnIndices;
+
 	ComponentPool(const std::bitset<N_COMPONENT_TYPES>& components);
 	~ComponentPool();
 
-	// Returns a pointer to a new object's components, the page that pointer is on, and its object index on that page in that order..
-	// These components are uninitialized and you must call their constructors.
-	std::tuple<void*, int, int> GetObject();
+	// Returns the page and the object index on that page of a new object, in that order.
+	// The object's components are uninitialized and you must call their constructors.
+	// owner is stored in the owner column (may be nullptr if nothing will ever compact this pool).
+	std::pair<int, int> GetObject(GameObject* owner);
+
+	// Like GetObject() but for lots of objects at once; appends the page and object index of count new objects to slots.
+	// The objects are taken from the earliest free slots, so in an empty/compacted pool they'll be contiguous.
+	// Their owners are set to nullptr; use SetOwner() once you have them.
+	void GetObjects(unsigned int count, std::vector<std::pair<int, int>>& slots);
 
 	// Returns an object to the component pool.
 	// Doesn't call destructors.
 	void ReturnObject(int pageIndex, int objectIndex);
 
-	
-	
-private:
-	// represents that there's nothing else in the free list on this page after this one
-	constexpr static inline uint8_t* LAST_COMPONENT = (uint8_t*)1;
+	// Returns a pointer to the given object's component described by memoryInfo.
+	void* GetComponent(const ComponentMemoryInfo& memoryInfo, int pageIndex, int objectIndex) const {
+		return pages[pageIndex] + memoryInfo.offset + objectIndex * memoryInfo.size;
+	}
+
+	// Returns true if the given object is in use.
+	bool IsLive(int pageIndex, int objectIndex) const {
+		return (occupancy[pageIndex][objectIndex / 64] >> (objectIndex % 64)) & 1;
+	}
+
+	// Returns the number of objects in use on the given page.
+	unsigned int LiveCount(int pageIndex) const {
+		return liveCounts[pageIndex];
+	}
+
+	// Returns the index of the first object in use on the given page at or after objectIndex, or COMPONENTS_PER_PAGE if there are none.
+	unsigned int NextLive(int pageIndex, unsigned int objectIndex) const;
+
+	// Returns the index of the last object in use on the given page, or -1 if there are none.
+	int LastLive(int pageIndex) const;
+
+	// Returns the gameobject that was passed to GetObject() for the given object.
+	GameObject* GetOwner(int pageIndex, int objectIndex) const {
+		return ((GameObject**)pages[pageIndex])[objectIndex];
+	}
+
+	// Changes the gameobject stored in the owner column for the given object.
+	void SetOwner(int pageIndex, int objectIndex, GameObject* owner) {
+		((GameObject**)pages[pageIndex])[objectIndex] = owner;
+	}
+
+	// Returns the number of objects in use on all pages.
+	unsigned int LiveObjectCount() const {
+		return totalLive;
+	}
+
+	// Frees pages at the end of the pool that have no live objects (except for the first page, which is always kept).
+	// Pages in the middle can't be freed because objects refer to their page by index; compaction moves objects off of the last pages so that this can free them.
+	void ReleaseEmptyPages();
+
+	// CHANGE VERSIONS
+	// Every component of every object has a change version, and every column of every page has the newest change version of any component in it.
+	// Writing to a component (or creating it) stamps it with the current change version, so a system can remember the version it last ran at and skip everything
+		// (whole pages at a time) that hasn't changed since (see SystemQuery::IterateChangedSince()).
+	// Transform components stamp themselves whenever they're moved; other components are stamped when they're created or moved to a different slot, 
+		// or when someone calls GameObject::MarkChanged()/SystemForwardIterator::MarkChanged() after writing to them.
+	// Different threads can stamp different objects at the same time (the physics engine's islands move their transforms in parallel, for example),
+		// as long as nothing calls AdvanceChangeVersion() or adds/removes objects or pages while they do. Reading versions isn't safe until they're done.
+
+	// Makes anything stamped from now on count as changed for a system that last ran at the returned version. 
+	// Call at the start of a system and pass what it returned last time to IterateChangedSince() (0 the first time, which gets you everything).
+	static uint32_t AdvanceChangeVersion() {
+		return CHANGE_VERSION++; // wraps around after 4 billion calls, which isn't going to happen
+	}
+
+	// Stamps the component in the given column of the given object with the current change version.
+	void MarkChanged(int columnIndex, int pageIndex, int objectIndex) {
+		slotVersions[pageIndex][columnIndex * COMPONENTS_PER_PAGE + objectIndex] = CHANGE_VERSION;
 
-	// the combined size in bytes of an object's components in the pool, + sizeof(uint8_t*) bytes.
-	// This uint8_t* at the start of each object's memory stores nullptr if the object is live/in use, LAST_COMPONENT if there are no more available objects in the page's free list after this one, or a pointer to the next free component otherwise
-	const unsigned int objectSize;
+		// Other objects on the page can be stamped from other threads. They'd all store the same version (it only changes between systems), so a relaxed store is enough.
+		std::atomic_ref<uint32_t>(pageVersions[pageIndex * componentLayout.size() + columnIndex]).store(CHANGE_VERSION, std::memory_order_relaxed);
+	}
 
-	// Vector of arrays of length objectSize * COMPONENTS_PER_PAGE which store components.
+	// Same as above, for a slot from FindSlot(). Does nothing if the component isn't in a pool.
+	static void MarkChanged(const ComponentSlot& slot) {
+		if (slot.pool != nullptr) {
+			slot.pool->MarkChanged(slot.columnIndex, slot.pageIndex, slot.objectIndex);
+		}
+	}
+
+	// Stamps every component of the given object with the current change version.
+	void MarkAllChanged(int pageIndex, int objectIndex) {
+		for (unsigned int columnIndex = 0; columnIndex < componentLayout.size(); columnIndex++) {
+			MarkChanged(columnIndex, pageIndex, objectIndex);
+		}
+	}
+
+	// Returns where the component at the given address, which must be the component with the given id of an object in some component pool, is stored (pool is nullptr if it isn't in one).
+	// For components that don't know which gameobject they belong to (like TransformComponent); does a binary search over every page of every pool,
+		// so hold onto the slot if you stamp the same component a lot. It stays good until the component is destroyed (compaction moves components by making new ones).
+	static ComponentSlot FindSlot(const void* component, int componentId);
+
+	// Stamps the component at the given address with the current change version. Same as MarkChanged(FindSlot(component, componentId)), so prefer MarkChanged() when you can.
+	static void MarkChangedAt(const void* component, int componentId);
+
+	// Stamps the component with id changedComponentId (if there is one) of the object that the component at the given address belongs to.
+	// For when a component changed in a way that means another component of the same object has to be looked at again, like a render component getting a new instance slot that needs its transform's matrices.
+	static void MarkObjectChangedAt(const void* component, int changedComponentId);
+
+	// Returns true if the component in the given column of the given object was stamped after version.
+	bool ChangedSince(int columnIndex, int pageIndex, int objectIndex, uint32_t version) const {
+		return slotVersions[pageIndex][columnIndex * COMPONENTS_PER_PAGE + objectIndex] > version;
+	}
+
+	// Returns true if any component in the given column of the given page was stamped after version.
+	bool PageChangedSince(int columnIndex, int pageIndex, uint32_t version) const {
+		return pageVersions[pageIndex * componentLayout.size() + columnIndex] > version;
+	}
+
+	// Returns the number of pages allocated so far, including empty ones.
+	unsigned int PageCount() const {
+		return static_cast<unsigned int>(pages.size());
+	}
+
+private:
+	// Size in bytes of a single page, including the owner column and any padding between columns.
+	const unsigned int pageSize;
+
+	// Vector of arrays of length pageSize which store components.
 	// to avoid frequent/expensive reallocations and ensure components are in mostly contiguous memory for cache-friendliness, we allocate components in batches of COMPONENTS_PER_PAGE.
 	std::vector<uint8_t*> pages;
 
-	// for each page, a pointer to the first free object in each page, or nullptr if none.
-	std::vector<uint8_t*> firstFree;
+	// For each page, a bitmap with a bit set for every object that is live/in use.
+	// Kept outside the pages so that finding live objects only touches COMPONENTS_PER_PAGE/8 bytes per page instead of a whole column.
+	std::vector<std::array<uint64_t, OCCUPANCY_WORDS_PER_PAGE>> occupancy;
+
+	// For each page, the number of set bits in its occupancy bitmap. Lets iteration skip empty pages and GetObject() skip full ones without looking at the bitmap.
+	std::vector<unsigned int> liveCounts;
+
+	// No page before this one has any free objects.
+	unsigned int firstNonFullPage;
+
+	// sum of liveCounts
+	unsigned int totalLive;
+
+	// For each page, the change version of each component of each object, column by column (so componentLayout.size() * COMPONENTS_PER_PAGE of them).
+	// Kept outside the pages for the same reason as occupancy.
+	std::vector<std::unique_ptr<uint32_t[]>> slotVersions;
+
+	// For each page, the newest change version in each column (componentLayout.size() per page).
+	std::vector<uint32_t> pageVersions;
+
+	// starts at 1 so that everything counts as changed for a system that's never run (and so passes 0)
+	static inline uint32_t CHANGE_VERSION = 1;
+
+	// Where a page is in memory, so MarkChangedAt() can figure out which pool and object a component belongs to.
+	struct PageRange {
+		const uint8_t* start;
+		const uint8_t* end;
+		ComponentPool* pool;
+		unsigned int pageIndex;
+	};
+
+	// Every page of every pool, sorted by start.
+	static std::vector<PageRange>& PAGE_RANGES();
 
 	// creates a new page with room for COMPONENTS_PER_PAGE more objects.
 	void AddPage();
 
 	friend class GameObject;
-};
\ No newline at end of file
+};
@@ -0,0 +1,45 @@
+#include "component_registry.hpp"
+#include "debug/assert.hpp"
+#include "debug/log.hpp"
+#include <array>
+#include <optional>
+
+namespace {
+	std::array<std::optional<ComponentTypeInfo>, N_COMPONENT_TYPES>& COMPONENT_TYPES() {
+		static std::array<std::optional<ComponentTypeInfo>, N_COMPONENT_TYPES> types = []() {
+			std::array<std::optional<ComponentTypeInfo>, N_COMPONENT_TYPES> builtIn;
+			builtIn[ComponentBitIndex::Transform] = MakeComponentTypeInfo<TransformComponent>("Transform");
+			builtIn[ComponentBitIndex::Render] = MakeComponentTypeInfo<RenderComponent>("Render");
+			builtIn[ComponentBitIndex::Collider] = MakeComponentTypeInfo<ColliderComponent>("Collider");
+			builtIn[ComponentBitIndex::Rigidbody] = MakeComponentTypeInfo<RigidbodyComponent>("Rigidbody");
+			builtIn[ComponentBitIndex::Pointlight] = MakeComponentTypeInfo<PointLightComponent>("Pointlight");
+			builtIn[ComponentBitIndex::RenderNoFO] = MakeComponentTypeInfo<RenderComponentNoFO>("RenderNoFO");
+			builtIn[ComponentBitIndex::AudioPlayer] = MakeComponentTypeInfo<AudioPlayerComponent>("AudioPlayer");
+			builtIn[ComponentBitIndex::Animation] = MakeComponentTypeInfo<AnimationComponent>("Animation");
+			builtIn[ComponentBitIndex::Spotlight] = MakeComponentTypeInfo<SpotLightComponent>("Spotlight");
+			return builtIn;
+		}();
+		return types;
+	}
+}
+
+const ComponentTypeInfo* GetComponentTypeInfo(int componentId) {
+	Assert(componentId >= 0 && componentId < N_COMPONENT_TYPES);
+	auto& info = COMPONENT_TYPES()[componentId];
+	return info.has_value() ? &info.value() : nullptr;
+}
+
+void RegisterComponentTypeInfo(int componentId, const ComponentTypeInfo& info) {
+	if (componentId < ComponentBitIndex::FirstUserComponent || componentId >= N_COMPONENT_TYPES) {
+		DebugLogError("Can't register component type ", info.name, " with id ", componentId, "; user components need ids from ", (int)ComponentBitIndex::FirstUserComponent, " to ", N_COMPONENT_TYPES - 1, ".");
+		abort();
+	}
+
+	auto& slot = COMPONENT_TYPES()[componentId];
+	if (slot.has_value()) {
+		DebugLogError("Can't register component type ", info.name, " with id ", componentId, "; ", slot->name, " already has that id.");
+		abort();
+	}
+
+	slot = info;
+}
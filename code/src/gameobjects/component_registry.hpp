@@ -0,0 +1,57 @@
+#pragma once
+#include "component_id.hpp"
+#include <type_traits>
+#include <memory>
+
+// Everything component pools and gameobjects need to know about a type of component to store it without knowing the type at compile time.
+// Built in components are registered automatically; game code/modules can register their own with RegisterComponentType() and then use them like any other component.
+struct ComponentTypeInfo {
+	const char* name;
+
+	// sizeof and alignof the component; component columns have a stride of size and start at a multiple of alignment.
+	unsigned int size;
+	unsigned int alignment;
+
+	// Default constructs a component in the given memory. Only used for user components; built in components get their constructor arguments from GameobjectCreateParams.
+	void (*construct)(void* component);
+
+	// Move constructs a component at to from the one at from, then destroys what's left at from.
+	void (*relocate)(void* from, void* to);
+
+	void (*destroy)(void* component);
+};
+
+// Returns the type info for the given component id, or nullptr if nothing has been registered with that id.
+const ComponentTypeInfo* GetComponentTypeInfo(int componentId);
+
+// Do not call, use RegisterComponentType().
+void RegisterComponentTypeInfo(int componentId, const ComponentTypeInfo& info);
+
+// Fills out everything but construct.
+template <std::derived_from<BaseComponent> T>
+ComponentTypeInfo MakeComponentTypeInfo(const char* name) {
+	return ComponentTypeInfo{
+		.name = name,
+		.size = sizeof(T),
+		.alignment = alignof(T),
+		.construct = nullptr,
+		.relocate = [](void* from, void* to) {
+			std::construct_at((T*)to, std::move(*(T*)from));
+			std::destroy_at((T*)from);
+		},
+		.destroy = [](void* component) { std::destroy_at((T*)component); }
+	};
+}
+
+// Lets gameobjects have components of type T, so gameplay data can be stored in component pools with everything else instead of in maps on the side.
+// You have to specialize ComponentIdFromType<T>() first (see component_id.hpp). Call before creating any gameobjects with T.
+// T is default constructed when a gameobject with it is created, and must be movable since compaction and AddComponents()/RemoveComponents() move components around.
+template <std::derived_from<BaseComponent> T>
+void RegisterComponentType(const char* name) {
+	static_assert(std::is_default_constructible_v<T>, "Components must be default constructible.");
+	static_assert(std::is_nothrow_move_constructible_v<T>, "Components must have a noexcept move constructor.");
+
+	ComponentTypeInfo info = MakeComponentTypeInfo<T>(name);
+	info.construct = [](void* component) { std::construct_at((T*)component); };
+	RegisterComponentTypeInfo(ComponentIdFromType<T>(), info);
+}
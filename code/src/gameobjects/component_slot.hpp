@@ -0,0 +1,12 @@
+#pragma once
+
+class ComponentPool;
+
+// Where a component is stored: which pool, which of its columns (see ComponentPool::columnIndices) and which object on which page.
+// Its own header so that components can hold onto one without including component_pool.hpp (which includes every component).
+struct ComponentSlot {
+	ComponentPool* pool = nullptr; // nullptr if the component isn't in a pool
+	int columnIndex = -1;
+	int pageIndex = -1;
+	int objectIndex = -1;
+};
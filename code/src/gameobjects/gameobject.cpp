@@ -1,5 +1,8 @@
 #include "gameobject.hpp"
 #include "component_field_initializer.hpp"
+#include "component_registry.hpp"
+#include "../utility/utility.hpp"
+#include <algorithm>
 
 // Used to make shared_ptr for GameObject, which lacks a public constructor
 template <typename... Args>
@@ -15,14 +18,26 @@ inline std::shared_ptr<GameObject> protected_make_shared(Args&&... args)
     return std::make_shared< helper >(std::forward< Args >(args)...);
 }
 
-std::tuple<ComponentPool*, int, int> GameObject::GetNewGameobjectComponentData(const GameobjectCreateParams& params) {
-    if (!COMPONENT_POOLS.contains(params.requestedComponents)) {
-        COMPONENT_POOLS.emplace(params.requestedComponents, new ComponentPool(params.requestedComponents));
+ComponentPool* GameObject::GetPool(const std::bitset<N_COMPONENT_TYPES>& archetype) {
+    // TODO: can the transform comp restriction ever be lifted?
+    Assert(archetype[ComponentBitIndex::Transform]);
+    // can't have both kinds of rendercomponent
+    Assert((archetype[ComponentBitIndex::Render] && archetype[ComponentBitIndex::RenderNoFO]) == false);
+    // animation components need a render component to animate. TODO: RenderNoFO???? How????
+    Assert(!archetype[ComponentBitIndex::Animation] || archetype[ComponentBitIndex::Render]);
+
+    if (!COMPONENT_POOLS.contains(archetype)) {
+        COMPONENT_POOLS.emplace(archetype, new ComponentPool(archetype));
+        POOLS_IN_CREATION_ORDER.push_back(COMPONENT_POOLS.at(archetype).get());
     }
 
-    std::unique_ptr<ComponentPool>& pool = COMPONENT_POOLS.at(params.requestedComponents);
-    auto [components, page, objectIndex] = pool->GetObject(); // TODO: components return is pointless
-    return std::make_tuple(pool.get(), page, objectIndex);
+    return COMPONENT_POOLS.at(archetype).get();
+}
+
+std::tuple<ComponentPool*, int, int> GameObject::GetNewGameobjectComponentData(const GameobjectCreateParams& params, GameObject* owner) {
+    ComponentPool* pool = GetPool(params.requestedComponents);
+    auto [page, objectIndex] = pool->GetObject(owner);
+    return std::make_tuple(pool, page, objectIndex);
 }
 
 std::shared_ptr<GameObject> GameObject::New(const GameobjectCreateParams& params) {
@@ -31,33 +46,100 @@ std::shared_ptr<GameObject> GameObject::New(const GameobjectCreateParams& params
 
     // we NEVER delete pools except when program ends (before which all gameobjects are destroyed) so this is fine
     auto ptr = protected_make_shared(params);
+    Register(ptr);
+    return ptr;
+}
 
-    GAMEOBJECTS()[ptr.get()] = ptr;
+std::vector<std::shared_ptr<GameObject>> GameObject::NewBatch(const GameobjectCreateParams& params, unsigned int count) {
+    std::vector<std::shared_ptr<GameObject>> gameobjects;
+    if (count == 0) {
+        return gameobjects;
+    }
 
-    return ptr;
+    // reserve all the slots at once; in a fresh or compacted pool they're contiguous, so the components below get constructed in order down each column
+    ComponentPool* pool = GetPool(params.requestedComponents);
+    std::vector<std::pair<int, int>> slots;
+    slots.reserve(count);
+    pool->GetObjects(count, slots);
+
+    gameobjects.reserve(count);
+    std::vector<GameObject*> rawGameobjects;
+    rawGameobjects.reserve(count);
+    for (auto& [page, objectIndex] : slots) {
+        auto ptr = protected_make_shared(std::make_tuple(pool, page, objectIndex));
+        pool->SetOwner(page, objectIndex, ptr.get());
+        rawGameobjects.push_back(ptr.get());
+        gameobjects.push_back(std::move(ptr));
+    }
+
+    ConstructComponents(params, params.requestedComponents, rawGameobjects);
+
+    // grow the registry once instead of once per gameobject
+    auto& registry = REGISTRY();
+    registry.slots.reserve(registry.slots.size() + count);
+    for (auto& ptr : gameobjects) {
+        Register(ptr);
+    }
+
+    return gameobjects;
+}
+
+void GameObject::Register(const std::shared_ptr<GameObject>& ptr) {
+    // put it in the registry, reusing a free slot if there is one
+    auto& registry = REGISTRY();
+    uint32_t index;
+    if (registry.firstFree == NO_FREE_SLOT) {
+        index = static_cast<uint32_t>(registry.slots.size());
+        registry.slots.push_back(RegistrySlot{ .object = nullptr, .generation = 1, .nextFree = NO_FREE_SLOT });
+    }
+    else {
+        index = registry.firstFree;
+        registry.firstFree = registry.slots[index].nextFree;
+    }
+
+    registry.slots[index].object = ptr;
+    ptr->handle = GameObjectHandle{ .index = index, .generation = registry.slots[index].generation };
 }
 
 GameObject::GameObject(const GameobjectCreateParams& params):
-    GameObject(GetNewGameobjectComponentData(params))
+    GameObject(GetNewGameobjectComponentData(params, this))
 {
+    GameObject* self = this;
+    ConstructComponents(params, params.requestedComponents, std::span<GameObject* const>(&self, 1));
+}
+
+void GameObject::ConstructComponents(const GameobjectCreateParams& params, const std::bitset<N_COMPONENT_TYPES>& components, std::span<GameObject* const> gameobjects) {
     int materialId = params.materialId == 0 ? GraphicsEngine::Get().defaultMaterial->id : params.materialId;
     Assert(materialId != 0);
 
-    // TODO: can the transform comp restriction ever be lifted?
-    Assert(params.requestedComponents[ComponentBitIndex::Transform]);
-    if (params.requestedComponents[ComponentBitIndex::Transform]) {
-        auto ptr = RawGet<TransformComponent>();
-        std::construct_at(ptr);
+    // Each component type is constructed for every gameobject before moving on to the next type, so a batch walks down one column at a time.
+
+    if (components[ComponentBitIndex::Transform]) {
+        for (auto gameobject : gameobjects) {
+            std::construct_at(gameobject->RawGet<TransformComponent>());
+        }
     }
-    // can't have both kinds of rendercomponent
-    Assert((params.requestedComponents[ComponentBitIndex::Render] && params.requestedComponents[ComponentBitIndex::RenderNoFO]) == false);
-    if (params.requestedComponents[ComponentBitIndex::Render] || params.requestedComponents[ComponentBitIndex::RenderNoFO]) {
+    if (components[ComponentBitIndex::Render] || components[ComponentBitIndex::RenderNoFO]) {
         Assert(Mesh::Get(params.meshId)); // verify that we were given a valid meshId
-        std::construct_at(RawGet<RenderComponent>(), params.meshId, materialId);
+        for (auto gameobject : gameobjects) {
+            std::construct_at(gameobject->RawGet<RenderComponent>(), params.meshId, materialId);
+        }
     }
-    if (params.requestedComponents[ComponentBitIndex::Collider] || params.requestedComponents[ComponentBitIndex::Rigidbody]) {
+    if (params.colliderShape == ColliderShapeHeightfield && (components[ComponentBitIndex::Collider] || components[ComponentBitIndex::Rigidbody])) {
+        // heightfields don't have a physics mesh, and can't have a rigidbody since they're always level and have no moment of inertia
+        if (params.heightfield == std::nullopt || components[ComponentBitIndex::Rigidbody]) {
+            DebugLogError("Heightfield colliders need a heightfield, and can't have a RigidbodyComponent.");
+            abort();
+        }
+
+        for (auto gameobject : gameobjects) {
+            std::construct_at(gameobject->RawGet<ColliderComponent>(), gameobject, params.heightfield.value());
+        }
+    }
+    else if (components[ComponentBitIndex::Collider] || components[ComponentBitIndex::Rigidbody]) {
         std::shared_ptr<PhysicsMesh> physMesh;
 
+        // only done once per batch, so every gameobject in it shares the physics mesh
         if (params.physMesh == std::nullopt) {
             if (params.meshId == 0) {
                 DebugLogError("When trying to create a ColliderComponent, no PhysicsMesh was given, and no MeshId was given to produce one with.");
@@ -73,28 +155,49 @@ GameObject::GameObject(const GameobjectCreateParams& params):
 
         Assert(physMesh != nullptr);
 
-        if (params.requestedComponents[ComponentBitIndex::Collider]) {
-            std::construct_at(RawGet<ColliderComponent>(), this, physMesh);
+        if (components[ComponentBitIndex::Collider]) {
+            for (auto gameobject : gameobjects) {
+                std::construct_at(gameobject->RawGet<ColliderComponent>(), gameobject, physMesh, params.colliderShape);
+            }
         }
-        if (params.requestedComponents[ComponentBitIndex::Rigidbody]) {
-            std::construct_at(RawGet<RigidbodyComponent>(), physMesh);
+        if (components[ComponentBitIndex::Rigidbody]) {
+            for (auto gameobject : gameobjects) {
+                std::construct_at(gameobject->RawGet<RigidbodyComponent>(), physMesh);
+            }
         }
     };
     
-    if (params.requestedComponents[ComponentBitIndex::Pointlight]) {
-        std::construct_at(RawGet<PointLightComponent>());
+    if (components[ComponentBitIndex::Pointlight]) {
+        for (auto gameobject : gameobjects) {
+            std::construct_at(gameobject->RawGet<PointLightComponent>());
+        }
     }
     
-    if (params.requestedComponents[ComponentBitIndex::AudioPlayer]) {
-        std::construct_at(RawGet<AudioPlayerComponent>(), params.sound);
+    if (components[ComponentBitIndex::AudioPlayer]) {
+        for (auto gameobject : gameobjects) {
+            std::construct_at(gameobject->RawGet<AudioPlayerComponent>(), params.sound);
+        }
     }
 
-    if (params.requestedComponents[ComponentBitIndex::Animation]) {
-        Assert(params.requestedComponents[ComponentBitIndex::Render]); // TODO: RenderNoFO???? How????
-        std::construct_at(RawGet<AnimationComponent>(), RawGet<RenderComponent>());
+    if (components[ComponentBitIndex::Animation]) {
+        for (auto gameobject : gameobjects) {
+            std::construct_at(gameobject->RawGet<AnimationComponent>(), gameobject->RawGet<RenderComponent>());
+        }
     }
-    if (params.requestedComponents[ComponentBitIndex::Spotlight]) {
-        std::construct_at(RawGet<SpotLightComponent>());
+    if (components[ComponentBitIndex::Spotlight]) {
+        for (auto gameobject : gameobjects) {
+            std::construct_at(gameobject->RawGet<SpotLightComponent>());
+        }
+    }
+
+    // components registered by game code/modules are just default constructed
+    for (unsigned int id = ComponentBitIndex::FirstUserComponent; id < N_COMPONENT_TYPES; id++) {
+        if (components[id]) {
+            const ComponentTypeInfo* info = GetComponentTypeInfo(id);
+            for (auto gameobject : gameobjects) {
+                info->construct(gameobject->pool->pages[gameobject->page] + gameobject->pool->columnOffsets[id] + gameobject->objectIndex * info->size);
+            }
+        }
     }
 
     //for (auto& initializer : params.componentFieldInitializers) {
@@ -114,41 +217,182 @@ GameObject::GameObject(std::tuple<ComponentPool*, int, int> data) :
 }
 
 GameObject::~GameObject() {
-    if (MaybeRawGet<TransformComponent>()) {
-        std::destroy_at(RawGet<TransformComponent>());
-    }
-    if (MaybeRawGet<RenderComponent>()) {
-        std::destroy_at(RawGet<RenderComponent>());
+    for (auto& info : pool->componentLayout) {
+        DestroyComponent(info.componentId, pool->GetComponent(info, page, objectIndex));
     }
-    if (MaybeRawGet<RigidbodyComponent>()) {
-        std::destroy_at(RawGet<RigidbodyComponent>());
-    }
-    if (MaybeRawGet<ColliderComponent>()) {
-        std::destroy_at(RawGet<ColliderComponent>());
+
+    pool->ReturnObject(page, objectIndex);
+}
+
+void GameObject::RelocateComponent(int componentId, void* from, void* to) {
+    GetComponentTypeInfo(componentId)->relocate(from, to);
+}
+
+void GameObject::DestroyComponent(int componentId, void* component) {
+    GetComponentTypeInfo(componentId)->destroy(component);
+}
+
+void GameObject::MoveToSlot(int newPage, int newObjectIndex) {
+    for (auto& info : pool->componentLayout) {
+        RelocateComponent(info.componentId, pool->GetComponent(info, page, objectIndex), pool->GetComponent(info, newPage, newObjectIndex));
     }
+
+    int oldPage = page;
+    int oldObjectIndex = objectIndex;
+    page = newPage;
+    objectIndex = newObjectIndex;
+    pool->ReturnObject(oldPage, oldObjectIndex);
+
+    // animation components point to the render component of the same gameobject, which just moved too
     if (MaybeRawGet<AnimationComponent>()) {
-        std::destroy_at(RawGet<AnimationComponent>());
+        RawGet<AnimationComponent>()->renderComponent = RawGet<RenderComponent>();
     }
-    if (MaybeRawGet<PointLightComponent>()) {
-        std::destroy_at(RawGet<PointLightComponent>());
+}
+
+void GameObject::ChangeArchetype(const std::bitset<N_COMPONENT_TYPES>& newArchetype, const GameobjectCreateParams& params) {
+    if (newArchetype == pool->archetype) {
+        return;
     }
-    if (MaybeRawGet<SpotLightComponent>()) {
-        std::destroy_at(RawGet<SpotLightComponent>());
+
+    ComponentPool* newPool = GetPool(newArchetype);
+    auto [newPage, newObjectIndex] = newPool->GetObject(this);
+
+    // destroy removed components first, while everything else (like the transform) is still where their destructors expect it
+    for (auto& info : pool->componentLayout) {
+        if (!newArchetype[info.componentId]) {
+            DestroyComponent(info.componentId, pool->GetComponent(info, page, objectIndex));
+        }
     }
-    if (MaybeRawGet<AudioPlayerComponent>()) {
-        std::destroy_at(RawGet<AudioPlayerComponent>());
+
+    // then move the components we're keeping; the column layout is different in the new pool, so go by component id
+    for (auto& info : pool->componentLayout) {
+        if (newArchetype[info.componentId]) {
+            void* to = newPool->pages[newPage] + newPool->columnOffsets[info.componentId] + newObjectIndex * info.size;
+            RelocateComponent(info.componentId, pool->GetComponent(info, page, objectIndex), to);
+        }
     }
 
+    std::bitset<N_COMPONENT_TYPES> addedComponents = newArchetype & ~pool->archetype;
+
     pool->ReturnObject(page, objectIndex);
+    pool = newPool;
+    page = newPage;
+    objectIndex = newObjectIndex;
+
+    if (MaybeRawGet<AnimationComponent>() && !addedComponents[ComponentBitIndex::Animation]) {
+        RawGet<AnimationComponent>()->renderComponent = RawGet<RenderComponent>();
+    }
+
+    if (addedComponents.any()) {
+        GameObject* self = this;
+        ConstructComponents(params, addedComponents, std::span<GameObject* const>(&self, 1));
+    }
+}
+
+void GameObject::AddComponents(const GameobjectCreateParams& params) {
+    ChangeArchetype(pool->archetype | params.requestedComponents, params);
+}
+
+void GameObject::RemoveComponents(const std::vector<ComponentBitIndex::ComponentBitIndex>& components) {
+    std::bitset<N_COMPONENT_TYPES> newArchetype = pool->archetype;
+    for (auto& i : components) {
+        newArchetype[i] = false;
+    }
+
+    // nothing gets constructed, so these params are never looked at
+    ChangeArchetype(newArchetype, GameobjectCreateParams(std::vector<ComponentBitIndex::ComponentBitIndex>()));
+}
+
+bool GameObject::CompactionStep(ComponentPool* pool) {
+    pool->ReleaseEmptyPages();
+
+    // only worth moving things if it will let us free a page
+    unsigned int pagesNeeded = std::max(1u, (pool->LiveObjectCount() + ComponentPool::COMPONENTS_PER_PAGE - 1) / ComponentPool::COMPONENTS_PER_PAGE);
+    if (pool->PageCount() <= pagesNeeded) {
+        return false;
+    }
+
+    // ReleaseEmptyPages() guarantees the last page has something on it
+    int lastPage = pool->PageCount() - 1;
+    int lastObject = pool->LastLive(lastPage);
+    Assert(lastObject != -1);
+
+    GameObject* owner = pool->GetOwner(lastPage, lastObject);
+    Assert(owner != nullptr);
+
+    // since we have more pages than we need, there's guaranteed to be a free slot on an earlier page, and GetObject() always uses the earliest one
+    auto [newPage, newObjectIndex] = pool->GetObject(owner);
+    Assert(newPage < lastPage);
+
+    owner->MoveToSlot(newPage, newObjectIndex);
+    return true;
+}
+
+void GameObject::CompactComponentPools(double timeBudget) {
+    double start = Time();
+
+    // checking the time isn't free, so only do it every few moves
+    const unsigned int MOVES_PER_TIME_CHECK = 32;
+
+    for (auto& pool : POOLS_IN_CREATION_ORDER) {
+        bool moreToDo = true;
+        while (moreToDo) {
+            for (unsigned int i = 0; i < MOVES_PER_TIME_CHECK && moreToDo; i++) {
+                moreToDo = CompactionStep(pool);
+            }
+
+            if (Time() - start > timeBudget) {
+                pool->ReleaseEmptyPages();
+                return;
+            }
+        }
+    }
+}
+
+std::shared_ptr<GameObject> GameObject::FreeRegistrySlot() {
+    Assert(Resolve(handle) == this);
+
+    auto& registry = REGISTRY();
+    auto& slot = registry.slots[handle.index];
+
+    std::shared_ptr<GameObject> lastReference = std::move(slot.object);
+
+    // bump the generation so existing handles stop resolving (skipping 0, which default constructed handles use)
+    slot.generation++;
+    if (slot.generation == 0) {
+        slot.generation = 1;
+    }
+
+    slot.nextFree = registry.firstFree;
+    registry.firstFree = handle.index;
+
+    return lastReference;
 }
 
 void GameObject::Destroy() {
-    // TODO
-    Assert(GAMEOBJECTS().count(this));
-    GAMEOBJECTS().erase(this);
+    // if the registry had the last reference, the gameobject is destroyed when this goes out of scope, so don't touch the registry or this after that
+    std::shared_ptr<GameObject> lastReference = FreeRegistrySlot();
+}
+
+void GameObject::DestroyBatch(const std::vector<std::shared_ptr<GameObject>>& gameobjects) {
+    // Free every registry slot first and only then let go of the registry's references, so that none of the gameobject destructors run while we're still going through the registry.
+    std::vector<std::shared_ptr<GameObject>> lastReferences;
+    lastReferences.reserve(gameobjects.size());
+    for (auto& gameobject : gameobjects) {
+        lastReferences.push_back(gameobject->FreeRegistrySlot());
+    }
+    lastReferences.clear();
+}
+
+std::shared_ptr<GameObject> GameObject::Lock(GameObjectHandle handle) {
+    GameObject* gameobject = Resolve(handle);
+    if (gameobject == nullptr) {
+        return nullptr;
+    }
+    return REGISTRY().slots[handle.index].object;
 }
 
-std::unordered_map<GameObject*, std::shared_ptr<GameObject>>& GameObject::GAMEOBJECTS() {
-    static std::unordered_map<GameObject*, std::shared_ptr<GameObject>> map;
-    return map;
+GameObject::Registry& GameObject::REGISTRY() {
+    static Registry registry{ .slots = {}, .firstFree = NO_FREE_SLOT };
+    return registry;
 }
\ No newline at end of file
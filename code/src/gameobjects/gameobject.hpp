@@ -1,57 +1,68 @@
 #pragma once
 #include "gameobjects/component_id.hpp"
 #include "gameobjects/component_pool.hpp"
+#include "physics/collider_shape.hpp"
 
 #include <type_traits>
 #include <bitset>
 #include <memory>
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+#include <span>
+
+// A generation-checked reference to a gameobject: an index into the gameobject registry, plus the generation that registry slot had when the gameobject was put in it.
+// Once the gameobject is destroyed (well, Destroy()ed), the slot's generation changes and GameObject::Resolve() returns nullptr for the handle, even if the slot has been reused.
+// Unlike a shared_ptr, copying one is free (no atomic refcounting) and it doesn't keep the gameobject alive.
+struct GameObjectHandle {
+	uint32_t index = 0;
+	uint32_t generation = 0; // slot generations start at 1, so a default constructed handle never resolves to anything
+
+	bool operator==(const GameObjectHandle&) const = default;
+};
+static_assert(sizeof(GameObjectHandle) == sizeof(uint64_t));
 
-// TODO: weak_ptr version?
-// An object that stores a component and a shared_ptr to the gameobject that component came from. 
-// Used to guarantee that the component reference returned by GameObject::Get() isn't left dangling when its gameobject is destructed.
+// An object that stores a handle to a gameobject and lets you use one of its components. 
+// Used to guarantee that the component reference returned by GameObject::Get() is never left dangling: once the gameobject is destroyed, the handle evaluates to false and dereferencing it aborts.
+// The component is looked up through the gameobject every time you use the handle (which is cheap), so the handle stays valid when GameObject::CompactComponentPools() moves the component.
 // Can store nullptr, in which case dereferencing will abort.
 template <std::derived_from<BaseComponent> Component>
 class ComponentHandle {
 public:
-	ComponentHandle(Component* const comp, const std::shared_ptr<GameObject>& obj) :
-		object(obj),
-		component(comp)
+	ComponentHandle(GameObjectHandle obj) :
+		object(obj)
 	{
 
 	}
 	ComponentHandle(const ComponentHandle<Component>&) = default;
-	ComponentHandle(const ComponentHandle<Component>&& other) {
-		other.object = nullptr;
-		other.component = nullptr;
-	}
+	ComponentHandle(ComponentHandle<Component>&&) = default;
 
 	Component& operator*() const {
+		Component* component = GetPtr();
 		Assert(component != nullptr);
 		return *component;
 	}
 	Component* operator->() const {
+		Component* component = GetPtr();
 		Assert(component != nullptr);
 		return component;
 	}
 
 	// Returns true if not nullptr
 	explicit operator bool() const {
-		return component != nullptr;
+		return GetPtr() != nullptr;
 	}
 
 	// might return nullptr, be careful.
-	// only exists so you can pass a reference to a component to a function
-	Component* const GetPtr() const {
-		return component;
-	}
+	// only exists so you can pass a reference to a component to a function. Don't hold onto it past the end of the frame; compaction can move the component.
+	Component* const GetPtr() const;
 
 	// If ptr != nullptr/it hasn't already been cleared, returns it to the pool (thus destructing the component), and sets ptr to nullptr.
 	// Gameobjects do this for all their components when Destroy() is called on them.
 	//void Clear();
 
 private:
-	const std::shared_ptr<GameObject> object;
-	Component* const component;
+	const GameObjectHandle object;
 };
 
 class ComponentFieldInitializer;
@@ -60,6 +71,8 @@ class ComponentFieldInitializer;
 // Pass to GameObject::New().
 struct GameobjectCreateParams {
 	std::optional<std::shared_ptr<class PhysicsMesh>> physMesh;
+	ColliderShape colliderShape; // defaults to ColliderShapeMesh. Primitive colliders still need a physMesh/meshId, see ColliderComponent::physicsMesh.
+	std::optional<std::shared_ptr<class Heightfield>> heightfield; // needed instead of a physMesh/meshId when colliderShape is ColliderShapeHeightfield. Every gameobject made with these params shares it.
 	unsigned int meshId; // ignore if not rendering
 	unsigned int materialId; // defaults to 0 for default material. ignore if not rendering
 
@@ -67,6 +80,8 @@ struct GameobjectCreateParams {
 
 	GameobjectCreateParams(std::vector<ComponentBitIndex::ComponentBitIndex> componentList, std::vector<ComponentFieldInitializer*> = {}) :
 		physMesh(std::nullopt),
+		colliderShape(ColliderShapeMesh),
+		heightfield(std::nullopt),
 		meshId(0),
 		materialId(0),
 		sound(std::nullopt)
@@ -102,29 +117,63 @@ public:
 
 	~GameObject();
 
-	// static method instead of static variable so we ensure that the GAMEOBJECTS map is destroyed before the singletons that component destructors depend on
-	static std::unordered_map<GameObject*, std::shared_ptr<GameObject>>& GAMEOBJECTS();
+	// Every gameobject that hasn't been Destroy()ed has a slot in the registry, which owns it (so it won't be destroyed until Destroy() is called) and lets handles find it in O(1).
+	// Freed slots are reused, with a bumped generation so that old handles to them stop resolving.
+	struct RegistrySlot {
+		std::shared_ptr<GameObject> object; // nullptr if the slot is free
+		uint32_t generation;
+		uint32_t nextFree; // if the slot is free, index of the next free slot (or NO_FREE_SLOT)
+	};
+	struct Registry {
+		std::vector<RegistrySlot> slots;
+		uint32_t firstFree; // index of the first free slot (or NO_FREE_SLOT)
+	};
+	static constexpr uint32_t NO_FREE_SLOT = UINT32_MAX;
+
+	// static method instead of static variable so we ensure that the registry is destroyed before the singletons that component destructors depend on
+	static Registry& REGISTRY();
+
+	// Returns the gameobject the handle refers to, or nullptr if it's been destroyed. O(1), and no refcounting.
+	static GameObject* Resolve(GameObjectHandle handle) {
+		auto& slots = REGISTRY().slots;
+		if (handle.index >= slots.size() || slots[handle.index].generation != handle.generation) {
+			return nullptr;
+		}
+		return slots[handle.index].object.get();
+	}
+
+	// Like Resolve(), but returns a shared_ptr, for when you need to keep the gameobject alive (for Lua, modules, etc.).
+	static std::shared_ptr<GameObject> Lock(GameObjectHandle handle);
+
+	// This gameobject's handle. Store these instead of shared_ptrs in anything performance sensitive.
+	GameObjectHandle Handle() const {
+		return handle;
+	}
 
 	// Factory constructor for gameobjects.
 	// Initialize other singletons before calling.
 	// TODO: option which returns weak_ptr?
 	static std::shared_ptr<GameObject> New(const GameobjectCreateParams& params);
 
+	// Creates count gameobjects with the same params, much faster than calling New() count times:
+		// their slots are all reserved from the pool at once, their components are constructed one column at a time, the physics mesh (if any) is only made once, and they're all put in the registry in one pass.
+	static std::vector<std::shared_ptr<GameObject>> NewBatch(const GameobjectCreateParams& params, unsigned int count);
+
 	// lets you create subclasses of gameobject correctly
 	//template<std::derived_from<GameObject> T, typename ... tArgs>
 	//static std::shared_ptr<T> New(const GameobjectCreateParams& params, tArgs ...);
 
 	// Returns the given component (or an empty handle if it doesn't exist). The component handle will evalulate to true if the component exists.
-	// The ComponentHandle contains a shared_ptr to the gameobject, so the gameobject will not be destroyed and the component will always remain valid for the entirety of the handle's lifetime.
+	// The ComponentHandle contains a handle to the gameobject, so once the gameobject is destroyed the ComponentHandle will evaluate to false instead of dangling.
 	// WARNING!!! WARNING!!! You cannot call Get() inside component constructors. 
-		// (Maybe)RawGet is fine, but because this will attempt to get a shared_ptr using shared_from_this before GameObject::New() makes a shared_ptr, std::bad_weak_ptr will be thrown.
+		// (Maybe)RawGet is fine, but the gameobject isn't put in the registry until GameObject::New() returns, so the handle won't resolve.
 	template <std::derived_from<BaseComponent> Component>
 	ComponentHandle<Component> Get() {
-		return ComponentHandle<Component>(MaybeRawGet<Component>(), shared_from_this());
+		return ComponentHandle<Component>(handle);
 	}
 
 	// Returns the given component. Aborts if this gameobject does not have that component.
-	// Be careful: the lifetime of this pointer is as long as the lifetime of the gameobject.
+	// Be careful: the lifetime of this pointer is as long as the lifetime of the gameobject, or until the next call to CompactComponentPools().
 	template <std::derived_from<BaseComponent> Component>
 	Component* RawGet() {
 		auto component = MaybeRawGet<Component>();
@@ -133,25 +182,19 @@ public:
 	}
 
 	// Returns the given component, or nullptr if this gameobject does not have that component.
-	// Be careful: the lifetime of this pointer is as long as the lifetime of the gameobject.
+	// Be careful: the lifetime of this pointer is as long as the lifetime of the gameobject, or until the next call to CompactComponentPools().
 	template <std::derived_from<BaseComponent> Component>
 	Component* MaybeRawGet() {
 		// verify pool has component and if so find byte offset
-		int offset = -1;
-
-		for (auto& info : pool->componentLayout) {
-			if (info.componentId == ComponentIdFromType<Component>()) {
-				offset = info.offset;
-				break;
-			}
-		}
+		int offset = pool->columnOffsets[ComponentIdFromType<Component>()];
 
 		if (offset == -1) { // then component was not found
 			return nullptr;
 		}
 
+		// components live in per-type columns, so the stride between objects is the size of the component rather than the size of the whole object
 		uint8_t* pagePtr = pool->pages[page];
-		return (Component*)(pagePtr + (objectIndex * pool->objectSize + offset));
+		return (Component*)(pagePtr + offset + objectIndex * sizeof(Component));
 	}
 
 	// Specialization for render components so that RenderComponentNoFO can be used as a RenderComponent.
@@ -159,13 +202,9 @@ public:
 	RenderComponent* MaybeRawGet<RenderComponent>() {
 
 		// verify pool has component and if so find byte offset
-		int offset = -1;
-
-		for (auto& info : pool->componentLayout) {
-			if (info.componentId == ComponentBitIndex::Render || info.componentId == ComponentBitIndex::RenderNoFO) {
-				offset = info.offset;
-				break;
-			}
+		int offset = pool->columnOffsets[ComponentBitIndex::Render];
+		if (offset == -1) {
+			offset = pool->columnOffsets[ComponentBitIndex::RenderNoFO];
 		}
 
 		if (offset == -1) { // then component was not found
@@ -173,17 +212,43 @@ public:
 		}
 
 		uint8_t* pagePtr = pool->pages[page];
-		return (RenderComponent*)(pagePtr + (objectIndex * pool->objectSize + offset));
+		return (RenderComponent*)(pagePtr + offset + objectIndex * sizeof(RenderComponent));
 	}
 
+	// Stamps the given component with the current change version, so that systems using SystemQuery::IterateChangedSince() see that you wrote to it.
+	// Transform components do this themselves; call it after writing to any other kind of component.
+	template <std::derived_from<BaseComponent> Component>
+	void MarkChanged() {
+		pool->MarkChanged(VersionColumn(pool, ComponentIdFromType<Component>()), page, objectIndex);
+	}
+
+	// Moves live objects off of the last pages of each component pool into free slots on earlier pages, and frees pages that end up empty.
+	// After lots of gameobjects are destroyed, pools are left with mostly empty pages that are still allocated and still have to be skipped over by systems; this fixes that.
+	// Stops once it's spent timeBudget seconds, so you can call it every frame and it will gradually finish. Opt-in; nothing calls this for you.
+	// Moving a component invalidates raw pointers to it (ComponentHandles are fine), so don't call this while iterating through a SystemQuery or while holding RawGet() pointers.
+	static void CompactComponentPools(double timeBudget);
+
 	// DOES NOT neccesarily destroy the gameobject. 
-	// All it does is remove the shared_ptr stored in the GAMEOBJECTS map, meaning that when all references aka shared_ptrs you 
-		// have to the gameobject are destroyed (ComponentHandles count as references), the gameobject will be destroyed.
+	// All it does is free the gameobject's registry slot (so its handles and ComponentHandles stop resolving) and drop the shared_ptr stored there, meaning that when all 
+		// shared_ptrs you have to the gameobject are destroyed, the gameobject will be destroyed.
 	// If you want Destroy() to always immediately destroy the gameobject regardless of other references to it, do not store shared_ptrs to your gameobjects; use weak_ptr instead.
 	void Destroy();
 
-private:
+	// Calls Destroy() on every given gameobject, but frees all of their registry slots before any of them are actually destroyed.
+	// The same caveat about other references applies (including the ones in the vector you pass, obviously).
+	static void DestroyBatch(const std::vector<std::shared_ptr<GameObject>>& gameobjects);
+
+	// Gives the gameobject every component in params that it doesn't already have, using the rest of params (meshId, physMesh, sound, etc.) to construct them.
+	// This moves the gameobject to the pool for its new archetype, so like CompactComponentPools() it invalidates raw pointers to its components and must not be called while iterating through a SystemQuery.
+		// Use a GameObjectCommandBuffer to do it from inside a system.
+	void AddComponents(const GameobjectCreateParams& params);
+
+	// Destroys the given components (if the gameobject has them) and moves the gameobject to the pool for its new archetype. Same caveats as AddComponents().
+	// Can't remove the transform component.
+	void RemoveComponents(const std::vector<ComponentBitIndex::ComponentBitIndex>& components);
+
 	// A forward iterator for systems to iterate through components with.
+	// Uses each pool's occupancy bitmaps to jump straight from one live object to the next, and skips pages with no live objects entirely.
 	template <std::derived_from<BaseComponent> ... Components>
 	class SystemForwardIterator {
 	public:
@@ -197,28 +262,25 @@ private:
 		using pointer = value_type*;
 		using reference = value_type&;
 
-		SystemForwardIterator(const std::vector<ComponentPool*>& poolVec) :
-			pools(poolVec),
+		// poolVec and offsetVec are not copied, so they must outlive the iterator. offsetVec has, for each pool, the column offset of each of Components (or -1), in the same order as Components.
+		// If changedComponentId isn't -1, only objects whose component with that id was stamped after changedSince are iterated through (see ComponentPool::AdvanceChangeVersion()).
+		SystemForwardIterator(const std::vector<ComponentPool*>& poolVec, const std::vector<std::array<int, sizeof...(Components)>>& offsetVec, int changedComponentId = -1, uint32_t changedSince = 0) :
+			pools(&poolVec),
+			offsets(&offsetVec),
 			poolIndex(0),
 			pageIndex(0),
 			objectIndex(0),
-			currentLiveChecker(nullptr)
+			columnsStale(true),
+			changedComponentId(changedComponentId),
+			changedSince(changedSince)
 		{
-			if (pools.size() > 0) { // if we have nothing to iterate through we can't write the tuple
-				WriteCurrentTuple();
-			}
-		}
-
-		template <typename T>
-		void AddIfNotNull(T& t) {
-			if (t != nullptr) {
-				t = (T)(((uint8_t*)t) + pools[poolIndex]->objectSize);
-			}
+			// the very first object might not be live, so seek to the first one that is
+			SeekLive();
 		}
 
 		// call in for loop to check when the iterator has nothing left to offer. Returns false when iterator has nothing left and should not be dereferenced.
 		bool Valid() {
-			if (pools.size() == poolIndex) {
+			if (pools->size() == poolIndex) {
 				return false;
 			}
 			else {
@@ -228,140 +290,255 @@ private:
 
 		// int argument is there to specify that we're overloading postfix, not prefix; doesn't do anything
 		void operator++(int) {
-
-			//DebugLogInfo("Postfix");
 			objectIndex++;
-			if (objectIndex == ComponentPool::COMPONENTS_PER_PAGE) {
+			SeekLive();
+		}
 
-				objectIndex = 0;
-				pageIndex++;
+		value_type& operator*() {
+			//DebugLogInfo("Deref, return ", objectIndex);
+			return currentTuple;
+		}
 
-				if (pageIndex == pools[poolIndex]->pages.size()) {
-					pageIndex = 0;
+		// Stamps the current object's given component with the current change version; call after writing to it. Transform components do this themselves.
+		template <std::derived_from<BaseComponent> Component>
+		void MarkChanged() {
+			ComponentPool* pool = (*pools)[poolIndex];
+			pool->MarkChanged(VersionColumn(pool, ComponentIdFromType<Component>()), pageIndex, objectIndex);
+		}
+
+	private:
+		// Moves to the first live object at or after (poolIndex, pageIndex, objectIndex), or makes the iterator invalid if there isn't one.
+		void SeekLive() {
+			while (Valid()) {
+				ComponentPool* pool = (*pools)[poolIndex];
+
+				if (pageIndex >= pool->PageCount()) { // done with this pool
 					poolIndex++;
+					pageIndex = 0;
+					objectIndex = 0;
+					columnsStale = true;
+					continue;
+				}
 
-					if (!Valid()) {
-						return;
+				if (changedComponentId == -1) {
+					if (pool->LiveCount(pageIndex) != 0) {
+						objectIndex = pool->NextLive(pageIndex, objectIndex);
+					}
+					else {
+						objectIndex = ComponentPool::COMPONENTS_PER_PAGE;
+					}
+				}
+				else {
+					// the page's version lets us skip pages where nothing changed without looking at any of their objects
+					int changedColumn = VersionColumn(pool, changedComponentId);
+					if (pool->LiveCount(pageIndex) != 0 && pool->PageChangedSince(changedColumn, pageIndex, changedSince)) {
+						objectIndex = pool->NextLive(pageIndex, objectIndex);
+						while (objectIndex != ComponentPool::COMPONENTS_PER_PAGE && !pool->ChangedSince(changedColumn, pageIndex, objectIndex, changedSince)) {
+							objectIndex = pool->NextLive(pageIndex, objectIndex + 1);
+						}
+					}
+					else {
+						objectIndex = ComponentPool::COMPONENTS_PER_PAGE;
 					}
 				}
 
-				// we're on a different page so we can't just increment pointers
-				WriteCurrentTuple();
-			}
-			else {
-				// increment pointers (that aren't nullptr)
-				std::apply([this](auto& ... x) {(..., AddIfNotNull(x)); }, currentTuple);
-				currentLiveChecker = (uint8_t**)((uint8_t*)currentLiveChecker + pools[poolIndex]->objectSize);
-			}
+				if (objectIndex != ComponentPool::COMPONENTS_PER_PAGE) {
+					WriteCurrentTuple();
+					return;
+				}
 
-			// check if the object we're now on is in use, or if we should skip it
-			// objects in use have their first sizeof(uint8_t) bytes set to nullptr
-			if (*currentLiveChecker != nullptr && Valid()) { // need to make sure we aren't going past end of iterator though or we'll just postfix forever until stack oveflow
-				(*this)++;
+				// nothing (else) live on this page
+				pageIndex++;
+				objectIndex = 0;
+				columnsStale = true;
 			}
 		}
 
-		value_type& operator*() {
-			//DebugLogInfo("Deref, return ", objectIndex);
-			return currentTuple;
+		// each component lives in its own column, so the current object's component is just that element of the column
+		template <typename ComponentPtr>
+		void OffsetIfNotNull(ComponentPtr& current, ComponentPtr column) {
+			current = column == nullptr ? nullptr : column + objectIndex;
 		}
 
-	private:
-		// stolen from stack overflow
-		template <class T, class Tuple>
-		struct TupleIndex;
+		void WriteCurrentTuple() {
+			// column pointers only change when we move to a different page
+			if (columnsStale) {
+				uint8_t* page = (*pools)[poolIndex]->pages[pageIndex];
+				auto& poolOffsets = (*offsets)[poolIndex];
+				[this, page, &poolOffsets]<std::size_t ... I>(std::index_sequence<I...>) {
+					(..., (std::get<I>(columnTuple) = poolOffsets[I] == -1 ? nullptr : (std::tuple_element_t<I, value_type>)(page + poolOffsets[I])));
+				}(std::index_sequence_for<Components...>{});
+				columnsStale = false;
+			}
 
-		template <class T, class... Types>
-		struct TupleIndex<T, std::tuple<T, Types...>> {
-			static const std::size_t value = 0;
-		};
+			[this]<std::size_t ... I>(std::index_sequence<I...>) {
+				(..., OffsetIfNotNull(std::get<I>(currentTuple), std::get<I>(columnTuple)));
+			}(std::index_sequence_for<Components...>{});
+		}
 
-		template <class T, class U, class... Types>
-		struct TupleIndex<T, std::tuple<U, Types...>> {
-			static const std::size_t value = 1 + TupleIndex<T, std::tuple<Types...>>::value;
-		};
+		const std::vector<ComponentPool*>* pools;
 
-		template <typename ComponentPtr>
-		void WriteTupleElement(ComponentPtr p) {
-			static_assert(std::is_pointer<ComponentPtr>::value);
+		const std::vector<std::array<int, sizeof...(Components)>>* offsets;
 
-			ComponentPool* pool = pools[poolIndex];
+		unsigned int poolIndex;
 
-			short offset = -1;
-			for (auto& memoryInfo : pool->componentLayout) {
+		unsigned int pageIndex;
 
-				constexpr int id(ComponentIdFromType < typename std::remove_pointer<ComponentPtr>::type>());
-				if (id == memoryInfo.componentId) {
-					offset = memoryInfo.offset;
-				}
+		unsigned int objectIndex;
 
-			}
+		value_type currentTuple;
 
-			//typedef I = TupleIndex<ComponentPtr, value_type>::value;
-			//static_assert(I == 1000);
+		// pointers to the start of each requested component's column on the current page (or nullptr if the pool doesn't have that component)
+		value_type columnTuple;
+
+		// true if we've moved to a different page since columnTuple was written
+		bool columnsStale;
+
+		// -1 to iterate through every object, otherwise the id of the component that has to have changed since changedSince
+		int changedComponentId;
+
+		uint32_t changedSince;
+	};
+
+	// A persistent query for all gameobjects that have the required components.
+	// Remembers which pools matched and where each of Components lives in them, and only looks at pools created since the last call to Iterate(),
+		// so keep these around (e.g. as a static local in your system) instead of making a new one every frame.
+	template <std::derived_from<BaseComponent> ... Components>
+	class SystemQuery {
+	public:
+		SystemQuery(std::vector<ComponentBitIndex::ComponentBitIndex> requiredComponents) :
+			requiredArchetype(GameobjectCreateParams(requiredComponents).requestedComponents),
+			nPoolsChecked(0)
+		{
 
-			if (offset == -1) {
-				std::get<TupleIndex<ComponentPtr, value_type>::value>(currentTuple) = nullptr;
-			}
-			else {
-				void* page = pool->pages[pageIndex];
-				std::get<TupleIndex<ComponentPtr, value_type>::value>(currentTuple) = (ComponentPtr)((uint8_t*)page + offset);
-			}
 		}
 
-		void WriteCurrentTuple() {
-			auto& pool = pools[poolIndex];
-			uint8_t* page = pool->pages[pageIndex];
-			currentLiveChecker = (uint8_t**)(void*)page;
+		SystemQuery(const SystemQuery&) = delete;
 
-			std::apply([this](auto& ... value) {
-				(..., WriteTupleElement(value));
-				}, currentTuple);
+		// Returns an iterator through all gameobjects that have the required components (except you don't actually get the gameobject, just a tuple of components).
+		// Components not specified as required may be nullptr. Check.
+		// The iterator references this query, so don't let it outlive it.
+		SystemForwardIterator<Components...> Iterate() {
+			Update();
+			return SystemForwardIterator<Components...>(matchingPools, columnOffsets);
 		}
 
-		const std::vector<ComponentPool*> pools;
+		// Like Iterate(), but only gets you gameobjects whose Changed component was stamped after version (pages where nothing changed are skipped entirely).
+		// Usage: uint32_t since = lastRun; lastRun = ComponentPool::AdvanceChangeVersion(); then iterate with IterateChangedSince<Whatever>(since).
+		template <std::derived_from<BaseComponent> Changed>
+		SystemForwardIterator<Components...> IterateChangedSince(uint32_t version) {
+			Update();
+			return SystemForwardIterator<Components...>(matchingPools, columnOffsets, ComponentIdFromType<Changed>(), version);
+		}
 
-		unsigned int poolIndex;
+	private:
+		// checks any pools created since the last update
+		void Update() {
+			for (; nPoolsChecked < POOLS_IN_CREATION_ORDER.size(); nPoolsChecked++) {
+				ComponentPool* pool = POOLS_IN_CREATION_ORDER[nPoolsChecked];
+				if ((pool->archetype & requiredArchetype) == requiredArchetype) {
+					matchingPools.push_back(pool);
+					columnOffsets.push_back({ pool->columnOffsets[ComponentIdFromType<Components>()]... });
+				}
+			}
+		}
 
-		unsigned int pageIndex;
+		const std::bitset<N_COMPONENT_TYPES> requiredArchetype;
 
-		unsigned int objectIndex;
+		std::vector<ComponentPool*> matchingPools;
 
-		value_type currentTuple;
-		uint8_t** currentLiveChecker;
-	};
+		// for each matching pool, the byte offset of each of Components' columns, or -1 if it doesn't have it
+		std::vector<std::array<int, sizeof...(Components)>> columnOffsets;
 
-public:
+		// number of pools in POOLS_IN_CREATION_ORDER we've already looked at
+		size_t nPoolsChecked;
+	};
 
 	// Returns an iterator so you can iterate through all gameobjects that have the requested components (except you don't actually get the gameobject, just a tuple of components).
 	// Components not specified as required may be nullptr. Check.
+	// Convenience wrapper that keeps a SystemQuery for each combination of required components it's called with; systems that run every frame should own a SystemQuery instead so they skip the lookup.
 	template <std::derived_from<BaseComponent> ... Components>
 	static SystemForwardIterator<Components...> SystemGetComponents(std::vector<ComponentBitIndex::ComponentBitIndex> requiredComponents) {
+		static std::unordered_map<std::bitset<N_COMPONENT_TYPES>, std::unique_ptr<SystemQuery<Components...>>> queries;
+
 		std::bitset<N_COMPONENT_TYPES> requestedArchetype = GameobjectCreateParams(requiredComponents).requestedComponents;
-		std::vector<ComponentPool*> matchingPools;
-		for (auto& [archetype, pool] : COMPONENT_POOLS) {
-			if ((archetype & requestedArchetype) == requestedArchetype) {
-				matchingPools.push_back(pool.get());
-			}
+		auto& query = queries[requestedArchetype];
+		if (!query) {
+			query = std::make_unique<SystemQuery<Components...>>(requiredComponents);
 		}
-		return SystemForwardIterator<Components...>(matchingPools);
+		return query->Iterate();
 	}
 
 protected:
 	// protected so you have to use factory constructor
 	GameObject(const GameobjectCreateParams& params);
 
+	// delegating constructor used by main constructor, and by NewBatch() (which constructs the components itself)
+	GameObject(std::tuple<ComponentPool*, int, int> data);
+
 private:
 
-	// delegating constructor used by main constructor
-	GameObject(std::tuple<ComponentPool*, int, int> data);
+	// set by New()/NewBatch()
+	GameObjectHandle handle;
 
-	ComponentPool* const pool;
-	const int objectIndex;
-	const int page;
+	// not const because AddComponents()/RemoveComponents() move the gameobject to a different pool
+	ComponentPool* pool;
+
+	// not const because compaction can move the gameobject's components to a different slot in the pool
+	int objectIndex;
+	int page;
 
 	// unique_ptr so it doesn't memory leak
 	static inline std::unordered_map<std::bitset<N_COMPONENT_TYPES>, std::unique_ptr<ComponentPool>> COMPONENT_POOLS;
 
-	static std::tuple<ComponentPool*, int, int> GetNewGameobjectComponentData(const GameobjectCreateParams& params);
-};
\ No newline at end of file
+	// Every pool in COMPONENT_POOLS, in the order they were created. Pools are never destroyed before the program ends, so SystemQuery can remember how many of these it's already seen.
+	static inline std::vector<ComponentPool*> POOLS_IN_CREATION_ORDER;
+
+	// Returns the pool for the given archetype, creating it if it doesn't exist yet.
+	static ComponentPool* GetPool(const std::bitset<N_COMPONENT_TYPES>& archetype);
+
+	static std::tuple<ComponentPool*, int, int> GetNewGameobjectComponentData(const GameobjectCreateParams& params, GameObject* owner);
+
+	// Calls the constructors of the given components for every given gameobject (which must all have those components in their pool), using params to construct them.
+	static void ConstructComponents(const GameobjectCreateParams& params, const std::bitset<N_COMPONENT_TYPES>& components, std::span<GameObject* const> gameobjects);
+
+	// Puts the gameobject in a registry slot and sets its handle.
+	static void Register(const std::shared_ptr<GameObject>& ptr);
+
+	// Frees the gameobject's registry slot and returns the registry's reference to it.
+	std::shared_ptr<GameObject> FreeRegistrySlot();
+
+	// Move constructs the component with the given id at to from the one at from, then destroys what's left at from.
+	static void RelocateComponent(int componentId, void* from, void* to);
+
+	// Calls the destructor of the component with the given id.
+	static void DestroyComponent(int componentId, void* component);
+
+	// Moves this gameobject to the pool for newArchetype, destroying components it no longer has and constructing ones it didn't have before (using params).
+	void ChangeArchetype(const std::bitset<N_COMPONENT_TYPES>& newArchetype, const GameobjectCreateParams& params);
+
+	// Returns the column index the given pool keeps change versions for the given component in. Like MaybeRawGet(), lets RenderComponentNoFO be used as a RenderComponent.
+	static int VersionColumn(const ComponentPool* pool, int componentId) {
+		int columnIndex = pool->columnIndices[componentId];
+		if (columnIndex == -1 && componentId == ComponentBitIndex::Render) {
+			columnIndex = pool->columnIndices[ComponentBitIndex::RenderNoFO];
+		}
+		Assert(columnIndex != -1);
+		return columnIndex;
+	}
+
+	// Moves this gameobject's components into the given free slot of its pool (which must have been reserved with GetObject()), and returns the old slot to the pool.
+	void MoveToSlot(int newPage, int newObjectIndex);
+
+	// Moves one gameobject from the last page of the pool to an earlier page. Returns false if the pool is already as compact as it's going to get.
+	static bool CompactionStep(ComponentPool* pool);
+};
+
+template <std::derived_from<BaseComponent> Component>
+Component* const ComponentHandle<Component>::GetPtr() const {
+	GameObject* gameobject = GameObject::Resolve(object);
+	if (gameobject == nullptr) {
+		return nullptr;
+	}
+	return gameobject->MaybeRawGet<Component>();
+}
\ No newline at end of file
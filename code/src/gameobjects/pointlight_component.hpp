@@ -9,6 +9,8 @@ class GraphicsEngine;
 class PointLightComponent: public BaseComponent {
 public:
     PointLightComponent(const PointLightComponent&) = delete;
+    // Used when compaction moves the component to a different slot.
+    PointLightComponent(PointLightComponent&& old) noexcept = default;
     PointLightComponent();
     ~PointLightComponent();
     //void Destroy();
@@ -24,9 +24,21 @@ RenderComponent::RenderComponent(unsigned int mId, unsigned int matId):
 
 };
 
+RenderComponent::RenderComponent(RenderComponent&& old) noexcept:
+    materialId(old.materialId),
+    meshId(old.meshId),
+    drawHandle(old.drawHandle),
+    meshpoolId(old.meshpoolId)
+{
+    GraphicsEngine::Get().RelocateObject(&old, this);
+    old.meshpoolId = RELOCATED_MESHPOOL_ID;
+}
+
 RenderComponent::~RenderComponent() {
     //Assert(live == true);
-    GraphicsEngine::Get().RemoveObject(this);
+    if (meshpoolId != RELOCATED_MESHPOOL_ID) {
+        GraphicsEngine::Get().RemoveObject(this);
+    }
 }
 
 //RenderComponent::RenderComponent() {
@@ -64,3 +76,8 @@ RenderComponentNoFO::RenderComponentNoFO(unsigned int meshId, unsigned int mater
     RenderComponent(meshId, materialId) 
 {
 }
+
+RenderComponentNoFO::RenderComponentNoFO(RenderComponentNoFO&& old) noexcept:
+    RenderComponent(std::move(old))
+{
+}
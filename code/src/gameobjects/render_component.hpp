@@ -13,6 +13,8 @@ public:
 
     RenderComponent(const RenderComponent&) = delete;
     RenderComponent(unsigned int meshId, unsigned int materialId);
+    // Used when compaction moves the component to a different slot; tells the GraphicsEngine about the new address.
+    RenderComponent(RenderComponent&& old) noexcept;
     ~RenderComponent();
 
     // called to initialize when given to a gameobject
@@ -73,6 +75,9 @@ private:
     // -1 before being initialized
     int meshpoolId;
 
+    // meshpoolId of a component that was moved somewhere else and is just waiting to be destroyed (so its destructor shouldn't remove it from the GraphicsEngine)
+    static constexpr int RELOCATED_MESHPOOL_ID = -2;
+
     friend class GraphicsEngine;
 
     // mesh.cpp needs to access mesh location sorry
@@ -90,6 +95,7 @@ public:
     // idk if we even call this when making one
     RenderComponentNoFO(unsigned int meshId, unsigned int materialId);
     RenderComponentNoFO(const RenderComponentNoFO&) = delete;
+    RenderComponentNoFO(RenderComponentNoFO&& old) noexcept;
     // TODO: implicit conversion to normal rendercomponent because they do the exact same things?
     
 private:
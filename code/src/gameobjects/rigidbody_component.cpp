@@ -13,12 +13,15 @@ RigidbodyComponent::RigidbodyComponent(const std::shared_ptr<PhysicsMesh>& physM
     Assert(physMesh != nullptr);
 
     kinematic = false;
+    continuousCollision = false;
     velocity = {0, 0, 0};
     accumulatedForce = {0, 0, 0};
     angularVelocity = {0, 0, 0}; 
     accumulatedTorque = {0, 0, 0};
     linearDrag = 0.99;
     angularDrag = 0.999;
+    sleeping = false;
+    timeStill = 0;
     
     MakeMassInfinite();
 }
@@ -39,6 +42,7 @@ void RigidbodyComponent::SetMass(float newMass, const TransformComponent& transf
     Assert(newMass != 0);
     inverseMass = 1.0f/newMass;
     UpdateMomentOfInertia(transform);
+    Wake();
 }
 
 void RigidbodyComponent::UpdateMomentOfInertia(const TransformComponent& transform) {
@@ -58,6 +62,52 @@ void RigidbodyComponent::MakeMassInfinite() { // TODO: untested.
     localMomentOfInertia = glm::mat3x3(INFINITY);
 }
 
+bool RigidbodyComponent::Sleeping() const {
+    return sleeping;
+}
+
+void RigidbodyComponent::Wake() {
+    sleeping = false;
+    timeStill = 0;
+}
+
+void RigidbodyComponent::Sleep(const TransformComponent& transform) {
+    sleeping = true;
+    velocity = {0, 0, 0};
+    angularVelocity = {0, 0, 0};
+    accumulatedForce = {0, 0, 0};
+    accumulatedTorque = {0, 0, 0};
+    sleepPosition = transform.Position();
+    sleepRotation = transform.Rotation();
+}
+
+bool RigidbodyComponent::Disturbed(const TransformComponent& transform) const {
+    // Sleep() zeroed all of these, so anything that isn't zero was set by someone else (like a lua script)
+    return velocity != glm::dvec3(0, 0, 0) || angularVelocity != glm::vec3(0, 0, 0) || accumulatedForce != glm::vec3(0, 0, 0) || accumulatedTorque != glm::vec3(0, 0, 0)
+        || transform.Position() != sleepPosition || transform.Rotation() != sleepRotation;
+}
+
+void RigidbodyComponent::UpdateSleepCountdown(const TransformComponent& transform, double timestep) {
+    // same as what PhysicsEngine::Step() does with them
+    glm::dvec3 newVelocity = velocity + glm::dvec3(accumulatedForce * InverseMass());
+    glm::vec3 newAngularVelocity = angularVelocity + glm::vec3(
+        InverseMomentOfInertiaAroundAxis(transform, { 1, 0, 0 }),
+        InverseMomentOfInertiaAroundAxis(transform, { 0, 1, 0 }),
+        InverseMomentOfInertiaAroundAxis(transform, { 0, 0, 1 })
+    ) * accumulatedTorque;
+
+    if (glm::length2(newVelocity) < SLEEP_LINEAR_VELOCITY * SLEEP_LINEAR_VELOCITY && glm::length2(newAngularVelocity) < SLEEP_ANGULAR_VELOCITY * SLEEP_ANGULAR_VELOCITY) {
+        timeStill += timestep;
+    }
+    else {
+        timeStill = 0;
+    }
+}
+
+bool RigidbodyComponent::ReadyToSleep() const {
+    return sleeping || timeStill >= SLEEP_DELAY;
+}
+
 // mainly so that division by zero gives infinity not undefined behavior
 static_assert(std::numeric_limits<double>::is_iec559, "Physics engine expects IEEE floating point compliance.");
 static_assert(std::numeric_limits<float>::is_iec559, "Physics engine expects IEEE floating point compliance.");
@@ -7,15 +7,32 @@
 
 class PhysicsMesh;
 
+// A rigidbody falls asleep once it has moved slower than this (in meters/second)...
+static const inline double SLEEP_LINEAR_VELOCITY = 0.15;
+// ...and rotated slower than this (in radians/second)...
+static const inline double SLEEP_ANGULAR_VELOCITY = 0.15;
+// ...for this many seconds, as long as everything simulated that it's touching has too.
+static const inline double SLEEP_DELAY = 0.5;
+
+// Continuous collision looks for things a rigidbody hit at least every this fraction of its width (along the direction it's moving), and is skipped for rigidbodies that moved less than that in a step.
+static const inline double CONTINUOUS_COLLISION_STEP = 0.5;
+
 // Created rigidbodies are immobile (infinite mass & moi) until you call SetMass() on them.
 class RigidbodyComponent: public BaseComponent {
     public:
     RigidbodyComponent(const RigidbodyComponent& other) = delete;
+    // Used when compaction moves the component to a different slot.
+    RigidbodyComponent(RigidbodyComponent&& old) noexcept = default;
     RigidbodyComponent(const std::shared_ptr<PhysicsMesh>& physMesh);
     ~RigidbodyComponent();
 
     bool kinematic; // if true, the physics engine will do nothing to this component except change its position/rotation by its velocity
 
+    // If true, the physics engine checks the whole path the rigidbody moved along each step (not just where it ended up), and stops it at the first thing it would've hit.
+    // Without this, something that moves further than its own width in one step can pass right through things (tunneling). Costs a few extra collision tests per step, but only while it's moving that fast.
+    // Only looks at the rigidbody's movement, not its rotation, and it loses whatever's left of its movement that step when it hits something.
+    bool continuousCollision;
+
     glm::dvec3 velocity;
     glm::vec3 accumulatedForce; // every physics timestep, accumulated forces are turned into change in velocity (f=ma) and then set to zero
 
@@ -63,6 +80,26 @@ class RigidbodyComponent: public BaseComponent {
     // returns inverse mmoi of the rigidbody around the given axis. Axis is in world space.
     float InverseMomentOfInertiaAroundAxis(const TransformComponent& transform, glm::vec3 axis) const;
 
+    // Sleeping rigidbodies aren't moved by the physics engine, and the broadphase doesn't look for collisions between them and anything else that isn't awake, so objects that have come to rest cost (almost) nothing.
+    // A sleeping rigidbody wakes up when something awake touches it, when its velocity is set or a force is applied to it, or when its transform is changed by anything other than the physics engine.
+    bool Sleeping() const;
+
+    // Wakes the rigidbody up (if it was asleep) and restarts its countdown to falling asleep.
+    void Wake();
+
+    // Used by the physics engine. Stops the rigidbody and remembers where it fell asleep, so that it can tell if something moves it.
+    void Sleep(const TransformComponent& transform);
+
+    // Used by the physics engine. Returns true if a sleeping rigidbody has been poked (velocity/force set or transform changed) since it fell asleep.
+    bool Disturbed(const TransformComponent& transform) const;
+
+    // Used by the physics engine for awake rigidbodies, after collisions are resolved. Counts how long the rigidbody has been moving slowly enough to sleep (see SLEEP_LINEAR_VELOCITY),
+        // going by what its velocity will be once its accumulated force and torque are applied.
+    void UpdateSleepCountdown(const TransformComponent& transform, double timestep);
+
+    // Returns true if the rigidbody has been moving slowly enough to sleep for at least SLEEP_DELAY seconds (or is already asleep).
+    bool ReadyToSleep() const;
+
     
 
     private:
@@ -72,5 +109,12 @@ class RigidbodyComponent: public BaseComponent {
 
     float inverseMass; // we store 1/mass instead of mass because all the formulas use inverse mass and this saves us some division
 
+    bool sleeping;
+    double timeStill; // seconds the rigidbody has been below the sleep velocity thresholds for
+
+    // where the rigidbody was when it fell asleep
+    glm::dvec3 sleepPosition;
+    glm::quat sleepRotation;
+
     const std::shared_ptr<PhysicsMesh> physicsMesh;
 };
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "glm/gtx/string_cast.hpp"
 #include "debug/log.hpp"
 #include "debug/assert.hpp"
+#include "gameobjects/component_pool.hpp"
+#include <algorithm>
 
 const glm::dvec3& TransformComponent::Position() const {
     return position;
@@ -26,9 +28,81 @@ TransformComponent::TransformComponent() {
 
     parent = nullptr;
     children = {};
+
+    localPosition = position;
+    localRotation = rotation;
+    localScale = scale;
+    depth = 0;
+    hierarchyDirty = false;
+    poolSlotFound = false;
+    moved = true;
+}
+
+TransformComponent::TransformComponent(TransformComponent&& old) noexcept:
+    parent(old.parent),
+    children(std::move(old.children)),
+    rotScaleMatrix(old.rotScaleMatrix),
+    normalMatrix(old.normalMatrix),
+    moved(old.moved),
+    position(old.position),
+    rotation(old.rotation),
+    scale(old.scale),
+    localPosition(old.localPosition),
+    localRotation(old.localRotation),
+    localScale(old.localScale),
+    depth(old.depth),
+    hierarchyDirty(old.hierarchyDirty),
+    poolSlotFound(false) // we're in a different slot than old was
+{
+    for (auto & c: children) {
+        c->parent = this;
+    }
+
+    if (parent != nullptr) {
+        for (auto & c: parent->children) {
+            if (c == &old) {
+                c = this;
+                break;
+            }
+        }
+    }
+
+    if (hierarchyDirty) {
+        for (auto& t : DIRTY_PARENTS()) {
+            if (t == &old) {
+                t = this;
+                break;
+            }
+        }
+    }
+
+    old.parent = nullptr;
+    old.children.clear();
+    old.hierarchyDirty = false;
 }
 
-TransformComponent::~TransformComponent() {}
+TransformComponent::~TransformComponent() {
+    // children get orphaned, but first they need to catch up to wherever we last were
+    if (hierarchyDirty) {
+        PropagateToChildren();
+
+        auto& dirtyParents = DIRTY_PARENTS();
+        dirtyParents.erase(std::find(dirtyParents.begin(), dirtyParents.end(), this));
+    }
+
+    for (auto& c : children) {
+        c->parent = nullptr;
+        c->localPosition = c->position;
+        c->localRotation = c->rotation;
+        c->localScale = c->scale;
+        c->SetDepth(0);
+    }
+
+    if (parent != nullptr) {
+        auto& siblings = parent->children;
+        siblings.erase(std::find(siblings.begin(), siblings.end(), this));
+    }
+}
 
 // void TransformComponent::MakeChildrenDirty() {
 //     for (auto & c: children) {
@@ -50,6 +124,15 @@ TransformComponent* TransformComponent::GetParent() {
 }
 
 void TransformComponent::SetParent(TransformComponent& newParent) {
+    // can't be our own ancestor
+    for (TransformComponent* ancestor = &newParent; ancestor != nullptr; ancestor = ancestor->parent) {
+        Assert(ancestor != this);
+    }
+
+    // local transform is computed from world transforms, so those had better be up to date
+    RefreshFromAncestors();
+    newParent.RefreshFromAncestors();
+
     // remove this transform from its current parent's list of children
     if (parent != nullptr) {
         for (auto & c: parent->children) {
@@ -65,16 +148,14 @@ void TransformComponent::SetParent(TransformComponent& newParent) {
 
     // add this transform to its new parent's list of children
     parent->children.push_back(this);
+
+    SetDepth(parent->depth + 1);
+    UpdateLocalTransform();
 }
 
 void TransformComponent::SetPos(glm::dvec3 pos) {
-    auto deltaPosition = pos - Position();
-    for (auto & c: children) {
-        c->SetPos(c->Position() + deltaPosition); // todo : delta position always gonna be the same as it recursively goes down the hierarchy, could optimize this?
-    }
     position = pos;
-    moved = true;
-    
+    OnWorldTransformSet();
 }
 
 void TransformComponent::SetRot(glm::quat rot) {
@@ -88,31 +169,11 @@ void TransformComponent::SetRot(glm::quat rot) {
         
     //     rot.x *= -1;
     // }
-
-    if (children.size() > 0) {
-        auto deltaRotation = rot * glm::inverse(rotation);
-         
-        for (auto & c: children) {
-            auto newRotation = c->Rotation() * deltaRotation;
-
-            // calculate child's local position relative to us (the parent)
-            glm::vec3 localP = glm::inverse(c->Rotation()) * glm::vec3(c->Position() - Position());
-
-            // then rotate that by its new rotation to find its new relative position in world space
-            c->SetPos(Position() + glm::dvec3(newRotation * localP));
-
-            // then, actually apply the rotation.
-            c->SetRot(newRotation);
-
-        }
-    }
-    
     
     rotation = rot;
     UpdateRotScaleMatrix();
     // dirtyRotScale = true;
-    moved = true;
-    
+    OnWorldTransformSet();
 }
 
 void TransformComponent::SetScl(glm::vec3 scl) {
@@ -120,30 +181,122 @@ void TransformComponent::SetScl(glm::vec3 scl) {
     if (scl.x <= 0) scl.x = 0.0001;
     if (scl.y <= 0) scl.y = 0.0001;
     if (scl.z <= 0) scl.z = 0.0001;
+    
+    scale = scl;
+    UpdateRotScaleMatrix();
+    // dirtyRotScale = true;
+    OnWorldTransformSet();
+}
+
+void TransformComponent::OnWorldTransformSet() {
+    if (parent != nullptr) {
+        parent->RefreshFromAncestors();
+        UpdateLocalTransform();
+    }
 
-    if (children.size() > 0) {
-        auto deltaScale = scl / scale;
-         
-        for (auto & c: children) {
-            auto newScale = c->Scale() * deltaScale;
+    // children follow along next time UpdateHierarchy() runs, no matter how many times we're moved before then
+    if (!children.empty() && !hierarchyDirty) {
+        hierarchyDirty = true;
+        DIRTY_PARENTS().push_back(this);
+    }
 
-            // calculate child's local position relative to us (the parent)
-            glm::vec3 localP = glm::inverse(c->Rotation()) * glm::vec3(c->Position() - Position());
+    moved = true;
+    MarkChanged();
+}
 
-            // then scale that its relative position by the new scale to get the real global position
-            c->SetPos(Position() + glm::dvec3(c->Rotation() * (localP * deltaScale)));
+void TransformComponent::UpdateLocalTransform() {
+    Assert(parent != nullptr);
+    glm::quat inverseParentRotation = glm::inverse(parent->rotation);
+    localPosition = glm::dvec3(inverseParentRotation * glm::vec3(position - parent->position)) / glm::dvec3(parent->scale);
+    localRotation = inverseParentRotation * rotation;
+    localScale = scale / parent->scale;
+}
 
-            // then, actually apply the scaling.
-            c->SetScl(newScale);
+void TransformComponent::ApplyParentTransform() {
+    Assert(parent != nullptr);
+    position = parent->position + glm::dvec3(parent->rotation * (parent->scale * glm::vec3(localPosition)));
+    rotation = glm::normalize(parent->rotation * localRotation);
+    scale = parent->scale * localScale;
+    UpdateRotScaleMatrix();
+}
 
+void TransformComponent::RefreshFromAncestors() {
+    // Ancestors only fall behind when one above them moved and hasn't propagated yet, so everything above the highest dirty ancestor is already right.
+    const TransformComponent* highestDirty = nullptr;
+    for (const TransformComponent* ancestor = parent; ancestor != nullptr; ancestor = ancestor->parent) {
+        if (ancestor->hierarchyDirty) {
+            highestDirty = ancestor;
         }
     }
-    
-    
-    scale = scl;
-    UpdateRotScaleMatrix();
-    // dirtyRotScale = true;
-    moved = true;
+
+    if (highestDirty != nullptr) {
+        ApplyParentTransformsBelow(highestDirty);
+    }
+}
+
+void TransformComponent::ApplyParentTransformsBelow(const TransformComponent* ancestor) {
+    if (parent != ancestor) {
+        parent->ApplyParentTransformsBelow(ancestor);
+    }
+    ApplyParentTransform();
+}
+
+void TransformComponent::PropagateToChildren() {
+    // explicit stack instead of recursion so deep hierarchies are fine
+    auto& stack = PROPAGATION_STACK();
+    Assert(stack.empty());
+    stack.push_back(this);
+    while (!stack.empty()) {
+        TransformComponent* t = stack.back();
+        stack.pop_back();
+        t->hierarchyDirty = false;
+
+        for (auto& c : t->children) {
+            c->ApplyParentTransform();
+            c->moved = true;
+            c->MarkChanged();
+            stack.push_back(c);
+        }
+    }
+}
+
+void TransformComponent::MarkChanged() {
+    if (!poolSlotFound) {
+        poolSlot = ComponentPool::FindSlot(this, ComponentBitIndex::Transform);
+        poolSlotFound = true;
+    }
+    ComponentPool::MarkChanged(poolSlot);
+}
+
+void TransformComponent::SetDepth(unsigned int newDepth) {
+    depth = newDepth;
+    for (auto& c : children) {
+        c->SetDepth(newDepth + 1);
+    }
+}
+
+void TransformComponent::UpdateHierarchy() {
+    auto& dirtyParents = DIRTY_PARENTS();
+    if (dirtyParents.empty()) {
+        return;
+    }
+
+    // Parents before children, so that by the time we get to a dirty transform its own world transform is final.
+    // Propagating from a transform also cleans every dirty transform under it, so those get skipped and each dirty subtree is only walked once.
+    std::sort(dirtyParents.begin(), dirtyParents.end(), [](const TransformComponent* a, const TransformComponent* b) { return a->depth < b->depth; });
+    for (auto& t : dirtyParents) {
+        if (t->hierarchyDirty) {
+            t->PropagateToChildren();
+        }
+    }
+
+    dirtyParents.clear();
+}
+
+std::vector<TransformComponent*>& TransformComponent::DIRTY_PARENTS() {
+    // never freed, because transforms (whose destructors use this) are destroyed during static destruction in an unspecified order
+    static std::vector<TransformComponent*>* dirtyParents = new std::vector<TransformComponent*>();
+    return *dirtyParents;
 }
 
 const glm::mat4x4& TransformComponent::GetGraphicsModelMatrix(const glm::dvec3 & cameraPosition) {
@@ -170,4 +323,10 @@ void TransformComponent::UpdateRotScaleMatrix() {
     Assert(!std::isnan(rotation[0]));
     normalMatrix = glm::inverseTranspose(glm::mat3x3(rotScaleMatrix));
     Assert(!std::isnan(normalMatrix[0][0]));
-}
\ No newline at end of file
+}
+
+std::vector<TransformComponent*>& TransformComponent::PROPAGATION_STACK() {
+    // never freed, same as DIRTY_PARENTS()
+    static std::vector<TransformComponent*>* stack = new std::vector<TransformComponent*>();
+    return *stack;
+}
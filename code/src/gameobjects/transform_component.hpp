@@ -1,5 +1,6 @@
 #pragma once
 #include "base_component.hpp"
+#include "component_slot.hpp"
 #include "glm/ext.hpp"
 #include "glm/gtx/quaternion.hpp"
 #include <vector>
@@ -7,9 +8,14 @@
 // TODO: use doubles in matrices for physics???
 // TODO: split off the matrices into their own component to enable graphics optimization (by reducing memory needing to be retrieved each frame in UpdateRenderComponents()).
 // Transform components store position/rotation/scale, they use a transform hierarchy (know that using it excessively carries a performance cost)
+// Children store their transform relative to their parent. Moving a parent doesn't touch its children right away; instead UpdateHierarchy() (called once per frame)
+    // updates every child of every transform that moved since the last call, so a parent that moves several times in a frame only costs one update of its children.
+    // Until then, Position()/Rotation()/Scale() of the children are where they were before their parent moved.
 class TransformComponent: public BaseComponent {
 public:
     TransformComponent(const TransformComponent&) = delete;
+    // Used when compaction moves the component to a different slot; updates the parent's and children's pointers to this transform.
+    TransformComponent(TransformComponent&& old) noexcept;
     TransformComponent();
     ~TransformComponent();
 
@@ -46,8 +52,12 @@ public:
     const glm::mat3& GetNormalMatrix() const;
 
     
+    // Keeps this transform where it is in world space (so its transform relative to newParent is whatever it needs to be for that).
     void SetParent(TransformComponent& newParent);
 
+    // Moves the children of every transform that was moved/rotated/scaled since the last call along with their parents. Call once per frame (before anything that needs child transforms).
+    static void UpdateHierarchy();
+
     // Returns the parent. Don't hold onto this pointer, as when the transform component gets deleted you're in trouble.
     TransformComponent* GetParent();
 
@@ -57,6 +67,37 @@ private:
     // TODO: could instead of calling this when rot/scl changes, call this every frame if a rotSclChanged flag is set
     void UpdateRotScaleMatrix();
 
+    // Called after position/rotation/scale are set in world space; updates the local transform and queues up the children to be moved by UpdateHierarchy().
+    void OnWorldTransformSet();
+
+    // Sets localPosition/localRotation/localScale from the world transforms of this and the parent.
+    void UpdateLocalTransform();
+
+    // Sets position/rotation/scale from the parent's world transform and this transform's local transform.
+    void ApplyParentTransform();
+
+    // Makes sure the world transform is up to date even if an ancestor moved since the last UpdateHierarchy().
+    // Only the transforms below the highest hierarchyDirty ancestor get recalculated; if there isn't one, the world transform is already right and nothing is.
+    void RefreshFromAncestors();
+
+    // Recalculates the world transforms of the ancestors below the given one, then this one's, from the top down.
+    void ApplyParentTransformsBelow(const TransformComponent* ancestor);
+
+    // Updates the world transforms of every descendant and marks them all as not needing that.
+    void PropagateToChildren();
+
+    // Stamps this transform's change version (see ComponentPool::MarkChanged()), finding its slot the first time.
+    void MarkChanged();
+
+    // Sets depth of this transform, and of its descendants accordingly.
+    void SetDepth(unsigned int newDepth);
+
+    // Every transform with hierarchyDirty set.
+    static std::vector<TransformComponent*>& DIRTY_PARENTS();
+
+    // The stack PropagateToChildren() walks descendants with, kept between calls so that it doesn't allocate every frame.
+    static std::vector<TransformComponent*>& PROPAGATION_STACK();
+
     // private constructor to enforce usage of object pool
     //friend class ComponentPool<TransformComponent>;
 
@@ -92,4 +133,19 @@ private:
     glm::dvec3 position;
     glm::quat rotation;
     glm::vec3 scale; 
+
+    // transform relative to the parent (only meaningful if there is one)
+    glm::dvec3 localPosition;
+    glm::quat localRotation;
+    glm::vec3 localScale;
+
+    // number of ancestors. UpdateHierarchy() sorts by this so that parents are handled before their children.
+    unsigned int depth;
+
+    // true if this transform moved and its children haven't caught up yet (in which case it's in DIRTY_PARENTS())
+    bool hierarchyDirty;
+
+    // Where this transform is in its component pool, so that MarkChanged() only has to search for it once instead of every time it moves. Only valid if poolSlotFound.
+    ComponentSlot poolSlot;
+    bool poolSlotFound;
 };
\ No newline at end of file
@@ -109,8 +109,12 @@ void BufferedBuffer::Reallocate(unsigned int newSize) {
     void* newBufferData = glMapBufferRange(bufferBindingLocation, 0, newSize * numBuffers, flags);
 
     // If there was a previous buffer, copy its data in and then delete it.
+    // Each of the numBuffers sections starts at a multiple of the size, so they have to be copied one at a time to end up at the start of their new (bigger) sections.
+        // (Things like UpdateRenderComponents() only write to instances that changed, so the contents of every section have to survive.)
     if (oldSize != 0) {
-        memcpy(newBufferData, _bufferData, oldSize * numBuffers);
+        for (unsigned int i = 0; i < numBuffers; i++) {
+            memcpy((char*)newBufferData + i * newSize, _bufferData + i * oldSize, oldSize);
+        }
         glDeleteBuffers(1, &_bufferId);
     }
 
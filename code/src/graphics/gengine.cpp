@@ -441,7 +441,8 @@ void GraphicsEngine::UpdateLights() {
     unsigned int i = 0;
 
     // Get components of all gameobjects that have a transform and point light component
-    for (auto it = GameObject::SystemGetComponents<TransformComponent, PointLightComponent>({ ComponentBitIndex::Transform, ComponentBitIndex::Pointlight });  it.Valid(); it++) {
+    static GameObject::SystemQuery<TransformComponent, PointLightComponent> pointlightQuery({ ComponentBitIndex::Transform, ComponentBitIndex::Pointlight });
+    for (auto it = pointlightQuery.Iterate(); it.Valid(); it++) {
         auto& tuple = *it;
         TransformComponent& transform = *std::get<0>(tuple);
         PointLightComponent& pointLight = *std::get<1>(tuple);
@@ -469,7 +470,8 @@ void GraphicsEngine::UpdateLights() {
     i = 0;
 
     // Get components of all gameobjects that have a transform and point light component
-    for (auto it = GameObject::SystemGetComponents<TransformComponent, SpotLightComponent>({ ComponentBitIndex::Transform, ComponentBitIndex::Spotlight });  it.Valid(); it++) {
+    static GameObject::SystemQuery<TransformComponent, SpotLightComponent> spotlightQuery({ ComponentBitIndex::Transform, ComponentBitIndex::Spotlight });
+    for (auto it = spotlightQuery.Iterate(); it.Valid(); it++) {
         auto& tuple = *it;
         TransformComponent& transform = *std::get<0>(tuple);
         SpotLightComponent& spotLight = *std::get<1>(tuple);
@@ -575,8 +577,7 @@ void GraphicsEngine::UpdateRenderComponents(float dt) {
     std::vector<unsigned int> indicesToRemove;
 
     // SETTING INSTANCED VERTEX ATTRIBUTES (color, textureZ, etc.)
-        // but not model/normal matrix; those are done in the next part bc every render component gets a different one, every frame.
-        // TODO: unless floating origin in which case this system would be good for them
+        // but not model/normal matrix; those are done in the next part, only for render components whose transform changed (or that just got a new instance slot, see AddCachedMeshes()).
     updater1.ApplyUpdates();
     updater2.ApplyUpdates();
     updater3.ApplyUpdates();
@@ -586,10 +587,30 @@ void GraphicsEngine::UpdateRenderComponents(float dt) {
     
     unsigned int nR = 0;
 
+    // Only objects whose transforms changed need new model/normal matrices.
+    // Instance data is INSTANCED_VERTEX_BUFFERING_FACTOR-buffered, so a change has to be written on that many frames; hence we go by the change version from that many frames ago.
+    // (New render components count as changed, and AddCachedMeshes() stamps the transform of anything it gives a new instance slot, so those get written too.)
+    static std::array<uint32_t, INSTANCED_VERTEX_BUFFERING_FACTOR> lastRunVersions = {}; // all 0, so everything counts as changed for the first few frames
+    static unsigned int lastRunIndex = 0;
+    uint32_t changedSince = lastRunVersions[lastRunIndex];
+    lastRunVersions[lastRunIndex] = ComponentPool::AdvanceChangeVersion();
+    lastRunIndex = (lastRunIndex + 1) % INSTANCED_VERTEX_BUFFERING_FACTOR;
+
+    // With floating origin every model matrix changes when the camera moves, so then everything has to be written (for INSTANCED_VERTEX_BUFFERING_FACTOR frames).
+    static glm::dvec3 lastCameraPos = cameraPos;
+    static unsigned int framesSinceCameraMoved = 0;
+    if (cameraPos != lastCameraPos) {
+        framesSinceCameraMoved = 0;
+        lastCameraPos = cameraPos;
+    }
+    uint32_t changedSinceFO = framesSinceCameraMoved < INSTANCED_VERTEX_BUFFERING_FACTOR ? 0 : changedSince;
+    framesSinceCameraMoved++;
+
     //DebugLogInfo("GOING IN:");
 
     // Get components of all gameobjects that have a transform and render component
-    for (auto it = GameObject::SystemGetComponents<TransformComponent, RenderComponent>({ComponentBitIndex::Transform, ComponentBitIndex::Render});  it.Valid(); it++) {
+    static GameObject::SystemQuery<TransformComponent, RenderComponent> renderQuery({ComponentBitIndex::Transform, ComponentBitIndex::Render});
+    for (auto it = renderQuery.IterateChangedSince<TransformComponent>(changedSinceFO); it.Valid(); it++) {
     //std::for_each(std::execution::par, components.begin(), components.end(), [this, &cameraPos](std::tuple<RenderComponent*, TransformComponent*>& tuple) {
         auto& tuple = *it;
         auto & transformComp = *std::get<0>(tuple);
@@ -618,7 +639,8 @@ void GraphicsEngine::UpdateRenderComponents(float dt) {
     unsigned int nRNFO = 0;
 
     // Get components of all gameobjects that have a transform and no floating origin render component
-    for (auto it = GameObject::SystemGetComponents<TransformComponent, RenderComponentNoFO>({ ComponentBitIndex::Transform, ComponentBitIndex::RenderNoFO });  it.Valid(); it++) {
+    static GameObject::SystemQuery<TransformComponent, RenderComponentNoFO> renderNoFOQuery({ ComponentBitIndex::Transform, ComponentBitIndex::RenderNoFO });
+    for (auto it = renderNoFOQuery.IterateChangedSince<TransformComponent>(changedSince); it.Valid(); it++) {
         auto& tuple = *it;
         auto& transformComp = *std::get<0>(tuple);
         auto& renderCompNoFO = *std::get<1>(tuple);
@@ -666,7 +688,8 @@ void GraphicsEngine::UpdateRenderComponents(float dt) {
     //});
 
     // animations
-    for (auto it = GameObject::SystemGetComponents<AnimationComponent>({ ComponentBitIndex::Animation });  it.Valid(); it++) {
+    static GameObject::SystemQuery<AnimationComponent> animationQuery({ ComponentBitIndex::Animation });
+    for (auto it = animationQuery.Iterate(); it.Valid(); it++) {
 
         auto& tuple = *it;
         auto& animComp = std::get<0>(tuple);
@@ -812,6 +835,9 @@ void GraphicsEngine::AddCachedMeshes() {
             for (unsigned int i = 0; i < components.size(); i++) {
                 components[i]->meshpoolId = poolIndex;
                 components[i]->drawHandle = drawHandles.at(i);
+
+                // the new instance slot has no model/normal matrix yet, so UpdateRenderComponents() has to treat the transform as changed even if it didn't move (like when a dynamic mesh outgrows its slot and its users get readded)
+                ComponentPool::MarkObjectChangedAt(components[i], ComponentBitIndex::Transform);
                 //DebugLogInfo("Wrote component to cslot ", drawHandles.at(i).drawBufferIndex);
 
                 if (m->dynamic) {
@@ -842,6 +868,33 @@ void GraphicsEngine::AddObject(unsigned int materialId, unsigned int meshId, Ren
     renderComponentsToAdd[meshId][materialId].push_back(component);
 }
 
+void GraphicsEngine::RelocateObject(RenderComponent* oldAddress, RenderComponent* newAddress) {
+    if (newAddress->meshpoolId == -1) {
+        // hasn't been added to a meshpool yet, so it's still in renderComponentsToAdd
+        for (auto& component : renderComponentsToAdd.at(newAddress->meshId).at(newAddress->materialId)) {
+            if (component == oldAddress) {
+                component = newAddress;
+                break;
+            }
+        }
+    }
+    else if (dynamicMeshUsers.contains(newAddress->meshId)) {
+        for (auto& component : dynamicMeshUsers.at(newAddress->meshId)) {
+            if (component == oldAddress) {
+                component = newAddress;
+                break;
+            }
+        }
+    }
+
+    updater1.RelocateUpdates(oldAddress, newAddress);
+    updater2.RelocateUpdates(oldAddress, newAddress);
+    updater3.RelocateUpdates(oldAddress, newAddress);
+    updater4.RelocateUpdates(oldAddress, newAddress);
+    updater3x3.RelocateUpdates(oldAddress, newAddress);
+    updater4x4.RelocateUpdates(oldAddress, newAddress);
+}
+
 void GraphicsEngine::RemoveObject(RenderComponent* comp)
 {
     
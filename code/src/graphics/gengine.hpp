@@ -5,6 +5,7 @@
 #include "window.hpp"
 #include "shader_program.hpp"
 #include "debug/assert.hpp"
+#include <algorithm>
 #include <cstdio>
 #include <memory>
 #include <unordered_map>
@@ -237,6 +238,22 @@ private:
             canceledUpdates.push_back(comp);
         }
 
+        // Called when a render component is moved to a different address, so that its pending updates follow it.
+        void RelocateUpdates(RenderComponent* oldAddress, RenderComponent* newAddress) {
+            // canceled updates at oldAddress belong to dead components that used to live there, and ApplyUpdates() cancels the first update it finds for each one, so leave that many alone
+            auto nCanceled = std::count(canceledUpdates.begin(), canceledUpdates.end(), oldAddress);
+            for (auto& update : updates) {
+                if (update.renderComp == oldAddress) {
+                    if (nCanceled > 0) {
+                        nCanceled--;
+                    }
+                    else {
+                        update.renderComp = newAddress;
+                    }
+                }
+            }
+        }
+
         void ApplyUpdates() {
             //unsigned int i = 0;
             
@@ -328,5 +345,8 @@ private:
     void AddObject(unsigned int materialId, unsigned int meshId, RenderComponent* component);
 
     void RemoveObject(RenderComponent* comp);
+
+    // Called by RenderComponent's move constructor so that everything that stores a pointer to the component points to its new address instead.
+    void RelocateObject(RenderComponent* oldAddress, RenderComponent* newAddress);
 };
 
@@ -185,6 +185,13 @@ LuaHandler::LuaHandler() {
             {"AudioPlayer", ComponentBitIndex::AudioPlayer}
         });
 
+    enumTable.new_enum<ColliderShape, true>("ColliderShape", {
+        {"Mesh", ColliderShapeMesh},
+        {"Sphere", ColliderShapeSphere},
+        {"Box", ColliderShapeBox},
+        {"Capsule", ColliderShapeCapsule}
+    });
+
     enumTable.new_enum<Texture::TextureUsage, true>("TextureUsage", {
         {"ColorMap", Texture::TextureUsage::ColorMap},
         {"DisplacementMap", Texture::TextureUsage::DisplacementMap},
@@ -295,6 +302,7 @@ LuaHandler::LuaHandler() {
     gameObjectCreateParamsUsertype["meshId"] = &LuaGameobjectCreateParams::meshId;
     gameObjectCreateParamsUsertype["materialId"] = &LuaGameobjectCreateParams::materialId;
     gameObjectCreateParamsUsertype["sound"] = &LuaGameobjectCreateParams::sound;
+    gameObjectCreateParamsUsertype["colliderShape"] = &LuaGameobjectCreateParams::colliderShape;
 
     auto transformComponentUsertype = LUA_STATE->new_usertype<TransformComponent>("Transform", sol::no_constructor);
     transformComponentUsertype["position"] = sol::property(&TransformComponent::Position, &TransformComponent::SetPos);
@@ -311,15 +319,19 @@ LuaHandler::LuaHandler() {
     // colliderComponentUsertype["IsCollidingWith"] = &ColliderComponent::IsCollidingWith;
     // colliderComponentUsertype["GetColliding"] = &ColliderComponent::GetColliding;
     colliderComponentUsertype["gameObject"] = sol::property(&ColliderComponent::GetGameObject);
+    colliderComponentUsertype["shape"] = sol::readonly(&ColliderComponent::shape);
 
     auto rigidbodyComponentUsertype = LUA_STATE->new_usertype<RigidbodyComponent>("Rigidbody", sol::no_constructor);
     rigidbodyComponentUsertype["kinematic"] = &RigidbodyComponent::kinematic;
+    rigidbodyComponentUsertype["continuousCollision"] = &RigidbodyComponent::continuousCollision;
     rigidbodyComponentUsertype["velocity"] = &RigidbodyComponent::velocity;
     rigidbodyComponentUsertype["angularVelocity"] = &RigidbodyComponent::angularVelocity;
     rigidbodyComponentUsertype["mass"] = sol::property(&RigidbodyComponent::SetMass);
     rigidbodyComponentUsertype["localMomentOfInertia"] = &RigidbodyComponent::localMomentOfInertia;
     rigidbodyComponentUsertype["linearDrag"] = &RigidbodyComponent::linearDrag;
     rigidbodyComponentUsertype["angularDrag"] = &RigidbodyComponent::angularDrag;
+    rigidbodyComponentUsertype["sleeping"] = sol::readonly_property(&RigidbodyComponent::Sleeping);
+    rigidbodyComponentUsertype["Wake"] = &RigidbodyComponent::Wake;
 
     auto pointlightComponentUsertype = LUA_STATE->new_usertype<PointLightComponent>("PointLight", sol::no_constructor);
     pointlightComponentUsertype["range"] = sol::property(&PointLightComponent::Range, &PointLightComponent::SetRange);
@@ -355,6 +367,7 @@ LuaHandler::LuaHandler() {
     raycastResultUsertype["hitObject"] = sol::readonly(&RaycastResult::hitObject);
     raycastResultUsertype["hitNormal"] = sol::readonly(&RaycastResult::hitNormal);
     raycastResultUsertype["hitPoint"] = sol::readonly(&RaycastResult::hitPoint);
+    raycastResultUsertype["hitDistance"] = sol::readonly(&RaycastResult::hitDistance);
     LUA_STATE->set_function("Raycast", &Raycast);
 
     // LUA_STATE->set_function("NewGameObject", ComponentRegistry::NewGameObject);
@@ -36,6 +36,8 @@
 #include "non-engine/game.hpp"
 #include <tests/gameobject_tests.hpp>
 #include "tests/graphics_test.hpp"
+#include "tests/gameobject_benchmarks.hpp"
+#include "tests/physics_benchmarks.hpp"
 
 //#include "FastNoise/FastNoise.h"
 
@@ -85,8 +87,8 @@ int main(int numArgs, const char *argPtrs[]) {
 
     atexit(RecordSingletonClosing);
 
-    // GAMEOBJECTS needs to be intitialized after all the other singletons so that component destructors are called before the singleton destructors are called.
-    GameObject::GAMEOBJECTS();
+    // The gameobject registry needs to be intitialized after all the other singletons so that component destructors are called before the singleton destructors are called.
+    GameObject::REGISTRY();
     //auto & CR = ComponentRegistry::Get();
 
     atexit(BaseEvent::Cleanup);
@@ -99,6 +101,15 @@ int main(int numArgs, const char *argPtrs[]) {
     DebugLogInfo("Calling GameInit().");
     GameInit();
     //TestGraphics();
+    //BenchmarkComponentPoolIteration();
+    //BenchmarkBroadphase();
+    //BenchmarkNarrowphase();
+    //BenchmarkPrimitiveColliders();
+    //BenchmarkPhysicsMeshFaces();
+    //BenchmarkRaycasts();
+    //BenchmarkSpatialQueries();
+    //BenchmarkTerrainColliders();
+    //BenchmarkContinuousCollision();
     //GE.SetDebugFreecamEnabled(true);
     //TestGrassFloor();
     //TestStationaryPointlight();
@@ -141,6 +152,7 @@ int main(int numArgs, const char *argPtrs[]) {
     //TestCubeArray({2, 2, 2}, {0, 0, 0}, {2, 2, 2}, false);
     //TestSpinningSpotlight();
     //TestSphere(5, 3, -4, false);
+    //TestProjectile({14, 4, 0}, {-100, 0, 0}); // at TestBrickWall()
 
     //auto m = CubeMesh();
 
@@ -177,6 +189,7 @@ int main(int numArgs, const char *argPtrs[]) {
         if (physicsLag >= SIMULATION_TIMESTEP) { // make sure stepping simulation won't put it ahead of realtime
             // printf("Updating SAS.\n");
 
+            TransformComponent::UpdateHierarchy();
             SpatialAccelerationStructure::Get().Update();
 
             if (!physicsPaused) {
@@ -186,12 +199,9 @@ int main(int numArgs, const char *argPtrs[]) {
                 PE.prePhysicsEvent->Fire(SIMULATION_TIMESTEP);
                 BaseEvent::FlushEventQueue(); // if we don't do this, if firing the event is meant to (for example) change velocities, it won't apply until next frame.
 
+                // fast things that would tunnel through stuff in one step should use RigidbodyComponent::continuousCollision instead of more steps
                 for (unsigned int i = 0; i < N_PHYSICS_ITERATIONS; i++) {
-                    PE.Step(SIMULATION_TIMESTEP/2.0/N_PHYSICS_ITERATIONS);
-                    PE.Step(SIMULATION_TIMESTEP/4.0/N_PHYSICS_ITERATIONS);
-                    PE.Step(SIMULATION_TIMESTEP/8.0/N_PHYSICS_ITERATIONS);
-                    PE.Step(SIMULATION_TIMESTEP/8.0/N_PHYSICS_ITERATIONS);
-                    // PE.Step(SIMULATION_TIMESTEP);
+                    PE.Step(SIMULATION_TIMESTEP/N_PHYSICS_ITERATIONS);
                 }
 
                 PE.postPhysicsEvent->Fire(SIMULATION_TIMESTEP);
@@ -210,6 +220,7 @@ int main(int numArgs, const char *argPtrs[]) {
         BaseEvent::FlushEventQueue();
         LUA.PreRenderCallbacks();
 
+        TransformComponent::UpdateHierarchy();
         GE.RenderScene(elapsedTime);
 
         // TODO: unsure about placement of flip buffers? 
@@ -225,6 +236,9 @@ int main(int numArgs, const char *argPtrs[]) {
         LUA.PostRenderCallbacks();
         Module::PostRender();
 
+        // opt-in, for long sessions that create and destroy lots of gameobjects; frees pool pages left mostly empty by destroyed gameobjects, a little each frame
+        //GameObject::CompactComponentPools(0.0005);
+
         //LogElapsed(currentTime, "Frame elapsed");
 
     }
@@ -32,7 +32,10 @@ void Entity::UpdateAll(float dt) {
 		// +/- 8 to reach chunk boundaries instead of chunk centres
 		AABB loaderBounds(glm::dvec3(loader.centerPosition.x - loader.radius - 8, -16384.0, loader.centerPosition.y - loader.radius), glm::dvec3(loader.centerPosition.x + loader.radius, 16384.0, loader.centerPosition.y + loader.radius + 8));
 
-		auto entityObjects = SAS.Query(loaderBounds, entityLayerSet);
+		// OnWakeup() could make or destroy colliders, which can't happen in the middle of a query, so this gets a list first (reusing the vector so it doesn't allocate every frame)
+		static std::vector<ColliderComponent*> entityObjects;
+		entityObjects.clear();
+		SAS.Query(loaderBounds, entityObjects, entityLayerSet);
 		for (auto& obj : entityObjects) {
 			auto entity = FromGameObject(obj->gameobject);
 			Assert(entity);
@@ -72,14 +75,27 @@ void Entity::Cleanup() {
 }
 
 std::shared_ptr<Entity> Entity::FromGameObject(GameObject* obj) {
-	if (GameObjectsToEntities().contains(obj)) {
-		return GameObjectsToEntities()[obj];
+	auto& entities = GameObjectsToEntities();
+	uint32_t index = obj->Handle().index;
+
+	// the slot might belong to an entity whose gameobject was destroyed and whose handle index was reused, so check it's actually obj's
+	if (index < entities.size() && entities[index] != nullptr && entities[index]->gameObject.get() == obj) {
+		return entities[index];
 	}
 	else {
 		return nullptr;
 	}
 }
 
+void Entity::RegisterEntity(const std::shared_ptr<Entity>& entity) {
+	auto& entities = GameObjectsToEntities();
+	uint32_t index = entity->gameObject->Handle().index;
+	if (index >= entities.size()) {
+		entities.resize(index + 1);
+	}
+	entities[index] = entity;
+}
+
 bool Entity::IsActive() {
 	return sleepTime == -1;
 }
@@ -133,8 +149,8 @@ std::vector<std::shared_ptr<Entity>>& Entity::Entities()
 //	return av;
 //}
 
-std::unordered_map<GameObject*, std::shared_ptr<Entity>>& Entity::GameObjectsToEntities()
+std::vector<std::shared_ptr<Entity>>& Entity::GameObjectsToEntities()
 {
-	static std::unordered_map<GameObject*, std::shared_ptr<Entity>> e;
+	static std::vector<std::shared_ptr<Entity>> e;
 	return e;
 }
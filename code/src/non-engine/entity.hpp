@@ -59,8 +59,11 @@ protected:
 	// order is not preserved
 	static std::vector<std::shared_ptr<Entity>>& Entities();
 
-	// not private; subclasses factory methods need to append created entities to this vector
-	static std::unordered_map<GameObject*, std::shared_ptr<Entity>>& GameObjectsToEntities();
+	// Indexed by the handle index of each entity's gameobject (nullptr where there's no entity), so FromGameObject() doesn't have to hash anything.
+	static std::vector<std::shared_ptr<Entity>>& GameObjectsToEntities();
+
+	// not private; subclasses factory methods need to call this on created entities so FromGameObject() can find them
+	static void RegisterEntity(const std::shared_ptr<Entity>& entity);
 
 private:
 	Entity(const Entity&) = delete;
@@ -22,7 +22,7 @@ Humanoid::Humanoid(std::shared_ptr<Mesh> mesh):
 std::shared_ptr<Humanoid> Humanoid::New()
 {
 	auto ptr = std::shared_ptr<Humanoid>(new Humanoid(CubeMesh())); // TODO: make_shared?
-	GameObjectsToEntities()[ptr->gameObject.get()] = ptr;
+	RegisterEntity(ptr);
 	Entities().push_back(ptr);
 	return ptr; 
 }
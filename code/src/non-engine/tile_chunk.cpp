@@ -2,8 +2,21 @@
 #include "gameobjects/gameobject.hpp"
 #include "world.hpp"
 #include "tile_data.hpp"
+#include "physics/heightfield.hpp"
 #include <tests/gameobject_tests.hpp>
 
+namespace {
+	// How high a tile's cell in the ground's heightfield is. Floors that are their own gameobject get to collide as that instead, so they're holes just like missing floors.
+	float GroundHeight(const TerrainTile& tile) {
+		if (tile.layers[TileLayer::Floor] < 0) {
+			return Heightfield::HOLE;
+		}
+
+		const auto& floorData = GetTileData(tile.layers[TileLayer::Floor]);
+		return floorData.gameobject.has_value() ? Heightfield::HOLE : floorData.yOffset;
+	}
+}
+
 void RenderChunk::MakeMesh(glm::ivec2 centerPos, int stride, int radius) {
 
 	MeshCreateParams params;
@@ -124,8 +137,19 @@ void RenderChunk::MakeMesh(glm::ivec2 centerPos, int stride, int radius) {
 	mesh = Mesh::New(RawMeshProvider(vertices, indices, params), false);
 }
 
+void RenderChunk::MakeMainObject() {
+	auto params = GameobjectCreateParams({ComponentBitIndex::Render, ComponentBitIndex::Transform});
+	params.materialId = material ? material->id: 0;
+	params.meshId = mesh->meshId;
+	mainObject = GameObject::New(params);
+	mainObject->RawGet<TransformComponent>()->SetPos(glm::dvec3(pos.x - 0.5, 0, pos.y - 0.5));
+	mainObject->RawGet<TransformComponent>()->SetScl(mesh->originalSize);
+}
+
 RenderChunk::RenderChunk(glm::ivec2 centerPos, int stride, int radius, const std::shared_ptr<Material>& material, const std::shared_ptr<TextureAtlas>& atlas):
 	pos(centerPos),
+	stride(stride),
+	radius(radius),
 	material(material),
 	atlas(atlas)
 {
@@ -137,18 +161,43 @@ RenderChunk::RenderChunk(glm::ivec2 centerPos, int stride, int radius, const std
 	//mesh = CubeMesh();
 	//DebugLogInfo("Created at ",  mesh->vertices.size());
 
-	auto params = GameobjectCreateParams({ComponentBitIndex::Render, ComponentBitIndex::Collider, ComponentBitIndex::Transform});
-	params.materialId = material ? material->id: 0;
-	params.meshId = mesh->meshId;
-	mainObject = GameObject::New(params);
-	mainObject->RawGet<ColliderComponent>()->SetCollisionLayer(COLLISION_LAYER);
-	mainObject->RawGet<TransformComponent>()->SetPos(glm::dvec3(centerPos.x - 0.5, 0, centerPos.y - 0.5));
-	mainObject->RawGet<TransformComponent>()->SetScl(mesh->originalSize);
+	MakeMainObject();
+
+	// the ground's heightfield covers every tile (even with stride > 1), plus the ring of tiles around the chunk so that its edges line up with the next chunk over
+	int width = radius * 2;
+	auto heightfield = std::make_shared<Heightfield>(width, width);
+	auto& world = World::Loaded();
+	for (int x = -1; x <= width; x++) {
+		for (int z = -1; z <= width; z++) {
+			heightfield->SetHeight(x, z, GroundHeight(world->GetTile(x + centerPos.x - radius, z + centerPos.y - radius)));
+		}
+	}
+
+	auto params = GameobjectCreateParams({ComponentBitIndex::Collider, ComponentBitIndex::Transform});
+	params.colliderShape = ColliderShapeHeightfield;
+	params.heightfield = heightfield;
+	groundObject = GameObject::New(params);
+	groundObject->RawGet<ColliderComponent>()->SetCollisionLayer(COLLISION_LAYER);
+	groundObject->RawGet<TransformComponent>()->SetPos(glm::dvec3(centerPos.x - radius - 0.5, 0, centerPos.y - radius - 0.5));
 }
 
-RenderChunk::~RenderChunk() {
-	//DebugLogInfo("Destroyed at ", pos);
+void RenderChunk::Remake() {
+	DestroyObjects();
+	MakeMesh(pos, stride, radius);
+	MakeMainObject();
+	dirty = false;
+}
+
+void RenderChunk::UpdateTile(int x, int z, const TerrainTile& tile) {
+	glm::ivec2 cell = glm::ivec2(x, z) - pos + radius;
+	if (cell.x < -1 || cell.y < -1 || cell.x > radius * 2 || cell.y > radius * 2) {
+		return; // not in the chunk or its ring
+	}
+
+	groundObject->RawGet<ColliderComponent>()->SetHeightfieldCell(cell.x, cell.y, GroundHeight(tile));
+}
 
+void RenderChunk::DestroyObjects() {
 	//if (mainObject) {
 		mainObject->Destroy();
 		mainObject = nullptr;
@@ -160,3 +209,11 @@ RenderChunk::~RenderChunk() {
 	objects.clear();
 	Mesh::Unload(mesh->meshId);
 }
+
+RenderChunk::~RenderChunk() {
+	//DebugLogInfo("Destroyed at ", pos);
+
+	DestroyObjects();
+	groundObject->Destroy();
+	groundObject = nullptr;
+}
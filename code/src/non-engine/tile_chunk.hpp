@@ -7,6 +7,7 @@ class TextureAtlas;
 class GameObject;
 class Mesh;
 class Material;
+struct TerrainTile;
 
 class RenderChunk {
 public:
@@ -18,18 +19,30 @@ public:
 
 	~RenderChunk();
 
+	// Remakes the mesh and objects after the chunk's tiles changed (see dirty). The ground collider stays, since UpdateTile() already keeps it up to date.
+	void Remake();
+
+	// Call when a tile in the chunk or right next to it changes, so that the ground collider matches it right away instead of whenever the chunk gets remade.
+	// Only changes one cell of the ground's heightfield, so it's cheap.
+	void UpdateTile(int x, int z, const TerrainTile& tile);
+
 	bool dead = false;
 	bool dirty = false; // true if renderchunk has been modified and its mesh must be redone
 
 private:
 	const glm::ivec2 pos;
+	const int stride;
+	const int radius;
 
 	std::shared_ptr<Material> material;
 	std::shared_ptr<TextureAtlas> atlas;
 	std::shared_ptr<Mesh> mesh;
 
 	std::shared_ptr<GameObject> mainObject; // main terrain is just textured tiles and is shoved into one mesh / object
+	std::shared_ptr<GameObject> groundObject; // collides as a heightfield of the floor tiles (see Heightfield), so that collisions with the ground don't have to go through a mesh
 	std::vector<std::shared_ptr<GameObject>> objects; // other things have more complex meshes and have their own object
 
 	void MakeMesh(glm::ivec2 centerPos, int stride, int radius);
+	void MakeMainObject();
+	void DestroyObjects();
 };
\ No newline at end of file
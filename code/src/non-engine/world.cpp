@@ -78,11 +78,24 @@ TerrainTile World::GetTile(int x, int z)
 void World::SetTile(int x, int z, TileLayer layer, int tile) {
     auto chunkPos = ChunkCoords(glm::ivec2(x, z));
     auto& chunk = GetChunkMut(x, z);
-    GetTileMut(x, z).layers[layer] = tile;
+    auto& terrainTile = GetTileMut(x, z);
+    terrainTile.layers[layer] = tile;
     chunk.pathfindingDirty = true;
 
-    if (renderChunks.contains(chunkPos));
+    if (renderChunks.contains(chunkPos)) {
         renderChunks[chunkPos]->dirty = true;
+    }
+
+    // Ground colliders get the new tile right away instead of waiting for their chunk to be remade.
+    // That includes the chunks next door if the tile's on the edge, since their heightfields remember the tiles around them.
+    for (int dx = -16; dx <= 16; dx += 16) {
+        for (int dz = -16; dz <= 16; dz += 16) {
+            auto it = renderChunks.find(chunkPos + glm::ivec2(dx, dz));
+            if (it != renderChunks.end()) {
+                it->second->UpdateTile(x, z, terrainTile);
+            }
+        }
+    }
 }
 
 TerrainChunk& World::GetChunkMut(int x, int z) {
@@ -222,9 +235,12 @@ World::World() {
         for (int x = roundedTopLeft.x - 8; x <= roundedBottomRight.x + 8; x += 16) {
             for (int y = roundedTopLeft.z - 8; y <= roundedBottomRight.z + 8; y += 16) {
                 if (!activeChunkLocations.contains({ x, y })) continue;
-                if (!renderChunks.count({ x, y }) || renderChunks[{x, y}]->dirty) {
+                if (!renderChunks.count({ x, y })) {
                     renderChunks[glm::ivec2(x, y)] = std::unique_ptr<RenderChunk>(new RenderChunk(glm::ivec2(x, y), 1, 8, TerrainMaterial(), TerrainAtlas()));
                 }
+                else if (renderChunks[{x, y}]->dirty) {
+                    renderChunks[{x, y}]->Remake();
+                }
                 renderChunks[{x, y}]->dead = false;
             }
         }
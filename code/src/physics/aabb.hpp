@@ -1,7 +1,8 @@
 #pragma once
 #include <bitset>
+#include <cmath>
 
-// AABBs inserted into the SAS will be scaled by this much so that if the object moves a little bit we don't need to update its position in the SAS. (TODO?)
+// Collider AABBs will be scaled by this much. (The SAS separately pads the AABBs it stores so that small movements don't need to update it, see SAS_AABB_MARGIN.)
 static const inline double AABB_FAT_FACTOR = 1;
 
 using CollisionLayer = uint16_t;
@@ -32,18 +33,18 @@ struct AABB {
     }
 
     // Checks if this AABB fully envelopes the other AABB 
-    bool TestEnvelopes(const AABB& other) {
+    bool TestEnvelopes(const AABB& other) const {
         return (min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z && max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z);
     }
 
     // returns true if they touching
-    bool TestIntersection(const AABB& other) {
+    bool TestIntersection(const AABB& other) const {
         return (min.x <= other.max.x && max.x >= other.min.x) && (min.y <= other.max.y && max.y >= other.min.y) && (min.z <= other.max.z && max.z >= other.min.z);
     }
 
     // returns true if they touching
     // uses https://tavianator.com/2011/ray_box.html 
-    bool TestIntersection(const glm::dvec3& origin, const glm::dvec3& direction_inverse) {
+    bool TestIntersection(const glm::dvec3& origin, const glm::dvec3& direction_inverse) const {
         //std::printf("Testing AABB going from %f %f %f to %f %f %f\n.", min.x, min.y, min.z, max.x, max.y, max.z);
 
         double t1 = (min[0] - origin[0]) * direction_inverse[0];
@@ -63,6 +64,26 @@ struct AABB {
         return tmax > std::max(tmin, 0.0);
     }
 
+    // Same test as above, but returns how far along the ray (in multiples of direction) it enters the AABB; 0 if the origin is inside, or INFINITY if the ray misses.
+    double RayDistance(const glm::dvec3& origin, const glm::dvec3& direction_inverse) const {
+        double t1 = (min[0] - origin[0]) * direction_inverse[0];
+        double t2 = (max[0] - origin[0]) * direction_inverse[0];
+
+        double tmin = std::min(t1, t2);
+        double tmax = std::max(t1, t2);
+
+        for (int i = 1; i < 3; ++i) {
+            t1 = (min[i] - origin[i]) * direction_inverse[i];
+            t2 = (max[i] - origin[i]) * direction_inverse[i];
+
+            tmin = std::min(std::max(t1, tmin), std::max(t2, tmin));
+            tmax = std::max(std::min(t1, tmax), std::min(t2, tmax));
+        }
+
+        tmin = std::max(tmin, 0.0);
+        return tmax < tmin ? INFINITY : tmin;
+    }
+
     // returns average of min and max
     glm::dvec3 Center() const {
         return (min + max) * 0.5;
@@ -73,4 +94,10 @@ struct AABB {
         auto m = max - min;
         return m.x * m.y * m.z;
     }   
+
+    // returns AABB's surface area
+    double SurfaceArea() const {
+        auto m = max - min;
+        return 2.0 * (m.x * m.y + m.y * m.z + m.z * m.x);
+    }
 };
@@ -0,0 +1,13 @@
+#pragma once
+
+// What shape a collider is.
+// Mesh colliders use their PhysicsMesh and go through GJK. The others are primitives (see primitive_collisions.hpp), which have closed-form AABBs and support functions,
+    // and (except for box vs box, which goes through GJK like a mesh would) their own collision routines for pairs of them.
+// Heightfield colliders are grids of columns for terrain (see heightfield.hpp), and collide with everything through their own routine.
+enum ColliderShape {
+    ColliderShapeMesh = 0,
+    ColliderShapeSphere = 1,
+    ColliderShapeBox = 2,
+    ColliderShapeCapsule = 3,
+    ColliderShapeHeightfield = 4
+};
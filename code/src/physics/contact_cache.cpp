@@ -0,0 +1,115 @@
+#include "contact_cache.hpp"
+#include "gameobjects/collider_component.hpp"
+#include "heightfield.hpp"
+#include <functional>
+#include <cmath>
+
+bool ContactCache::FindCollision(const TransformComponent& transform1, const ColliderComponent& collider1, const TransformComponent& transform2, const ColliderComponent& collider2, CollisionInfo& collision) {
+    if (std::greater<const ColliderComponent*>()(&collider1, &collider2)) {
+        // the entry is stored the other way around; swapping the objects just flips the normal
+        if (!FindCollision(transform2, collider2, transform1, collider1, collision)) {
+            return false;
+        }
+        collision.collisionNormal = -collision.collisionNormal;
+        return true;
+    }
+
+    // no inserting here, since other threads might be looking up their own pairs
+    auto it = entries.find(std::make_pair(&collider1, &collider2));
+    Assert(it != entries.end()); // forgot ReservePair()
+    Entry& entry = it->second;
+    if (entry.physicsMesh1 != collider1.physicsMesh.get() || entry.physicsMesh2 != collider2.physicsMesh.get() || entry.shapeVersion1 != ShapeVersion(collider1) || entry.shapeVersion2 != ShapeVersion(collider2)) {
+        entry.colliding = false;
+        entry.searchDirection = glm::dvec3(0, 0, 0);
+    }
+
+    // Not colliding last time isn't reused even if they haven't moved, since they could have been just barely apart. That case gets GJK's warm start instead.
+    if (entry.colliding && !MovedTooFar(entry.pose1, transform1) && !MovedTooFar(entry.pose2, transform2)) {
+        if (RefreshManifold(entry, transform1, transform2, collision)) {
+            return true;
+        }
+    }
+
+    entry.physicsMesh1 = collider1.physicsMesh.get();
+    entry.physicsMesh2 = collider2.physicsMesh.get();
+    entry.shapeVersion1 = ShapeVersion(collider1);
+    entry.shapeVersion2 = ShapeVersion(collider2);
+    entry.pose1 = Pose { .position = transform1.Position(), .rotation = transform1.Rotation(), .scale = transform1.Scale() };
+    entry.pose2 = Pose { .position = transform2.Position(), .rotation = transform2.Rotation(), .scale = transform2.Scale() };
+    entry.colliding = IsColliding(transform1, collider1, transform2, collider2, entry.manifold, &entry.searchDirection);
+    if (entry.colliding) {
+        collision = entry.manifold; // (copy assignment reuses collision's storage too)
+    }
+    return entry.colliding;
+}
+
+void ContactCache::ReservePair(const ColliderComponent* collider1, const ColliderComponent* collider2) {
+    if (std::greater<const ColliderComponent*>()(collider1, collider2)) {
+        std::swap(collider1, collider2);
+    }
+
+    auto [it, inserted] = entries.try_emplace(std::make_pair(collider1, collider2));
+    if (inserted) {
+        // no manifold yet, and null meshes so that FindCollision() doesn't trust anything else in here
+        it->second.physicsMesh1 = nullptr;
+        it->second.physicsMesh2 = nullptr;
+        it->second.shapeVersion1 = 0;
+        it->second.shapeVersion2 = 0;
+        it->second.colliding = false;
+        it->second.searchDirection = glm::dvec3(0, 0, 0);
+    }
+    it->second.seenThisStep = true;
+}
+
+void ContactCache::EndStep() {
+    std::erase_if(entries, [](const auto& keyAndEntry) {
+        return !keyAndEntry.second.seenThisStep;
+    });
+
+    for (auto& [key, entry] : entries) {
+        entry.seenThisStep = false;
+    }
+}
+
+unsigned int ContactCache::ShapeVersion(const ColliderComponent& collider) {
+    return collider.heightfield ? collider.heightfield->Version() : 0;
+}
+
+bool ContactCache::MovedTooFar(const Pose& pose, const TransformComponent& transform) {
+    if (pose.scale != transform.Scale()) {
+        return true;
+    }
+
+    if (glm::length2(transform.Position() - pose.position) > CONTACT_CACHE_LINEAR_TOLERANCE * CONTACT_CACHE_LINEAR_TOLERANCE) {
+        return true;
+    }
+
+    // the angle between two rotations is 2 * acos(|dot product of the quaternions|)
+    static const float MIN_ROTATION_DOT = std::cos(CONTACT_CACHE_ANGULAR_TOLERANCE / 2.0);
+    return std::abs(glm::dot(pose.rotation, transform.Rotation())) < MIN_ROTATION_DOT;
+}
+
+bool ContactCache::RefreshManifold(const Entry& entry, const TransformComponent& transform1, const TransformComponent& transform2, CollisionInfo& refreshed) {
+    glm::dquat rotationChange1 = glm::dquat(transform1.Rotation() * glm::inverse(entry.pose1.rotation));
+    glm::dquat rotationChange2 = glm::dquat(transform2.Rotation() * glm::inverse(entry.pose2.rotation));
+
+    // the normal might come from a face of either object or from an edge of each, but they can't have rotated much, so following object 1 is close enough
+    refreshed.collisionNormal = glm::normalize(rotationChange1 * entry.manifold.collisionNormal);
+    refreshed.contactPoints.clear();
+
+    for (auto& [point, depth] : entry.manifold.contactPoints) {
+        // where the contact point is now if it's stuck to each object
+        glm::dvec3 pointOn1 = transform1.Position() + rotationChange1 * (point - entry.pose1.position);
+        glm::dvec3 pointOn2 = transform2.Position() + rotationChange2 * (point - entry.pose2.position);
+
+        // the normal faces out of object 1 towards object 2, so object 2 moving along the normal relative to object 1 makes them penetrate less
+        double newDepth = depth - glm::dot(pointOn2 - pointOn1, refreshed.collisionNormal);
+        if (newDepth <= 0) {
+            return false;
+        }
+
+        refreshed.contactPoints.emplace_back((pointOn1 + pointOn2) * 0.5, newDepth);
+    }
+
+    return true;
+}
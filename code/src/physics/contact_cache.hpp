@@ -0,0 +1,74 @@
+#pragma once
+#include "gjk.hpp"
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+
+// A collision found by the narrowphase is reused by later steps as long as neither object has moved more than this far since it was found...
+static const inline double CONTACT_CACHE_LINEAR_TOLERANCE = 0.01;
+// ...or rotated more than this many radians.
+static const inline double CONTACT_CACHE_ANGULAR_TOLERANCE = 0.01;
+
+// Remembers what the narrowphase found for each pair of colliders, so that the next step doesn't have to rediscover the same contacts with GJK+SAT (objects resting on each other barely move from one step to the next).
+// Colliding pairs keep a persistent contact manifold. While neither object has moved much, its contact points are carried along with the objects and their penetration depths updated, instead of being recomputed.
+// Pairs that aren't colliding remember the direction that separated them last time, which GJK is warm started with.
+class ContactCache {
+public:
+    // Makes sure the pair has an entry, so that FindCollision() can be called for it while other threads call it for other pairs. Call for each pair every step, before the narrowphase.
+    void ReservePair(const ColliderComponent* collider1, const ColliderComponent* collider2);
+
+    // Same as IsColliding(transform1, collider1, transform2, collider2, collision), but reuses what was found for these colliders in earlier steps when it can.
+    // The pair must have been given to ReservePair() this step. Thread safe, as long as no two threads use the same pair at once.
+    bool FindCollision(const TransformComponent& transform1, const ColliderComponent& collider1, const TransformComponent& transform2, const ColliderComponent& collider2, CollisionInfo& collision);
+
+    // Forgets every pair that wasn't given to ReservePair() since the last call to this (because they stopped overlapping, or one of them was destroyed),
+        // so that a collider that later gets created at the same address can't be given a stale result.
+    // Call once after each step's narrowphase.
+    void EndStep();
+
+private:
+    struct Pose {
+        glm::dvec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+
+    struct Entry {
+        // what the colliders' meshes and transforms were when the manifold was found
+        const PhysicsMesh* physicsMesh1;
+        const PhysicsMesh* physicsMesh2;
+        unsigned int shapeVersion1; // see ShapeVersion()
+        unsigned int shapeVersion2;
+        Pose pose1;
+        Pose pose2;
+
+        // what the narrowphase found, only meaningful if they were colliding (kept around either way so that its contact points' storage gets reused)
+        CollisionInfo manifold;
+        bool colliding;
+
+        // where GJK left off, see IsColliding()
+        glm::dvec3 searchDirection;
+
+        // set by ReservePair(), cleared by EndStep()
+        bool seenThisStep;
+    };
+
+    struct PairHash {
+        size_t operator()(const std::pair<const ColliderComponent*, const ColliderComponent*>& pair) const {
+            return std::hash<const void*>()(pair.first) ^ (std::hash<const void*>()(pair.second) * 31);
+        }
+    };
+
+    // Heightfields can change without moving (see Heightfield::Version()), which means the manifold can't be trusted anymore either. Always 0 for other colliders.
+    static unsigned int ShapeVersion(const ColliderComponent& collider);
+
+    // Returns true if the transform is too far from pose to reuse a manifold found at pose.
+    static bool MovedTooFar(const Pose& pose, const TransformComponent& transform);
+
+    // Moves the manifold's contact points along with the objects from where they were when it was found to where they are now, updates penetration depths, and writes the result into refreshed.
+    // Returns false if any of the contact points stopped penetrating, since they might be touching somewhere else now.
+    static bool RefreshManifold(const Entry& entry, const TransformComponent& transform1, const TransformComponent& transform2, CollisionInfo& refreshed);
+
+    // Keys always have the lower address first, so that a pair is found regardless of the order it's given in.
+    std::unordered_map<std::pair<const ColliderComponent*, const ColliderComponent*>, Entry, PairHash> entries;
+};
@@ -1,4 +1,6 @@
 #include "gjk.hpp"
+#include "primitive_collisions.hpp"
+#include "heightfield.hpp"
 #include <algorithm>
 #include <array>
 #include "debug/assert.hpp"
@@ -8,6 +10,7 @@
 #include <cstdlib>
 #include "../utility/utility.hpp"
 #include <optional>
+#include <initializer_list>
 #include <utility>
 #include <vector>
 #include <iostream>
@@ -19,54 +22,164 @@
 // DECEMBER TO FEBRUARY 2ND. FINALLY.
 // feb 14 it wasn't enough apparently
 
+// Scratch space in here (thread_local vectors) keeps its capacity between calls, so that finding collisions stops allocating once it's big enough.
+// It's thread_local because islands, and so their collisions, are resolved on several threads at once.
+
+// Boxes borrow a unit cube so that they can be clipped against like any other hull, but spheres and capsules don't have one.
+// piece is which of the physics mesh's convex meshes to use, for meshes that were split up by convex decomposition.
+const PhysicsMesh::ConvexMesh* ShapeHull(const ColliderComponent& collider, unsigned int piece) {
+    switch (collider.shape) {
+        case ColliderShapeMesh:
+        return &collider.physicsMesh->meshes.at(piece);
+        case ColliderShapeBox:
+        return &UnitBoxHull();
+        default:
+        return nullptr;
+    }
+}
+
+// How many convex pieces the collider's support function can be asked about (see ShapeHull()). Heightfields don't have a support function, so they don't get here.
+unsigned int PieceCount(const ColliderComponent& collider) {
+    Assert(collider.shape != ColliderShapeHeightfield);
+    return collider.shape == ColliderShapeMesh ? collider.physicsMesh->meshes.size() : 1;
+}
+
+// Everything the support function needs to know about one of the objects, worked out once per IsColliding() call instead of on every support query.
+struct SupportShape {
+    const TransformComponent& transform;
+    const ColliderComponent& collider;
+
+    // nullptr for spheres and capsules, whose support points come from primitive instead
+    const PhysicsMesh::ConvexMesh* hull;
+    const Primitive primitive;
+
+    // The physics mesh's vertices are obviously in model space, so we put search directions in model space instead of putting every vertex in world space.
+    // Since the support point only depends on dot products with the direction, this only needs to be the transpose of the rotation/scale matrix, not an inverse.
+    glm::mat3 worldToModel;
+    glm::dmat4 modelToWorld;
+
+    // A point inside the hull in world space, for making sure normals point outwards.
+    // This is just the object's position, unless the hull is one piece of a concave mesh (which the position could be outside of).
+    glm::dvec3 center;
+
+    // offset moves the object that far (in world space) from where its transform has it (see the IsColliding() that takes an offset).
+    SupportShape(const TransformComponent& objectTransform, const ColliderComponent& objectCollider, unsigned int piece = 0, const glm::dvec3& offset = glm::dvec3(0, 0, 0)):
+        transform(objectTransform),
+        collider(objectCollider),
+        hull(ShapeHull(objectCollider, piece)),
+        primitive(objectCollider.shape, objectTransform.Position() + offset, objectTransform.Rotation(), objectTransform.Scale()),
+        worldToModel(glm::transpose(glm::mat3(objectTransform.GetRotSclPhysicsMatrix()))),
+        modelToWorld(objectTransform.GetPhysicsModelMatrix()),
+        center(0, 0, 0)
+    {
+        modelToWorld[3] += glm::dvec4(offset, 0);
+        center = hull ? glm::dvec3(modelToWorld * glm::dvec4(hull->center, 1)) : objectTransform.Position() + offset;
+    }
+};
+
 // the GJK support function. returns farthest vertex (in world space) along a directional vector 
-glm::dvec3 FindFarthestVertexOnObject(const glm::dvec3& directionInWorldSpace, const TransformComponent& transform, const ColliderComponent& collider) {
-    // the physics mesh's vertices are obviously in model space, so we must put search direction in model space.
-    // this way, to find the farthest vertex on a 10000-vertex mesh we don't need to do 10000 vertex transformations
-    // TODO: this is still O(n vertices) complexity
+glm::dvec3 FindFarthestVertexOnObject(const glm::dvec3& directionInWorldSpace, const SupportShape& object) {
+    // below this many vertices, looking at all of them is about as fast as hill climbing
+    const unsigned int HILL_CLIMB_MIN_VERTICES = 16;
 
     Assert(!std::isnan(directionInWorldSpace.x)); 
     Assert(!std::isnan(directionInWorldSpace.y)); 
     Assert(!std::isnan(directionInWorldSpace.z)); 
 
-    // std::cout << "Normal matrix is " << glm::to_string(transform.GetNormalMatrix()) << "\n";
-    auto worldToModel = glm::inverse(transform.GetNormalMatrix());
-    auto directionInModelSpace = glm::vec3(glm::normalize(worldToModel * glm::vec4(directionInWorldSpace.x, directionInWorldSpace.y, directionInWorldSpace.z, 1)));
+    // not normalized, since we only compare dot products with it
+    auto directionInModelSpace = object.worldToModel * glm::vec3(directionInWorldSpace);
 
     Assert(!std::isnan(directionInModelSpace.x)); 
     Assert(!std::isnan(directionInModelSpace.y)); 
     Assert(!std::isnan(directionInModelSpace.z)); 
 
+    if (object.hull == nullptr) {
+        return PrimitiveSupport(object.primitive, directionInWorldSpace);
+    }
 
-    float farthestDistance = -FLT_MAX;
-    glm::vec3 farthestVertex = {0, 0, 0};
+    const auto& vertices = object.hull->vertices;
+    Assert(vertices.size() > 0);
+    unsigned int farthestVertex = 0;
+    float farthestDistance = glm::dot(vertices[0], directionInModelSpace);
 
-    //TODO: concave support
-    for (auto & face: collider.physicsMesh->meshes.at(0).faces) {
-        for (auto & vertex: face.second) {
-            auto dp = glm::dot(vertex, (directionInModelSpace)); // TODO: do we normalize vertex before taking dot product? i don't think so???
-            if (dp >= farthestDistance) {
+    if (vertices.size() < HILL_CLIMB_MIN_VERTICES || object.hull->neighbours.empty()) { // (no neighbours means it's not a real hull, see ConvexMesh::neighbours)
+        for (unsigned int i = 1; i < vertices.size(); i++) {
+            auto dp = glm::dot(vertices[i], directionInModelSpace);
+            if (dp > farthestDistance) {
                 farthestDistance = dp;
-                farthestVertex = vertex;
+                farthestVertex = i;
             }
-        } 
+        }
+    }
+    else {
+        // the hull is convex, so a vertex that none of its neighbours are farther than is the farthest vertex
+        bool foundFartherVertex = true;
+        while (foundFartherVertex) {
+            foundFartherVertex = false;
+            for (unsigned int neighbour: object.hull->neighbours[farthestVertex]) {
+                auto dp = glm::dot(vertices[neighbour], directionInModelSpace);
+                if (dp > farthestDistance) {
+                    farthestDistance = dp;
+                    farthestVertex = neighbour;
+                    foundFartherVertex = true;
+                }
+            }
+        }
     }
 
-    
-
-    //// std::cout << "Model matrix is " << glm::to_string(transform.GetPhysicsModelMatrix()) << "\n";
-    // std::cout << "Support: farthest vertex in direction " << glm::to_string(directionInModelSpace) << " is " << glm::to_string(farthestVertex) << "\n";
+    // std::cout << "Support: farthest vertex in direction " << glm::to_string(directionInModelSpace) << " is " << glm::to_string(vertices[farthestVertex]) << "\n";
 
     // put returned point in world space
-    const auto& modelToWorld = transform.GetPhysicsModelMatrix();
-    auto farthestVertexInWorldSpace = glm::dvec3(modelToWorld * glm::dvec4(farthestVertex.x, farthestVertex.y, farthestVertex.z, 1));
-    //// std::cout << "\tIn world space that's " << glm::to_string(farthestVertexInWorldSpace) << "\n";
-    
-    return farthestVertexInWorldSpace;
+    return glm::dvec3(object.modelToWorld * glm::dvec4(vertices[farthestVertex], 1));
 }
 
+// A point on the Minkowski difference, followed by the points on each object whose difference it is (see NewSimplexPoint()).
+using SupportPoint = std::array<glm::dvec3, 3>;
+
+// GJK's simplex never has more than 4 points, so it lives on the stack instead of in a std::vector.
+// Point 0 is always the newest one, since the cases below depend on the order.
+class Simplex {
+    public:
+    Simplex(): nPoints(0) {}
+
+    // a, b, c etc. in the cases below are references to points in the simplex, but the initializer list copies them before we overwrite anything
+    Simplex& operator=(std::initializer_list<SupportPoint> newPoints) {
+        Assert(newPoints.size() <= points.size());
+        nPoints = 0;
+        for (auto & p: newPoints) {
+            points[nPoints++] = p;
+        }
+        return *this;
+    }
+
+    void PushFront(const SupportPoint& point) {
+        Assert(nPoints < points.size());
+        for (unsigned int i = nPoints; i > 0; i--) {
+            points[i] = points[i - 1];
+        }
+        points[0] = point;
+        nPoints++;
+    }
+
+    unsigned int size() const {
+        return nPoints;
+    }
+
+    SupportPoint& operator[](unsigned int i) {
+        return points[i];
+    }
+
+    const SupportPoint& operator[](unsigned int i) const {
+        return points[i];
+    }
+
+    private:
+    std::array<SupportPoint, 4> points;
+    unsigned int nPoints;
+};
+
 // helper function for GJK, look inside GJK() for explanation of purpose
-void LineCase(std::vector<std::array<glm::dvec3, 3>>& simplex, glm::dvec3& searchDirection) {
+void LineCase(Simplex& simplex, glm::dvec3& searchDirection) {
     auto & a = simplex[0];
     auto & b = simplex[1];
 
@@ -89,7 +202,7 @@ void LineCase(std::vector<std::array<glm::dvec3, 3>>& simplex, glm::dvec3& searc
 }
 
 // helper function for GJK, look inside GJK() for explanation of purpose
-void TriangleCase(std::vector<std::array<glm::dvec3, 3>>& simplex, glm::dvec3& searchDirection) { 
+void TriangleCase(Simplex& simplex, glm::dvec3& searchDirection) { 
     auto& a = simplex[0];
     auto& b = simplex[1];
     auto& c = simplex[2];
@@ -133,7 +246,7 @@ void TriangleCase(std::vector<std::array<glm::dvec3, 3>>& simplex, glm::dvec3& s
     searchDirection = glm::normalize(searchDirection);
 }
 
-bool TetrahedronCase(std::vector<std::array<glm::dvec3, 3>>& simplex, glm::dvec3& searchDirection) {
+bool TetrahedronCase(Simplex& simplex, glm::dvec3& searchDirection) {
     auto& a = simplex[0];
     auto& b = simplex[1];
     auto& c = simplex[2];
@@ -174,14 +287,12 @@ bool TetrahedronCase(std::vector<std::array<glm::dvec3, 3>>& simplex, glm::dvec3
 // the actual support points in world space are needed to get contact points from EPA
 std::array<glm::dvec3, 3> NewSimplexPoint(
     const glm::dvec3& searchDirection,
-    const TransformComponent& transform1,
-    const ColliderComponent& collider1,
-    const TransformComponent& transform2,
-    const ColliderComponent& collider2
+    const SupportShape& object1,
+    const SupportShape& object2
 ) {
     // DebugLogInfo("Generating new simplex point.");
-    auto a = FindFarthestVertexOnObject(searchDirection, transform1, collider1);
-    auto b = FindFarthestVertexOnObject(-searchDirection, transform2, collider2);
+    auto a = FindFarthestVertexOnObject(searchDirection, object1);
+    auto b = FindFarthestVertexOnObject(-searchDirection, object2);
 
     Assert(!std::isnan(a.x)); 
     Assert(!std::isnan(a.x)); 
@@ -191,67 +302,6 @@ std::array<glm::dvec3, 3> NewSimplexPoint(
     return {a-b, a, b};
 }
 
-// Used by EPA to test if the reverse of an edge already exists in the list and if so, remove it, otherwise add the unreversed edge.
-// I don't really know why it needs that tho.
-void AddIfUniqueEdge(std::vector<std::pair<unsigned int, unsigned int>>& edges, const std::vector<unsigned int>& faces, unsigned int a, unsigned int b) {
-    // std::cout << "Adding if unique edge, are currently " << edges.size() << "\n";
-	auto reverse = std::find(           
-		edges.begin(),                           
-		edges.end(),                             
-		std::make_pair(faces[b], faces[a]) 
-	);
- 
-	if (reverse != edges.end()) {
-        // std::cout << "eraser\n";
-		edges.erase(reverse);
-	}
- 
-	else {
-        // std::cout << "emplacing, size was previously " << edges.size() << "\n";
-		edges.emplace_back(faces[a], faces[b]);
-        // std::cout << "now its " << edges.size() << "\n";
-	}
-}
-
-// Used by EPA to get (take a guess) face normals.
-// Returns vector of pair {normal, distance to face} and index of the closest normal.
-std::pair<std::vector<std::pair<glm::dvec3, double>>, unsigned int> GetFaceNormals(
-    const std::vector<std::array<glm::dvec3, 3>>& polytope, 
-    const std::vector<unsigned int>& faces) 
-    {
-	std::vector<std::pair<glm::dvec3, double>> normals;
-    Assert(faces.size() > 0);
-	size_t minTriangle = 0;
-	double  minDistance = FLT_MAX;
-
-    // std::cout << "There are " << faces.size() << " face indices.\n";
-	for (size_t i = 0; i < faces.size(); i += 3) {
-		auto& a = polytope[faces[i    ]];
-		auto& b = polytope[faces[i + 1]];
-		auto& c = polytope[faces[i + 2]];
-
-		glm::dvec3 normal = glm::normalize(glm::cross(b[0] - a[0], c[0] - a[0]));
-		double distance = glm::dot(normal, a[0]);
-
-		if (distance < 0) {
-			normal   *= -1;
-			distance *= -1;
-		}
-
-        // std::cout << "Pushing back to normals.\n";
-		normals.emplace_back(std::make_pair(normal, distance));
-
-		if (distance < minDistance) {
-			minTriangle = i / 3;
-			minDistance = distance;
-            // std::cout << "Min distance " << minDistance << " created by dot of " << glm::to_string(normal) << " and support " << glm::to_string(a[0]) << "\n";
-		}
-	}
-
-    Assert(normals.size() > 0);
-	return { normals, minTriangle };
-}
-
 // used by FindContact()
 double SignedDistanceToPlane(glm::dvec3 planeNormal, glm::dvec3 point, glm::dvec3 pointOnPlane) {
     return glm::dot(planeNormal, point - pointOnPlane);
@@ -266,28 +316,26 @@ struct SatFacesResult {
 // Used by SAT algorithm in FindContactPoint().
 // Does SAT by testing collider1's faces against collider 2's vertices.
 SatFacesResult SatFaces(
-    const TransformComponent& transform1,
-    const ColliderComponent& collider1,
-    const TransformComponent& transform2,
-    const ColliderComponent& collider2
+    const SupportShape& object1,
+    const SupportShape& object2
 ) 
 {
     double farthestDistance = -FLT_MAX;
     glm::vec3 farthestNormal(0, 0, 0); // in world space
     const std::vector<glm::vec3>* farthestFace = nullptr; // in model space
 
-    for (auto & face1: collider1.physicsMesh->meshes.at(0).faces) {
+    for (auto & face1: object1.hull->faces) {
 
-        auto normalInWorldSpace = glm::normalize(transform1.GetNormalMatrix() * face1.first);
+        auto normalInWorldSpace = glm::normalize(object1.transform.GetNormalMatrix() * face1.first);
 
         // make sure normal faces out of collider 1 because somehow it wasn't???
-        glm::dvec3 pointOnPlaneInWorldSpace = transform1.GetPhysicsModelMatrix() * glm::dvec4(face1.second.at(0), 1);
-        if (glm::dot(glm::dvec3(normalInWorldSpace), pointOnPlaneInWorldSpace - transform1.Position()) < 0) {
+        glm::dvec3 pointOnPlaneInWorldSpace = object1.modelToWorld * glm::dvec4(face1.second.at(0), 1);
+        if (glm::dot(glm::dvec3(normalInWorldSpace), pointOnPlaneInWorldSpace - object1.center) < 0) {
             normalInWorldSpace *= -1;
             // std::cout << "bruh we had to switch???\n";
         }
 
-        auto vertex2 = FindFarthestVertexOnObject(-normalInWorldSpace, transform2, collider2);
+        auto vertex2 = FindFarthestVertexOnObject(-normalInWorldSpace, object2);
         double distance = SignedDistanceToPlane(normalInWorldSpace, vertex2, pointOnPlaneInWorldSpace);
         
         // they're colliding, so distance should be negative, so flip normal/distance if it's not
@@ -319,23 +367,29 @@ SatFacesResult SatFaces(
     return {farthestNormal, farthestDistance, farthestFace};
 }
 
-// Returns the contact points for a face-face collision.
-// Each pair in the return value is <hitPoint, penetrationDepth>.
+// Adds the contact points for a face-face collision to contactPoints (none if the faces don't actually overlap).
+// Each pair is <hitPoint, penetrationDepth>.
 // referenceNormal is normal of refereneceFace IN WORLD SPACE.
-// referenceFace is (IN MODEL SPACE) the face that had the least penetration, and referenceTransform is the transform of the collider that contains referenceFace.
-std::vector<std::pair<glm::dvec3, double>> ClipFaceContactPoints(
+// referenceFace is (IN MODEL SPACE) the face that had the least penetration, and referenceObject is the object that contains referenceFace.
+void ClipFaceContactPoints(
     const glm::vec3 referenceNormal,
     const std::vector<glm::vec3>* referenceFace, 
-    const TransformComponent& referenceTransform, 
-    const TransformComponent& otherTransform,
-    const ColliderComponent& otherCollider
+    const SupportShape& referenceObject, 
+    const SupportShape& otherObject,
+    std::vector<std::pair<glm::dvec3, double>>& contactPoints
 ) {
+    // scratch space for clipping (see the top of the file)
+    thread_local std::vector<glm::dvec3> referenceFaceInWorldSpace;
+    thread_local std::vector<std::pair<glm::dvec3, glm::dvec3>> sidePlanes;
+    thread_local std::vector<glm::dvec3> contactList;
+    thread_local std::vector<glm::dvec3> input;
+
     // std::cout << "Clipping face contact points: reference face has normal " << glm::to_string(referenceNormal) << ".\n";
     // find the face on otherCollider with a normal closest to -normal.
     const std::vector<glm::vec3>* incidentFace = nullptr;
     float smallestDot = FLT_MAX;
-    for (auto & face: otherCollider.physicsMesh->meshes.at(0).faces) {
-        auto dot = glm::dot(otherTransform.GetNormalMatrix() * face.first, referenceNormal);
+    for (auto & face: otherObject.hull->faces) {
+        auto dot = glm::dot(otherObject.transform.GetNormalMatrix() * face.first, referenceNormal);
         if (dot < smallestDot) {
             incidentFace = &face.second;
             // std::cout << "Set incident face to thing with normal " << glm::to_string(otherTransform.GetNormalMatrix() * face.first) << ".\n";
@@ -346,21 +400,20 @@ std::vector<std::pair<glm::dvec3, double>> ClipFaceContactPoints(
     Assert(incidentFace != nullptr); // mostly to shut up compiler 
     Assert(referenceFace != nullptr); // this one we actually had an issue
 
-    // Get reference face and incident face in world space
-    std::vector<glm::dvec3> referenceFaceInWorldSpace;
+    // Get reference face and incident face in world space (the incident face goes straight into contactList, since that's what gets clipped)
+    referenceFaceInWorldSpace.clear();
     for (auto & v: *referenceFace) {
-        referenceFaceInWorldSpace.push_back(referenceTransform.GetPhysicsModelMatrix() * glm::dvec4(v, 1.0));
+        referenceFaceInWorldSpace.push_back(referenceObject.modelToWorld * glm::dvec4(v, 1.0));
     }
 
-    std::vector<glm::dvec3> incidentFaceInWorldSpace;
+    contactList.clear();
     for (auto & v: *incidentFace) {
-        
-        incidentFaceInWorldSpace.push_back(otherTransform.GetPhysicsModelMatrix() * glm::dvec4(v, 1.0));
+        contactList.push_back(otherObject.modelToWorld * glm::dvec4(v, 1.0));
     }
 
     // Get side planes for reference face.
     // Pairs are <normal, pointOnPlane>
-    std::vector<std::pair<glm::dvec3, glm::dvec3>> sidePlanes;
+    sidePlanes.clear();
     for (unsigned int i = 0; i < referenceFaceInWorldSpace.size(); i++) {
         // get edge
         auto v1 = referenceFaceInWorldSpace[i];
@@ -372,7 +425,7 @@ std::vector<std::pair<glm::dvec3, double>> ClipFaceContactPoints(
 
         // flip normal if needed so normal faces away from the face
         // TODO: needed??
-        if (glm::dot(glm::dvec3(planeNormal), v1 - referenceTransform.Position()) < 0) {
+        if (glm::dot(glm::dvec3(planeNormal), v1 - referenceObject.center) < 0) {
             planeNormal *= -1;
             // std::cout << "UH OH FLIPPING\n";
         }
@@ -383,10 +436,9 @@ std::vector<std::pair<glm::dvec3, double>> ClipFaceContactPoints(
     // Clip the incident face against those side planes of the reference face, using the Sutherland-Hodgman algorithm 
     // (https://en.wikipedia.org/wiki/Sutherland%E2%80%93Hodgman_algorithm)
     // This will get the contact area.
-    std::vector<glm::dvec3> contactList = incidentFaceInWorldSpace;
     for (auto & clippingPlane: sidePlanes) {
         // std::cout << "Side plane has normal " << glm::to_string(clippingPlane.first) << " and point " << glm::to_string(clippingPlane.second) << ".\n"; 
-        std::vector<glm::dvec3> input = contactList;
+        std::swap(input, contactList);
         contactList.clear();
 
         for (unsigned int i = 0; i < input.size(); i++) {
@@ -428,10 +480,7 @@ std::vector<std::pair<glm::dvec3, double>> ClipFaceContactPoints(
 
     }
 
-    Assert(contactList.size() > 0);
-
     // Lastly, verify for each contact point that it's actually inside the reference face and if it is, move contact points onto the reference face (idk why lel).
-    std::vector<std::pair<glm::dvec3, double>> contactPoints; 
     for (auto & p: contactList) {
         
         // std::cout << "Testing point " << glm::to_string(p) << " against plane with normal " << glm::to_string(referenceNormal) << " and point " << glm::to_string(referenceFaceInWorldSpace.at(0)) << ".\n";
@@ -452,25 +501,28 @@ std::vector<std::pair<glm::dvec3, double>> ClipFaceContactPoints(
     }
     // DebugLogInfo("Of ", contactList.size(), " contact points, ", contactPoints.size(), " were accepted; rf ", referenceFaceInWorldSpace.size(), " if ", incidentFaceInWorldSpace.size(), " sp ", sidePlanes.size());
     Assert(contactList.size() <= std::max(referenceFace->size(), incidentFace->size()) * 2);
-    Assert(contactPoints.size() > 0);
-    return contactPoints;
 }
 
 
-// Calculates info about the collision, since EPA gives pretty mid contact points for face-face, face-edge, or edge-edge cases, causing weird rotational artifacts.
-// When GJK determines a collision, we then use SAT to find the contact information.
-// TODO: optimizations, concave support, non-vertex based support
+// Calculates info about the collision by testing every face of each object and every pair of edges with SAT.
+// This is the slow way (the edge test alone is O(edges1 * edges2) support queries), so it's only used when EPA fails; see FindContact().
+// TODO: concave support, non-vertex based support
 // Contact points are in world space, will all be coplanar.
-// returns a normal and a vector of pair<contactPosition, penetrationDepth> representing the contact surface.
+// Writes a normal and pair<contactPosition, penetrationDepth>s representing the contact surface into collision, and returns true.
 // TODO: because sometimes GJK and SAT disagree about whether there's a collision because it's really close + FP precision errors, this function can say there wasn't actually a collision, which might not work.
-std::optional<CollisionInfo> FindContact(
-    const TransformComponent& transform1,
-    const ColliderComponent& collider1,
-    const TransformComponent& transform2,
-    const ColliderComponent& collider2
+bool SatContact(
+    const SupportShape& object1,
+    const SupportShape& object2,
+    CollisionInfo& collision
 ) 
 {
-    // if we have like spheres or something with no actual vertices that won't work for this, TODO fallback to EPA
+    const ColliderComponent& collider1 = object1.collider;
+    const ColliderComponent& collider2 = object2.collider;
+
+    // spheres and capsules don't have faces or edges to test, so all we can do is skip the collision for this step (this only happens when EPA fails). TODO: something better
+    if (object1.hull == nullptr || object2.hull == nullptr) {
+        return false;
+    }
     Assert(collider1.physicsMesh->meshes.size() > 0);
     Assert(collider2.physicsMesh->meshes.size() > 0);
 
@@ -488,15 +540,15 @@ std::optional<CollisionInfo> FindContact(
     // Face tests:
     // Test faces of collider1 against vertices of collider2
     // std::cout << "TESTING FACE 1\n";
-    auto Face1Result = SatFaces(transform1, collider1, transform2, collider2); 
+    auto Face1Result = SatFaces(object1, object2); 
     Assert(Face1Result.farthestDistance <= 0.1); // they must be colliding or we mad.    
-    if (Face1Result.farthestDistance > 0) {std::cout << "sus amogus\n"; return std::nullopt;}
+    if (Face1Result.farthestDistance > 0) {std::cout << "sus amogus\n"; return false;}
 
     // Test faces of collider2 against vertices of collider1
     // std::cout << "TESTING FACE 2\n";
-    auto Face2Result = SatFaces(transform2, collider2, transform1, collider1); 
+    auto Face2Result = SatFaces(object2, object1); 
     Assert(Face2Result.farthestDistance <= 0.1); // they must be colliding or we mad.
-    if (Face2Result.farthestDistance > 0) {std::cout << "sus amogus\n"; return std::nullopt;}
+    if (Face2Result.farthestDistance > 0) {std::cout << "sus amogus\n"; return false;}
 
     glm::vec3 farthestNormal(0, 0, 0); // in world space
     double farthestDistance;
@@ -524,15 +576,15 @@ std::optional<CollisionInfo> FindContact(
     glm::vec3 farthestEdgeNormal(0,0,0);
     glm::dvec3 farthestEdge1Origin(0, 0, 0), farthestEdge1Direction(0, 0, 0), farthestEdge2Origin(0, 0, 0), farthestEdge2Direction(0, 0, 0);
 
-    for (auto & edge1: collider1.physicsMesh->meshes.at(0).edges) {
+    for (auto & edge1: object1.hull->edges) {
         // std::cout << " Edge1 is " << glm::to_string(edge1.first) << " to " << glm::to_string(edge1.second) << ".\n";
-        for (auto & edge2: collider2.physicsMesh->meshes.at(0).edges) {
+        for (auto & edge2: object2.hull->edges) {
             // put edges in world space
-            glm::dvec3 edge1OriginWorld = transform1.GetPhysicsModelMatrix() * glm::dvec4(edge1.first, 1.0);
-            glm::dvec3 edge1bWorld = transform1.GetPhysicsModelMatrix() * glm::dvec4(edge1.second, 1.0);
+            glm::dvec3 edge1OriginWorld = object1.modelToWorld * glm::dvec4(edge1.first, 1.0);
+            glm::dvec3 edge1bWorld = object1.modelToWorld * glm::dvec4(edge1.second, 1.0);
             glm::dvec3 edge1DirectionWorld = glm::normalize(edge1bWorld - edge1OriginWorld);
-            glm::dvec3 edge2OriginWorld = transform2.GetPhysicsModelMatrix() * glm::dvec4(edge2.first, 1.0);
-            glm::dvec3 edge2bWorld = transform2.GetPhysicsModelMatrix() * glm::dvec4(edge2.second, 1.0);
+            glm::dvec3 edge2OriginWorld = object2.modelToWorld * glm::dvec4(edge2.first, 1.0);
+            glm::dvec3 edge2bWorld = object2.modelToWorld * glm::dvec4(edge2.second, 1.0);
             glm::dvec3 edge2DirectionWorld = glm::normalize(edge2bWorld - edge2OriginWorld);
 
             glm::vec3 normalInWorldSpace =  glm::cross(edge1DirectionWorld, edge2DirectionWorld);
@@ -542,14 +594,12 @@ std::optional<CollisionInfo> FindContact(
             }
             normalInWorldSpace = glm::normalize(normalInWorldSpace);
             // make sure all normals go out of collider1, so the sign of our distance calculations is consistent
-            // TODO:
-                // transform1 and 2 are both wrong
-            if (glm::dot(normalInWorldSpace, glm::vec3(edge1OriginWorld - transform1.Position())) < 0.0) { // if dot product between center of model to vertex and the normal is < 0, normal is opposite direction of model to vertex and needs to be flipped
+            if (glm::dot(normalInWorldSpace, glm::vec3(edge1OriginWorld - object1.center)) < 0.0) { // if dot product between center of model to vertex and the normal is < 0, normal is opposite direction of model to vertex and needs to be flipped
                 // std::cout << "\tFlipped normal.\n";
                 normalInWorldSpace *= -1;
             }
             else {
-                // std::cout << "\tDid not flip, dot product was " << glm::dot(normalInWorldSpace, glm::vec3(edge1OriginWorld - transform1.Position())) << ".\n";
+                // std::cout << "\tDid not flip, dot product was " << glm::dot(normalInWorldSpace, glm::vec3(edge1OriginWorld - object1.center)) << ".\n";
             }
 
             // often times the edge pair will create a normal that is the same as a face normal, in which case we can skip it.
@@ -558,10 +608,10 @@ std::optional<CollisionInfo> FindContact(
             //     continue;
             // }
             
-            glm::dvec3 collider2Vertex = FindFarthestVertexOnObject(-normalInWorldSpace, transform2, collider2);
+            glm::dvec3 collider2Vertex = FindFarthestVertexOnObject(-normalInWorldSpace, object2);
 
             // using edge1OriginWorld doesn't work here because it's not actually a point on the plane we want to test, so instead we using support function?
-             glm::dvec3 collider1Vertex = FindFarthestVertexOnObject(normalInWorldSpace, transform1, collider1);
+             glm::dvec3 collider1Vertex = FindFarthestVertexOnObject(normalInWorldSpace, object1);
             double distance = SignedDistanceToPlane(normalInWorldSpace, collider2Vertex, collider1Vertex);
             // distance has to be negative if they colliding so use opposite normal if its not
             // if (distance > 0) {
@@ -587,7 +637,7 @@ std::optional<CollisionInfo> FindContact(
             }
 
             Assert(distance <= 0.1); // if distance > 0, we have no collision and this function won't work
-            if (Face1Result.farthestDistance > 0) {std::cout << "sus amogus\n"; return std::nullopt;}
+            if (Face1Result.farthestDistance > 0) {std::cout << "sus amogus\n"; return false;}
         }
     }
 
@@ -604,18 +654,22 @@ std::optional<CollisionInfo> FindContact(
 
     Assert(farthestDistance <= 0.1); // if this was > 0, then they wouldn't be colliding, and if you called this function they better be colliding
 
-    std::vector<std::pair<glm::dvec3, double>> contactPoints;
-
     // figure whether a face of collider1 hit collider2, a face of collider2 hit collider1, or if their edges hit each other, and then calculate contact points.
     // smallest distance is the right one.
     switch (collisionType) {
         case Face1Collision:
         // std::cout << "FACE1 COLLISION\n"; 
-        return CollisionInfo {.collisionNormal = farthestNormal, .contactPoints = ClipFaceContactPoints(farthestNormal, farthestFace, transform1, transform2, collider2)};
+        collision.collisionNormal = farthestNormal;
+        collision.contactPoints.clear();
+        ClipFaceContactPoints(farthestNormal, farthestFace, object1, object2, collision.contactPoints);
+        return true;
         break;
         case Face2Collision:
         // std::cout << "FACE2 COLLISION\n";
-        return CollisionInfo {.collisionNormal = -farthestNormal, .contactPoints = ClipFaceContactPoints(farthestNormal, farthestFace, transform2, transform1, collider1)};
+        collision.collisionNormal = -farthestNormal;
+        collision.contactPoints.clear();
+        ClipFaceContactPoints(farthestNormal, farthestFace, object2, object1, collision.contactPoints);
+        return true;
         break;
         {case EdgeCollision:
         // std::printf("Edge is %f vs face %f", farthestEdgeDistance, farthestDistance);
@@ -644,7 +698,10 @@ std::optional<CollisionInfo> FindContact(
         Assert(!std::isnan(closestPointOnEdge2ToEdge1.y));
         Assert(!std::isnan(closestPointOnEdge2ToEdge1.z));  
 
-        return CollisionInfo {.collisionNormal = farthestNormal, .contactPoints = {{point, abs(farthestEdgeDistance)}}};
+        collision.collisionNormal = farthestNormal;
+        collision.contactPoints.clear();
+        collision.contactPoints.emplace_back(point, abs(farthestEdgeDistance));
+        return true;
         break;}
         default:
         // shut up compiler warning for reaching end of non-void function
@@ -655,235 +712,261 @@ std::optional<CollisionInfo> FindContact(
 
 }   
 
-//  EPA algorithm, used to get collision normals/penetration depth, explained here: https://winter.dev/articles/epa-algorithm
+// What EPA() found out about a collision.
+struct Penetration {
+    glm::dvec3 normal; // out of object1 towards object2, in world space
+    double depth;
+    glm::dvec3 contactPoint; // halfway between the deepest points of each object, in world space
+};
+
+// EPA algorithm, used to get collision normals/penetration depth, explained here: https://winter.dev/articles/epa-algorithm
+// Starting from the tetrahedron GJK ended with, keeps adding support points in the direction of the polytope's face that's closest to the origin, until that face is (nearly) on the surface of the Minkowski difference.
+// That face's normal and distance from the origin are then the collision normal and penetration depth.
+// The polytope is kept in fixed size arrays so that this doesn't allocate. Returns nullopt if they fill up before EPA converges, or if GJK's simplex is too flat to start from.
 // TODO: concave support
-// CollisionInfo EPA(
-//     std::vector<std::array<glm::dvec3, 3>>& simplex, // first dvec3 in each array is actual simplex point on the minkoskwi difference, the other 2 are the collider points whose difference is that point, we need those for contact points
-//     const TransformComponent& transform1,
-//     const ColliderComponent& collider1,
-//     const TransformComponent& transform2,
-//     const ColliderComponent& collider2
-// ) 
-// {
-//     // Simplex is no longer a simplex and is just a convex polytope (3d polygon) made from (more than 4) points on the Minkoski difference.
-//     auto & polytope = simplex;
-
-//     // To find the normal, we must progressively expand the simplex, which neccesitates knowing the faces of the simplex so that we can calculate proper normals
-//     std::vector<unsigned int> faces = {
-// 		0, 1, 2,
-// 		0, 3, 1,
-// 		0, 2, 3,
-// 		1, 3, 2
-// 	};
-
-//     // vector<pair of normal + distance>, minFace = index to face with min distance
-// 	auto [normals, minFace] = GetFaceNormals(polytope, faces);
-//     Assert(normals.size() == 4); // simplex should have 4 vertices and 4 faces
-
-//     glm::dvec3 minNormal;
-// 	double minDistance = FLT_MAX;
-//     unsigned short nIterations = 0;
-// 	while (minDistance == FLT_MAX) {
-//         // Assert(nIterations < 64);
-//         // std::cout << "iteration " << nIterations << "\n";
-//         nIterations+=1;
-
-// 		minNormal   = normals.at(minFace).first;
-// 		minDistance = normals.at(minFace).second;
-
-//         if (nIterations > 64) {
-//             std::cout << "EPA failed\n";
-//             break;
-//         }
- 
-// 		auto support = NewSimplexPoint(minNormal, transform1, collider1, transform2, collider2);
-// 		double sDistance = glm::dot(minNormal, support[0]);
- 
-//         // std::cout << "Polytope: ";
-//         for (auto & p: polytope) {
-//             std::cout << glm::to_string(p[0]) << ", ";
-//         }
-//         // std::cout << "\n";
-//         // std::cout << "Min normal is " << glm::to_string(minNormal) << "\n";
-        
-//         // std::cout << "S distance " << sDistance << " created by dot of " << glm::to_string(minNormal) << " and support " << glm::to_string(support[0]) << "\n";
-
-//         // std::cout << "Distance is " << sDistance << " - " << minDistance << ".\n";
-// 		if (abs( sDistance - minDistance) > 0.001f) {
-// 			minDistance = FLT_MAX;
-//             std::vector<std::pair<unsigned int, unsigned int>> uniqueEdges;
-//             // std::cout << "before loop size is " << uniqueEdges.size() << "\n";
-
-//             Assert(normals.size() > 0);
-// 			for (unsigned int i = 0; i < normals.size(); i++) {
-
-//                  // check if after adding that support point, this face is no longer in the polytope and needs to go.
-// 				// if (glm::dot(normals[i].first, support[0]) > glm::dot(normals[i].first, polytope[faces[i * 3]][0])) {
-//                 if (glm::dot(normals[i].first, support[0]) > 0) {
-// 					unsigned int f = i * 3;
-
-//                     // For all of the edges of this face, 
-// 					AddIfUniqueEdge(uniqueEdges, faces, f,     f + 1);
-// 					AddIfUniqueEdge(uniqueEdges, faces, f + 1, f + 2);
-// 					AddIfUniqueEdge(uniqueEdges, faces, f + 2, f    );
-//                     // std::cout << "after those adds there are " << uniqueEdges.size() << "\n";
-
-// 					faces[f + 2] = faces.back(); faces.pop_back();
-// 					faces[f + 1] = faces.back(); faces.pop_back();
-// 					faces[f    ] = faces.back(); faces.pop_back();
-
-//                     // std::cout << "uh oh bois we deleting a normal.\n";
-// 					normals[i] = normals.back(); // pop-erase
-// 					normals.pop_back();
-
-// 					i--;
-// 				}
-//                 // std::cout << "that just happened, size " << uniqueEdges.size() << "\n";
-// 			}
-//             // std::cout << "after everything there are still " << uniqueEdges.size() << "\n";
-//             Assert(uniqueEdges.size() > 0);
-//             std::vector<unsigned int> newFaces;
-// 			for (auto [edgeIndex1, edgeIndex2] : uniqueEdges) {
-// 				newFaces.push_back(edgeIndex1);
-// 				newFaces.push_back(edgeIndex2);
-// 				newFaces.push_back(polytope.size());
-// 			}
-            
-			 
-// 			polytope.push_back(support);
-            
-//             Assert(newFaces.size() > 0);
-//             auto [newNormals, newMinFace] = GetFaceNormals(polytope, newFaces);
-
-//             double oldMinDistance = FLT_MAX;
-//             for (unsigned int i = 0; i < normals.size(); i++) {
-//                 if (normals[i].second < oldMinDistance) {
-//                     oldMinDistance = normals[i].second;
-//                     minFace = i;
-//                 }
-//             }
-
-//             if (newNormals.at(newMinFace).second < oldMinDistance) {
-//                 minFace = newMinFace + normals.size();
-//             }
-
-//             // std::cout << "Extending normals.\n";
-//             // std::cout << "Was size " << normals.size() << ".\n";
-//             faces  .insert(faces  .end(), newFaces  .begin(), newFaces  .end());
-//             normals.insert(normals.end(), newNormals.begin(), newNormals.end());
-//             // std::cout << "Now its size " << normals.size() << ".\n";
-			
-            
-// 		}
-// 	}
-
-//     Assert((minNormal != glm::dvec3(0,0,0)));
-//     // Assert(minDistance != 0); // TODO: PROBABLY REMOVE
-
-//     // find collision point
-//     // get verts of closest triangle to origin
-//     auto& a = polytope[faces[minFace * 3]];
-//     auto& b = polytope[faces[minFace * 3 + 1]];
-//     auto& c = polytope[faces[minFace * 3 + 2]];
-
-//     // DebugPlacePointOnPosition({a[0]}, {1.0, 0.4, 1.0, 1.0});
-//     // DebugPlacePointOnPosition({b[0]}, {1.0, 0.7, 1.0, 1.0});
-//     // DebugPlacePointOnPosition({c[0]}, {1.0, 1.0, 1.0, 1.0});
-
-//     // DebugPlacePointOnPosition({a[1]}, {0.2, 1.0, 0.2, 1.0});
-//     // DebugPlacePointOnPosition({b[1]}, {0.2, 1.0, 0.2, 1.0});
-//     // DebugPlacePointOnPosition({c[1]}, {0.2, 1.0, 0.2, 1.0});
-
-//     // DebugPlacePointOnPosition({a[2]}, {1.0, 0.4, 0.0, 1.0});
-//     // DebugPlacePointOnPosition({b[2]}, {1.0, 0.7, 0.0, 1.0});
-//     // DebugPlacePointOnPosition({c[2]}, {1.0, 1.0, 0.0, 1.0});
-
-//     // std::printf("Min face vertices are %f %f %f and %f %f %f, and %f %f %f \n", a[0].x, a[0].y, a[0].z, b[0].x, b[0].y, b[0].z, c[0].x, c[0].y, c[0].z);
-//     // std::printf("Min face vertices for support 1 are %f %f %f and %f %f %f, and %f %f %f \n", a[1].x, a[1].y, a[1].z, b[1].x, b[1].y, b[1].z, c[1].x, c[1].y, c[1].z);
-//     // std::printf("Min face vertices for support 2 are %f %f %f and %f %f %f, and %f %f %f \n", a[2].x, a[2].y, a[2].z, b[2].x, b[2].y, b[2].z, c[2].x, c[2].y, c[2].z);
-//     // std::cout << "\tHmm, minNormal is " << glm::to_string(minNormal) << " but the minFace's normal we got is " << glm::to_string(glm::normalize(glm::cross(b[0] - a[0], c[0] - a[0]))) << ".\n";
-
-//     // Project origin onto plane abc to get point of contact in minkoski space
-//     auto planeToOrigin = -a[0];
-//     auto distance = glm::dot(planeToOrigin, minNormal);
-//     auto projectedPoint = -minNormal * distance;
-//     // auto projectedPoint = glm::normalize(-minNormal * glm::dot(-a[0], minNormal));
-//     // std::cout << "Projected point " << glm::to_string(projectedPoint) << "\n";
-    
+std::optional<Penetration> EPA(
+    const Simplex& simplex,
+    const SupportShape& object1,
+    const SupportShape& object2
+)
+{
+    constexpr unsigned int MAX_VERTICES = 64;
+    constexpr unsigned int MAX_FACES = 2 * MAX_VERTICES; // a closed triangle mesh with V vertices has 2V - 4 faces
+    constexpr double CONVERGENCE_TOLERANCE = 0.0001; // stop once the closest face is this close to the surface of the Minkowski difference
+    constexpr double MIN_FACE_AREA = 1.0e-12; // (doubled), below this we can't get a trustworthy normal out of a face
+
+    struct EpaFace {
+        std::array<unsigned int, 3> vertices; // indices into polytope, counterclockwise when looking at the face from outside
+        glm::dvec3 normal; // faces out of the polytope
+        double distance; // from the origin to the face's plane
+    };
+
+    Assert(simplex.size() == 4);
+    std::array<SupportPoint, MAX_VERTICES> polytope;
+    unsigned int nVertices = 4;
+    for (unsigned int i = 0; i < 4; i++) {
+        polytope[i] = simplex[i];
+    }
 
-//     // put that point of contact in barycentric coordinates (meaning its a mix of the triangle vertices), so that we can get out of minkoski space and into world space
-//     auto ab = b[0] - a[0];
-//     auto ac = c[0] - a[0];
-//     auto ao = projectedPoint - a[0];
+    std::array<EpaFace, MAX_FACES> faces;
+    unsigned int nFaces = 0;
 
-//     glm::dvec3 pointForObj2;
-//     glm::dvec3 pointForObj1;
+    // Adds a face with the given winding (so that its normal faces away from the polytope). Returns false if the face is degenerate.
+    auto addFace = [&polytope, &faces, &nFaces](unsigned int a, unsigned int b, unsigned int c) {
+        glm::dvec3 normal = glm::cross(polytope[b][0] - polytope[a][0], polytope[c][0] - polytope[a][0]);
+        double length = glm::length(normal);
+        if (length < MIN_FACE_AREA || nFaces == MAX_FACES) {
+            return false;
+        }
+        normal /= length;
+
+        // the origin is inside the polytope, so this should only be (barely) negative because of floating point error
+        double distance = std::max(0.0, glm::dot(normal, polytope[a][0]));
+        faces[nFaces++] = EpaFace {.vertices = {a, b, c}, .normal = normal, .distance = distance};
+        return true;
+    };
+
+    // wind each face of the tetrahedron so that its normal points away from the vertex that isn't on it
+    const std::array<std::array<unsigned int, 4>, 4> tetrahedronFaces = {{ {0, 1, 2, 3}, {0, 3, 1, 2}, {0, 2, 3, 1}, {1, 3, 2, 0} }};
+    for (auto [a, b, c, opposite]: tetrahedronFaces) {
+        glm::dvec3 normal = glm::cross(polytope[b][0] - polytope[a][0], polytope[c][0] - polytope[a][0]);
+        if (glm::dot(normal, polytope[opposite][0] - polytope[a][0]) > 0) {
+            std::swap(b, c);
+        }
+        if (!addFace(a, b, c)) {
+            return std::nullopt;
+        }
+    }
+
+    // edges on the border between the faces a new point can see (which get removed) and the ones it can't, each with the same direction it had in the removed face
+    std::array<std::pair<unsigned int, unsigned int>, MAX_FACES * 3> horizon;
+
+    unsigned int closestFace = 0;
+    while (true) {
+        closestFace = 0;
+        for (unsigned int i = 1; i < nFaces; i++) {
+            if (faces[i].distance < faces[closestFace].distance) {
+                closestFace = i;
+            }
+        }
+
+        glm::dvec3 searchDirection = faces[closestFace].normal;
+        auto support = NewSimplexPoint(searchDirection, object1, object2);
+        if (glm::dot(searchDirection, support[0]) - faces[closestFace].distance < CONVERGENCE_TOLERANCE) {
+            break; // the closest face is already on the surface, so it's the answer
+        }
+
+        if (nVertices == MAX_VERTICES) {
+            return std::nullopt;
+        }
+        unsigned int newVertex = nVertices++;
+        polytope[newVertex] = support;
+
+        // remove every face the new point is in front of, keeping track of the edges around the hole that leaves
+        unsigned int nHorizonEdges = 0;
+        for (unsigned int i = 0; i < nFaces; i++) {
+            const EpaFace& face = faces[i];
+            if (glm::dot(face.normal, support[0] - polytope[face.vertices[0]][0]) <= 0) {
+                continue;
+            }
+
+            for (unsigned int j = 0; j < 3; j++) {
+                unsigned int a = face.vertices[j];
+                unsigned int b = face.vertices[j == 2 ? 0 : j + 1];
+
+                // an edge shared with another removed face shows up once in each direction, and isn't on the border of the hole
+                bool shared = false;
+                for (unsigned int k = 0; k < nHorizonEdges; k++) {
+                    if (horizon[k].first == b && horizon[k].second == a) {
+                        horizon[k] = horizon[--nHorizonEdges];
+                        shared = true;
+                        break;
+                    }
+                }
+                if (!shared) {
+                    horizon[nHorizonEdges++] = {a, b};
+                }
+            }
+
+            faces[i] = faces[--nFaces];
+            i--;
+        }
+
+        // fill the hole with faces going from its border to the new point
+        for (unsigned int i = 0; i < nHorizonEdges; i++) {
+            if (!addFace(horizon[i].first, horizon[i].second, newVertex)) {
+                return std::nullopt;
+            }
+        }
+
+        if (nFaces == 0) {
+            return std::nullopt; // floating point error made the new point see every face
+        }
+    }
+
+    const EpaFace& face = faces[closestFace];
+    const SupportPoint& a = polytope[face.vertices[0]];
+    const SupportPoint& b = polytope[face.vertices[1]];
+    const SupportPoint& c = polytope[face.vertices[2]];
+
+    // Project origin onto the face to get point of contact in minkoski space, and put that in barycentric coordinates (meaning its a mix of the triangle vertices).
+    // Mixing the support points that AREN'T in minkoski space the same way gives the deepest point on each object.
+    glm::dvec3 projectedPoint = face.normal * face.distance;
+    glm::dvec3 ab = b[0] - a[0];
+    glm::dvec3 ac = c[0] - a[0];
+    glm::dvec3 ap = projectedPoint - a[0];
+    double d00 = glm::dot(ab, ab);
+    double d01 = glm::dot(ab, ac);
+    double d11 = glm::dot(ac, ac);
+    double d20 = glm::dot(ap, ab);
+    double d21 = glm::dot(ap, ac);
+    double denom = d00 * d11 - d01 * d01;
+    Assert(denom != 0); // addFace() doesn't let in degenerate faces
+
+    double v = (d11 * d20 - d01 * d21) / denom;
+    double w = (d00 * d21 - d01 * d20) / denom;
+    double u = 1.0 - v - w;
+    glm::dvec3 pointOnObject1 = (a[1] * u) + (b[1] * v) + (c[1] * w);
+    glm::dvec3 pointOnObject2 = (a[2] * u) + (b[2] * v) + (c[2] * w);
+
+    // The minkoski difference is object1 - object2, so moving object1 by -normal * depth (or object2 by normal * depth) would put the origin on its surface.
+    return Penetration {.normal = face.normal, .depth = face.distance, .contactPoint = (pointOnObject1 + pointOnObject2) * 0.5};
+}
+
+// Returns the normal of one of the object's faces in world space, pointing out of the object.
+glm::vec3 FaceNormalInWorldSpace(const SupportShape& object, const std::pair<glm::vec3, std::vector<glm::vec3>>& face) {
+    auto normalInWorldSpace = glm::normalize(object.transform.GetNormalMatrix() * face.first);
+
+    // make sure normal faces out of the object because somehow it wasn't??? (see SatFaces())
+    glm::dvec3 pointOnPlaneInWorldSpace = object.modelToWorld * glm::dvec4(face.second.at(0), 1);
+    if (glm::dot(glm::dvec3(normalInWorldSpace), pointOnPlaneInWorldSpace - object.center) < 0) {
+        normalInWorldSpace *= -1;
+    }
+    return normalInWorldSpace;
+}
+
+// Calculates info about the collision from what EPA found, since EPA alone gives pretty mid contact points for face-face or face-edge cases (just one point), causing weird rotational artifacts.
+// If a face of either object lines up with EPA's normal, that's the reference face, and the contact points come from clipping the other object's face against it like SatContact() does.
+// Otherwise it's an edge-edge collision, where EPA's single contact point is exactly right.
+void FindContact(
+    const SupportShape& object1,
+    const SupportShape& object2,
+    const Penetration& penetration,
+    CollisionInfo& collision
+)
+{
+    // faces whose normals are within ~5 degrees of EPA's normal count as lined up
+    const double FACE_ALIGNMENT_THRESHOLD = 0.996;
+
+    glm::vec3 normal = penetration.normal;
+
+    // spheres and capsules don't have faces, so if either object is one, EPA's contact point is as good as it gets. TODO: capsules lying on a mesh only get one contact point
+    if (object1.hull != nullptr && object2.hull != nullptr) {
+        // the face of object1 that points the most towards object2, and the face of object2 that points the most towards object1
+        double bestAlignment1 = -FLT_MAX, bestAlignment2 = -FLT_MAX;
+        glm::vec3 bestNormal1(0, 0, 0), bestNormal2(0, 0, 0);
+        const std::vector<glm::vec3>* bestFace1 = nullptr;
+        const std::vector<glm::vec3>* bestFace2 = nullptr;
+        for (auto & face: object1.hull->faces) {
+            auto faceNormal = FaceNormalInWorldSpace(object1, face);
+            double alignment = glm::dot(faceNormal, normal);
+            if (alignment > bestAlignment1) {
+                bestAlignment1 = alignment;
+                bestNormal1 = faceNormal;
+                bestFace1 = &face.second;
+            }
+        }
+        for (auto & face: object2.hull->faces) {
+            auto faceNormal = FaceNormalInWorldSpace(object2, face);
+            double alignment = glm::dot(faceNormal, -normal);
+            if (alignment > bestAlignment2) {
+                bestAlignment2 = alignment;
+                bestNormal2 = faceNormal;
+                bestFace2 = &face.second;
+            }
+        }
+
+        collision.contactPoints.clear();
+        if (bestAlignment1 >= FACE_ALIGNMENT_THRESHOLD && bestAlignment1 >= bestAlignment2) {
+            ClipFaceContactPoints(bestNormal1, bestFace1, object1, object2, collision.contactPoints);
+            if (collision.contactPoints.size() > 0) {
+                collision.collisionNormal = bestNormal1;
+                return;
+            }
+        }
+        else if (bestAlignment2 >= FACE_ALIGNMENT_THRESHOLD) {
+            ClipFaceContactPoints(bestNormal2, bestFace2, object2, object1, collision.contactPoints);
+            if (collision.contactPoints.size() > 0) {
+                collision.collisionNormal = -bestNormal2;
+                return;
+            }
+        }
+    }
+
+    collision.collisionNormal = normal;
+    collision.contactPoints.clear();
+    collision.contactPoints.emplace_back(penetration.contactPoint, penetration.depth);
+}
 
-//     // in the case of edge-face collision, we can't use barycentric coordinates to find the contact point because we have a degenerate triangle (the edge is a degenerate triangle) 
-    
-    
-//     // if (glm::length2(glm::cross(b[2] - a[2], c[2] - a[2])) == 0) {
-//     //     // TODO: this assumes that a and c are always the identical points, which is literally wrong
-//     //     //Assert(a[2] != b[2]);
-//     //     // std::cout << "Executing EPA degenerate contact point case.\n";
-//     //     // std::cout << "\tCross is  = " << glm::to_string(glm::cross(b[2] - a[2], b[2] - projectedPoint)) << "\n";
-//     //     // // std::cout << "\tLerp between " << glm::to_string(a[2]) << " and " << glm::to_string(b[2]) << "\n";
-//     //     // std::cout << "\tLerp between In minkoski space " << glm::to_string(a[0]) << " and " << glm::to_string(b[0]) << "\n";
-//     //     // std::cout << "\tAB = " << glm::to_string(ab) << "\n";
-//     //     // std::cout << "\tAB for actual world space = " << glm::to_string(b[2] - a[2]) << "\n";
-//     //     // std::cout << "\tP = " << glm::to_string(projectedPoint) << "\n";
-//     //     // auto lerpAmount = glm::length(projectedPoint - a[0])/glm::length(ab);
-//     //     // std::cout << "\tlerp amount = " << /*glm::to_string*/(lerpAmount) << "\n";
-//     //     pointForObj2 = a[2] + 0.5 * (b[2] - a[2]);
-//     // }
-//     // else {
-//         // std::cout << "AB = " << glm::to_string(ab) << ", AC = " << glm::to_string(ac) << ", AO = " << glm::to_string(ao) << ".\n";
-    
-//         double d00 = glm::dot(ab, ab);
-//         double d01 = glm::dot(ab, ac);
-//         double d11 = glm::dot(ac, ac);
-//         double d20 = glm::dot(ao, ab);
-//         double d21 = glm::dot(ao, ac);
-//         double denom = d00 * d11 - d01 * d01;
-
-//         // uvw is barycentric coords aka a mixture of the triangle vertices that averages out to the point we got
-//         double v = (d11 * d20 - d01 * d21) / denom;
-//         double w = (d00 * d21 - d01 * d20) / denom;
-//         double u = 1.0f - v - w;
-//         // we use that mixture with the triangle vertices that AREN'T in minkoski space to get the real contact point
-//         // std::cout << "We got " << glm::to_string((a[0] * u) + (b[0] * v) + (c[0] * w)) << " vs " << glm::to_string(projectedPoint);
-//         pointForObj1 = (a[1] * u) + (b[1] * v) + (c[1] * w);  
-//         pointForObj2 = (a[2] * u) + (b[2] * v) + (c[2] * w); 
-//         std::cout << "Its either " << glm::to_string(pointForObj1) << " or " << glm::to_string(pointForObj2) << ".\n";
-//         std::printf("Barycentric coords are %f %f %f \n", v, w, u);
-//         // std::printf("Considering support points %f %f %f and %f %f %f, and %f %f %f \n", a[2].x, a[2].y, a[2].z, b[2].x, b[2].y, b[2].z, c[2].x, c[2].y, c[2].z);
-
-//         //auto point = (a[2] * gamma) + (b[2] * beta) + (c[2] * alpha);
-//     // }
-
-//     // return CollisionInfo({
-//     //     .collisionNormal = minNormal,
-//     //     .contactPoints = {pointForObj2},
-//     //     .penetrationDepth = minDistance // TODO: add 0.0001f?
-//     // });
-// }
- 
 // this article actually does a really good job of explaining the GJK algorithm.
 // https://cse442-17f.github.io/Gilbert-Johnson-Keerthi-Distance-Algorithm/
-// TODO: concave support
-std::optional<CollisionInfo> IsColliding(
-    const TransformComponent& transform1,
-    const ColliderComponent& collider1,
-    const TransformComponent& transform2,
-    const ColliderComponent& collider2
+// IsColliding() (the one that writes into collision) for one convex piece of each object.
+bool GjkCollision(
+    const SupportShape& object1,
+    const SupportShape& object2,
+    glm::dvec3* warmStartDirection,
+    CollisionInfo& collision
 ) 
 {
-    // std::cout << "HI: testing collision between #1 = " << glm::to_string(transform1.Position()) << " and #2 = " << glm::to_string(transform2.Position()) << "\n";
+    // std::cout << "HI: testing collision between #1 = " << glm::to_string(object1.transform.Position()) << " and #2 = " << glm::to_string(object2.transform.Position()) << "\n";
     // first dvec3 in each array is actual simplex point on the minkoskwi difference, the other 2 are the collider points whose difference is that point, we need those for contact points
-    std::vector<std::array<glm::dvec3, 3>> simplex;
+    Simplex simplex;
 
     // Search direction is in WORLD space.
     glm::dvec3 searchDirection = glm::normalize(glm::dvec3 {1, 1, 1}); // arbitrary starting direction
+    if (warmStartDirection && glm::length2(*warmStartDirection) > 0) {
+        searchDirection = glm::normalize(*warmStartDirection); // or wherever we ended up last time
+    }
     // std::printf("\tInitial search direction %f %f %f\n", searchDirection.x, searchDirection.y, searchDirection.z);
 
     // add starting point to simplex
@@ -891,17 +974,26 @@ std::optional<CollisionInfo> IsColliding(
         // If the minowski difference of the 2 objects contains the origin, there is a point where the two positions subtracted from each other = 0, meaning the two objects are colliding.
         // Again, check the link above if you don't get it.
         // The simplex is just (in 3d) 4 points in the minoski difference that will be enough to determine whether the objects are colliding.
-    simplex.push_back(NewSimplexPoint(searchDirection, transform1, collider1, transform2, collider2));
-    // std::cout << "INIT: Searched in " << glm::to_string(searchDirection) << " to get point " << glm::to_string(simplex.back()[0]) << "\n";
+    simplex.PushFront(NewSimplexPoint(searchDirection, object1, object2));
+    // std::cout << "INIT: Searched in " << glm::to_string(searchDirection) << " to get point " << glm::to_string(simplex[0][0]) << "\n";
+
+    // same test as in the loop below; if the starting direction separates the objects (likely when it's the direction that separated them last time), we're already done
+    if (glm::dot(simplex[0][0], searchDirection) <= 0) {
+        if (warmStartDirection) {
+            *warmStartDirection = searchDirection;
+        }
+        return false;
+    }
+
     // make new search direction go from simplex towards origin
-    searchDirection = glm::normalize(-simplex.back()[0]);
+    searchDirection = glm::normalize(-simplex[0][0]);
 
     unsigned int nIterations = 0;
     while (true) {
         nIterations++;
         if (nIterations == 1024) {
             DebugLogError("WARNING: GJK FAILED TO DETERMINE COLLISION AFTER 1024 ITERATIONS. NANs likely.");
-            return std::nullopt;
+            return false;
         }
         // std::cout << "\tSimplex: ";
         // for (auto & p: simplex) {
@@ -910,7 +1002,7 @@ std::optional<CollisionInfo> IsColliding(
         // std::cout << "\n";
 
         // get new point for simplex
-        auto newSimplexPoint = NewSimplexPoint(searchDirection, transform1, collider1, transform2, collider2);
+        auto newSimplexPoint = NewSimplexPoint(searchDirection, object1, object2);
         // std::printf("Going in direction %f %f %f\n", searchDirection.x, searchDirection.y, searchDirection.z);
         //  std::cout << "\tSearched in " << glm::to_string(searchDirection) << " to get point " << glm::to_string(newSimplexPoint[0]) << " from " << glm::to_string(newSimplexPoint[1]) << " - " << glm::to_string(newSimplexPoint[2]) << "\n";
 
@@ -918,12 +1010,15 @@ std::optional<CollisionInfo> IsColliding(
         if (glm::dot(newSimplexPoint[0], searchDirection) <= 0) {
             // std::cout << "GJK failed with " << simplex.size() << " vertices.\n\n";
             // while (true) {}kk
-            return std::nullopt;
+            if (warmStartDirection) {
+                *warmStartDirection = searchDirection;
+            }
+            return false;
         }
 
         // add point to simplex
         // we gotta insert at beginning because simplex order matters
-        simplex.insert(simplex.begin(), newSimplexPoint);
+        simplex.PushFront(newSimplexPoint);
 
         // the code for this next part depends on # of points in the current simplex, but its basically:
         // 1. see if origin intersects simplex
@@ -957,14 +1052,22 @@ std::optional<CollisionInfo> IsColliding(
                 //     }
                 // }
 
-                // return EPA(simplex, transform1, collider1, transform2, collider2);
                 // std::cout << "THERE IS A COLLISION\n";
-                // std::cout << "Positions are #1 = " << glm::to_string(transform1.Position()) << " and #2 = " << glm::to_string(transform2.Position()) << "\n";
-                auto result = FindContact(transform1, collider1, transform2, collider2);
-                if (!result) {
+                // std::cout << "Positions are #1 = " << glm::to_string(object1.transform.Position()) << " and #2 = " << glm::to_string(object2.transform.Position()) << "\n";
+                if (warmStartDirection) {
+                    *warmStartDirection = searchDirection;
+                }
+                // EPA expands the simplex we just found into the penetration normal/depth; if it can't, SAT gets the slow but sure answer
+                auto penetration = EPA(simplex, object1, object2);
+                if (penetration) {
+                    FindContact(object1, object2, *penetration, collision);
+                    return true;
+                }
+                if (!SatContact(object1, object2, collision)) {
                     std::cout << "SAT and GJK disagreed, uh oh.\n";
+                    return false;
                 }
-                return result;
+                return true;
             }
             break;
             default:
@@ -973,4 +1076,506 @@ std::optional<CollisionInfo> IsColliding(
             break;
         }
     }
-}
\ No newline at end of file
+}
+
+// The solver wants one normal per collision, so when an object was tested in several parts (convex pieces, heightfield columns), use the normal of whichever part is deepest, and keep the contact points of the parts that agree with it.
+// Only looks at the first nCollisions, so that callers can keep the rest (and their contact points' storage) around for next time. Collisions without any contact points are ignored.
+// Returns false if none of them had any contact points.
+bool CombineCollisions(const std::vector<CollisionInfo>& collisions, unsigned int nCollisions, CollisionInfo& result) {
+    // contact points from different parts count as the same contact surface if their normals are within ~8 degrees of each other
+    const double SAME_NORMAL_THRESHOLD = 0.99;
+
+    unsigned int deepest = 0;
+    double deepestDepth = -DBL_MAX;
+    for (unsigned int i = 0; i < nCollisions; i++) {
+        for (auto & [point, depth]: collisions[i].contactPoints) {
+            if (depth > deepestDepth) {
+                deepestDepth = depth;
+                deepest = i;
+            }
+        }
+    }
+
+    if (deepestDepth == -DBL_MAX) {
+        return false;
+    }
+
+    result.collisionNormal = collisions[deepest].collisionNormal;
+    result.contactPoints.clear();
+    for (unsigned int i = 0; i < nCollisions; i++) {
+        if (glm::dot(collisions[i].collisionNormal, result.collisionNormal) >= SAME_NORMAL_THRESHOLD) {
+            result.contactPoints.insert(result.contactPoints.end(), collisions[i].contactPoints.begin(), collisions[i].contactPoints.end());
+        }
+    }
+    return true;
+}
+
+// Returns the next unused collision in collisions (see CombineCollisions()), with no contact points, reusing one left over from last time if there is one.
+CollisionInfo& NextCollision(std::vector<CollisionInfo>& collisions, unsigned int& nCollisions, const glm::dvec3& normal) {
+    if (nCollisions == collisions.size()) {
+        collisions.emplace_back();
+    }
+    CollisionInfo& collision = collisions[nCollisions++];
+    collision.collisionNormal = normal;
+    collision.contactPoints.clear();
+    return collision;
+}
+
+// Collides one convex piece of an object with the columns of a heightfield it's over, adding a collision (with the normal facing out of the heightfield) to collisions for each column it's in (see NextCollision()).
+// Each column gets SAT against just its own faces, and only the top and the sides that aren't against a column at least as tall count,
+    // so that things sliding along flat ground don't catch on the seams between cells like they would on a mesh.
+void CollideHeightfieldPiece(const TransformComponent& heightfieldTransform, const Heightfield& heightfield, const SupportShape& object, std::vector<CollisionInfo>& collisions, unsigned int& nCollisions) {
+    // The piece's extent along each axis. This comes from the support function instead of the collider's AABB, since continuous collision moves objects without updating their AABB.
+    glm::dvec3 low, high;
+    for (unsigned int axis = 0; axis < 3; axis++) {
+        glm::dvec3 direction(0, 0, 0);
+        direction[axis] = 1;
+        high[axis] = FindFarthestVertexOnObject(direction, object)[axis];
+        low[axis] = FindFarthestVertexOnObject(-direction, object)[axis];
+    }
+
+    glm::ivec2 minCell, maxCell;
+    if (!heightfield.CellRange(heightfieldTransform, AABB(low, high), minCell, maxCell)) {
+        return;
+    }
+
+    // The face of a column that the piece gets pushed out through, which is a rectangle on the plane dot(point, normal) = offset.
+    // bounds is that rectangle, but unbounded along the normal, so that testing a point against it only checks whether the point is over the face.
+    struct Face {
+        glm::dvec3 normal;
+        double offset;
+        double depth; // how far the piece is through the face
+        AABB bounds;
+    };
+    // scratch space for the faces and the piece's vertices
+    thread_local std::vector<Face> faces;
+    thread_local std::vector<glm::dvec3> vertices;
+    faces.clear();
+
+    glm::dvec3 position = heightfieldTransform.Position();
+    glm::dvec3 scale = heightfieldTransform.Scale();
+    for (int x = minCell.x; x <= maxCell.x; x++) {
+        for (int z = minCell.y; z <= maxCell.y; z++) {
+            float height = heightfield.GetHeight(x, z);
+            if (height == Heightfield::HOLE) {
+                continue;
+            }
+
+            double top = position.y + height * scale.y;
+            glm::dvec3 cellMin(position.x + x * scale.x, -INFINITY, position.z + z * scale.z);
+            glm::dvec3 cellMax(cellMin.x + scale.x, top, cellMin.z + scale.z);
+            if (low.y >= top || low.x >= cellMax.x || high.x < cellMin.x || low.z >= cellMax.z || high.z < cellMin.z) {
+                continue;
+            }
+
+            Face face {.normal = glm::dvec3(0, 1, 0), .offset = top, .depth = top - low.y, .bounds = AABB(glm::dvec3(cellMin.x, -INFINITY, cellMin.z), glm::dvec3(cellMax.x, INFINITY, cellMax.z))};
+
+            const std::array<glm::ivec2, 4> SIDES = {glm::ivec2(-1, 0), glm::ivec2(1, 0), glm::ivec2(0, -1), glm::ivec2(0, 1)};
+            for (auto & side: SIDES) {
+                float neighbourHeight = heightfield.GetHeight(x + side.x, z + side.y);
+                if (neighbourHeight >= height) {
+                    continue; // the neighbour covers this side
+                }
+
+                glm::dvec3 normal(side.x, 0, side.y);
+                double offset = side.x + side.y < 0 ? glm::dot(normal, glm::dvec3(cellMin.x, 0, cellMin.z)) : glm::dot(normal, glm::dvec3(cellMax.x, 0, cellMax.z));
+                double depth = offset - glm::dot(normal, glm::dvec3(side.x < 0 ? high.x : low.x, 0, side.y < 0 ? high.z : low.z));
+                if (depth < face.depth) {
+                    // the side goes from the neighbour's top up to this column's top
+                    double bottom = neighbourHeight == Heightfield::HOLE ? -INFINITY : position.y + neighbourHeight * scale.y;
+                    AABB bounds = side.x != 0 ? AABB(glm::dvec3(-INFINITY, bottom, cellMin.z), glm::dvec3(INFINITY, top, cellMax.z)) : AABB(glm::dvec3(cellMin.x, bottom, -INFINITY), glm::dvec3(cellMax.x, top, INFINITY));
+                    face = Face {.normal = normal, .offset = offset, .depth = depth, .bounds = bounds};
+                }
+            }
+
+            faces.push_back(face);
+        }
+    }
+
+    if (faces.empty()) {
+        return;
+    }
+
+    // The points that could be deepest through a face are the hull's vertices, or for spheres and capsules the point on the surface below each end of their segment (which are the same point for a sphere).
+    vertices.clear();
+    if (object.hull) {
+        for (auto & vertex: object.hull->vertices) {
+            vertices.push_back(glm::dvec3(object.modelToWorld * glm::dvec4(vertex, 1)));
+        }
+    }
+
+    // contact points are halfway between the point on the piece and the face, like everywhere else
+    unsigned int firstCollision = nCollisions;
+    bool foundContactPoint = false;
+    for (auto & face: faces) {
+        CollisionInfo& collision = NextCollision(collisions, nCollisions, face.normal);
+        auto tryPoint = [&face, &collision](const glm::dvec3& point) {
+            double depth = face.offset - glm::dot(point, face.normal);
+            // (half open, so that a point right on the line between two cells doesn't get added by both)
+            if (depth > 0 && point.x >= face.bounds.min.x && point.x < face.bounds.max.x && point.y >= face.bounds.min.y && point.y < face.bounds.max.y && point.z >= face.bounds.min.z && point.z < face.bounds.max.z) {
+                collision.contactPoints.emplace_back(point + face.normal * (depth / 2.0), depth);
+            }
+        };
+
+        if (object.hull) {
+            for (auto & vertex: vertices) {
+                tryPoint(vertex);
+            }
+        }
+        else {
+            tryPoint(object.primitive.SegmentStart() - face.normal * object.primitive.radius);
+            if (object.primitive.halfHeight > 0) {
+                tryPoint(object.primitive.SegmentEnd() - face.normal * object.primitive.radius);
+            }
+        }
+        foundContactPoint = foundContactPoint || !collision.contactPoints.empty();
+    }
+
+    if (foundContactPoint) {
+        return;
+    }
+
+    // None of those points were over a face, so the columns poke into the piece between them (like a bump under a crate, or a sphere hanging over the edge of a hole).
+    // Put contact points where the piece and each face overlap instead; the corners of the overlap for hulls, or just the point closest to the deepest point for spheres and capsules.
+    for (unsigned int i = 0; i < faces.size(); i++) {
+        const Face& face = faces[i];
+        CollisionInfo& collision = collisions[firstCollision + i];
+        unsigned int normalAxis = face.normal.x != 0 ? 0 : face.normal.y != 0 ? 1 : 2;
+        unsigned int tangentAxis1 = (normalAxis + 1) % 3;
+        unsigned int tangentAxis2 = (normalAxis + 2) % 3;
+        double normalCoordinate = face.normal[normalAxis] * (face.offset - face.depth / 2.0);
+
+        glm::dvec3 overlapMin = glm::max(face.bounds.min, low);
+        glm::dvec3 overlapMax = glm::min(face.bounds.max, high);
+        if (overlapMin[tangentAxis1] >= overlapMax[tangentAxis1] || overlapMin[tangentAxis2] >= overlapMax[tangentAxis2]) {
+            continue; // only touching the edge of the face
+        }
+
+        if (object.hull) {
+            for (unsigned int corner = 0; corner < 4; corner++) {
+                glm::dvec3 point;
+                point[normalAxis] = normalCoordinate;
+                point[tangentAxis1] = corner & 1 ? overlapMax[tangentAxis1] : overlapMin[tangentAxis1];
+                point[tangentAxis2] = corner & 2 ? overlapMax[tangentAxis2] : overlapMin[tangentAxis2];
+                collision.contactPoints.emplace_back(point, face.depth);
+            }
+        }
+        else {
+            glm::dvec3 point = glm::clamp(FindFarthestVertexOnObject(-face.normal, object), face.bounds.min, face.bounds.max);
+            point[normalAxis] = normalCoordinate;
+            collision.contactPoints.emplace_back(point, face.depth);
+        }
+    }
+}
+
+// IsColliding() (the one that writes into collision) for when one of the colliders is a heightfield. The normal faces out of the heightfield.
+bool CollideHeightfield(const TransformComponent& heightfieldTransform, const Heightfield& heightfield, const TransformComponent& transform, const ColliderComponent& collider, const glm::dvec3& offset, CollisionInfo& collision) {
+    if (collider.shape == ColliderShapeHeightfield) {
+        return false; // heightfields don't move, so there's nothing to do if two of them touch
+    }
+
+    // one per column, reused like the rest of the scratch space
+    thread_local std::vector<CollisionInfo> columnCollisions;
+    unsigned int nCollisions = 0;
+    unsigned int nPieces = PieceCount(collider);
+    for (unsigned int piece = 0; piece < nPieces; piece++) {
+        CollideHeightfieldPiece(heightfieldTransform, heightfield, SupportShape(transform, collider, piece, offset), columnCollisions, nCollisions);
+    }
+    return CombineCollisions(columnCollisions, nCollisions, collision);
+}
+
+bool IsColliding(
+    const TransformComponent& transform1,
+    const ColliderComponent& collider1,
+    const TransformComponent& transform2,
+    const ColliderComponent& collider2,
+    CollisionInfo& collision,
+    glm::dvec3* warmStartDirection
+) 
+{
+    return IsColliding(transform1, collider1, glm::dvec3(0, 0, 0), transform2, collider2, collision, warmStartDirection);
+}
+
+bool IsColliding(
+    const TransformComponent& transform1,
+    const ColliderComponent& collider1,
+    const glm::dvec3& offset1,
+    const TransformComponent& transform2,
+    const ColliderComponent& collider2,
+    CollisionInfo& collision,
+    glm::dvec3* warmStartDirection
+) 
+{
+    // heightfields only look at the columns the other object is over, instead of going through GJK
+    if (collider1.shape == ColliderShapeHeightfield) {
+        // moving the heightfield is the same as moving the other object the opposite way, and then moving the contact points back
+        if (!CollideHeightfield(transform1, *collider1.heightfield, transform2, collider2, -offset1, collision)) {
+            return false;
+        }
+        for (auto& [point, depth]: collision.contactPoints) {
+            point += offset1;
+        }
+        return true;
+    }
+    if (collider2.shape == ColliderShapeHeightfield) {
+        if (!CollideHeightfield(transform2, *collider2.heightfield, transform1, collider1, offset1, collision)) {
+            return false;
+        }
+        collision.collisionNormal = -collision.collisionNormal;
+        return true;
+    }
+
+    // pairs of primitives (besides two boxes) have their own much faster routines
+    if (HasDedicatedCollision(collider1.shape, collider2.shape)) {
+        Primitive primitive1(collider1.shape, transform1);
+        primitive1.center += offset1;
+        return CollidePrimitives(primitive1, Primitive(collider2.shape, transform2), collision);
+    }
+
+    unsigned int nPieces1 = PieceCount(collider1);
+    unsigned int nPieces2 = PieceCount(collider2);
+
+    if (nPieces1 == 1 && nPieces2 == 1) {
+        return GjkCollision(SupportShape(transform1, collider1, 0, offset1), SupportShape(transform2, collider2), warmStartDirection, collision);
+    }
+
+    // Concave meshes (see PhysicsMesh::New()) are made of several convex pieces, so test every piece against every piece.
+    // The warm start direction is only good for one pair of pieces, so it isn't used here.
+    // The pieces' collisions are scratch space too, so that their contact points don't get allocated every time.
+    thread_local std::vector<CollisionInfo> pieceCollisions;
+    unsigned int nCollisions = 0;
+    for (unsigned int piece1 = 0; piece1 < nPieces1; piece1++) {
+        const SupportShape object1(transform1, collider1, piece1, offset1);
+        for (unsigned int piece2 = 0; piece2 < nPieces2; piece2++) {
+            CollisionInfo& pieceCollision = NextCollision(pieceCollisions, nCollisions, glm::dvec3(0, 0, 0));
+            if (!GjkCollision(object1, SupportShape(transform2, collider2, piece2), nullptr, pieceCollision)) {
+                nCollisions--; // give it back
+            }
+        }
+    }
+
+    return CombineCollisions(pieceCollisions, nCollisions, collision);
+}
+
+std::optional<CollisionInfo> IsColliding(
+    const TransformComponent& transform1,
+    const ColliderComponent& collider1,
+    const TransformComponent& transform2,
+    const ColliderComponent& collider2,
+    glm::dvec3* warmStartDirection
+) 
+{
+    CollisionInfo collision;
+    if (!IsColliding(transform1, collider1, transform2, collider2, collision, warmStartDirection)) {
+        return std::nullopt;
+    }
+    return collision;
+}
+
+std::optional<CollisionInfo> FindContactSat(
+    const TransformComponent& transform1,
+    const ColliderComponent& collider1,
+    const TransformComponent& transform2,
+    const ColliderComponent& collider2
+) 
+{
+    CollisionInfo collision;
+    if (!SatContact(SupportShape(transform1, collider1), SupportShape(transform2, collider2), collision)) {
+        return std::nullopt;
+    }
+    return collision;
+}
+
+double ColliderWidth(const TransformComponent& transform, const ColliderComponent& collider, const glm::dvec3& direction) {
+    glm::dvec3 normalizedDirection = glm::normalize(direction);
+    double farthest = -DBL_MAX, nearest = DBL_MAX;
+
+    unsigned int nPieces = PieceCount(collider);
+    for (unsigned int piece = 0; piece < nPieces; piece++) {
+        const SupportShape object(transform, collider, piece);
+        farthest = std::max(farthest, glm::dot(FindFarthestVertexOnObject(normalizedDirection, object), normalizedDirection));
+        nearest = std::min(nearest, glm::dot(FindFarthestVertexOnObject(-normalizedDirection, object), normalizedDirection));
+    }
+    return farthest - nearest;
+}
+
+// Finds the point in the convex hull of the given points (up to 4 of them) that's closest to target, and throws out the points that aren't needed to make it.
+// This is Johnson's distance subalgorithm done the dumb way, by trying every subset of the points; there's only 15 of them.
+glm::dvec3 ClosestPointOnSimplex(std::array<glm::dvec3, 4>& points, unsigned int& nPoints, const glm::dvec3& target) {
+    glm::dvec3 closest(0, 0, 0);
+    double closestDistance2 = DBL_MAX;
+    unsigned int closestSubset = 0;
+
+    for (unsigned int subset = 1; subset < (1u << nPoints); subset++) {
+        std::array<glm::dvec3, 4> subsetPoints;
+        unsigned int n = 0;
+        for (unsigned int i = 0; i < nPoints; i++) {
+            if (subset & (1u << i)) {
+                subsetPoints[n++] = points[i] - target;
+            }
+        }
+
+        // The closest point on the point/line/plane through the subset is subsetPoints[0] + the sum of weights[j] * edges[j], where the weights solve gram * weights = -dot(edges, subsetPoints[0])
+        glm::dvec3 point = subsetPoints[0];
+        bool inside = true;
+        if (n > 1) {
+            glm::dmat3 gram(1.0); // identity for the unused rows/columns, so it can always be inverted the same way
+            glm::dvec3 rhs(0, 0, 0);
+            std::array<glm::dvec3, 3> edges;
+            for (unsigned int j = 0; j < n - 1; j++) {
+                edges[j] = subsetPoints[j + 1] - subsetPoints[0];
+                rhs[j] = -glm::dot(edges[j], subsetPoints[0]);
+            }
+            for (unsigned int j = 0; j < n - 1; j++) {
+                for (unsigned int k = 0; k < n - 1; k++) {
+                    gram[j][k] = glm::dot(edges[j], edges[k]);
+                }
+            }
+            if (glm::determinant(gram) <= 1e-12 * gram[0][0] * gram[1][1] * gram[2][2]) { // the points are on a line/plane, so some smaller subset will do
+                continue;
+            }
+            glm::dvec3 weights = glm::inverse(gram) * rhs;
+
+            double weightSum = 0;
+            for (unsigned int j = 0; j < n - 1; j++) {
+                point += edges[j] * weights[j];
+                weightSum += weights[j];
+                inside = inside && weights[j] > 0;
+            }
+            inside = inside && weightSum < 1;
+        }
+
+        // the closest point on the whole hull is the closest of the ones that are actually inside their subset's hull
+        double distance2 = glm::length2(point);
+        if (inside && distance2 < closestDistance2) {
+            closest = point;
+            closestDistance2 = distance2;
+            closestSubset = subset;
+        }
+    }
+
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < nPoints; i++) {
+        if (closestSubset & (1u << i)) {
+            points[n++] = points[i];
+        }
+    }
+    nPoints = n;
+    return closest + target;
+}
+
+// GJK raycast (see "Ray Casting against General Convex Objects with Application to Continuous Collision Detection", van den Bergen 2004) for one convex piece.
+// Casting the shape against the object is the same as casting a ray from the shape's center against the object grown by the shape (their Minkowski difference, offset by the center), so that's what this does.
+// x moves along the ray towards the grown object, and every time GJK finds a plane that x is in front of, x jumps forward to that plane.
+// objectSupport is the object's support function, taking a direction in world space and returning a point in world space.
+template<typename ObjectSupport>
+std::optional<ShapeCastHit> ShapeCastPiece(const ObjectSupport& objectSupport, const Primitive& castShape, const glm::dvec3& direction, double maxDistance) {
+    const unsigned int MAX_ITERATIONS = 64;
+    const double TOLERANCE = 1e-5;
+
+    const glm::dvec3 start = castShape.center;
+    auto support = [&objectSupport, &castShape, &start](const glm::dvec3& d) {
+        return objectSupport(d) - (PrimitiveSupport(castShape, -d) - start);
+    };
+
+    double distance = 0;
+    glm::dvec3 x = start;
+    glm::dvec3 normal(0, 0, 0);
+    std::array<glm::dvec3, 4> simplex;
+    unsigned int nPoints = 0;
+
+    glm::dvec3 v = x - support(direction);
+    unsigned int iteration = 0;
+    for (; iteration < MAX_ITERATIONS && glm::length2(v) > TOLERANCE * TOLERANCE; iteration++) {
+        glm::dvec3 p = support(v);
+        glm::dvec3 w = x - p;
+        if (glm::dot(v, w) > 0) {
+            double approach = glm::dot(v, direction);
+            if (approach >= 0) { // x is in front of a plane separating it from the grown object and the ray is moving away from it
+                return std::nullopt;
+            }
+            distance -= glm::dot(v, w) / approach;
+            if (distance > maxDistance) {
+                return std::nullopt;
+            }
+            x = start + direction * distance;
+            normal = v;
+        }
+        simplex[nPoints++] = p;
+        v = x - ClosestPointOnSimplex(simplex, nPoints, x);
+    }
+
+    // ran out of iterations without getting close, call it a miss
+    if (iteration == MAX_ITERATIONS && glm::length2(v) > 100 * TOLERANCE * TOLERANCE) {
+        return std::nullopt;
+    }
+
+    // if x never moved the shape started out touching the object, so there's no real normal
+    normal = glm::length2(normal) > 0 ? glm::normalize(normal) : -direction;
+    return ShapeCastHit {.distance = distance, .normal = normal, .point = x + (PrimitiveSupport(castShape, -normal) - start)};
+}
+
+// ShapeCast() for heightfields, which casts against each column (as a box) that the shape passes over.
+std::optional<ShapeCastHit> ShapeCastHeightfield(const TransformComponent& transform, const Heightfield& heightfield, const Primitive& castShape, const glm::dvec3& direction, double maxDistance) {
+    std::optional<ShapeCastHit> closestHit = std::nullopt;
+
+    AABB shapeAabb = PrimitiveAABB(castShape);
+    glm::dvec3 extents = (shapeAabb.max - shapeAabb.min) / 2.0;
+    glm::dvec3 inverseDirection = 1.0 / direction;
+
+    // the columns worth looking at are the ones under the part of the cast that's over the heightfield
+    AABB bounds = heightfield.GetAABB(transform);
+    bounds = AABB(bounds.min - extents, bounds.max + extents);
+    double enter = bounds.RayDistance(castShape.center, inverseDirection);
+    if (enter == INFINITY || enter > maxDistance) {
+        return std::nullopt;
+    }
+    double reach = std::min(maxDistance, enter + glm::length(bounds.max - bounds.min));
+    glm::dvec3 end = castShape.center + direction * reach;
+    glm::ivec2 minCell, maxCell;
+    if (!heightfield.CellRange(transform, AABB(glm::min(castShape.center, end) - extents, glm::max(castShape.center, end) + extents), minCell, maxCell)) {
+        return std::nullopt;
+    }
+
+    for (int x = minCell.x; x <= maxCell.x; x++) {
+        for (int z = minCell.y; z <= maxCell.y; z++) {
+            if (heightfield.GetHeight(x, z) == Heightfield::HOLE) {
+                continue;
+            }
+
+            // skip columns the shape couldn't reach before whatever it already hit
+            AABB column = heightfield.CellAABB(transform, x, z);
+            double distance = AABB(column.min - extents, column.max + extents).RayDistance(castShape.center, inverseDirection);
+            if (distance > (closestHit ? closestHit->distance : maxDistance)) {
+                continue;
+            }
+
+            Primitive box(ColliderShapeBox, (column.min + column.max) / 2.0, glm::quat(1, 0, 0, 0), column.max - column.min);
+            auto hit = ShapeCastPiece([&box](const glm::dvec3& d) { return PrimitiveSupport(box, d); }, castShape, direction, closestHit ? closestHit->distance : maxDistance);
+            if (hit) {
+                closestHit = hit;
+            }
+        }
+    }
+
+    return closestHit;
+}
+
+std::optional<ShapeCastHit> ShapeCast(const TransformComponent& transform, const ColliderComponent& collider, const Primitive& castShape, const glm::dvec3& direction, double maxDistance) {
+    if (collider.shape == ColliderShapeHeightfield) {
+        return ShapeCastHeightfield(transform, *collider.heightfield, castShape, direction, maxDistance);
+    }
+
+    std::optional<ShapeCastHit> closestHit = std::nullopt;
+
+    unsigned int nPieces = PieceCount(collider);
+    for (unsigned int piece = 0; piece < nPieces; piece++) {
+        const SupportShape object(transform, collider, piece);
+        auto hit = ShapeCastPiece([&object](const glm::dvec3& d) { return FindFarthestVertexOnObject(d, object); }, castShape, direction, closestHit ? closestHit->distance : maxDistance);
+        if (hit) {
+            closestHit = hit;
+        }
+    }
+
+    return closestHit;
+}
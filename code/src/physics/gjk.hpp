@@ -7,6 +7,8 @@
 #include <optional>
 #include <vector>
 
+struct Primitive;
+
 struct CollisionInfo {
     glm::dvec3 collisionNormal;
 
@@ -18,13 +20,71 @@ struct CollisionInfo {
 };
 
 // GJK+EPA collision algorithms. Determines whether the given thingies are colliding, and if they are, the return value will contain the collision info.
+// The collision normal faces out of collider1 towards collider2.
+// Most pairs of primitive colliders skip GJK for their own routines (see primitive_collisions.hpp), and primitives mixed with meshes go through GJK with closed-form support functions.
+// Heightfields skip GJK too, and collide with everything by looking at the columns it's over (see heightfield.hpp). Two heightfields never collide.
+// Meshes split into several convex pieces (see PhysicsMesh::New()) have every piece tested against every piece of the other object.
+// If warmStartDirection is given and isn't zero, GJK starts searching in that direction, and afterwards it's set to the last direction GJK searched in.
+    // For objects that aren't colliding that's a direction that separates them, so passing it in again next time for the same objects usually lets GJK give up after looking at one point.
 std::optional<CollisionInfo> IsColliding(
+    const TransformComponent& transform1,
+    const ColliderComponent& collider1,
+    const TransformComponent& transform2,
+    const ColliderComponent& collider2,
+    glm::dvec3* warmStartDirection = nullptr
+);
+
+// Same as above, but writes the collision into collision instead of returning it, and returns whether they're colliding (if they aren't, collision is left with junk in it).
+// collision's contact points reuse its storage, so keeping the same CollisionInfo around between calls means nothing gets allocated once it's big enough.
+bool IsColliding(
+    const TransformComponent& transform1,
+    const ColliderComponent& collider1,
+    const TransformComponent& transform2,
+    const ColliderComponent& collider2,
+    CollisionInfo& collision,
+    glm::dvec3* warmStartDirection = nullptr
+);
+
+// Same as above, but as if collider1 were offset1 (in world space) away from where transform1 has it, without actually moving it.
+// Continuous collision tries lots of positions along a collider's path like this, since actually moving the transform (see TransformComponent::SetPos()) for every one of them would cost a lot more than the collision test.
+bool IsColliding(
+    const TransformComponent& transform1,
+    const ColliderComponent& collider1,
+    const glm::dvec3& offset1,
+    const TransformComponent& transform2,
+    const ColliderComponent& collider2,
+    CollisionInfo& collision,
+    glm::dvec3* warmStartDirection = nullptr
+);
+
+// For two objects that are known to be colliding, finds how they're colliding by testing every face and every pair of edges with SAT.
+// This is how IsColliding() found contacts before it used EPA. IsColliding() still falls back to it when EPA fails; it's exposed so that benchmarks can compare against it.
+// Only looks at the first convex piece of each object.
+std::optional<CollisionInfo> FindContactSat(
     const TransformComponent& transform1,
     const ColliderComponent& collider1,
     const TransformComponent& transform2,
     const ColliderComponent& collider2
 );
 
+// Returns how wide the collider is along the given direction (in world space, doesn't need to be normalized), i.e. how far apart two planes facing that direction would be if they sandwiched the collider.
+double ColliderWidth(const TransformComponent& transform, const ColliderComponent& collider, const glm::dvec3& direction);
+
+struct ShapeCastHit {
+    // how far the shape moved before touching the collider; 0 if it was already touching it
+    double distance;
+
+    // faces out of the collider, towards the shape
+    glm::dvec3 normal;
+
+    // where the shape touches the collider, in world space
+    glm::dvec3 point;
+};
+
+// Moves castShape along direction (which should be normalized) and returns where it first touches the collider, if it does so before moving maxDistance.
+// Uses GJK raycasting against each convex piece, so it doesn't need to look at the collider's triangles.
+std::optional<ShapeCastHit> ShapeCast(const TransformComponent& transform, const ColliderComponent& collider, const Primitive& castShape, const glm::dvec3& direction, double maxDistance);
+
 // // Faster than IsColliding() because it only checks IF they are colliding, not HOW they are colliding.
 // bool TestCollision(
 //     const TransformComponent& transform1,
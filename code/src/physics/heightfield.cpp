@@ -0,0 +1,210 @@
+#include "heightfield.hpp"
+#include "gameobjects/transform_component.hpp"
+#include "debug/assert.hpp"
+#include <algorithm>
+#include <cmath>
+
+Heightfield::Heightfield(unsigned int heightfieldWidth, unsigned int heightfieldDepth):
+    width(heightfieldWidth),
+    depth(heightfieldDepth),
+    heights((heightfieldWidth + 2) * (heightfieldDepth + 2), HOLE),
+    minHeight(HOLE),
+    maxHeight(HOLE),
+    version(0)
+{
+    Assert(width > 0 && depth > 0);
+}
+
+unsigned int Heightfield::Width() const {
+    return width;
+}
+
+unsigned int Heightfield::Depth() const {
+    return depth;
+}
+
+float Heightfield::GetHeight(int x, int z) const {
+    if (x < -1 || z < -1 || x > (int)width || z > (int)depth) {
+        return HOLE;
+    }
+    return heights[(x + 1) * (depth + 2) + z + 1];
+}
+
+void Heightfield::SetHeight(int x, int z, float height) {
+    Assert(x >= -1 && z >= -1 && x <= (int)width && z <= (int)depth);
+    Assert(!std::isnan(height));
+
+    float& cell = heights[(x + 1) * (depth + 2) + z + 1];
+    if (cell == height) {
+        return;
+    }
+    float oldHeight = cell;
+    cell = height;
+    version++;
+
+    // the ring doesn't count towards the height range
+    if (x < 0 || z < 0 || x == (int)width || z == (int)depth) {
+        return;
+    }
+
+    // only have to look at every cell if this one was the lowest or highest
+    if (oldHeight != HOLE && (oldHeight == minHeight || oldHeight == maxHeight)) {
+        RecalculateHeightRange();
+    }
+    else if (height != HOLE) {
+        minHeight = maxHeight == HOLE ? height : std::min(minHeight, height);
+        maxHeight = std::max(maxHeight, height);
+    }
+}
+
+void Heightfield::RecalculateHeightRange() {
+    minHeight = HOLE;
+    maxHeight = HOLE;
+    for (unsigned int x = 0; x < width; x++) {
+        for (unsigned int z = 0; z < depth; z++) {
+            float height = heights[(x + 1) * (depth + 2) + z + 1];
+            if (height != HOLE) {
+                minHeight = maxHeight == HOLE ? height : std::min(minHeight, height);
+                maxHeight = std::max(maxHeight, height);
+            }
+        }
+    }
+}
+
+unsigned int Heightfield::Version() const {
+    return version;
+}
+
+AABB Heightfield::GetAABB(const TransformComponent& transform) const {
+    glm::dvec3 position = transform.Position();
+    glm::dvec3 scale = transform.Scale();
+    if (maxHeight == HOLE) {
+        return AABB(position, position); // nothing to collide with
+    }
+
+    return AABB(
+        glm::dvec3(position.x, position.y + minHeight * scale.y - AABB_DEPTH, position.z),
+        glm::dvec3(position.x + width * scale.x, position.y + maxHeight * scale.y, position.z + depth * scale.z)
+    );
+}
+
+AABB Heightfield::CellAABB(const TransformComponent& transform, int x, int z) const {
+    glm::dvec3 position = transform.Position();
+    glm::dvec3 scale = transform.Scale();
+    float height = GetHeight(x, z);
+    double bottom = maxHeight == HOLE ? position.y : position.y + minHeight * scale.y - AABB_DEPTH;
+    double top = height == HOLE ? bottom : std::max(bottom, position.y + height * scale.y);
+
+    return AABB(
+        glm::dvec3(position.x + x * scale.x, bottom, position.z + z * scale.z),
+        glm::dvec3(position.x + (x + 1) * scale.x, top, position.z + (z + 1) * scale.z)
+    );
+}
+
+bool Heightfield::CellRange(const TransformComponent& transform, const AABB& box, glm::ivec2& minCell, glm::ivec2& maxCell) const {
+    glm::dvec3 position = transform.Position();
+    glm::dvec3 scale = transform.Scale();
+
+    glm::dvec3 low = (box.min - position) / scale;
+    glm::dvec3 high = (box.max - position) / scale;
+    if (high.x < 0 || high.z < 0 || low.x >= width || low.z >= depth) {
+        return false;
+    }
+
+    minCell = glm::ivec2(std::max(0.0, std::floor(low.x)), std::max(0.0, std::floor(low.z)));
+    maxCell = glm::ivec2(std::min(width - 1.0, std::floor(high.x)), std::min(depth - 1.0, std::floor(high.z)));
+    return true;
+}
+
+// 2D DDA (see "A Fast Voxel Traversal Algorithm for Ray Tracing", Amanatides and Woo 1987), so the ray only looks at the cells it actually goes over, in order, and stops at the first thing it hits.
+double Heightfield::RayDistance(const TransformComponent& transform, const glm::dvec3& origin, const glm::dvec3& direction, double maxDistance, glm::dvec3& normal) const {
+    if (maxHeight == HOLE) {
+        return INFINITY;
+    }
+
+    // Put the ray in cell coordinates. The direction gets scaled too, so distances along it stay the same.
+    glm::dvec3 position = transform.Position();
+    glm::dvec3 scale = transform.Scale();
+    glm::dvec3 localOrigin = (origin - position) / scale;
+    glm::dvec3 localDirection = direction / scale;
+
+    // only the part of the ray that's over the heightfield matters
+    double start = 0, end = maxDistance;
+    glm::dvec3 entryNormal(0, 0, 0); // the outside of the side of the heightfield the ray comes in through, if it doesn't start over it
+    for (unsigned int axis = 0; axis < 3; axis += 2) {
+        double size = axis == 0 ? width : depth;
+        if (localDirection[axis] == 0) {
+            if (localOrigin[axis] < 0 || localOrigin[axis] >= size) {
+                return INFINITY;
+            }
+            continue;
+        }
+
+        double near = ((localDirection[axis] > 0 ? 0 : size) - localOrigin[axis]) / localDirection[axis];
+        double far = ((localDirection[axis] > 0 ? size : 0) - localOrigin[axis]) / localDirection[axis];
+        if (near > start) {
+            start = near;
+            entryNormal = glm::dvec3(0, 0, 0);
+            entryNormal[axis] = localDirection[axis] > 0 ? -1 : 1;
+        }
+        end = std::min(end, far);
+    }
+    if (start >= end) {
+        return INFINITY;
+    }
+
+    glm::dvec3 entry = localOrigin + localDirection * start;
+    glm::ivec2 cell(std::clamp((int)std::floor(entry.x), 0, (int)width - 1), std::clamp((int)std::floor(entry.z), 0, (int)depth - 1));
+    glm::ivec2 step(localDirection.x > 0 ? 1 : -1, localDirection.z > 0 ? 1 : -1);
+
+    // how far along the ray it crosses into the next cell on each axis, and how far it goes between crossings
+    double nextX = localDirection.x != 0 ? (cell.x + (step.x > 0 ? 1 : 0) - localOrigin.x) / localDirection.x : INFINITY;
+    double nextZ = localDirection.z != 0 ? (cell.y + (step.y > 0 ? 1 : 0) - localOrigin.z) / localDirection.z : INFINITY;
+    double deltaX = localDirection.x != 0 ? 1.0 / std::abs(localDirection.x) : INFINITY;
+    double deltaZ = localDirection.z != 0 ? 1.0 / std::abs(localDirection.z) : INFINITY;
+
+    double t = start;
+    glm::dvec3 sideNormal = entryNormal;
+    while (true) {
+        double enterY = localOrigin.y + localDirection.y * t;
+        if (localDirection.y >= 0 && enterY > maxHeight) {
+            return INFINITY; // above everything and not coming back down
+        }
+
+        double exit = std::min({nextX, nextZ, end});
+        float height = heights[(cell.x + 1) * (depth + 2) + cell.y + 1];
+        if (height != HOLE) {
+            if (enterY <= height && t > 0) { // came in through the column's side
+                normal = sideNormal;
+                return t;
+            }
+
+            double exitY = localOrigin.y + localDirection.y * exit;
+            if (enterY > height && exitY <= height) { // came down through its top
+                normal = glm::dvec3(0, 1, 0);
+                return (height - localOrigin.y) / localDirection.y;
+            }
+        }
+
+        if (exit >= end) {
+            return INFINITY;
+        }
+
+        if (nextX < nextZ) {
+            cell.x += step.x;
+            t = nextX;
+            nextX += deltaX;
+            sideNormal = glm::dvec3(-step.x, 0, 0);
+        }
+        else {
+            cell.y += step.y;
+            t = nextZ;
+            nextZ += deltaZ;
+            sideNormal = glm::dvec3(0, 0, -step.y);
+        }
+
+        if (cell.x < 0 || cell.y < 0 || cell.x >= (int)width || cell.y >= (int)depth) {
+            return INFINITY;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "aabb.hpp"
+#include <cmath>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+class TransformComponent;
+
+// A grid of flat-topped columns, for terrain. Colliders with ColliderShapeHeightfield collide as one of these instead of as a PhysicsMesh.
+// In the collider's local space, cell (x, z) covers x to x + 1 and z to z + 1, and its column goes from the cell's height all the way down.
+// The collider's transform moves that and scales it (x and z scale the cells, y scales the heights), but its rotation is ignored; heightfields are always level.
+// Cells can also be holes, which nothing collides with.
+// Finding a cell is just indexing an array and changing one doesn't rebuild anything, so it's cheap to keep a heightfield in sync with the terrain it's for.
+class Heightfield {
+    public:
+    // height of cells that are holes
+    static constexpr float HOLE = -INFINITY;
+
+    // The AABB goes this far (in world space) below the lowest cell. Nothing deeper in the terrain than that will collide with it.
+    static constexpr double AABB_DEPTH = 1.0;
+
+    // Every cell starts out as a hole.
+    Heightfield(unsigned int width, unsigned int depth);
+
+    unsigned int Width() const;
+    unsigned int Depth() const;
+
+    // The heightfield also remembers a ring of cells around its edge (x or z of -1, or width/depth), which nothing collides with.
+    // They're there so edge cells know whether the terrain keeps going past the edge (like into the next terrain chunk), since if it does at the same height the sides of the edge cells shouldn't push anything.
+    // Returns HOLE for cells outside of the ring.
+    float GetHeight(int x, int z) const;
+    void SetHeight(int x, int z, float height);
+
+    // Goes up every time SetHeight() changes something, so that anything remembering collisions with the heightfield (like the ContactCache) knows to forget them.
+    unsigned int Version() const;
+
+    // Returns the smallest AABB containing the tops of all the cells, plus AABB_DEPTH below them.
+    AABB GetAABB(const TransformComponent& transform) const;
+
+    // Returns the AABB of cell (x, z)'s column, from its top down to the bottom of GetAABB(). Holes have no height.
+    AABB CellAABB(const TransformComponent& transform, int x, int z) const;
+
+    // Finds the cells that the world space box is over, returning false if it isn't over any of them.
+    bool CellRange(const TransformComponent& transform, const AABB& box, glm::ivec2& minCell, glm::ivec2& maxCell) const;
+
+    // Marches a ray (in world space) through the cells it goes over, and returns how far along it (in multiples of direction) it hits the top or side of a column, or INFINITY if it doesn't before maxDistance.
+    // If it hits, normal is set to the normal of whatever it hit. Rays that start inside a column go right through it.
+    double RayDistance(const TransformComponent& transform, const glm::dvec3& origin, const glm::dvec3& direction, double maxDistance, glm::dvec3& normal) const;
+
+    private:
+    unsigned int width;
+    unsigned int depth;
+
+    // includes the ring, so (width + 2) * (depth + 2) of them; see GetHeight()
+    std::vector<float> heights;
+
+    // of the cells that aren't holes (not counting the ring), or HOLE if they're all holes
+    float minHeight;
+    float maxHeight;
+
+    unsigned int version;
+
+    void RecalculateHeightRange();
+};
@@ -1,9 +1,349 @@
-//#include "mesh_simplification/simplify.cpp"
-//#include <vector>
-//
-//// Declared in physics_mesh.cpp
-//void SimplifyMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, float threshold) {
-//    // Simplify::Vertex;
-//    // Simplify::vertices = vertices;
-//    Simplify::simplify_mesh(float(indices.size())/3.0f/threshold, 7);
-//}
\ No newline at end of file
+#include "mesh_simplification.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include "../utility/hash_glm.hpp"
+#include "glm/geometric.hpp"
+
+namespace {
+    struct HullFace {
+        std::array<unsigned int, 3> vertices; // indices into the points, counterclockwise from outside
+        glm::dvec3 normal; // faces out of the hull
+        double offset; // dot product of the normal with any point on the face
+
+        // points in front of this face that aren't in the hull yet, and which of them is farthest in front
+        std::vector<unsigned int> outside;
+        unsigned int farthestPoint;
+        double farthestDistance;
+
+        bool removed;
+    };
+
+    // directed edge from vertex a to vertex b
+    uint64_t EdgeKey(unsigned int a, unsigned int b) {
+        return (static_cast<uint64_t>(a) << 32) | b;
+    }
+
+    // Returns the triangles of the mesh's convex hull as planes (normal, offset), for measuring how far inside the hull points are.
+    std::vector<std::pair<glm::dvec3, double>> HullPlanes(const std::vector<std::array<glm::vec3, 3>>& hull) {
+        std::vector<std::pair<glm::dvec3, double>> planes;
+        planes.reserve(hull.size());
+        for (auto & triangle: hull) {
+            glm::dvec3 normal = glm::normalize(glm::cross(glm::dvec3(triangle[1] - triangle[0]), glm::dvec3(triangle[2] - triangle[0])));
+            planes.emplace_back(normal, glm::dot(normal, glm::dvec3(triangle[0])));
+        }
+        return planes;
+    }
+
+    // Returns the vertices of the triangles (with duplicates, ConvexHull() doesn't care).
+    std::vector<glm::vec3> VerticesOf(const std::vector<std::array<glm::vec3, 3>>& triangles) {
+        std::vector<glm::vec3> vertices;
+        vertices.reserve(triangles.size() * 3);
+        for (auto & triangle: triangles) {
+            vertices.insert(vertices.end(), triangle.begin(), triangle.end());
+        }
+        return vertices;
+    }
+
+    // How far inside their convex hull the deepest triangle (well, its center) is, which is 0 for a convex mesh.
+    // (Vertices don't work for this, since a concave mesh's vertices can all be on its hull; an L shaped prism's inside corner is on the hull's end caps, for example.)
+    double Concavity(const std::vector<std::array<glm::vec3, 3>>& triangles) {
+        auto hull = ConvexHull(VerticesOf(triangles));
+        if (hull.empty()) {
+            return 0; // flat, and so convex enough
+        }
+
+        auto planes = HullPlanes(hull);
+        double deepest = 0;
+        for (auto & triangle: triangles) {
+            glm::dvec3 center = (glm::dvec3(triangle[0]) + glm::dvec3(triangle[1]) + glm::dvec3(triangle[2])) / 3.0;
+            double depth = DBL_MAX;
+            for (auto & [normal, offset]: planes) {
+                depth = std::min(depth, offset - glm::dot(normal, center));
+            }
+            deepest = std::max(deepest, depth);
+        }
+        return deepest;
+    }
+}
+
+std::vector<std::array<glm::vec3, 3>> ConvexHull(const std::vector<glm::vec3>& inputPoints, unsigned int maxTriangles) {
+    // duplicate points would make degenerate faces
+    std::vector<glm::dvec3> points;
+    std::unordered_set<glm::vec3> seen;
+    for (auto & p: inputPoints) {
+        if (seen.insert(p).second) {
+            points.push_back(p);
+        }
+    }
+    if (points.size() < 4) {
+        return {};
+    }
+
+    // the index of the points with the smallest and largest x, y and z coordinates, in that order
+    std::array<unsigned int, 6> extremes = {0, 0, 0, 0, 0, 0};
+    for (unsigned int i = 1; i < points.size(); i++) {
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            if (points[i][axis] < points[extremes[axis * 2]][axis]) {
+                extremes[axis * 2] = i;
+            }
+            if (points[i][axis] > points[extremes[axis * 2 + 1]][axis]) {
+                extremes[axis * 2 + 1] = i;
+            }
+        }
+    }
+
+    // points less than this far in front of a face are treated as being on it, which is what merges coplanar points instead of making slivers out of them
+    glm::dvec3 size(points[extremes[1]].x - points[extremes[0]].x, points[extremes[3]].y - points[extremes[2]].y, points[extremes[5]].z - points[extremes[4]].z);
+    const double epsilon = glm::length(size) * 1.0e-6;
+
+    // Start with a tetrahedron that's as big as possible: the two extreme points that are farthest apart, the point farthest from the line between them, and the point farthest from the plane through those three.
+    unsigned int a = extremes[0], b = extremes[1];
+    for (auto i: extremes) {
+        for (auto j: extremes) {
+            if (glm::distance(points[i], points[j]) > glm::distance(points[a], points[b])) {
+                a = i;
+                b = j;
+            }
+        }
+    }
+
+    unsigned int c = 0;
+    double farthestFromLine = -1;
+    for (unsigned int i = 0; i < points.size(); i++) {
+        double distance = glm::length(glm::cross(points[i] - points[a], points[b] - points[a]));
+        if (distance > farthestFromLine) {
+            farthestFromLine = distance;
+            c = i;
+        }
+    }
+
+    unsigned int d = 0;
+    double farthestFromPlane = -1;
+    glm::dvec3 planeNormal = glm::cross(points[b] - points[a], points[c] - points[a]);
+    for (unsigned int i = 0; i < points.size(); i++) {
+        double distance = std::abs(glm::dot(planeNormal, points[i] - points[a]));
+        if (distance > farthestFromPlane) {
+            farthestFromPlane = distance;
+            d = i;
+        }
+    }
+
+    if (glm::distance(points[a], points[b]) <= epsilon || farthestFromLine <= epsilon * glm::distance(points[a], points[b]) || farthestFromPlane <= epsilon * glm::length(planeNormal)) {
+        return {}; // flat or worse
+    }
+
+    std::vector<HullFace> faces;
+    std::unordered_map<uint64_t, unsigned int> edgeFaces; // which face each directed edge belongs to, so that we can walk from a face to its neighbours
+
+    auto distanceInFront = [&points, &faces](unsigned int face, unsigned int point) {
+        return glm::dot(faces[face].normal, points[point]) - faces[face].offset;
+    };
+
+    auto addFace = [&points, &faces, &edgeFaces](unsigned int v0, unsigned int v1, unsigned int v2) {
+        glm::dvec3 normal = glm::normalize(glm::cross(points[v1] - points[v0], points[v2] - points[v0]));
+        faces.push_back(HullFace {.vertices = {v0, v1, v2}, .normal = normal, .offset = glm::dot(normal, points[v0]), .outside = {}, .farthestPoint = 0, .farthestDistance = 0, .removed = false});
+        unsigned int index = static_cast<unsigned int>(faces.size() - 1);
+        edgeFaces[EdgeKey(v0, v1)] = index;
+        edgeFaces[EdgeKey(v1, v2)] = index;
+        edgeFaces[EdgeKey(v2, v0)] = index;
+        return index;
+    };
+
+    // Gives the point to the first of the faces it's in front of, if any (if none, it's inside the hull and we can forget about it).
+    auto assignPoint = [&faces, &distanceInFront, epsilon](unsigned int point, const unsigned int* candidateFaces, unsigned int nCandidates) {
+        for (unsigned int i = 0; i < nCandidates; i++) {
+            unsigned int face = candidateFaces[i];
+            double distance = distanceInFront(face, point);
+            if (distance > epsilon) {
+                if (faces[face].outside.empty() || distance > faces[face].farthestDistance) {
+                    faces[face].farthestPoint = point;
+                    faces[face].farthestDistance = distance;
+                }
+                faces[face].outside.push_back(point);
+                return;
+            }
+        }
+    };
+
+    // wind each face of the tetrahedron so that its normal points away from the vertex that isn't on it
+    const std::array<std::array<unsigned int, 4>, 4> tetrahedronFaces = {{ {a, b, c, d}, {a, d, b, c}, {a, c, d, b}, {b, d, c, a} }};
+    for (auto [v0, v1, v2, opposite]: tetrahedronFaces) {
+        if (glm::dot(glm::cross(points[v1] - points[v0], points[v2] - points[v0]), points[opposite] - points[v0]) > 0) {
+            std::swap(v1, v2);
+        }
+        addFace(v0, v1, v2);
+    }
+
+    const std::array<unsigned int, 4> firstFaces = {0, 1, 2, 3};
+    for (unsigned int i = 0; i < points.size(); i++) {
+        if (i != a && i != b && i != c && i != d) {
+            assignPoint(i, firstFaces.data(), 4);
+        }
+    }
+
+    // a closed triangle mesh with V vertices has 2V - 4 triangles
+    const unsigned int maxVertices = maxTriangles == 0 ? UINT_MAX : std::max(4u, maxTriangles / 2 + 2);
+    unsigned int nVertices = 4; // might be more than the hull really has, if adding a point swallowed an old one
+
+    std::vector<unsigned int> visible;
+    std::vector<std::pair<unsigned int, unsigned int>> horizon;
+    std::vector<unsigned int> newFaces;
+    while (nVertices < maxVertices) {
+        // grow the hull towards the point that's farthest outside of it
+        unsigned int seedFace = UINT_MAX;
+        for (unsigned int f = 0; f < faces.size(); f++) {
+            if (!faces[f].removed && !faces[f].outside.empty() && (seedFace == UINT_MAX || faces[f].farthestDistance > faces[seedFace].farthestDistance)) {
+                seedFace = f;
+            }
+        }
+        if (seedFace == UINT_MAX) {
+            break; // every point is inside
+        }
+        unsigned int newPoint = faces[seedFace].farthestPoint;
+
+        // Flood out from that face to find every face the point can see. The edges between faces it can and can't see are the horizon, which gets connected to the new point.
+        // (Doing this by walking neighbours instead of testing every face keeps the visible faces in one piece, even when floating point error disagrees about faces that are nearly coplanar with the point.)
+        visible.clear();
+        horizon.clear();
+        visible.push_back(seedFace);
+        faces[seedFace].removed = true;
+        for (unsigned int i = 0; i < visible.size(); i++) {
+            auto vertices = faces[visible[i]].vertices;
+            for (unsigned int j = 0; j < 3; j++) {
+                unsigned int from = vertices[j];
+                unsigned int to = vertices[j == 2 ? 0 : j + 1];
+                unsigned int neighbour = edgeFaces.at(EdgeKey(to, from));
+                if (faces[neighbour].removed) {
+                    continue; // already visible
+                }
+                if (distanceInFront(neighbour, newPoint) > epsilon) {
+                    faces[neighbour].removed = true;
+                    visible.push_back(neighbour);
+                }
+                else {
+                    horizon.emplace_back(from, to);
+                }
+            }
+        }
+
+        for (auto f: visible) {
+            auto vertices = faces[f].vertices;
+            for (unsigned int j = 0; j < 3; j++) {
+                unsigned int from = vertices[j];
+                unsigned int to = vertices[j == 2 ? 0 : j + 1];
+                auto it = edgeFaces.find(EdgeKey(from, to));
+                if (it != edgeFaces.end() && it->second == f) {
+                    edgeFaces.erase(it);
+                }
+            }
+        }
+
+        // the horizon edges keep the direction they had in the visible faces, so these new faces are wound the same way
+        newFaces.clear();
+        for (auto [from, to]: horizon) {
+            newFaces.push_back(addFace(from, to, newPoint));
+        }
+
+        // the points outside the removed faces are either outside a new face or inside the hull now
+        for (auto f: visible) {
+            for (auto point: faces[f].outside) {
+                if (point != newPoint) {
+                    assignPoint(point, newFaces.data(), static_cast<unsigned int>(newFaces.size()));
+                }
+            }
+            faces[f].outside.clear();
+            faces[f].outside.shrink_to_fit();
+        }
+
+        nVertices++;
+    }
+
+    std::vector<std::array<glm::vec3, 3>> triangles;
+    for (auto & face: faces) {
+        if (!face.removed) {
+            triangles.push_back({glm::vec3(points[face.vertices[0]]), glm::vec3(points[face.vertices[1]]), glm::vec3(points[face.vertices[2]])});
+        }
+    }
+    return triangles;
+}
+
+std::vector<std::vector<glm::vec3>> ApproximateConvexDecomposition(const std::vector<std::array<glm::vec3, 3>>& triangles) {
+    struct Piece {
+        std::vector<std::array<glm::vec3, 3>> triangles;
+        double concavity;
+        bool splittable; // false once we've found that every way of splitting the piece leaves one side empty
+    };
+
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (auto & triangle: triangles) {
+        for (auto & v: triangle) {
+            min = glm::min(min, v);
+            max = glm::max(max, v);
+        }
+    }
+    const double tolerance = CONVEX_DECOMPOSITION_TOLERANCE * glm::length(glm::dvec3(max - min));
+
+    std::vector<Piece> pieces;
+    pieces.push_back(Piece {.triangles = triangles, .concavity = Concavity(triangles), .splittable = true});
+
+    while (pieces.size() < MAX_CONVEX_PIECES) {
+        // split the least convex piece
+        Piece* worst = nullptr;
+        for (auto & piece: pieces) {
+            if (piece.splittable && piece.concavity > tolerance && (worst == nullptr || piece.concavity > worst->concavity)) {
+                worst = &piece;
+            }
+        }
+        if (worst == nullptr) {
+            break;
+        }
+
+        // Try cutting across each axis through the average of the triangles' centers (triangles go to whichever side their center is on), and keep whichever cut leaves the most convex pieces.
+        std::vector<std::array<glm::vec3, 3>> bestSides[2];
+        double bestConcavities[2] = {DBL_MAX, DBL_MAX};
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            double average = 0;
+            for (auto & triangle: worst->triangles) {
+                average += (triangle[0][axis] + triangle[1][axis] + triangle[2][axis]) / 3.0;
+            }
+            average /= worst->triangles.size();
+
+            std::vector<std::array<glm::vec3, 3>> sides[2];
+            for (auto & triangle: worst->triangles) {
+                double center = (triangle[0][axis] + triangle[1][axis] + triangle[2][axis]) / 3.0;
+                sides[center < average ? 0 : 1].push_back(triangle);
+            }
+            if (sides[0].empty() || sides[1].empty()) {
+                continue;
+            }
+
+            double concavities[2] = {Concavity(sides[0]), Concavity(sides[1])};
+            if (std::max(concavities[0], concavities[1]) < std::max(bestConcavities[0], bestConcavities[1])) {
+                for (unsigned int side = 0; side < 2; side++) {
+                    bestSides[side] = std::move(sides[side]);
+                    bestConcavities[side] = concavities[side];
+                }
+            }
+        }
+
+        if (bestSides[0].empty()) {
+            worst->splittable = false;
+            continue;
+        }
+
+        *worst = Piece {.triangles = std::move(bestSides[0]), .concavity = bestConcavities[0], .splittable = true};
+        pieces.push_back(Piece {.triangles = std::move(bestSides[1]), .concavity = bestConcavities[1], .splittable = true});
+    }
+
+    std::vector<std::vector<glm::vec3>> pieceVertices;
+    for (auto & piece: pieces) {
+        pieceVertices.push_back(VerticesOf(piece.triangles));
+    }
+    return pieceVertices;
+}
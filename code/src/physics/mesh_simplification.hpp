@@ -0,0 +1,19 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <glm/vec3.hpp>
+
+// Convex decomposition keeps splitting a mesh until every piece is within this fraction of the mesh's size (the diagonal of its AABB) of being convex...
+static const inline double CONVEX_DECOMPOSITION_TOLERANCE = 0.02;
+// ...or until there are this many pieces, since every piece of one object gets tested against every piece of another.
+static const inline unsigned int MAX_CONVEX_PIECES = 16;
+
+// Returns the triangles of the convex hull of the given points, wound counterclockwise when looking at them from outside the hull, using quickhull (https://www.researchgate.net/publication/2641780_The_Quickhull_Algorithm_for_Convex_Hulls).
+// If maxTriangles isn't 0, the hull will have at most (about) that many triangles. Quickhull always grows the hull by the point that's farthest outside it,
+    // so stopping early gives the hull that's closest to the real one for its size (and it's always inside the real one).
+// Returns no triangles if the points are all (nearly) on one plane, since then there's no hull.
+std::vector<std::array<glm::vec3, 3>> ConvexHull(const std::vector<glm::vec3>& points, unsigned int maxTriangles = 0);
+
+// Splits a (possibly concave) triangle mesh into pieces whose convex hulls are close to it, and returns the vertices of each piece.
+// It's approximate: the piece that's farthest from its convex hull gets cut in half by an axis aligned plane until they're all close enough to convex (see CONVEX_DECOMPOSITION_TOLERANCE) or there are MAX_CONVEX_PIECES pieces.
+std::vector<std::vector<glm::vec3>> ApproximateConvexDecomposition(const std::vector<std::array<glm::vec3, 3>>& triangles);
@@ -5,6 +5,7 @@
 #include "spatial_acceleration_structure.hpp"
 #include "../gameobjects/gameobject.hpp"
 #include "debug/assert.hpp"
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <memory>
@@ -12,6 +13,7 @@
 #include <vector>
 #include "pengine.hpp"
 #include "gjk.hpp"
+#include "utility/thread_pool.hpp"
 #include "glm/gtx/string_cast.hpp"
 
 
@@ -56,253 +58,324 @@ PhysicsEngine& PhysicsEngine::Get() {
     #endif
 }
 
-// Simulates physics of a single rigidbody.
-void DoPhysics(const double dt, ColliderComponent& collider, TransformComponent& transform, RigidbodyComponent& rigidbody, std::vector<std::pair<TransformComponent*, glm::dvec3>>& seperations) {    
-    if (rigidbody.InverseMass() == 0) {
-        return; // infinite mass = collisions/forces ain't doing nothing to this
-    }
+// Resolves a collision (found by IsColliding()) for one of the two colliding objects, by pushing it out of the other object and applying collision and friction impulses to its rigidbody.
+// normal should face out of the other object towards this one.
+// Doesn't do anything to the other object; if it has a rigidbody that needs resolving too, call this again with the objects swapped and the normal flipped.
+// Only changes the rigidbody's accumulated force/torque and adds to seperations, so the order collisions are resolved in doesn't matter.
+void ResolveCollision(ColliderComponent& collider, TransformComponent& transform, RigidbodyComponent& rigidbody, const ColliderComponent& otherCollider, const TransformComponent& otherTransform, const RigidbodyComponent* otherRigidbody, glm::vec3 normal, const CollisionInfo& collision, std::vector<std::pair<TransformComponent*, glm::dvec3>>& seperations) {
+    // if (otherRigidbody && collisionTestResult->contactPoints.size() > 4) {
+    //     DebugLogInfo("Collision with ", collisionTestResult->contactPoints.size(), " points.");
+        // for (auto & p: collisionTestResult->contactPoints) {
+        //     averageContactPoint += p.first;
+        //     averagePenetration += p.second;
+            // DebugPlacePointOnPosition({p.first}, {0.5, 0.0, 0.0, 1.0});
+        // }
+    // }
+    // find center of contact region
+    // glm::dvec3 averageContactPoint = {0, 0, 0}; // in object space
+    // double averagePenetration = 0;
     
-    // TODO: should REALLY use tight fitting AABB here
-    auto aabbToTest = collider.GetAABB();
-    std::vector<ColliderComponent*> potentialColliding = SpatialAccelerationStructure::Get().Query(aabbToTest, PhysicsEngine::Get().GetCollisionLayerMatrix()[collider.GetCollisionLayer()]);
-    // Assert(potentialColliding.size() == 0);
+    // averageContactPoint /= collisionTestResult->contactPoints.size();
+    // averagePenetration /= collisionTestResult->contactPoints.size();
 
-    // TODO: potential perf gains by using tight fitting AABB/OBB here after broadphase SAS query?
+    // glm::vec3 normal = -collisionTestResult->collisionNormal; // normal faces out of the first object towards the other object
     
-    // we don't do anything to the other gameobjects we hit; if they have a rigidbody, they will independently take care of that in their call to DoPhysics()
-    // TODO: this does mean redundant narrowphase collision checks, we should cache results of narrowphase checks to avoid that
-    for (auto & otherColliderPtr: potentialColliding) {
-        if (otherColliderPtr == &collider) {continue;} // collider shouldn't collide with itself lol
-        
-        auto collisionTestResult = IsColliding(*otherColliderPtr->gameobject->RawGet<TransformComponent>(), *otherColliderPtr, transform, collider);
-        if (collisionTestResult) {
 
-            
-            const RigidbodyComponent* otherRigidbody = otherColliderPtr->gameobject->MaybeRawGet<RigidbodyComponent>(); // might be nullptr
-            const TransformComponent* otherTransform = otherColliderPtr->gameobject->RawGet<TransformComponent>();
-
-            Assert(collisionTestResult->contactPoints.size() > 0);
-            // if (otherRigidbody && collisionTestResult->contactPoints.size() > 4) {
-            //     DebugLogInfo("Collision with ", collisionTestResult->contactPoints.size(), " points.");
-                // for (auto & p: collisionTestResult->contactPoints) {
-                //     averageContactPoint += p.first;
-                //     averagePenetration += p.second;
-                    // DebugPlacePointOnPosition({p.first}, {0.5, 0.0, 0.0, 1.0});
-                // }
-            // }
-            // find center of contact region
-            // glm::dvec3 averageContactPoint = {0, 0, 0}; // in object space
-            // double averagePenetration = 0;
-            
-            // averageContactPoint /= collisionTestResult->contactPoints.size();
-            // averagePenetration /= collisionTestResult->contactPoints.size();
+    // collision impulse-based response stolen from https://physics.stackexchange.com/questions/686640/resolving-angular-components-in-2d-circular-rigid-body-collision-response
+    // and this https://physics.stackexchange.com/questions/743172/simulating-rigid-body-collisions-in-3d
+    // also this source looks useful https://gafferongames.com/post/collision_response_and_coulomb_friction/
+    // and this https://gamedev.stackexchange.com/questions/131219/rigid-body-physics-resolution-causing-never-ending-bouncing-and-jittering?rq=1
+    // http://www.chrishecker.com/Rigid_Body_Dynamics
+    // https://graphics.stanford.edu/papers/rigid_bodies-sig03/rigid_bodies.pdf
+    // this engine implementation seems simple and does similar stuff to us https://github.com/NathanMacLeod/physics3D/blob/master/Physics/PhysicsEngine.cpp#L71
 
-            // glm::vec3 normal = -collisionTestResult->collisionNormal; // normal faces out of the first object towards the other object
-            
+    
 
-            // collision impulse-based response stolen from https://physics.stackexchange.com/questions/686640/resolving-angular-components-in-2d-circular-rigid-body-collision-response
-            // and this https://physics.stackexchange.com/questions/743172/simulating-rigid-body-collisions-in-3d
-            // also this source looks useful https://gafferongames.com/post/collision_response_and_coulomb_friction/
-            // and this https://gamedev.stackexchange.com/questions/131219/rigid-body-physics-resolution-causing-never-ending-bouncing-and-jittering?rq=1
-            // http://www.chrishecker.com/Rigid_Body_Dynamics
-            // https://graphics.stanford.edu/papers/rigid_bodies-sig03/rigid_bodies.pdf
-            // this engine implementation seems simple and does similar stuff to us https://github.com/NathanMacLeod/physics3D/blob/master/Physics/PhysicsEngine.cpp#L71
 
-            
+    for (auto & p: collision.contactPoints) {
 
-            glm::vec3 normal = collisionTestResult->collisionNormal;
+        // seperate colliding objects
+        const double LINEAR_SLOP = 0.0;
+        float seperation = std::max(0.0, p.second - LINEAR_SLOP); 
+            // DebugPlacePointOnPosition({transform.Position() + seperationVector}, {1, 0.2, 0.2, 1.0});
+        if (otherRigidbody) { seperation /= 2;}
+        seperations.emplace_back(std::make_pair(&transform, normal * (seperation / collision.contactPoints.size())));
 
-            for (auto & p: collisionTestResult->contactPoints) {
+        glm::vec3 d1 = (transform.Position() - p.first); // contact to pos    
+        glm::vec3 d2 = (otherTransform.Position() - p.first); // contact to otherPos
+
+        glm::vec3 relVelocity = glm::vec3(rigidbody.velocity) + glm::cross(d1, rigidbody.angularVelocity);
+        if (otherRigidbody) {
+            relVelocity -= glm::vec3(otherRigidbody->velocity) + glm::cross(d2, otherRigidbody->angularVelocity);
+        }
+        float relVelocityAlongNormal = glm::dot(normal, relVelocity);
 
-                // seperate colliding objects
-                const double LINEAR_SLOP = 0.0;
-                float seperation = std::max(0.0, p.second - LINEAR_SLOP); 
-                    // DebugPlacePointOnPosition({transform.Position() + seperationVector}, {1, 0.2, 0.2, 1.0});
-                if (otherRigidbody) { seperation /= 2;}
-                seperations.emplace_back(std::make_pair(&transform, normal * (seperation / collisionTestResult->contactPoints.size())));
+        if (relVelocityAlongNormal > 0) {
+            continue;
+        }
 
-                glm::vec3 d1 = (transform.Position() - p.first); // contact to pos    
-                glm::vec3 d2 = (otherTransform->Position() - p.first); // contact to otherPos
+       
 
-                glm::vec3 relVelocity = glm::vec3(rigidbody.velocity) + glm::cross(d1, rigidbody.angularVelocity);
-                if (otherRigidbody) {
-                    relVelocity -= glm::vec3(otherRigidbody->velocity) + glm::cross(d2, otherRigidbody->angularVelocity);
-                }
-                float relVelocityAlongNormal = glm::dot(normal, relVelocity);
+        // collision impulse
+        glm::vec3 collisionResolutionImpulse;
+        {
+            
+            glm::vec3 torqueAxis1 = glm::cross(normal, d1); // rCLdeXn ; axis around which torque is applied
+            // DebugLogInfo("AXIS ", glm::to_string(torqueAxis1), " NORMAL ", glm::to_string(normal), " d1 ", glm::to_string(d1));
+
+            float inverseMomentOfInertiaAroundAxis1 = 0; // if collision angle is directly perpendicular torque doesn't happen, gonna get divide by zero problems
+            if (glm::length2(torqueAxis1) >= FLT_EPSILON) {
+                // DebugLogInfo("\tNORMALIZING ", glm::to_string(torqueAxis1), glm::length2(torqueAxis1));
+                torqueAxis1 = glm::normalize(torqueAxis1);
+                // DebugLogInfo("\tNORMALIZED TO ", glm::to_string(torqueAxis1));
+                inverseMomentOfInertiaAroundAxis1 = rigidbody.InverseMomentOfInertiaAroundAxis(transform, torqueAxis1);
+                // DebugLogInfo("\tGOT MOMENT ", inverseMomentOfInertiaAroundAxis1)
+            }
+            
+    
+            float reducedMass = rigidbody.InverseMass() + glm::length2(torqueAxis1) * inverseMomentOfInertiaAroundAxis1;
+            
+            if (otherRigidbody) {
 
-                if (relVelocityAlongNormal > 0) {
-                    continue;
+                glm::vec3 torqueAxis2 = glm::cross(normal, d2); // rCLdrXn ; -1 * axis around which torque is applied
+                
+                float inverseMomentOfInertiaAroundAxis2 = 0; // if collision angle is directly perpendicular torque obvi irrelevant
+                if (glm::length2(torqueAxis2) >= FLT_EPSILON) {
+                    torqueAxis2= glm::normalize(torqueAxis2);
+                    inverseMomentOfInertiaAroundAxis2 = otherRigidbody->InverseMomentOfInertiaAroundAxis(otherTransform, torqueAxis2);
                 }
+                
+                reducedMass += otherRigidbody->InverseMass() + glm::length2(torqueAxis2) * inverseMomentOfInertiaAroundAxis2;
 
-               
-
-                // collision impulse
-                glm::vec3 collisionResolutionImpulse;
-                {
-                    
-                    glm::vec3 torqueAxis1 = glm::cross(normal, d1); // rCLdeXn ; axis around which torque is applied
-                    // DebugLogInfo("AXIS ", glm::to_string(torqueAxis1), " NORMAL ", glm::to_string(normal), " d1 ", glm::to_string(d1));
-
-                    float inverseMomentOfInertiaAroundAxis1 = 0; // if collision angle is directly perpendicular torque doesn't happen, gonna get divide by zero problems
-                    if (glm::length2(torqueAxis1) >= FLT_EPSILON) {
-                        // DebugLogInfo("\tNORMALIZING ", glm::to_string(torqueAxis1), glm::length2(torqueAxis1));
-                        torqueAxis1 = glm::normalize(torqueAxis1);
-                        // DebugLogInfo("\tNORMALIZED TO ", glm::to_string(torqueAxis1));
-                        inverseMomentOfInertiaAroundAxis1 = rigidbody.InverseMomentOfInertiaAroundAxis(transform, torqueAxis1);
-                        // DebugLogInfo("\tGOT MOMENT ", inverseMomentOfInertiaAroundAxis1)
-                    }
-                    
+            }
             
-                    float reducedMass = rigidbody.InverseMass() + glm::length2(torqueAxis1) * inverseMomentOfInertiaAroundAxis1;
-                    
-                    if (otherRigidbody) {
-
-                        glm::vec3 torqueAxis2 = glm::cross(normal, d2); // rCLdrXn ; -1 * axis around which torque is applied
-                        
-                        float inverseMomentOfInertiaAroundAxis2 = 0; // if collision angle is directly perpendicular torque obvi irrelevant
-                        if (glm::length2(torqueAxis2) >= FLT_EPSILON) {
-                            torqueAxis2= glm::normalize(torqueAxis2);
-                            inverseMomentOfInertiaAroundAxis2 = otherRigidbody->InverseMomentOfInertiaAroundAxis(*otherTransform, torqueAxis2);
-                        }
-                        
-                        reducedMass += otherRigidbody->InverseMass() + glm::length2(torqueAxis2) * inverseMomentOfInertiaAroundAxis2;
+            reducedMass = 1.0f/reducedMass;
+
+            // float reducedMass = rigidbody.InverseMass() + glm::dot(nxd1, rigidbody.GetInverseGlobalMomentOfInertia(transform) * nxd1);
+            // if (otherRigidbody) {
+            //     reducedMass += otherRigidbody->InverseMass() + glm::dot(nxd2, rigidbody.GetInverseGlobalMomentOfInertia(otherTransform) * nxd2);
+            // }
+            // reducedMass = 1.0 / reducedMass;
+            // if (reducedMass > rigidbody.InverseMass()) {
+                // DebugLogError("Calculated reduced contact mass of ", reducedMass, " (1/", 1.0/reducedMass , "). n = ", glm::to_string(normal), " d1 = ", glm::to_string(d1), " nxd1 = ", glm::to_string(torqueAxis1));
+            // }
+
+            // Assert(reducedMass <= rigidbody.InverseMass());
+
         
-                    }
-                    
-                    reducedMass = 1.0f/reducedMass;
+            float elasticity = otherCollider.elasticity * collider.elasticity;
+            float elasticityTerm = -(1 + elasticity);
+            
+            float impulse = abs(elasticityTerm * relVelocityAlongNormal * reducedMass);
 
-                    // float reducedMass = rigidbody.InverseMass() + glm::dot(nxd1, rigidbody.GetInverseGlobalMomentOfInertia(transform) * nxd1);
-                    // if (otherRigidbody) {
-                    //     reducedMass += otherRigidbody->InverseMass() + glm::dot(nxd2, rigidbody.GetInverseGlobalMomentOfInertia(*otherTransform) * nxd2);
-                    // }
-                    // reducedMass = 1.0 / reducedMass;
-                    // if (reducedMass > rigidbody.InverseMass()) {
-                        // DebugLogError("Calculated reduced contact mass of ", reducedMass, " (1/", 1.0/reducedMass , "). n = ", glm::to_string(normal), " d1 = ", glm::to_string(d1), " nxd1 = ", glm::to_string(torqueAxis1));
-                    // }
+            // impulse is only infinite if the object has infinite mass, in which case it just can't move. (and we shouldn't try to hit it with an infinite force to make it move)
+            Assert(!std::isinf(impulse));
 
-                    // Assert(reducedMass <= rigidbody.InverseMass());
+            collisionResolutionImpulse = normal * impulse;
+            // rigidbody.accumulatedForce += collisionResolutionImpulse;
+            // DebugLogInfo("Resolving collision with force ", glm::to_string(collisionResolutionImpulse), " applied at ", glm::to_string(-d1));
+            rigidbody.Impulse(-d1, collisionResolutionImpulse);
+            // DebugLogInfo("Torque axs is ", glm::to_string(torqueAxis1), " normal ", glm::to_string(normal), " d1 ", glm::to_string(d1), " crossing those gives ", glm::to_string(glm::cross(normal, d1)));
+            // rigidbody.accumulatedTorque += torqueAxis1 * impulse;
+            
+        }
 
-                
-                    float elasticity = otherColliderPtr->elasticity * collider.elasticity;
-                    float elasticityTerm = -(1 + elasticity);
-                    
-                    float impulse = abs(elasticityTerm * relVelocityAlongNormal * reducedMass);
-
-                    // impulse is only infinite if the object has infinite mass, in which case it just can't move. (and we shouldn't try to hit it with an infinite force to make it move)
-                    Assert(!std::isinf(impulse));
-
-                    collisionResolutionImpulse = normal * impulse;
-                    // rigidbody.accumulatedForce += collisionResolutionImpulse;
-                    // DebugLogInfo("Resolving collision with force ", glm::to_string(collisionResolutionImpulse), " applied at ", glm::to_string(-d1));
-                    rigidbody.Impulse(-d1, collisionResolutionImpulse);
-                    // DebugLogInfo("Torque axs is ", glm::to_string(torqueAxis1), " normal ", glm::to_string(normal), " d1 ", glm::to_string(d1), " crossing those gives ", glm::to_string(glm::cross(normal, d1)));
-                    // rigidbody.accumulatedTorque += torqueAxis1 * impulse;
-                    
+        // friction impulse #3: electric boogalee
+        {
+            glm::vec3 tangentVelocity = relVelocity - (normal * relVelocityAlongNormal);
+            if (glm::length2(tangentVelocity) != 0) {
+                // DebugLogInfo("Tangent V = ", glm::to_string(tangentVelocity), ", relV = ", glm::to_string(relVelocity), ", along normal = ", glm::to_string(normal * relVelocityAlongNormal));
+                glm::vec3 tangentDirection = glm::normalize(tangentVelocity);
+
+                glm::vec3 torqueAxis1 = glm::cross(tangentDirection, d1);
+                float inverseMomentOfInertiaAroundAxis1 = rigidbody.InverseMomentOfInertiaAroundAxis(transform, torqueAxis1);
+                glm::vec3 txd1 = glm::cross(torqueAxis1, tangentDirection);
+                float reducedMass = rigidbody.InverseMass() + glm::length2(txd1) * inverseMomentOfInertiaAroundAxis1;
+
+                if (otherRigidbody) {
+                    glm::vec3 torqueAxis2 = glm::cross(tangentDirection, d2);
+                    float inverseMomentOfInertiaAroundAxis2 = otherRigidbody->InverseMomentOfInertiaAroundAxis(otherTransform, torqueAxis2);
+                    glm::vec3 txd2 = glm::cross(torqueAxis2, tangentDirection);
+                    reducedMass += otherRigidbody->InverseMass() + glm::length2(txd2) * inverseMomentOfInertiaAroundAxis2;
                 }
 
-                // friction impulse #3: electric boogalee
-                {
-                    glm::vec3 tangentVelocity = relVelocity - (normal * relVelocityAlongNormal);
-                    if (glm::length2(tangentVelocity) != 0) {
-                        // DebugLogInfo("Tangent V = ", glm::to_string(tangentVelocity), ", relV = ", glm::to_string(relVelocity), ", along normal = ", glm::to_string(normal * relVelocityAlongNormal));
-                        glm::vec3 tangentDirection = glm::normalize(tangentVelocity);
-
-                        glm::vec3 torqueAxis1 = glm::cross(tangentDirection, d1);
-                        float inverseMomentOfInertiaAroundAxis1 = rigidbody.InverseMomentOfInertiaAroundAxis(transform, torqueAxis1);
-                        glm::vec3 txd1 = glm::cross(torqueAxis1, tangentDirection);
-                        float reducedMass = rigidbody.InverseMass() + glm::length2(txd1) * inverseMomentOfInertiaAroundAxis1;
-
-                        if (otherRigidbody) {
-                            glm::vec3 torqueAxis2 = glm::cross(tangentDirection, d2);
-                            float inverseMomentOfInertiaAroundAxis2 = otherRigidbody->InverseMomentOfInertiaAroundAxis(*otherTransform, torqueAxis2);
-                            glm::vec3 txd2 = glm::cross(torqueAxis2, tangentDirection);
-                            reducedMass += otherRigidbody->InverseMass() + glm::length2(txd2) * inverseMomentOfInertiaAroundAxis2;
-                        }
-
-                        reducedMass = 1.0f/reducedMass;
-                        // if (reducedMass > rigidbody.InverseMass()) {
-                        //     DebugLogError("Calculated reduced contact mass of ", reducedMass, " (1/", 1.0/reducedMass , "). n = ", glm::to_string(normal), " d1 = ", glm::to_string(d1), " nxd1 = ", glm::to_string(torqueAxis1));
-                        // }
-
-                        // this is the impulse that would completely halt the objects.
-                        float impulse =  abs(glm::dot(tangentDirection, relVelocity) * reducedMass);
-                        
-                        float friction = otherColliderPtr->friction * collider.friction;
-                        float maxPossibleImpulse = glm::length(collisionResolutionImpulse) * friction;
-                        if (maxPossibleImpulse < impulse) {
-                            impulse = maxPossibleImpulse;
-                        }
-
-                        rigidbody.Impulse(-d1, -tangentDirection * impulse);
-                    }
+                reducedMass = 1.0f/reducedMass;
+                // if (reducedMass > rigidbody.InverseMass()) {
+                //     DebugLogError("Calculated reduced contact mass of ", reducedMass, " (1/", 1.0/reducedMass , "). n = ", glm::to_string(normal), " d1 = ", glm::to_string(d1), " nxd1 = ", glm::to_string(torqueAxis1));
+                // }
+
+                // this is the impulse that would completely halt the objects.
+                float impulse =  abs(glm::dot(tangentDirection, relVelocity) * reducedMass);
+                
+                float friction = otherCollider.friction * collider.friction;
+                float maxPossibleImpulse = glm::length(collisionResolutionImpulse) * friction;
+                if (maxPossibleImpulse < impulse) {
+                    impulse = maxPossibleImpulse;
                 }
+
+                rigidbody.Impulse(-d1, -tangentDirection * impulse);
             }
+        }
+    }
+
+    // DebugPlacePointOnPosition({averageContactPoint}, {0.2, 0.2, 1.0, 1.0});
 
-            // DebugPlacePointOnPosition({averageContactPoint}, {0.2, 0.2, 1.0, 1.0});
     
-            
 
-            // friction impulse
-            // {
-            //     float friction = otherColliderPtr->friction * collider.friction;
-            //     glm::vec3 relVelocityAlongPlane = glm::vec3(glm::vec3(rigidbody.velocity) + glm::cross(d1, rigidbody.angularVelocity)) - (normal * relVelocityAlongNormal);
-            //     if (glm::length(relVelocityAlongPlane) != 0) {
-            //         glm::vec3 tangent = glm::normalize(relVelocityAlongPlane);
+    // friction impulse
+    // {
+    //     float friction = otherCollider.friction * collider.friction;
+    //     glm::vec3 relVelocityAlongPlane = glm::vec3(glm::vec3(rigidbody.velocity) + glm::cross(d1, rigidbody.angularVelocity)) - (normal * relVelocityAlongNormal);
+    //     if (glm::length(relVelocityAlongPlane) != 0) {
+    //         glm::vec3 tangent = glm::normalize(relVelocityAlongPlane);
 
-            //         glm::vec3 txd1 = glm::cross(tangent, d1);
-            //         // glm::vec3 txd2 = glm::cross(tangent, d2);
+    //         glm::vec3 txd1 = glm::cross(tangent, d1);
+    //         // glm::vec3 txd2 = glm::cross(tangent, d2);
+
+    //         // float reducedMass = 1.0 / (rigidbody.InverseMass() + glm::dot(txd1, rigidbody.GetInverseGlobalMomentOfInertia(transform) * txd1));
+    //         // if (reducedMass > rigidbody.InverseMass()) {
+    //         //     DebugLogError("Calculated reduced friction mass of ", reducedMass, " (1/", 1.0/reducedMass , "). t = ", glm::to_string(tangent), " d1 = ", glm::to_string(d1), " txd1 = ", glm::to_string(txd1), " mmoi*txd1 = ", glm::to_string(rigidbody.GetInverseGlobalMomentOfInertia(transform) * txd1), " dotting that yields ", glm::dot(txd1, rigidbody.GetInverseGlobalMomentOfInertia(transform) * txd1));
+    //         // }
+            
+    //         float frictionImpulse = friction * reducedMass;
+
+    //         // check if friction is strong enough to reverse the object's speed and if so, set speed to 0 instead so we don't start going backwards due to friction
+    //         if (glm::length(relVelocityAlongPlane) < frictionImpulse * rigidbody.InverseMass()) {
+    //             DebugLogInfo("Friction totally stopped the object.");
+    //             rigidbody.accumulatedForce += -relVelocityAlongPlane / rigidbody.InverseMass();
+    //         }
+    //         else {
+    //             DebugLogInfo("Applying force with tangent ", glm::to_string(tangent), " and friction impulse ", frictionImpulse, ". Rel. tangent velocity was ", glm::to_string(relVelocityAlongPlane), " torque axis ", glm::to_string(glm::cross(d1, tangent)));
+    //             rigidbody.accumulatedForce -= tangent * frictionImpulse;
+    //             rigidbody.accumulatedTorque -= glm::cross(normal, tangent) * frictionImpulse;
+    //         }
+
+            
+    //     }
         
-            //         // float reducedMass = 1.0 / (rigidbody.InverseMass() + glm::dot(txd1, rigidbody.GetInverseGlobalMomentOfInertia(transform) * txd1));
-            //         // if (reducedMass > rigidbody.InverseMass()) {
-            //         //     DebugLogError("Calculated reduced friction mass of ", reducedMass, " (1/", 1.0/reducedMass , "). t = ", glm::to_string(tangent), " d1 = ", glm::to_string(d1), " txd1 = ", glm::to_string(txd1), " mmoi*txd1 = ", glm::to_string(rigidbody.GetInverseGlobalMomentOfInertia(transform) * txd1), " dotting that yields ", glm::dot(txd1, rigidbody.GetInverseGlobalMomentOfInertia(transform) * txd1));
-            //         // }
-                    
-            //         float frictionImpulse = friction * reducedMass;
-
-            //         // check if friction is strong enough to reverse the object's speed and if so, set speed to 0 instead so we don't start going backwards due to friction
-            //         if (glm::length(relVelocityAlongPlane) < frictionImpulse * rigidbody.InverseMass()) {
-            //             DebugLogInfo("Friction totally stopped the object.");
-            //             rigidbody.accumulatedForce += -relVelocityAlongPlane / rigidbody.InverseMass();
-            //         }
-            //         else {
-            //             DebugLogInfo("Applying force with tangent ", glm::to_string(tangent), " and friction impulse ", frictionImpulse, ". Rel. tangent velocity was ", glm::to_string(relVelocityAlongPlane), " torque axis ", glm::to_string(glm::cross(d1, tangent)));
-            //             rigidbody.accumulatedForce -= tangent * frictionImpulse;
-            //             rigidbody.accumulatedTorque -= glm::cross(normal, tangent) * frictionImpulse;
-            //         }
-
-                    
-            //     }
-                
-                
-            // // }
-            // // std::cout << "Accumulated force is now " << glm::to_string(rigidbody.accumulatedForce) << ". Impulse is " << impulse << ". Reduced mass is " << reducedMass << ".\n";
-            // }
+        
+    // // }
+    // // std::cout << "Accumulated force is now " << glm::to_string(rigidbody.accumulatedForce) << ". Impulse is " << impulse << ". Reduced mass is " << reducedMass << ".\n";
+    // }
+
+    // FRICTION
+    // glm::vec3 relVelocityAlongPlane =  relVelocity + (normal * relVelocityAlongContactNormal);
+    // if (glm::length(relVelocityAlongPlane) > 0) {
+    //     auto tangentDirection = glm::normalize(relVelocityAlongPlane);
+
+    //     glm::vec3 planarCrossThing1 = glm::cross((glm::vec3)tangentDirection, contactToRigidbody);
+    //     glm::vec3 planarCrossThing2 = glm::cross((glm::vec3)tangentDirection, contactToOtherRigidbody);
+    //     // std::cout << "Along plane, rel velocity is " << glm::to_string(relVelocityAlongPlane) << " as calculated from total rel vel " << glm::to_string(relVelocity) << " and vel along normal " << relVelocityAlongContactNormal << ".\n";
+        
+    //     
+    //     // double reducedInverseMassAlongPlane = 1/(rigidbody.InverseMass() + (otherRigidbody ? otherRigidbody->InverseMass() : 0) + glm::dot(planarCrossThing1, (globalInverseInertiaTensor1 * planarCrossThing1)) + glm::dot(planarCrossThing2, otherRigidbody ? (globalInverseInertiaTensor2 * planarCrossThing2): glm::vec3(0, 0, 0)));
+    //     // float frictionImpulse = friction * reducedInverseMassAlongPlane * glm::length(relVelocityAlongPlane);
+
+    //     // if (glm::length(relVelocityAlongPlane) > friction * )
+    //     // rigidbody.accumulatedForce += frictionImpulse * tangentDirection;   
+    //     // rigidbody.accumulatedTorque -= glm::cross(-posRelToContact, -tangentDirection) * frictionImpulse;
+    // }
+}
 
-            // FRICTION
-            // glm::vec3 relVelocityAlongPlane =  relVelocity + (normal * relVelocityAlongContactNormal);
-            // if (glm::length(relVelocityAlongPlane) > 0) {
-            //     auto tangentDirection = glm::normalize(relVelocityAlongPlane);
+void PhysicsEngine::SweepContinuousCollision(TransformComponent& transform, ColliderComponent& collider, glm::dvec3 start) {
+    // how many times to halve the interval the hit is in to find when it happened
+    const unsigned int TIME_OF_IMPACT_ITERATIONS = 8;
 
-            //     glm::vec3 planarCrossThing1 = glm::cross((glm::vec3)tangentDirection, contactToRigidbody);
-            //     glm::vec3 planarCrossThing2 = glm::cross((glm::vec3)tangentDirection, contactToOtherRigidbody);
-            //     // std::cout << "Along plane, rel velocity is " << glm::to_string(relVelocityAlongPlane) << " as calculated from total rel vel " << glm::to_string(relVelocity) << " and vel along normal " << relVelocityAlongContactNormal << ".\n";
-                
-            //     
-            //     // double reducedInverseMassAlongPlane = 1/(rigidbody.InverseMass() + (otherRigidbody ? otherRigidbody->InverseMass() : 0) + glm::dot(planarCrossThing1, (globalInverseInertiaTensor1 * planarCrossThing1)) + glm::dot(planarCrossThing2, otherRigidbody ? (globalInverseInertiaTensor2 * planarCrossThing2): glm::vec3(0, 0, 0)));
-            //     // float frictionImpulse = friction * reducedInverseMassAlongPlane * glm::length(relVelocityAlongPlane);
+    glm::dvec3 end = transform.Position();
+    glm::dvec3 motion = end - start;
+    if (motion == glm::dvec3(0, 0, 0)) {
+        return;
+    }
 
-            //     // if (glm::length(relVelocityAlongPlane) > friction * )
-            //     // rigidbody.accumulatedForce += frictionImpulse * tangentDirection;   
-            //     // rigidbody.accumulatedTorque -= glm::cross(-posRelToContact, -tangentDirection) * frictionImpulse;
-            // }
+    // if it didn't move more than a fraction of its own width, it can't have skipped past anything and the regular collisions will do
+    double distance = glm::length(motion);
+    double width = ColliderWidth(transform, collider, motion);
+    if (distance <= width * CONTINUOUS_COLLISION_STEP) {
+        return;
+    }
 
+    // The collider's AABB is from wherever it was the last time the SAS was updated, but its size is still good.
+    const AABB& aabb = collider.GetAABB();
+    glm::dvec3 halfSize = (aabb.max - aabb.min) * 0.5;
+    AABB sweptAabb(glm::min(start, end) - halfSize, glm::max(start, end) + halfSize);
+
+    // Times are fractions of the way from start to end.
+    // The collider is tested every CONTINUOUS_COLLISION_STEP of its width along its path, so even something infinitely thin would overlap it at one of those times.
+    double timeStep = width * CONTINUOUS_COLLISION_STEP / distance;
+    double timeOfImpact = 1.0;
+    ColliderComponent* hit = nullptr;
+
+    // reused for every test, so that the contact points are only allocated once per sweep
+    CollisionInfo collision;
+    auto collidingAt = [&](const ColliderComponent& other, const TransformComponent& otherTransform, double time) {
+        // the transform stays at the end of the path, and each test just offsets the collider back to where it'd be at that time
+        return IsColliding(transform, collider, start + motion * time - end, otherTransform, other, collision);
+    };
+
+    // visits the candidates straight out of the SAS instead of making a vector of them, since this happens for every fast body every step
+    SpatialAccelerationStructure::Get().QueryVisit(sweptAabb, collisionLayerMatrix[collider.GetCollisionLayer()], [&](ColliderComponent* other) {
+        if (other == &collider) {
+            return true;
         }
-        else {
-            //std::cout << "aw.\n";
+        const TransformComponent& otherTransform = *other->gameobject->RawGet<TransformComponent>();
+
+        // If they were already touching before it moved, that's usually a resting/sliding contact for the regular collisions to handle.
+        // But it can still go straight through something it started out touching (like a thin floor it's resting on, or a wall it's pressed against) if it moves into it fast enough.
+        // Moving into it no further than the steps below can't do that (same as the check at the top), otherwise it hit it right where it started.
+        if (collidingAt(*other, otherTransform, 0)) {
+            if (glm::dot(motion, collision.collisionNormal) > width * CONTINUOUS_COLLISION_STEP) { // normal faces out of the collider towards the other object
+                timeOfImpact = 0;
+                hit = other;
+            }
+            return true;
         }
+
+        // step along the path (only up to the earliest hit so far, anything later doesn't matter) until they collide, then binary search for when they started colliding
+        double lastFreeTime = 0;
+        while (lastFreeTime < timeOfImpact) {
+            double time = std::min(lastFreeTime + timeStep, timeOfImpact);
+            if (collidingAt(*other, otherTransform, time)) {
+                for (unsigned int i = 0; i < TIME_OF_IMPACT_ITERATIONS; i++) {
+                    double middle = (lastFreeTime + time) / 2.0;
+                    if (collidingAt(*other, otherTransform, middle)) {
+                        time = middle;
+                    }
+                    else {
+                        lastFreeTime = middle;
+                    }
+                }
+
+                // stop where they're (barely) colliding instead of where they're (barely) not, so the regular collisions see the contact and bounce it off
+                timeOfImpact = time;
+                hit = other;
+                break;
+            }
+            lastFreeTime = time;
+        }
+
+        return true;
+    });
+
+    if (hit) {
+        transform.SetPos(start + motion * timeOfImpact);
+        continuousCollisionPairs.emplace_back(&collider, hit);
+    }
+}
+
+unsigned int PhysicsEngine::IslandBody(ColliderComponent* collider) {
+    auto [it, inserted] = islandBodies.try_emplace(collider, static_cast<unsigned int>(islandParents.size()));
+    if (inserted) {
+        islandParents.push_back(it->second); // starts out as its own island
     }
+    return it->second;
+}
 
-    
+unsigned int PhysicsEngine::IslandRoot(unsigned int body) {
+    while (islandParents[body] != body) {
+        islandParents[body] = islandParents[islandParents[body]]; // path halving, keeps the trees flat
+        body = islandParents[body];
+    }
+    return body;
 }
 
 void PhysicsEngine::Step(const double timestep) {
@@ -312,10 +385,27 @@ void PhysicsEngine::Step(const double timestep) {
 
     // iterate through all sets of rigidBodyComponent + transformComponent
     // first pass, apply gravity, convert applied force to velocity, apply drag, and move everything by its velocity
-    for (auto it = GameObject::SystemGetComponents<TransformComponent, RigidbodyComponent>({ComponentBitIndex::Transform, ComponentBitIndex::Rigidbody}); it.Valid(); it++) {
+    // sleeping objects are skipped, unless something disturbed them
+    awakeRigidbodies.clear();
+    continuousCollisionSweeps.clear();
+    static GameObject::SystemQuery<TransformComponent, RigidbodyComponent, ColliderComponent> rigidbodyQuery({ComponentBitIndex::Transform, ComponentBitIndex::Rigidbody});
+    for (auto it = rigidbodyQuery.Iterate(); it.Valid(); it++) {
         auto& tuple = *it;
         TransformComponent& transform = *std::get<0>(tuple);
         RigidbodyComponent& rigidbody = *std::get<1>(tuple);
+        ColliderComponent* collider = std::get<2>(tuple); // might be nullptr
+
+        if (rigidbody.Sleeping()) {
+            if (!rigidbody.Disturbed(transform)) {
+                continue;
+            }
+            rigidbody.Wake();
+        }
+
+        if (collider) {
+            // the broadphase only looks for collisions involving awake colliders
+            SpatialAccelerationStructure::Get().SetColliderAwake(*collider, true);
+        }
 
         // transform.SetRot(glm::normalize(transform.Rotation()));
         if (!rigidbody.kinematic) {
@@ -343,6 +433,9 @@ void PhysicsEngine::Step(const double timestep) {
         rigidbody.accumulatedTorque = {0, 0, 0};
 
         if (rigidbody.velocity != glm::dvec3(0, 0, 0)) {
+            if (rigidbody.continuousCollision && collider && !rigidbody.kinematic) {
+                continuousCollisionSweeps.emplace_back(&transform, collider, transform.Position());
+            }
             transform.SetPos(transform.Position() + rigidbody.velocity * timestep);
         }
            
@@ -356,28 +449,160 @@ void PhysicsEngine::Step(const double timestep) {
             Assert(!std::isnan(spin.x));
             transform.SetRot((spin * transform.Rotation()));
         }
+
+        awakeRigidbodies.emplace_back(&transform, &rigidbody, collider);
     }
     
+    // continuous collision: stop fast rigidbodies at the first thing they hit, instead of letting them skip past it
+    // (after everything has moved, so they're tested against where everything else ended up)
+    continuousCollisionPairs.clear();
+    for (auto [transform, collider, start] : continuousCollisionSweeps) {
+        SweepContinuousCollision(*transform, *collider, start);
+    }
+
     // second pass, do collisions and constraints for non-kinematic objects
     // the second pass should under no circumstances change any property of the gameobjects, except for the accumulatedForce of the object being moved, so that the order of operations doesn't matter and so that physics can be parallelized.
-    
-    // for each pair, the transform component will be shifted over by the vector
-    // TODO: NOT THREAD SAFE MY BAD DO NOT FORGET TO FIX
-    std::vector<std::pair<TransformComponent*, glm::dvec3>> separations; // to separate colliding objects, since we can't change position in this pass, DoPhysics() adds desired translations to this std::vector, and 3rd pass actually sets position 
-    
-    for (auto it = GameObject::SystemGetComponents<TransformComponent, ColliderComponent, RigidbodyComponent>({ ComponentBitIndex::Transform, ComponentBitIndex::Collider, ComponentBitIndex::Rigidbody });  it.Valid(); it++) {
-        auto& tuple = *it;
-        TransformComponent& transform = *std::get<0>(tuple);
-        ColliderComponent& collider = *std::get<1>(tuple);
-        RigidbodyComponent& rigidbody = *std::get<2>(tuple);
-        if (!rigidbody.kinematic) {
-            DoPhysics(timestep, collider, transform, rigidbody, separations);
+
+    // broadphase: find every pair of colliders whose AABBs overlap. Each pair is only found once, so the expensive narrowphase below only runs once per pair.
+    // TODO: should REALLY use tight fitting AABB here
+    broadphasePairs.clear();
+    SpatialAccelerationStructure::Get().FindOverlappingPairs(broadphasePairs, collisionLayerMatrix);
+    for (auto& pair : continuousCollisionPairs) {
+        auto samePair = [&pair](const std::pair<ColliderComponent*, ColliderComponent*>& other) {
+            return other == pair || (other.first == pair.second && other.second == pair.first);
+        };
+        if (std::find_if(broadphasePairs.begin(), broadphasePairs.end(), samePair) == broadphasePairs.end()) {
+            broadphasePairs.push_back(pair);
+        }
+    }
+
+    // Keep the pairs that the narrowphase needs to look at, and group them into islands: sets of simulated objects that touch each other (directly or through other simulated objects).
+    // Resolving a collision only changes the simulated objects in it, so each island can be resolved on a different thread without them stepping on each other.
+    // Objects that aren't simulated (static/kinematic) never change, so they don't join islands together.
+    contactPairs.clear();
+    islandBodies.clear();
+    islandParents.clear();
+    for (auto [collider, otherCollider] : broadphasePairs) {
+        RigidbodyComponent* rigidbody = collider->gameobject->MaybeRawGet<RigidbodyComponent>(); // might be nullptr
+        RigidbodyComponent* otherRigidbody = otherCollider->gameobject->MaybeRawGet<RigidbodyComponent>(); // might be nullptr
+
+        // Pairs are only found when at least one of the colliders is awake, so anything asleep here is being touched by something awake and has to wake up.
+        // (Its neighbours will be woken the same way next step, once its collider is awake.)
+        if (rigidbody && rigidbody->Sleeping()) {
+            rigidbody->Wake();
+        }
+        if (otherRigidbody && otherRigidbody->Sleeping()) {
+            otherRigidbody->Wake();
+        }
+
+        // infinite mass/kinematic/no rigidbody = collisions ain't doing nothing to this
+        bool simulated = rigidbody && !rigidbody->kinematic && rigidbody->InverseMass() != 0;
+        bool otherSimulated = otherRigidbody && !otherRigidbody->kinematic && otherRigidbody->InverseMass() != 0;
+        if (!simulated && !otherSimulated) {
+            continue;
+        }
+
+        // make sure the first object is always one that gets resolved
+        if (!simulated) {
+            std::swap(collider, otherCollider);
+            std::swap(rigidbody, otherRigidbody);
+            std::swap(simulated, otherSimulated);
+        }
+
+        contactPairs.push_back(ContactPair { .collider = collider, .otherCollider = otherCollider, .rigidbody = rigidbody, .otherRigidbody = otherRigidbody, .otherSimulated = otherSimulated });
+        contactCache.ReservePair(collider, otherCollider);
+
+        unsigned int body = IslandBody(collider);
+        if (otherSimulated) {
+            // union the two objects' islands
+            unsigned int root = IslandRoot(body);
+            unsigned int otherRoot = IslandRoot(IslandBody(otherCollider));
+            if (root != otherRoot) {
+                islandParents[std::max(root, otherRoot)] = std::min(root, otherRoot);
+            }
+        }
+    }
+
+    // Number the islands in the order their first pair was found, and list each island's pairs in the order they were found.
+    // That way nothing about how the pairs get resolved depends on which thread got to what first, and the results are the same every run.
+    unsigned int nIslands = 0;
+    islandIndices.assign(islandParents.size(), -1);
+    for (unsigned int i = 0; i < contactPairs.size(); i++) {
+        unsigned int root = IslandRoot(islandBodies.at(contactPairs[i].collider));
+        if (islandIndices[root] == -1) {
+            islandIndices[root] = nIslands++;
+            if (islands.size() < nIslands) {
+                islands.emplace_back();
+                islandSeparations.emplace_back();
+            }
+            islands[nIslands - 1].clear();
+            islandSeparations[nIslands - 1].clear();
         }
+        islands[islandIndices[root]].push_back(i);
     }
 
+    // narrowphase + collision response, one island per task
+    ThreadPool::Get().ParallelFor(nIslands, [this](unsigned int island) {
+        // reused for every pair this thread looks at, so that contact points only get allocated when there's more of them than ever before
+        thread_local CollisionInfo collision;
+        for (unsigned int pairIndex : islands[island]) {
+            const ContactPair& pair = contactPairs[pairIndex];
+            TransformComponent& transform = *pair.collider->gameobject->RawGet<TransformComponent>();
+            TransformComponent& otherTransform = *pair.otherCollider->gameobject->RawGet<TransformComponent>();
+
+            // TODO: potential perf gains by using tight fitting AABB/OBB here after broadphase?
+            if (!contactCache.FindCollision(otherTransform, *pair.otherCollider, transform, *pair.collider, collision)) { // normal faces out of the other object towards the first one
+                continue;
+            }
+            Assert(collision.contactPoints.size() > 0);
+
+            // each island gets its own separations so that threads don't share a vector
+            auto& separations = islandSeparations[island];
+            ResolveCollision(*pair.collider, transform, *pair.rigidbody, *pair.otherCollider, otherTransform, pair.otherRigidbody, collision.collisionNormal, collision, separations);
+            if (pair.otherSimulated) {
+                ResolveCollision(*pair.otherCollider, otherTransform, *pair.otherRigidbody, *pair.collider, transform, pair.rigidbody, -collision.collisionNormal, collision, separations);
+            }
+        }
+    });
+
+    contactCache.EndStep();
+
     // third pass, seperate colliding objects since we couldn't change positions in 2nd pass
-    for (auto & [comp, offset]: separations) {
-        comp->SetPos(comp->Position() + offset);
+    // (in island order, so that it's deterministic too)
+    for (unsigned int island = 0; island < nIslands; island++) {
+        for (auto & [comp, offset]: islandSeparations[island]) {
+            comp->SetPos(comp->Position() + offset);
+        }
+    }
+
+    // Count how long everything's been still for. This goes by the velocity the collisions left it with (which the accumulated impulses get added to next step),
+        // since before that even something lying on the floor is falling at gravity * timestep, which is faster than SLEEP_LINEAR_VELOCITY at 60 steps per second.
+    for (auto [transform, rigidbody, collider] : awakeRigidbodies) {
+        rigidbody->UpdateSleepCountdown(*transform, timestep);
+    }
+
+    // An island can only fall asleep all at once, when everything in it is ready to, or else objects could be left asleep in mid-air when something under them falls asleep first.
+    // Objects it touches that aren't simulated count too, so that things riding a moving kinematic platform stay awake.
+    restlessIslands.assign(nIslands, false);
+    for (const auto& pair : contactPairs) {
+        if (!pair.rigidbody->ReadyToSleep() || (pair.otherRigidbody && !pair.otherRigidbody->ReadyToSleep())) {
+            restlessIslands[islandIndices[IslandRoot(islandBodies.at(pair.collider))]] = true;
+        }
+    }
+
+    // put everything that's been still for long enough (and whose island has been too) to sleep
+    for (auto [transform, rigidbody, collider] : awakeRigidbodies) {
+        if (!rigidbody->ReadyToSleep()) {
+            continue;
+        }
+        if (collider) {
+            auto it = islandBodies.find(collider);
+            if (it != islandBodies.end() && restlessIslands[islandIndices[IslandRoot(it->second)]]) {
+                continue;
+            }
+            SpatialAccelerationStructure::Get().SetColliderAwake(*collider, false);
+        }
+        rigidbody->Sleep(*transform);
     }
 
     //postPhysicsEvent->Fire(timestep);
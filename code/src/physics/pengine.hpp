@@ -1,6 +1,12 @@
 #include <glm/vec3.hpp>
 #include <vector>
+#include <unordered_map>
+#include <tuple>
 #include "aabb.hpp"
+#include "contact_cache.hpp"
+
+class ColliderComponent;
+class RigidbodyComponent;
 
 // it's a physics engine, obviously.
 class PhysicsEngine {
@@ -40,6 +46,55 @@ private:
     // defaults to all true.
     std::array<std::bitset<MAX_COLLISION_LAYERS>, MAX_COLLISION_LAYERS> collisionLayerMatrix;
 
+    // overlapping pairs of colliders found by the broadphase each Step(); a member so it doesn't have to be reallocated every step
+    std::vector<std::pair<ColliderComponent*, ColliderComponent*>> broadphasePairs;
+
+    // narrowphase results from previous steps, so that contacts that barely moved don't have to be found again
+    ContactCache contactCache;
+
+    // A broadphase pair that the narrowphase has to look at, because at least one of the objects (always the first one) is simulated.
+    struct ContactPair {
+        ColliderComponent* collider;
+        ColliderComponent* otherCollider;
+        RigidbodyComponent* rigidbody;
+        RigidbodyComponent* otherRigidbody; // might be nullptr
+        bool otherSimulated;
+    };
+
+    // Everything below is rebuilt every Step() and only kept around to avoid reallocating it.
+
+    std::vector<ContactPair> contactPairs;
+
+    // Islands are found with a union-find over the simulated objects in contactPairs.
+    std::unordered_map<ColliderComponent*, unsigned int> islandBodies; // index of each simulated object in islandParents
+    std::vector<unsigned int> islandParents; // each object's parent in the union-find; roots are their own parent
+    std::vector<int> islandIndices; // for each root, which island it is, or -1 if not numbered yet
+
+    // for each island, indices into contactPairs (only the first n are used, where n is the number of islands this step)
+    std::vector<std::vector<unsigned int>> islands;
+    // for each island, offsets to move objects by after the collisions are resolved
+    std::vector<std::vector<std::pair<TransformComponent*, glm::dvec3>>> islandSeparations;
+    // for each island, true if anything in it isn't ready to sleep
+    std::vector<bool> restlessIslands;
+
+    // rigidbodies that were awake this step (collider might be nullptr), so their sleep countdowns can be updated once this step's collisions are resolved
+    std::vector<std::tuple<TransformComponent*, RigidbodyComponent*, ColliderComponent*>> awakeRigidbodies;
+
+    // rigidbodies with continuousCollision that moved this step, and where they were before they moved
+    std::vector<std::tuple<TransformComponent*, ColliderComponent*, glm::dvec3>> continuousCollisionSweeps;
+    // pairs of <rigidbody's collider, what it hit> found by SweepContinuousCollision(), which the broadphase can miss since the SAS hasn't seen the rigidbody where it got stopped
+    std::vector<std::pair<ColliderComponent*, ColliderComponent*>> continuousCollisionPairs;
+
+    // Looks for the first thing the collider hit while moving from start to where it is now (only if it moved far enough that it could've passed through something),
+        // and if it hit something, moves it back to where it hit and adds them to continuousCollisionPairs.
+    void SweepContinuousCollision(TransformComponent& transform, ColliderComponent& collider, glm::dvec3 start);
+
+    // Returns the given simulated object's index in islandParents, adding it as its own island if it isn't there yet.
+    unsigned int IslandBody(ColliderComponent* collider);
+
+    // Returns the index in islandParents of the root of the given object's island.
+    unsigned int IslandRoot(unsigned int body);
+
     PhysicsEngine();
 
     ~PhysicsEngine();
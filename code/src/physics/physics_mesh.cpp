@@ -1,15 +1,19 @@
 #include "physics_mesh.hpp"
 #include "../graphics/mesh.hpp"
+#include "mesh_simplification.hpp"
 #include <algorithm>
 #include <array>
 #include "debug/assert.hpp"
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 #include "../utility/let_me_hash_a_tuple.cpp"
+#include "../utility/hash_glm.hpp"
 #include "glm/gtx/string_cast.hpp"
 #include "glm/gtx/norm.hpp"
 
@@ -33,11 +37,11 @@ PhysicsMesh::~PhysicsMesh()
 
 std::shared_ptr<PhysicsMesh> PhysicsMesh::New(std::shared_ptr<Mesh> &mesh, unsigned int simplifyThreshold, bool convexDecomposition) {
     auto tuple = std::make_tuple(mesh->meshId, simplifyThreshold, convexDecomposition);
-    if (MeshGlobals::Get().MESHES_TO_PHYS_MESHES.count(tuple)) { // TODO: once we have simplifyThreshold and convexDecomposition, we need to make sure that matches up too
+    if (MeshGlobals::Get().MESHES_TO_PHYS_MESHES.count(tuple)) {
         return MeshGlobals::Get().MESHES_TO_PHYS_MESHES[tuple];
     }
     else {
-        auto ptr = std::shared_ptr<PhysicsMesh>(new PhysicsMesh(mesh));
+        auto ptr = std::shared_ptr<PhysicsMesh>(new PhysicsMesh(mesh, simplifyThreshold, convexDecomposition));
         // MeshGlobals::Get().LOADED_PHYS_MESHES[ptr->physMeshId] = ptr;
         if (mesh->dynamic) {
             mesh->physicsUsers.push_back(ptr.get());
@@ -49,18 +53,9 @@ std::shared_ptr<PhysicsMesh> PhysicsMesh::New(std::shared_ptr<Mesh> &mesh, unsig
 
 
 
-// Returns a vector of ConvexMesh objects for a PhysicsMesh from the given Mesh. 
-// TODO: convex decomposition
-std::vector<PhysicsMesh::ConvexMesh> me_when_i_so_i_but_then_i_so_i(const std::shared_ptr<Mesh>& mesh, float simplifyThreshold, bool convexDecomposition) {
-    //Assert(!mesh->dynamic);
-    Assert(simplifyThreshold >= 1.0f);
-    // DebugLogInfo("Here we go. ", mesh->meshId);
-
-    // Graphics meshes contain extraneous data (UVs, colors, etc.) that isn't relevant to physics, so this function needs to get rid of that.
-    // This function also needs to take triangles with same normal and put them in same polygon to fill faces, and get edges.
-    std::vector<std::pair<glm::vec3, std::vector<glm::vec3>>> faces;
+// Returns the triangles of the (graphical) mesh, without the UVs, colors, etc. that aren't relevant to physics.
+std::vector<std::array<glm::vec3, 3>> GetTriangles(const std::shared_ptr<Mesh>& mesh) {
     std::vector<std::array<glm::vec3, 3>> triangles;
-    std::vector<std::pair<glm::vec3, glm::vec3>> edges;
 
     Assert(mesh->indices.size() % 3 == 0);
     for (auto it = mesh->indices.begin(); it != mesh->indices.end();) {
@@ -77,66 +72,22 @@ std::vector<PhysicsMesh::ConvexMesh> me_when_i_so_i_but_then_i_so_i(const std::s
         glm::vec3 vertex3 = {mesh->vertices.at(vertexIndex3 + offset), mesh->vertices.at(vertexIndex3 + 1 + offset), mesh->vertices.at(vertexIndex3 + 2 + offset)};
         
         // DebugLogInfo("Vertices ", glm::to_string(vertex1), ",", glm::to_string(vertex2), ",", glm::to_string(vertex3));
+        triangles.push_back({vertex1, vertex2, vertex3});
+    }
 
-        auto normal = glm::cross(vertex1 - vertex2, vertex1 - vertex3);
-
-        // make sure normal always points outward
-        double distance = glm::dot(normal, vertex1);
-		if (distance < 0) { // if dot product between center of model to vertex and the normal is < 0, normal is opposite direction of model to vertex and needs to be flipped
-			normal   *= -1;
-			distance *= -1;
-		}
-
-        // if we already started a face with this normal, add our nonduplicate vertices to it. 
-        bool foundFace = false;
-        for (auto & f: faces) {
-            if (glm::dot(f.first, normal) > 0.99f) { // this dot product check lets the normals be very slightly different (TODO: change threshold? do we even want threshold?)
-                foundFace = true;
-                // DebugLogInfo("Found second face with normal ", glm::to_string(normal));
-
-                bool containsVertex1 = false;
-                bool containsVertex2 = false;
-                bool containsVertex3 = false;
-                for (auto & v: f.second) {
-                    if (v == vertex1) {
-                        // DebugLogInfo("Face already has ", glm::to_string(v));
-                        containsVertex1 = true;
-                    }
-                    else if (v == vertex2) {
-                        // DebugLogInfo("Face already has ", glm::to_string(v));
-                        containsVertex2 = true;
-                    }
-                    else if (v == vertex3) {
-                        // DebugLogInfo("Face already has ", glm::to_string(v));
-                        containsVertex3 = true;
-                    }
-                }
-                
-                // DebugLogInfo("Before: f2 size = ", f.second.size());
-                if (!containsVertex1) {
-                    f.second.push_back(vertex1);
-                }
-                if (!containsVertex2) {
-                    f.second.push_back(vertex2);
-                }
-                if (!containsVertex3) {
-                    f.second.push_back(vertex3);
-                }
-                // DebugLogInfo("After: f2 size = ", f.second.size());
-
-                break; // break exits the inner loop
-            }
-        }
-        // if this is the first face we've found with this normal, create a new face.
-        if (!foundFace) {
-            faces.push_back({normal, {vertex1, vertex2, vertex3}});
-        }
+    return triangles;
+}
 
-        // and of course add triangle to triangles vector
-        triangles.push_back({vertex1, vertex2, vertex3});
+// Returns the average of the triangles' vertices, which is inside them if they're convex.
+glm::vec3 AverageVertex(const std::vector<std::array<glm::vec3, 3>>& triangles) {
+    glm::vec3 sum(0, 0, 0);
+    for (auto & triangle: triangles) {
+        sum += triangle[0] + triangle[1] + triangle[2];
     }
+    return sum / (triangles.size() * 3.0f);
+}
 
-    // Then, we need to sort each face's vertices so that they're in clockwise order, because SAT needs that too.
+void SortFaceVertices(std::vector<std::pair<glm::vec3, std::vector<glm::vec3>>>& faces, glm::vec3 center) {
     for (auto & face: faces) {
         
         auto faceCenter = glm::vec3(0, 0, 0);
@@ -145,10 +96,11 @@ std::vector<PhysicsMesh::ConvexMesh> me_when_i_so_i_but_then_i_so_i(const std::s
         }
         faceCenter /= face.second.size();
 
+        const auto outward = faceCenter - center; // not parallel to the face, since center is inside the mesh
         const auto r = face.second.at(0) - faceCenter; // use an arbitrary vector as the twelve o’clock reference
-        const auto p = cross(r, faceCenter);
+        const auto p = cross(r, outward);
 
-        std::sort(face.second.begin(), face.second.end(), [&faceCenter, &p, &r](const glm::vec3 &v1, const glm::vec3&v2) {
+        std::sort(face.second.begin(), face.second.end(), [&faceCenter, &outward, &p, &r](const glm::vec3 &v1, const glm::vec3&v2) {
             
             // stolen from https://stackoverflow.com/questions/47949485/sorting-a-list-of-3d-points-in-clockwise-order
             // the sort function should return true if v1 is clockwise from v2 around the center of the face.
@@ -168,33 +120,137 @@ std::vector<PhysicsMesh::ConvexMesh> me_when_i_so_i_but_then_i_so_i(const std::s
                 return (glm::dot(u1, r) > 0 && glm::dot(u2, r) < 0);
             }
             else {
-                return (glm::dot(glm::cross(u1, u2), faceCenter) > 0);
+                return (glm::dot(glm::cross(u1, u2), outward) > 0);
             }
                     
         });
     }
+}
 
-    // Then, we need to get edges of each face.
+PhysicsMesh::ConvexMesh MakeConvexMesh(const std::vector<std::array<glm::vec3, 3>>& triangles, glm::vec3 center, bool isConvexHull) {
+    // Need to take triangles with same normal and put them in same polygon to fill faces, and get edges.
+    std::vector<std::pair<glm::vec3, std::vector<glm::vec3>>> faces;
+    std::vector<std::pair<glm::vec3, glm::vec3>> edges;
+
+    // Comparing each triangle's normal to every face's normal made this O(n^2), which took forever for detailed meshes, so faces are also bucketed by the direction of their normal.
+    // Normals aren't normalized (TODO: change threshold? do we even want threshold?), so whether two of them are close enough to share a face depends on how long they are too.
+    // dot(a, b) > SAME_FACE_THRESHOLD needs the angle between them to have a cosine above SAME_FACE_THRESHOLD / (|a| * |b|), so the longest face normal so far bounds how far apart
+        // (and so how many buckets away) a matching face can be. Tiny triangles can't match anything, and if the bound covers too many buckets we just check every face like before.
+    const float SAME_FACE_THRESHOLD = 0.99f; // this dot product check lets the normals be very slightly different
+    const float NORMAL_BUCKET_SIZE = 0.05f;
+    std::unordered_map<glm::ivec3, std::vector<unsigned int>> faceBuckets; // indices into faces (except ones with a zero normal, which can't match anything)
+    std::vector<std::unordered_set<glm::vec3>> faceVertices; // so we don't have to look through a face's vertices to see if it already has one
+    double longestFaceNormal = 0;
+
+    for (auto & [vertex1, vertex2, vertex3]: triangles) {
+        auto normal = glm::cross(vertex1 - vertex2, vertex1 - vertex3);
+
+        // make sure normal always points outward
+        double distance = glm::dot(normal, vertex1 - center);
+		if (distance < 0) { // if dot product between center of model to vertex and the normal is < 0, normal is opposite direction of model to vertex and needs to be flipped
+			normal   *= -1;
+			distance *= -1;
+		}
+
+        // if we already started a face with this normal, add our nonduplicate vertices to it. If more than one face is close enough, use the one that was made first.
+        unsigned int foundFace = faces.size();
+        double length = glm::length(glm::dvec3(normal));
+        double minCosine = SAME_FACE_THRESHOLD / (length * longestFaceNormal) * (1 - 1e-4) - 1e-4; // (loosened a little so that rounding can't make us skip a match)
+        if (length > 0 && minCosine < 1) {
+            glm::dvec3 direction = glm::dvec3(normal) / length;
+            int range = int(std::ceil(std::sqrt(2 - 2 * std::max(minCosine, -1.0)) / NORMAL_BUCKET_SIZE)) + 1;
+            if (std::pow(2 * range + 1, 3) > faces.size()) {
+                for (unsigned int f = 0; f < faces.size(); f++) {
+                    if (glm::dot(faces[f].first, normal) > SAME_FACE_THRESHOLD) {
+                        foundFace = f;
+                        break;
+                    }
+                }
+            }
+            else {
+                glm::ivec3 bucket(glm::floor(direction / double(NORMAL_BUCKET_SIZE)));
+                for (int x = -range; x <= range; x++) {
+                    for (int y = -range; y <= range; y++) {
+                        for (int z = -range; z <= range; z++) {
+                            auto it = faceBuckets.find(bucket + glm::ivec3(x, y, z));
+                            if (it == faceBuckets.end()) {
+                                continue;
+                            }
+                            for (unsigned int f: it->second) {
+                                if (f < foundFace && glm::dot(faces[f].first, normal) > SAME_FACE_THRESHOLD) {
+                                    foundFace = f;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        if (foundFace != faces.size()) {
+            for (auto & vertex: {vertex1, vertex2, vertex3}) {
+                if (faceVertices[foundFace].insert(vertex).second) {
+                    faces[foundFace].second.push_back(vertex);
+                }
+            }
+        }
+        else { // if this is the first face we've found with this normal, create a new face.
+            faces.push_back({normal, {vertex1, vertex2, vertex3}});
+            faceVertices.emplace_back(faces.back().second.begin(), faces.back().second.end());
+            if (length > 0) {
+                faceBuckets[glm::ivec3(glm::floor(glm::dvec3(normal) / length / double(NORMAL_BUCKET_SIZE)))].push_back(foundFace);
+                longestFaceNormal = std::max(longestFaceNormal, length);
+            }
+        }
+    }
+
+    // Then, we need to sort each face's vertices so that they're in clockwise order, because SAT needs that too.
+    SortFaceVertices(faces, center);
+
+    // Then, we need to get edges of each face, and deduplicate the vertices for the support function.
     // We don't do this when iterating through triangles since we don't want (for example) the diagonal of a square face to be treated as an edge, plus we might (???) want edges in clockwise order too.
+    std::vector<glm::vec3> vertices;
+    std::unordered_map<glm::vec3, unsigned int> vertexIndices;
+    auto indexOf = [&vertices, &vertexIndices](const glm::vec3& v) {
+        auto [it, inserted] = vertexIndices.try_emplace(v, static_cast<unsigned int>(vertices.size()));
+        if (inserted) {
+            vertices.push_back(v);
+        }
+        return it->second;
+    };
+
+    // faces that share an edge both have it, so edges are hashed by the indices of their vertices (smaller one first, since the order doesn't matter) to only add them once
+    auto edgeKey = [](unsigned int index1, unsigned int index2) {
+        return (uint64_t(std::min(index1, index2)) << 32) | std::max(index1, index2);
+    };
+    std::unordered_set<uint64_t> foundEdges;
     for (auto & f: faces) {
         for (unsigned int i = 0; i < f.second.size(); i++) {
             auto vertex1 = f.second[i];
             auto vertex2 = f.second[(i + 1 == f.second.size() ? 0 : i + 1)]; // make sure we get the edge between the last vertex and the first vertex of the face
-            // check if this edge isn't already in the edges vector and if so add it
-            bool foundEdge = false;
-            for (auto & [a, b]: edges) {
-                // the order of a and b doesn't matter so we gotta check both combinations
-                if (a == vertex1 && b == vertex2) {foundEdge = true;}
-                if (a == vertex2 && b == vertex1) {foundEdge = true;}
+            if (foundEdges.insert(edgeKey(indexOf(vertex1), indexOf(vertex2))).second) {
+                edges.emplace_back(vertex1, vertex2);
             }
+        }
+    }
 
-            if (!foundEdge) {
-                edges.emplace_back(vertex1, vertex2);
+    // Hill climbing over neighbours only finds the farthest vertex if they come from a real convex hull. Faces are merged by normal alone, so on an arbitrary mesh (which could be concave, or have vertices in the middle of a face) their edges don't cut it.
+    // For a hull, every triangle edge is a neighbour; the triangles' diagonals don't hurt since the hull is convex.
+    std::vector<std::vector<unsigned int>> neighbours;
+    if (isConvexHull) {
+        neighbours.resize(vertices.size()); // every vertex of every triangle is on some face, so indexOf() won't find any new ones
+        std::unordered_set<uint64_t> foundNeighbours;
+        for (auto & triangle: triangles) {
+            for (unsigned int i = 0; i < 3; i++) {
+                unsigned int index1 = indexOf(triangle[i]), index2 = indexOf(triangle[(i + 1) % 3]);
+                if (index1 != index2 && foundNeighbours.insert(edgeKey(index1, index2)).second) {
+                    neighbours[index1].push_back(index2);
+                    neighbours[index2].push_back(index1);
+                }
             }
         }
-        
     }
-    
+
     // std::cout << "Created physics mesh:\n";
     // for (auto & f: faces) {
     //     std::cout << "\tFace with normal " << glm::to_string(f.first) << " has vertices "; 
@@ -206,18 +262,53 @@ std::vector<PhysicsMesh::ConvexMesh> me_when_i_so_i_but_then_i_so_i(const std::s
     // for (auto & e: edges) {
     //     std::cout << "\tEdge " << glm::to_string(e.first) << " to " << glm::to_string(e.second) << ".\n";
     // }
-    return {PhysicsMesh::ConvexMesh {.triangles = triangles, .faces = faces, .edges = edges}};
+    return PhysicsMesh::ConvexMesh {.triangles = triangles, .faces = faces, .edges = edges, .vertices = vertices, .neighbours = neighbours, .center = center};
+}
+
+// simplifyThreshold and convexDecomposition are documented on PhysicsMesh::New().
+std::vector<PhysicsMesh::ConvexMesh> me_when_i_so_i_but_then_i_so_i(const std::shared_ptr<Mesh>& mesh, unsigned int simplifyThreshold, bool convexDecomposition) {
+    auto triangles = GetTriangles(mesh);
+
+    if (convexDecomposition) {
+        std::vector<PhysicsMesh::ConvexMesh> pieces;
+        for (auto & piece: ApproximateConvexDecomposition(triangles)) {
+            auto hull = ConvexHull(piece, simplifyThreshold);
+            if (!hull.empty()) { // flat pieces don't have a hull, but the pieces around them will cover them anyways
+                pieces.push_back(MakeConvexMesh(hull, AverageVertex(hull), true));
+            }
+        }
+        if (!pieces.empty()) {
+            return pieces;
+        }
+    }
+    else if (simplifyThreshold != 0) {
+        std::vector<glm::vec3> points;
+        points.reserve(triangles.size() * 3);
+        for (auto & triangle: triangles) {
+            points.insert(points.end(), triangle.begin(), triangle.end());
+        }
+
+        auto hull = ConvexHull(points, simplifyThreshold);
+        if (!hull.empty()) {
+            return {MakeConvexMesh(hull, AverageVertex(hull), true)};
+        }
+    }
+
+    // use the mesh as is (which means it had better be convex and centered on the origin, like the old physics meshes always had to be)
+    return {MakeConvexMesh(triangles, {0, 0, 0})};
 }
 
 void PhysicsMesh::RefreshMesh()
 {
     assert(origin != nullptr);
-    meshes = (me_when_i_so_i_but_then_i_so_i(origin, 1.0, false));
+    meshes = (me_when_i_so_i_but_then_i_so_i(origin, simplifyThreshold, convexDecomposition));
 }
 
-PhysicsMesh::PhysicsMesh(std::shared_ptr<Mesh>& mesh): 
+PhysicsMesh::PhysicsMesh(std::shared_ptr<Mesh>& mesh, unsigned int simplifyThreshold, bool convexDecomposition): 
+    meshes(me_when_i_so_i_but_then_i_so_i(mesh, simplifyThreshold, convexDecomposition)),
     origin(mesh->dynamic ? mesh : nullptr), 
-    meshes(me_when_i_so_i_but_then_i_so_i(mesh, 1.0, false))
+    simplifyThreshold(simplifyThreshold),
+    convexDecomposition(convexDecomposition)
 {
     
     //RefreshMesh();
@@ -281,7 +372,7 @@ glm::mat3x3 PhysicsMesh::CalculateLocalMomentOfInertia(glm::vec3 objectScale, fl
             // volume calc from https://math.stackexchange.com/questions/3616760/how-to-calculate-the-volume-of-tetrahedron-given-by-4-points
             float tetrahedronVolume = TetrahedronVolume(p1, p2, p3, {1.0, 1.0, 1.0});
             
-            float dot = glm::dot(triangleNormal, triangleCentroid); // We're checking if the triangle normal points towards the origin.
+            float dot = glm::dot(triangleNormal, triangleCentroid - convexMesh.center * objectScale); // We're checking if the triangle normal points towards the inside of the convex mesh (which for a decomposition piece might not have the origin in it).
             if (dot > 0.0) { // then the triangle's normal points away from the origin. 
                 volume += tetrahedronVolume;
             }
@@ -315,7 +406,7 @@ glm::mat3x3 PhysicsMesh::CalculateLocalMomentOfInertia(glm::vec3 objectScale, fl
 
             float tetrahedronMass = tetrahedronVolume * density;
 
-            float dot = glm::dot(triangleNormal, triangleCentroid); // We're checking if the triangle normal points towards the origin.
+            float dot = glm::dot(triangleNormal, triangleCentroid - convexMesh.center * objectScale); // same check as above
             if (dot < 0.0) { // then the triangle's normal points towards the origin and must be negated. 
                 tetrahedronMass *= -1;
                 tetrahedronVolume *= -1;
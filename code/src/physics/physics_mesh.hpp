@@ -1,3 +1,4 @@
+#pragma once
 #include <array>
 #include <memory>
 #include <atomic>
@@ -21,8 +22,9 @@ class PhysicsMesh {
     // Creates a physics mesh based on the vertices of the (graphical) mesh.
     // If the given mesh is dynamic, then changes to the mesh will affect the physics mesh automatically.
     // If you call this function twice with the same arguments, you'll (hopefully) get 2 pointers to the same PhysicsMesh.
-    // simplifyThreshold is TODO
-    // convexDecomposition is TODO
+    // If simplifyThreshold isn't 0, the physics mesh is the convex hull of the mesh (or of each convex piece, see below) with at most about simplifyThreshold triangles, instead of the mesh's triangles as is.
+    // If convexDecomposition is true, the mesh is split into convex pieces (approximately, see ApproximateConvexDecomposition()) so that concave meshes can collide properly.
+    // With the defaults, the mesh is used as is and had better be convex.
     static std::shared_ptr<PhysicsMesh> New(std::shared_ptr<Mesh>& mesh, unsigned int simplifyThreshold = 0, bool convexDecomposition = false);
 
     // TODO: CONSTRUCT FROM VERTICES
@@ -49,6 +51,17 @@ class PhysicsMesh {
         // SAT also needs edges annoyingly
         // each pair is two vertices
         std::vector<std::pair<glm::vec3, glm::vec3>> edges;
+
+        // Every vertex, without the duplicates that faces/triangles have, so that the GJK support function doesn't have to look at each vertex several times.
+        std::vector<glm::vec3> vertices;
+
+        // For each of vertices, the indices of the vertices it shares an edge with, but only if the triangles are a real convex hull (from ConvexHull()); empty otherwise.
+        // Then the support function can start anywhere and keep moving to whichever neighbour is farthest along the search direction until none are, instead of looking at every vertex.
+        // Meshes used as is are only supposed to be convex, and if they aren't (or have vertices in the middle of faces) that could get stuck short of the farthest vertex, so they get looked at vertex by vertex.
+        std::vector<std::vector<unsigned int>> neighbours;
+
+        // A point inside the convex mesh (in model space), used to tell which way faces point. It's the origin unless this is one piece of a convex decomposition.
+        glm::vec3 center = {0, 0, 0};
     };
 
     // To allow for accurate, fast, and simple collisions with concave and convex objects, stores a vector of convex meshes.
@@ -64,12 +77,23 @@ class PhysicsMesh {
     friend class Mesh;
     // overwrites "meshes" with new data
     void RefreshMesh();
-    PhysicsMesh(std::shared_ptr<Mesh>& mesh);
+    PhysicsMesh(std::shared_ptr<Mesh>& mesh, unsigned int simplifyThreshold, bool convexDecomposition);
 
     // nullptr if physicsMesh was not created from a Mesh object; used to refresh the mesh.
     std::shared_ptr<Mesh> origin = nullptr;
 
+    // what New() was called with, so RefreshMesh() makes the same kind of physics mesh
+    unsigned int simplifyThreshold;
+    bool convexDecomposition;
+
     // the moi for this mesh when it is 1x1x1 size. TODO, might not actually be possible to get scaled moi from unscaled moi, but if it is, would make nice optimization.
     // const glm::mat3x3 baseMomentOfInertia;
 
-};
\ No newline at end of file
+};
+
+// Makes a ConvexMesh out of the given triangles (which had better be convex), merging triangles with the same normal into faces. center is a point inside them, which is used to tell which way is out.
+// Pass isConvexHull = true only if the triangles came from ConvexHull(), which gives the ConvexMesh neighbours (see ConvexMesh::neighbours).
+PhysicsMesh::ConvexMesh MakeConvexMesh(const std::vector<std::array<glm::vec3, 3>>& triangles, glm::vec3 center, bool isConvexHull = false);
+
+// Sorts each face's vertices into clockwise order (looking at the face from outside), like MakeConvexMesh() does. center is a point inside the faces' mesh.
+void SortFaceVertices(std::vector<std::pair<glm::vec3, std::vector<glm::vec3>>>& faces, glm::vec3 center);
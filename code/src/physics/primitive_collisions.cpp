@@ -0,0 +1,568 @@
+#include "primitive_collisions.hpp"
+#include "debug/assert.hpp"
+#include "debug/log.hpp"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+#include "glm/gtx/norm.hpp"
+
+Primitive::Primitive(ColliderShape primitiveShape, const TransformComponent& transform):
+    Primitive(primitiveShape, transform.Position(), transform.Rotation(), transform.Scale())
+{
+
+}
+
+Primitive::Primitive(ColliderShape primitiveShape, glm::dvec3 position, glm::quat rotation, glm::dvec3 scale):
+    shape(primitiveShape),
+    center(position),
+    axes(glm::mat3_cast(rotation)),
+    halfExtents(0, 0, 0),
+    radius(0),
+    halfHeight(0)
+{
+    switch (shape) {
+        case ColliderShapeSphere:
+        radius = std::max({scale.x, scale.y, scale.z}) / 2.0;
+        break;
+        case ColliderShapeBox:
+        halfExtents = scale / 2.0;
+        break;
+        case ColliderShapeCapsule:
+        radius = std::max(scale.x, scale.z) / 2.0;
+        halfHeight = std::max(0.0, scale.y / 2.0 - radius);
+        break;
+        default:
+        break; // meshes only get a center and axes
+    }
+}
+
+glm::dvec3 Primitive::SegmentStart() const {
+    return center - axes[1] * halfHeight;
+}
+
+glm::dvec3 Primitive::SegmentEnd() const {
+    return center + axes[1] * halfHeight;
+}
+
+AABB PrimitiveAABB(const Primitive& primitive) {
+    glm::dvec3 extents;
+    switch (primitive.shape) {
+        case ColliderShapeSphere:
+        extents = glm::dvec3(primitive.radius);
+        break;
+        case ColliderShapeBox:
+        // each axis of the box reaches as far along each world axis as the absolute value of its component along it
+        for (unsigned int i = 0; i < 3; i++) {
+            extents[i] = std::abs(primitive.axes[0][i]) * primitive.halfExtents.x + std::abs(primitive.axes[1][i]) * primitive.halfExtents.y + std::abs(primitive.axes[2][i]) * primitive.halfExtents.z;
+        }
+        break;
+        case ColliderShapeCapsule:
+        extents = glm::abs(primitive.axes[1]) * primitive.halfHeight + glm::dvec3(primitive.radius);
+        break;
+        default:
+        DebugLogError("PrimitiveAABB() was given a mesh.");
+        abort();
+    }
+
+    extents *= AABB_FAT_FACTOR;
+    return AABB(primitive.center - extents, primitive.center + extents);
+}
+
+glm::dvec3 PrimitiveSupport(const Primitive& primitive, const glm::dvec3& directionInWorldSpace) {
+    switch (primitive.shape) {
+        case ColliderShapeSphere:
+        {
+            double length = glm::length(directionInWorldSpace);
+            if (length == 0) {
+                return primitive.center;
+            }
+            return primitive.center + directionInWorldSpace * (primitive.radius / length);
+        }
+        case ColliderShapeBox:
+        {
+            glm::dvec3 corner = primitive.center;
+            for (unsigned int i = 0; i < 3; i++) {
+                corner += primitive.axes[i] * (glm::dot(primitive.axes[i], directionInWorldSpace) >= 0 ? primitive.halfExtents[i] : -primitive.halfExtents[i]);
+            }
+            return corner;
+        }
+        case ColliderShapeCapsule:
+        {
+            glm::dvec3 end = glm::dot(primitive.axes[1], directionInWorldSpace) >= 0 ? primitive.SegmentEnd() : primitive.SegmentStart();
+            double length = glm::length(directionInWorldSpace);
+            if (length == 0) {
+                return end;
+            }
+            return end + directionInWorldSpace * (primitive.radius / length);
+        }
+        default:
+        DebugLogError("PrimitiveSupport() was given a mesh.");
+        abort();
+    }
+}
+
+const PhysicsMesh::ConvexMesh& UnitBoxHull() {
+    static const PhysicsMesh::ConvexMesh hull = []() {
+        PhysicsMesh::ConvexMesh box;
+
+        // bits 0, 1 and 2 of a corner's index say whether its x, y and z coordinates are positive
+        for (unsigned int i = 0; i < 8; i++) {
+            box.vertices.emplace_back((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+        }
+
+        // corners that share an edge only differ in one coordinate
+        box.neighbours.resize(8);
+        for (unsigned int i = 0; i < 8; i++) {
+            for (unsigned int axis = 0; axis < 3; axis++) {
+                unsigned int neighbour = i ^ (1u << axis);
+                box.neighbours[i].push_back(neighbour);
+                if (i < neighbour) {
+                    box.edges.emplace_back(box.vertices[i], box.vertices[neighbour]);
+                }
+            }
+        }
+
+        // for each face, go around its corners in order by flipping the bits of the other two axes one at a time
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            unsigned int u = 1u << ((axis + 1) % 3);
+            unsigned int v = 1u << ((axis + 2) % 3);
+            for (unsigned int side = 0; side < 2; side++) {
+                unsigned int first = side == 1 ? (1u << axis) : 0;
+                glm::vec3 normal(0, 0, 0);
+                normal[axis] = side == 1 ? 1.0f : -1.0f;
+
+                std::vector<glm::vec3> corners = {box.vertices[first], box.vertices[first | u], box.vertices[first | u | v], box.vertices[first | v]};
+                box.triangles.push_back({corners[0], corners[1], corners[2]});
+                box.triangles.push_back({corners[0], corners[2], corners[3]});
+                box.faces.emplace_back(normal, std::move(corners));
+            }
+        }
+
+        return box;
+    }();
+
+    return hull;
+}
+
+bool HasDedicatedCollision(ColliderShape shape1, ColliderShape shape2) {
+    return shape1 != ColliderShapeMesh && shape2 != ColliderShapeMesh && shape1 != ColliderShapeHeightfield && shape2 != ColliderShapeHeightfield && !(shape1 == ColliderShapeBox && shape2 == ColliderShapeBox);
+}
+
+namespace {
+    // One point where two shapes touch.
+    struct Contact {
+        glm::dvec3 normal; // out of the first shape towards the second
+        glm::dvec3 point;
+        double depth;
+    };
+
+    // Spheres are the building block for everything else here, since capsules are just spheres swept along a line segment.
+    std::optional<Contact> CollideSpheres(const glm::dvec3& center1, double radius1, const glm::dvec3& center2, double radius2) {
+        glm::dvec3 offset = center2 - center1;
+        double distance = glm::length(offset);
+        double depth = radius1 + radius2 - distance;
+        if (depth <= 0) {
+            return std::nullopt;
+        }
+
+        // if the centers are in the same place then every direction is equally good
+        glm::dvec3 normal = distance > 0 ? offset / distance : glm::dvec3(0, 1, 0);
+
+        // halfway between the deepest points of each sphere
+        return Contact {.normal = normal, .point = ((center1 + normal * radius1) + (center2 - normal * radius2)) * 0.5, .depth = depth};
+    }
+
+    // Collides a sphere with a box. The normal faces out of the box.
+    std::optional<Contact> CollideBoxSphere(const Primitive& box, const glm::dvec3& center, double radius) {
+        glm::dvec3 local = glm::transpose(box.axes) * (center - box.center);
+        glm::dvec3 clamped = glm::clamp(local, -box.halfExtents, box.halfExtents);
+
+        if (local != clamped) {
+            // center is outside the box, so clamping it gave the closest point on the box
+            glm::dvec3 closest = box.center + box.axes * clamped;
+            glm::dvec3 offset = center - closest;
+            double distance = glm::length(offset);
+            double depth = radius - distance;
+            if (depth <= 0) {
+                return std::nullopt;
+            }
+
+            glm::dvec3 normal = offset / distance;
+            return Contact {.normal = normal, .point = ((center - normal * radius) + closest) * 0.5, .depth = depth};
+        }
+
+        // center is inside the box, so push it out through the closest face
+        unsigned int closestAxis = 0;
+        double faceDistance = DBL_MAX;
+        for (unsigned int i = 0; i < 3; i++) {
+            double distance = box.halfExtents[i] - std::abs(local[i]);
+            if (distance < faceDistance) {
+                faceDistance = distance;
+                closestAxis = i;
+            }
+        }
+
+        glm::dvec3 normal = box.axes[closestAxis] * (local[closestAxis] >= 0 ? 1.0 : -1.0);
+        glm::dvec3 pointOnFace = center + normal * faceDistance;
+        return Contact {.normal = normal, .point = ((center - normal * radius) + pointOnFace) * 0.5, .depth = radius + faceDistance};
+    }
+
+    // Negative inside the box.
+    double BoxSignedDistance(const Primitive& box, const glm::dvec3& point) {
+        glm::dvec3 q = glm::abs(glm::transpose(box.axes) * (point - box.center)) - box.halfExtents;
+        return glm::length(glm::max(q, 0.0)) + std::min(std::max({q.x, q.y, q.z}), 0.0);
+    }
+
+    glm::dvec3 ClosestPointOnSegment(const glm::dvec3& start, const glm::dvec3& end, const glm::dvec3& point) {
+        glm::dvec3 segment = end - start;
+        double lengthSquared = glm::dot(segment, segment);
+        if (lengthSquared == 0) {
+            return start;
+        }
+        return start + segment * std::clamp(glm::dot(point - start, segment) / lengthSquared, 0.0, 1.0);
+    }
+
+    // Returns the closest pair of points on segments start1-end1 and start2-end2, from Real-Time Collision Detection (Ericson) section 5.1.9.
+    std::pair<glm::dvec3, glm::dvec3> ClosestPointsOnSegments(const glm::dvec3& start1, const glm::dvec3& end1, const glm::dvec3& start2, const glm::dvec3& end2) {
+        const double EPSILON = 1.0e-12; // segments shorter than this are points
+
+        glm::dvec3 d1 = end1 - start1;
+        glm::dvec3 d2 = end2 - start2;
+        glm::dvec3 r = start1 - start2;
+        double a = glm::dot(d1, d1);
+        double e = glm::dot(d2, d2);
+        double f = glm::dot(d2, r);
+
+        double s, t; // how far along each segment the closest points are, from 0 to 1
+        if (a <= EPSILON && e <= EPSILON) {
+            return {start1, start2};
+        }
+        if (a <= EPSILON) {
+            s = 0;
+            t = std::clamp(f / e, 0.0, 1.0);
+        }
+        else {
+            double c = glm::dot(d1, r);
+            if (e <= EPSILON) {
+                t = 0;
+                s = std::clamp(-c / a, 0.0, 1.0);
+            }
+            else {
+                double b = glm::dot(d1, d2);
+                double denominator = a * e - b * b;
+
+                // if the segments are parallel any s works, so just use 0
+                s = denominator != 0 ? std::clamp((b * f - c * e) / denominator, 0.0, 1.0) : 0.0;
+                t = (b * s + f) / e;
+                if (t < 0) {
+                    t = 0;
+                    s = std::clamp(-c / a, 0.0, 1.0);
+                }
+                else if (t > 1) {
+                    t = 1;
+                    s = std::clamp((b - c) / a, 0.0, 1.0);
+                }
+            }
+        }
+
+        return {start1 + d1 * s, start2 + d2 * t};
+    }
+
+    // Turns the contacts found between two shapes into collision (reusing its contact points' storage), or returns false if none of them were touching.
+    // The deepest contact decides the normal, and the rest are only kept if they (nearly) agree with it, so that a capsule lying flat on something gets a contact point at each end instead of rocking around one.
+    bool CombineContacts(std::initializer_list<std::optional<Contact>> contacts, CollisionInfo& collision) {
+        const double SAME_NORMAL_THRESHOLD = 0.99; // dot product
+        const double SAME_POINT_DISTANCE = 0.001; // contacts closer than this to one that was already kept are redundant
+
+        const Contact* deepest = nullptr;
+        for (auto & contact: contacts) {
+            if (contact && (deepest == nullptr || contact->depth > deepest->depth)) {
+                deepest = &*contact;
+            }
+        }
+        if (deepest == nullptr) {
+            return false;
+        }
+
+        collision.collisionNormal = deepest->normal;
+        collision.contactPoints.clear();
+        collision.contactPoints.emplace_back(deepest->point, deepest->depth);
+        for (auto & contact: contacts) {
+            if (!contact || &*contact == deepest || glm::dot(contact->normal, deepest->normal) < SAME_NORMAL_THRESHOLD) {
+                continue;
+            }
+
+            bool redundant = false;
+            for (auto & [point, depth]: collision.contactPoints) {
+                if (glm::length2(point - contact->point) < SAME_POINT_DISTANCE * SAME_POINT_DISTANCE) {
+                    redundant = true;
+                }
+            }
+            if (!redundant) {
+                collision.contactPoints.emplace_back(contact->point, contact->depth);
+            }
+        }
+
+        return true;
+    }
+
+    bool CollideSphereSphere(const Primitive& sphere1, const Primitive& sphere2, CollisionInfo& collision) {
+        return CombineContacts({CollideSpheres(sphere1.center, sphere1.radius, sphere2.center, sphere2.radius)}, collision);
+    }
+
+    bool CollideSphereBox(const Primitive& sphere, const Primitive& box, CollisionInfo& collision) {
+        auto contact = CollideBoxSphere(box, sphere.center, sphere.radius);
+        if (contact) {
+            contact->normal = -contact->normal;
+        }
+        return CombineContacts({contact}, collision);
+    }
+
+    bool CollideSphereCapsule(const Primitive& sphere, const Primitive& capsule, CollisionInfo& collision) {
+        glm::dvec3 closest = ClosestPointOnSegment(capsule.SegmentStart(), capsule.SegmentEnd(), sphere.center);
+        return CombineContacts({CollideSpheres(sphere.center, sphere.radius, closest, capsule.radius)}, collision);
+    }
+
+    // Treats the capsule as spheres at each end of its segment and at the point on its segment that's deepest in the box.
+    bool CollideBoxCapsule(const Primitive& box, const Primitive& capsule, CollisionInfo& collision) {
+        const unsigned int SEARCH_ITERATIONS = 40; // each one cuts the search range by a third
+
+        glm::dvec3 start = capsule.SegmentStart();
+        glm::dvec3 end = capsule.SegmentEnd();
+
+        // The signed distance to a convex shape is a convex function, so it only has one minimum along the segment, which a ternary search finds.
+        double low = 0, high = 1;
+        for (unsigned int i = 0; i < SEARCH_ITERATIONS; i++) {
+            double third1 = low + (high - low) / 3.0;
+            double third2 = high - (high - low) / 3.0;
+            if (BoxSignedDistance(box, start + (end - start) * third1) < BoxSignedDistance(box, start + (end - start) * third2)) {
+                high = third2;
+            }
+            else {
+                low = third1;
+            }
+        }
+        glm::dvec3 deepest = start + (end - start) * ((low + high) / 2.0);
+
+        return CombineContacts({
+            CollideBoxSphere(box, deepest, capsule.radius),
+            CollideBoxSphere(box, start, capsule.radius),
+            CollideBoxSphere(box, end, capsule.radius)
+        }, collision);
+    }
+
+    // Besides the closest points between the two segments, also tries each end of each segment against the other segment, which is what gives parallel capsules two contact points.
+    bool CollideCapsuleCapsule(const Primitive& capsule1, const Primitive& capsule2, CollisionInfo& collision) {
+        glm::dvec3 start1 = capsule1.SegmentStart();
+        glm::dvec3 end1 = capsule1.SegmentEnd();
+        glm::dvec3 start2 = capsule2.SegmentStart();
+        glm::dvec3 end2 = capsule2.SegmentEnd();
+
+        auto [closest1, closest2] = ClosestPointsOnSegments(start1, end1, start2, end2);
+        return CombineContacts({
+            CollideSpheres(closest1, capsule1.radius, closest2, capsule2.radius),
+            CollideSpheres(start1, capsule1.radius, ClosestPointOnSegment(start2, end2, start1), capsule2.radius),
+            CollideSpheres(end1, capsule1.radius, ClosestPointOnSegment(start2, end2, end1), capsule2.radius),
+            CollideSpheres(ClosestPointOnSegment(start1, end1, start2), capsule1.radius, start2, capsule2.radius),
+            CollideSpheres(ClosestPointOnSegment(start1, end1, end2), capsule1.radius, end2, capsule2.radius)
+        }, collision);
+    }
+}
+
+bool CollidePrimitives(const Primitive& primitive1, const Primitive& primitive2, CollisionInfo& collision) {
+    Assert(HasDedicatedCollision(primitive1.shape, primitive2.shape));
+
+    // the functions above only take each pair of shapes one way around (in the order of the ColliderShape enum), so swap the primitives if needed and flip the normal back
+    if (primitive1.shape > primitive2.shape) {
+        if (!CollidePrimitives(primitive2, primitive1, collision)) {
+            return false;
+        }
+        collision.collisionNormal = -collision.collisionNormal;
+        return true;
+    }
+
+    if (primitive1.shape == ColliderShapeSphere) {
+        switch (primitive2.shape) {
+            case ColliderShapeSphere:
+            return CollideSphereSphere(primitive1, primitive2, collision);
+            case ColliderShapeBox:
+            return CollideSphereBox(primitive1, primitive2, collision);
+            case ColliderShapeCapsule:
+            return CollideSphereCapsule(primitive1, primitive2, collision);
+            default:
+            break;
+        }
+    }
+    else if (primitive1.shape == ColliderShapeBox && primitive2.shape == ColliderShapeCapsule) {
+        return CollideBoxCapsule(primitive1, primitive2, collision);
+    }
+    else if (primitive1.shape == ColliderShapeCapsule && primitive2.shape == ColliderShapeCapsule) {
+        return CollideCapsuleCapsule(primitive1, primitive2, collision);
+    }
+
+    DebugLogError("CollidePrimitives() has no routine for shapes ", primitive1.shape, " and ", primitive2.shape);
+    abort();
+}
+
+namespace {
+    // Where a ray goes into and comes out of a convex shape (in multiples of its direction), and the shape's outward surface normal at each. enter > exit if it misses.
+    struct RaySpan {
+        double enter = INFINITY;
+        double exit = -INFINITY;
+        glm::dvec3 enterNormal = glm::dvec3(0, 0, 0);
+        glm::dvec3 exitNormal = glm::dvec3(0, 0, 0);
+    };
+
+    // Widens span to cover part, for shapes made of overlapping convex parts that are convex as a whole (capsules).
+    // The ray goes into the whole shape where it goes into the first part, and comes out where it leaves the last one.
+    void MergeRaySpan(RaySpan& span, const RaySpan& part) {
+        if (part.enter < span.enter) {
+            span.enter = part.enter;
+            span.enterNormal = part.enterNormal;
+        }
+        if (part.exit > span.exit) {
+            span.exit = part.exit;
+            span.exitNormal = part.exitNormal;
+        }
+    }
+
+    RaySpan RaySphere(const glm::dvec3& origin, const glm::dvec3& direction, const glm::dvec3& center, double radius) {
+        RaySpan span;
+        glm::dvec3 offset = origin - center;
+        double a = glm::dot(direction, direction);
+        double b = glm::dot(offset, direction);
+        double c = glm::dot(offset, offset) - radius * radius;
+        double discriminant = b * b - a * c;
+        if (radius <= 0 || a == 0 || discriminant < 0) {
+            return span;
+        }
+
+        double root = std::sqrt(discriminant);
+        span.enter = (-b - root) / a;
+        span.exit = (-b + root) / a;
+        span.enterNormal = (offset + direction * span.enter) / radius;
+        span.exitNormal = (offset + direction * span.exit) / radius;
+        return span;
+    }
+
+    // slab test in the box's own space
+    RaySpan RayBox(const Primitive& box, const glm::dvec3& origin, const glm::dvec3& direction) {
+        glm::dvec3 localOrigin = glm::transpose(box.axes) * (origin - box.center);
+        glm::dvec3 localDirection = glm::transpose(box.axes) * direction;
+
+        RaySpan span;
+        span.enter = -INFINITY;
+        span.exit = INFINITY;
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            if (localDirection[axis] == 0) {
+                if (std::abs(localOrigin[axis]) > box.halfExtents[axis]) {
+                    return RaySpan(); // parallel to this slab and outside it
+                }
+                continue;
+            }
+
+            // the ray goes in through the face on the side it's coming from, and out through the opposite one
+            double sign = std::copysign(1.0, localDirection[axis]);
+            double enter = (-sign * box.halfExtents[axis] - localOrigin[axis]) / localDirection[axis];
+            double exit = (sign * box.halfExtents[axis] - localOrigin[axis]) / localDirection[axis];
+            if (enter > span.enter) {
+                span.enter = enter;
+                span.enterNormal = box.axes[axis] * -sign;
+            }
+            if (exit < span.exit) {
+                span.exit = exit;
+                span.exitNormal = box.axes[axis] * sign;
+            }
+        }
+
+        if (span.enter > span.exit) {
+            return RaySpan();
+        }
+        return span;
+    }
+
+    // a sphere at each end of the segment, plus the side of the cylinder between them
+    RaySpan RayCapsule(const Primitive& capsule, const glm::dvec3& origin, const glm::dvec3& direction) {
+        glm::dvec3 start = capsule.SegmentStart();
+        RaySpan span = RaySphere(origin, direction, start, capsule.radius);
+        MergeRaySpan(span, RaySphere(origin, direction, capsule.SegmentEnd(), capsule.radius));
+
+        // The cylinder's side only counts where it's between the ends, the rest of the infinite cylinder is outside the capsule.
+        // Rays parallel to the segment never cross the side, but the spheres already cover how far they go through.
+        glm::dvec3 axis = capsule.axes[1];
+        glm::dvec3 offset = origin - start;
+        glm::dvec3 perpendicularOffset = offset - axis * glm::dot(offset, axis);
+        glm::dvec3 perpendicularDirection = direction - axis * glm::dot(direction, axis);
+        double a = glm::dot(perpendicularDirection, perpendicularDirection);
+        double b = glm::dot(perpendicularOffset, perpendicularDirection);
+        double c = glm::dot(perpendicularOffset, perpendicularOffset) - capsule.radius * capsule.radius;
+        double discriminant = b * b - a * c;
+        if (capsule.radius <= 0 || a == 0 || discriminant < 0) {
+            return span;
+        }
+
+        double root = std::sqrt(discriminant);
+        RaySpan side;
+        auto betweenEnds = [&](double distance) {
+            double along = glm::dot(offset + direction * distance, axis);
+            return along >= 0 && along <= capsule.halfHeight * 2.0;
+        };
+        double enter = (-b - root) / a;
+        double exit = (-b + root) / a;
+        if (betweenEnds(enter)) {
+            side.enter = enter;
+            side.enterNormal = (perpendicularOffset + perpendicularDirection * enter) / capsule.radius;
+        }
+        if (betweenEnds(exit)) {
+            side.exit = exit;
+            side.exitNormal = (perpendicularOffset + perpendicularDirection * exit) / capsule.radius;
+        }
+        MergeRaySpan(span, side);
+        return span;
+    }
+}
+
+double PrimitiveRayDistance(const Primitive& primitive, const glm::dvec3& origin, const glm::dvec3& direction, double maxDistance, glm::dvec3& normal) {
+    // same as TriangleRayDistance(), the ray has to actually go somewhere before it hits anything
+    const double EPSILON = 0.0000001;
+
+    RaySpan span;
+    switch (primitive.shape) {
+        case ColliderShapeSphere:
+        span = RaySphere(origin, direction, primitive.center, primitive.radius);
+        break;
+        case ColliderShapeBox:
+        span = RayBox(primitive, origin, direction);
+        break;
+        case ColliderShapeCapsule:
+        span = RayCapsule(primitive, origin, direction);
+        break;
+        default:
+        DebugLogError("PrimitiveRayDistance() was given a mesh.");
+        abort();
+    }
+
+    if (span.enter > span.exit) {
+        return INFINITY;
+    }
+
+    double distance;
+    if (span.enter > EPSILON) {
+        distance = span.enter;
+        normal = span.enterNormal;
+    }
+    else if (span.exit > EPSILON) {
+        // started inside, so it hits where it comes out, with the normal facing the ray (like rays that start inside a mesh hit its far side)
+        distance = span.exit;
+        normal = -span.exitNormal;
+    }
+    else {
+        return INFINITY;
+    }
+
+    return distance <= maxDistance ? distance : INFINITY;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "collider_shape.hpp"
+#include "gjk.hpp"
+#include <glm/mat3x3.hpp>
+
+// Primitive colliders are spheres, boxes and capsules, which unlike meshes can have their AABBs, support points and most of their collisions worked out directly instead of by looking at vertices.
+// Like meshes, they're sized by their transform's scale, fitting inside the same 1x1x1 cube (scaled by the transform) that CubeMesh() fills:
+    // - a sphere's diameter is the largest component of the scale
+    // - a box is that whole scaled cube
+    // - a capsule runs along its local y axis, with a diameter of the larger of the x and z scale, and is as tall as the y scale (but never shorter than its diameter)
+
+// A primitive collider put in world space.
+struct Primitive {
+    ColliderShape shape;
+    glm::dvec3 center;
+
+    // columns are the primitive's local x, y and z axes in world space, unit length
+    glm::dmat3 axes;
+
+    // boxes only
+    glm::dvec3 halfExtents;
+
+    // spheres and capsules only
+    double radius;
+
+    // capsules only, half the length of the line segment down the middle of the capsule (which the capsule is everything within radius of)
+    double halfHeight;
+
+    Primitive(ColliderShape primitiveShape, const TransformComponent& transform);
+
+    // For primitives that aren't colliders (like the shapes used by BatchSphereCast()/BatchBoxCast()); scale sizes the primitive just like a transform's scale would.
+    Primitive(ColliderShape primitiveShape, glm::dvec3 position, glm::quat rotation, glm::dvec3 scale);
+
+    // capsules only, the ends of the line segment down the middle of the capsule
+    glm::dvec3 SegmentStart() const;
+    glm::dvec3 SegmentEnd() const;
+};
+
+// Returns the smallest AABB containing the primitive.
+AABB PrimitiveAABB(const Primitive& primitive);
+
+// The GJK support function for primitives; returns the point on the primitive (in world space) that's farthest along the direction.
+glm::dvec3 PrimitiveSupport(const Primitive& primitive, const glm::dvec3& directionInWorldSpace);
+
+// The 1x1x1 cube, centered at the origin. Boxes use this as their hull when they go through GJK, so that they get SAT and face clipping for contact points just like a cube mesh would.
+const PhysicsMesh::ConvexMesh& UnitBoxHull();
+
+// Returns true if CollidePrimitives() handles colliders with these shapes; the rest go through GJK.
+bool HasDedicatedCollision(ColliderShape shape1, ColliderShape shape2);
+
+// Same as IsColliding() (the one that writes into collision), but for two primitives that HasDedicatedCollision() is true for.
+// The collision normal faces out of primitive1 towards primitive2.
+bool CollidePrimitives(const Primitive& primitive1, const Primitive& primitive2, CollisionInfo& collision);
+
+// Returns how far along a ray (in world space) it hits the primitive, in multiples of direction, or INFINITY if it doesn't before maxDistance.
+// Exact, unlike testing the triangles of a mesh shaped like it. If it hits, normal is set to the surface normal where it hit, facing the ray.
+// Rays that start inside the primitive hit it where they come out, like rays that start inside a mesh hit its far side.
+double PrimitiveRayDistance(const Primitive& primitive, const glm::dvec3& origin, const glm::dvec3& direction, double maxDistance, glm::dvec3& normal);
@@ -3,102 +3,190 @@
 #define GLM_FORCE_SWIZZLE
 #include "raycast.hpp"
 #include "spatial_acceleration_structure.hpp"
+#include "gjk.hpp"
+#include "primitive_collisions.hpp"
+#include "heightfield.hpp"
+#include <algorithm>
 #include <cstdio>
 #include <vector>
 #include "utility/triangle_intersection.hpp"
 #include "glm/gtx/string_cast.hpp"
+#include "gameobjects/collider_component.hpp"
 
 glm::dvec3 GetTriangleNormal(glm::dvec3 triVertex0, glm::dvec3 triVertex1, glm::dvec3 triVertex2) {
     return glm::normalize(glm::cross((triVertex1 - triVertex0), (triVertex2 - triVertex0)));
 }
 
-// TODO: max distance for perf?
-// TODO: IGNORES ANIMATION, FIX
-RaycastResult Raycast(glm::dvec3 origin, glm::dvec3 direction, CollisionLayerSet layers) {
-    auto possible_colliding = SpatialAccelerationStructure::Get().Query(origin, direction, layers);
-    // std::printf("Ray might be hitting ");
-    // for (auto & collider: possible_colliding) {
-    //     std::cout << collider->GetGameObject()->name << " ";
-    // }
-    // std::printf("\n");
-    //std::printf("muy guy %f %f %f\n", direction.x, direction.y, direction.z);
-    
-    //DebugLogInfo("Maybe hitting ", possible_colliding.size());
-    //if (possible_colliding.empty()) {
-        //DebugLogInfo("muy guy ", direction);
-    //}
-
-    // for every convex piece of every object's mesh, there are two hit triangles, and one of them is discarded through backface culling.
-    // we'll then look thru the hit triangles/their objects to figure out which one the ray hit first.
-    std::vector<RaycastResult> hitTriangles;
-    
-    for (auto & comp: possible_colliding) {
-        auto& mesh = comp->physicsMesh;
-        auto obj = comp->GetGameObject();
-        Assert(obj != nullptr);
-        // std::cout << "Could be colliding with " << obj->name << ".\n";
-        auto modelMatrix = obj->Get<TransformComponent>()->GetPhysicsModelMatrix();
-
-        for (auto & convexMesh: mesh->meshes) {
-            for (auto & triangle: convexMesh.triangles) {
-
-                // need to put vertices in world space to raycast against
-                glm::dvec3 trianglePoints[3];
-                for (unsigned int j = 0; j < 3; j++) {
-                    trianglePoints[j] = (modelMatrix * glm::dvec4(triangle[j], 1)).xyz();
-                }
-
-                auto normal = GetTriangleNormal(trianglePoints[0], trianglePoints[1], trianglePoints[2]);
-                
-                
-                // TODO rework physics_mesh.cpp so that triangles have clockwise winding; in the meantime we have to check normals because sometimes they backwards
-                // TODO i thought i already did?
-                
-                // making normals always face away from the center of the mesh is an awful idea, what was I on?
-                //if (glm::dot(normal, trianglePoints[0] - obj->Get<TransformComponent>()->Position()) < 0) { 
-                    //normal *= -1;
-                //}
-
-                // backface culling so that we hit the right triangle (TODO: NEED CLOCKWISE WINDING FIRST)
-                //if (glm::dot(normal, direction) < 0) { // works according to https://en.wikipedia.org/wiki/Back-face_culling
-                    //std::cout << "Passed backface culling.\n";
-                    // std::printf("Triangle has points %f %f %f, %f %f %f, and %f %f %f, the normal is %f %f %f\n.", trianglePoints[0][0], trianglePoints[0][1], trianglePoints[0][2], trianglePoints[1][0], trianglePoints[1][1], trianglePoints[1][2], trianglePoints[2][0], trianglePoints[2][1], trianglePoints[2][2], normal.x, normal.y, normal.z);
-                    glm::dvec3 intersectionPoint;
-
-                    // TODO: IsTriangleColliding() might (?) independently calculate the normal which is waste of resources? compiler could probably optimize out that but idk        
-                    if (IsTriangleColliding(origin, direction, trianglePoints[0], trianglePoints[1], trianglePoints[2], intersectionPoint)) {
-                        //std::cout << "Ray intersects object at " << obj << " named " << obj->name << "\n";
-                        hitTriangles.push_back({.hitPoint = intersectionPoint, .hitNormal = normal, .hitObject = obj});
-                        goto foundTriangle;
-                    }
-                //}
-                
-            }
+// Tests one ray against one collider. If it hits before result.hitDistance and ray.maxDistance, puts the hit in result (all but hitObject) and returns true.
+bool RayHitCollider(const RayQuery& ray, const ColliderComponent& collider, RaycastResult& result) {
+    Assert(collider.gameobject != nullptr);
 
-            foundTriangle:;
+    if (collider.shape == ColliderShapeHeightfield) {
+        // heightfields have no triangles, the ray just marches over their cells
+        glm::dvec3 normal;
+        double distance = collider.heightfield->RayDistance(*collider.gameobject->Get<TransformComponent>(), ray.origin, ray.direction, std::min(result.hitDistance, ray.maxDistance), normal);
+        if (distance < result.hitDistance) {
+            result.hitPoint = ray.origin + ray.direction * distance;
+            result.hitNormal = normal;
+            result.hitDistance = distance;
+            return true;
         }
+        return false;
+    }
 
-        
+    if (collider.shape != ColliderShapeMesh) {
+        // primitives get hit exactly, instead of by the triangles of whatever mesh they were made with (which a sphere's or capsule's physics mesh only roughly matches)
+        glm::dvec3 normal;
+        double distance = PrimitiveRayDistance(Primitive(collider.shape, *collider.gameobject->Get<TransformComponent>()), ray.origin, ray.direction, std::min(result.hitDistance, ray.maxDistance), normal);
+        if (distance < result.hitDistance) {
+            result.hitPoint = ray.origin + ray.direction * distance;
+            result.hitNormal = normal;
+            result.hitDistance = distance;
+            return true;
+        }
+        return false;
     }
 
-    if (hitTriangles.size() == 0) { // If there were no hit triangles then yeah
+    auto modelMatrix = collider.gameobject->Get<TransformComponent>()->GetPhysicsModelMatrix();
 
-        return RaycastResult {.hitObject = nullptr};
-    }
-    else { // else go through them to decide which triangle was hit first and return that one
-        // closest hit point is first hit triangle
-        double closestDistance = FLT_MAX;
-        RaycastResult bestResult;
-        for (auto & result: hitTriangles) {
-            double distance = glm::length2(origin - result.hitPoint);
-            // std::cout << "Considering object normal " << glm::to_string(result.hitNormal) << " named " << result.hitObject->name << " with distance " << distance << " vs closest " << closestDistance << "\n";
+    // Instead of putting every triangle in world space, put the ray in model space.
+    // The direction isn't renormalized afterwards, so distances along it are still world space distances.
+    auto worldToModel = glm::inverse(modelMatrix);
+    glm::dvec3 origin = (worldToModel * glm::dvec4(ray.origin, 1)).xyz();
+    glm::dvec3 direction = (worldToModel * glm::dvec4(ray.direction, 0)).xyz();
+
+    // unlike collisions, rays don't care whether the mesh is convex, so just test every triangle of every piece and keep the closest
+    double closestDistance = std::min(result.hitDistance, ray.maxDistance);
+    const std::array<glm::vec3, 3>* closestTriangle = nullptr;
+    for (auto & convexMesh: collider.physicsMesh->meshes) {
+        for (auto & triangle: convexMesh.triangles) {
+            double distance = TriangleRayDistance(origin, direction, triangle[0], triangle[1], triangle[2]);
             if (distance < closestDistance) {
                 closestDistance = distance;
-                bestResult = result;
+                closestTriangle = &triangle;
             }
         }
+    }
+
+    if (closestTriangle) {
+        // normals go to world space with the inverse transpose, and should face the ray since we hit the side facing the ray
+        glm::dvec3 normal = GetTriangleNormal((*closestTriangle)[0], (*closestTriangle)[1], (*closestTriangle)[2]);
+        normal = glm::normalize(glm::transpose(glm::dmat3(worldToModel)) * normal);
+        if (glm::dot(normal, ray.direction) > 0) {
+            normal *= -1;
+        }
+
+        result.hitPoint = ray.origin + ray.direction * closestDistance;
+        result.hitNormal = normal;
+        result.hitDistance = closestDistance;
+        return true;
+    }
+
+    return false;
+}
+
+RaycastResult Raycast(glm::dvec3 origin, glm::dvec3 direction, CollisionLayerSet layers) {
+    // one ray doesn't need any of BatchRaycast()'s vectors
+    RayQuery ray {.origin = origin, .direction = glm::normalize(direction), .layers = layers};
+    SpatialAccelerationStructure::Cast cast {.origin = ray.origin, .direction = ray.direction, .maxDistance = ray.maxDistance, .padding = 0, .layers = ray.layers};
+
+    RaycastResult result {.hitObject = nullptr};
+    ColliderComponent* hitCollider = nullptr;
+    SpatialAccelerationStructure::Get().CastBatch(&cast, 1, [&ray, &result, &hitCollider](unsigned int, ColliderComponent* collider) {
+        if (RayHitCollider(ray, *collider, result)) {
+            hitCollider = collider;
+        }
+        return result.hitDistance;
+    });
+
+    if (hitCollider) {
+        result.hitObject = hitCollider->GetGameObject();
+    }
+    return result;
+}
+
+// TODO: IGNORES ANIMATION, FIX
+void BatchRaycast(const std::vector<RayQuery>& rays, std::vector<RaycastResult>& results) {
+    // kept between calls (per thread, since rays get cast from several) so that batches don't allocate
+    thread_local std::vector<SpatialAccelerationStructure::Cast> casts;
+    thread_local std::vector<ColliderComponent*> hitColliders;
+
+    casts.clear();
+    for (auto & ray: rays) {
+        casts.push_back({.origin = ray.origin, .direction = ray.direction, .maxDistance = ray.maxDistance, .padding = 0, .layers = ray.layers});
+    }
+
+    results.assign(rays.size(), RaycastResult {.hitObject = nullptr});
+    hitColliders.assign(rays.size(), nullptr);
+
+    SpatialAccelerationStructure::Get().CastBatch(casts, [&rays, &results](unsigned int rayIndex, ColliderComponent* collider) {
+        if (RayHitCollider(rays[rayIndex], *collider, results[rayIndex])) {
+            hitColliders[rayIndex] = collider;
+        }
+        return results[rayIndex].hitDistance;
+    });
+
+    for (unsigned int i = 0; i < rays.size(); i++) {
+        if (hitColliders[i]) {
+            results[i].hitObject = hitColliders[i]->GetGameObject();
+        }
+    }
+}
+
+// BatchSphereCast() and BatchBoxCast() are the same thing other than the shapes.
+// Each cast's padding should be the radius of a sphere containing its shape, so the SAS doesn't skip anything the shape could touch.
+void BatchShapeCast(const std::vector<Primitive>& shapes, const std::vector<SpatialAccelerationStructure::Cast>& casts, std::vector<RaycastResult>& results) {
+    thread_local std::vector<ColliderComponent*> hitColliders; // see BatchRaycast()
+
+    results.assign(casts.size(), RaycastResult {.hitObject = nullptr});
+    hitColliders.assign(casts.size(), nullptr);
+
+    SpatialAccelerationStructure::Get().CastBatch(casts, [&shapes, &casts, &results](unsigned int castIndex, ColliderComponent* collider) {
+        const SpatialAccelerationStructure::Cast& cast = casts[castIndex];
+        RaycastResult& result = results[castIndex];
+        Assert(collider->gameobject != nullptr);
+        const TransformComponent& transform = *collider->gameobject->Get<TransformComponent>();
+
+        auto hit = ShapeCast(transform, *collider, shapes[castIndex], cast.direction, std::min(result.hitDistance, cast.maxDistance));
+        if (hit && hit->distance < result.hitDistance) {
+            result.hitPoint = hit->point;
+            result.hitNormal = hit->normal;
+            result.hitDistance = hit->distance;
+            hitColliders[castIndex] = collider;
+        }
+
+        return result.hitDistance;
+    });
+
+    for (unsigned int i = 0; i < casts.size(); i++) {
+        if (hitColliders[i]) {
+            results[i].hitObject = hitColliders[i]->GetGameObject();
+        }
+    }
+}
 
-        return bestResult;
+void BatchSphereCast(const std::vector<SphereCastQuery>& sphereCasts, std::vector<RaycastResult>& results) {
+    thread_local std::vector<Primitive> shapes; // see BatchRaycast()
+    thread_local std::vector<SpatialAccelerationStructure::Cast> casts;
+    shapes.clear();
+    casts.clear();
+    for (auto & sphereCast: sphereCasts) {
+        shapes.emplace_back(ColliderShapeSphere, sphereCast.origin, glm::quat(1, 0, 0, 0), glm::dvec3(sphereCast.radius * 2.0));
+        casts.push_back({.origin = sphereCast.origin, .direction = sphereCast.direction, .maxDistance = sphereCast.maxDistance, .padding = sphereCast.radius, .layers = sphereCast.layers});
     }
-    
-}
\ No newline at end of file
+
+    BatchShapeCast(shapes, casts, results);
+}
+
+void BatchBoxCast(const std::vector<BoxCastQuery>& boxCasts, std::vector<RaycastResult>& results) {
+    thread_local std::vector<Primitive> shapes; // see BatchRaycast()
+    thread_local std::vector<SpatialAccelerationStructure::Cast> casts;
+    shapes.clear();
+    casts.clear();
+    for (auto & boxCast: boxCasts) {
+        shapes.emplace_back(ColliderShapeBox, boxCast.origin, boxCast.rotation, boxCast.halfExtents * 2.0);
+        casts.push_back({.origin = boxCast.origin, .direction = boxCast.direction, .maxDistance = boxCast.maxDistance, .padding = glm::length(boxCast.halfExtents), .layers = boxCast.layers});
+    }
+
+    BatchShapeCast(shapes, casts, results);
+}
@@ -1,14 +1,55 @@
 #pragma once
 #include "gameobjects/gameobject.hpp"
 #include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "physics/aabb.hpp"
+#include <cmath>
 #include <memory>
+#include <vector>
 
 struct RaycastResult {
     glm::dvec3 hitPoint;
     glm::dvec3 hitNormal;
+    double hitDistance = INFINITY; // how far the ray/shape went before hitting something
     std::shared_ptr<GameObject> hitObject;
 };
 
 // If ray did not hit anything, result.hitObject == nullptr.
+// Same as calling BatchRaycast() with one ray, which is faster if you have lots of rays.
 RaycastResult Raycast(glm::dvec3 origin, glm::dvec3 direction, CollisionLayerSet layers = std::bitset<MAX_COLLISION_LAYERS>().set());
 
+struct RayQuery {
+    glm::dvec3 origin;
+    glm::dvec3 direction; // should be normalized
+    double maxDistance = INFINITY;
+    CollisionLayerSet layers = ALL_COLLISION_LAYERS;
+};
+
+struct SphereCastQuery {
+    glm::dvec3 origin; // where the sphere's center starts
+    glm::dvec3 direction; // should be normalized
+    double radius;
+    double maxDistance = INFINITY;
+    CollisionLayerSet layers = ALL_COLLISION_LAYERS;
+};
+
+struct BoxCastQuery {
+    glm::dvec3 origin; // where the box's center starts
+    glm::dvec3 direction; // should be normalized
+    glm::dvec3 halfExtents;
+    glm::quat rotation = glm::quat(1, 0, 0, 0);
+    double maxDistance = INFINITY;
+    CollisionLayerSet layers = ALL_COLLISION_LAYERS;
+};
+
+// Casts every ray at once, putting the closest hit of each one in results (which is resized to fit; results[i] goes with rays[i]).
+// Rays that don't hit anything within their maxDistance get a result with hitObject == nullptr.
+// Walks the SAS once for all the rays, and each ray stops looking at things farther away than the closest thing it's hit so far, so rays that start close together and go the same-ish way (like bullets from a shotgun) should be batched together.
+void BatchRaycast(const std::vector<RayQuery>& rays, std::vector<RaycastResult>& results);
+
+// Same as BatchRaycast(), but moves a sphere along each ray. hitPoint is where the sphere first touches something, and hitNormal faces out of what it touched.
+// A sphere that starts out touching something hits it with hitDistance 0 and hitNormal = -direction.
+void BatchSphereCast(const std::vector<SphereCastQuery>& casts, std::vector<RaycastResult>& results);
+
+// Same as BatchSphereCast(), but with boxes.
+void BatchBoxCast(const std::vector<BoxCastQuery>& casts, std::vector<RaycastResult>& results);
@@ -3,110 +3,254 @@
 #include "glm/gtx/string_cast.hpp"
 #include "graphics/gengine.hpp"
 #include "gameobjects/collider_component.hpp"
+#include "gameobjects/rigidbody_component.hpp"
+#include <algorithm>
+#include <bit>
+
+// Leaf scans test 4 aabbs at a time with AVX, 2 at a time with SSE2 (which every x64 cpu has), or one at a time otherwise.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SAS_SIMD_WIDTH 4
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SAS_SIMD_WIDTH 2
+#else
+#define SAS_SIMD_WIDTH 1
+#endif
 
 void SpatialAccelerationStructure::Update() {
     //auto start = Time();
     // Get components of all gameobjects that have a transform and collider component
 
-    for (auto it = GameObject::SystemGetComponents<TransformComponent, ColliderComponent>({ ComponentBitIndex::Transform, ComponentBitIndex::Collider });  it.Valid(); it++) {
+    static GameObject::SystemQuery<TransformComponent, ColliderComponent> colliderQuery({ ComponentBitIndex::Transform, ComponentBitIndex::Collider });
+    for (auto it = colliderQuery.Iterate(); it.Valid(); it++) {
         auto & tuple = *it;
         auto& colliderComp = *std::get<1>(tuple);
         auto& transformComp = *std::get<0>(tuple);
-        if (transformComp.moved) {
+        bool moved = transformComp.moved;
+        if (moved) {
             transformComp.moved = false;
             // std::cout << "Updating collider " << &colliderComp << "\n";
             UpdateCollider(colliderComp, transformComp);
                 
         }      
+
+        // The physics engine keeps rigidbodies' colliders awake/asleep itself, but nothing else tells the broadphase when a collider without one (moved by a script, say) shoves into something that's asleep.
+        // So those count as awake for the step after they move, which gets the pair found and wakes whatever they're touching.
+        if (colliderComp.node != NULL_NODE && (moved || nodes[colliderComp.node].awake) && colliderComp.gameobject->MaybeRawGet<RigidbodyComponent>() == nullptr) {
+            SetColliderAwake(colliderComp, moved);
+        }
+    }
+
+    // might as well get this out of the way now instead of in the middle of the first query
+    if (leafBoundsDirty) {
+        RebuildLeafBounds();
     }
 
     //LogElapsed(start, "\nSAS update elapsed ");
 }
 
-void SpatialAccelerationStructure::AddIntersectingLeafNodes(SpatialAccelerationStructure::SasNode* node, std::vector<SpatialAccelerationStructure::SasNode*>& collidingNodes, const AABB& collider, CollisionLayerSet layers) {
-    if ((node->layers & layers).any() && node->aabb.TestIntersection(collider)) { // if this node touched the given collider, then its children may as well.
-        if (node->children != nullptr) {
-            for (auto& child : *node->children) {
-                AddIntersectingLeafNodes(child, collidingNodes, collider, layers);
-            } 
-        }
-        
-        if (!node->objects.empty()) {
-            collidingNodes.push_back(node);
+
+std::vector<ColliderComponent*> SpatialAccelerationStructure::Query(const AABB& collider, CollisionLayerSet layers) {
+    std::vector<ColliderComponent*> collidingComponents;
+    Query(collider, collidingComponents, layers);
+    return collidingComponents;
+}
+
+std::vector<ColliderComponent*> SpatialAccelerationStructure::Query(const glm::dvec3& origin, const glm::dvec3& direction, CollisionLayerSet layers) {
+    std::vector<ColliderComponent*> collidingComponents;
+    Query(origin, direction, collidingComponents, layers);
+    return collidingComponents;
+}
+
+void SpatialAccelerationStructure::Query(const AABB& collider, std::vector<ColliderComponent*>& results, CollisionLayerSet layers) {
+    QueryVisit(collider, layers, [&results](ColliderComponent* found) {
+        results.push_back(found);
+        return true;
+    });
+}
+
+void SpatialAccelerationStructure::Query(const glm::dvec3& origin, const glm::dvec3& direction, std::vector<ColliderComponent*>& results, CollisionLayerSet layers) {
+    QueryVisit(origin, direction, layers, [&results](ColliderComponent* found) {
+        results.push_back(found);
+        return true;
+    });
+}
+
+unsigned int SpatialAccelerationStructure::FilterLayers(unsigned int firstSlot, unsigned int hits, CollisionLayerSet layers) const {
+    for (unsigned int remaining = hits; remaining != 0; remaining &= remaining - 1) {
+        unsigned int i = std::countr_zero(remaining);
+        if (!layers[leafBounds.layers[firstSlot + i]]) {
+            hits &= ~(1u << i);
         }
     }
+    return hits;
 }
 
-void SpatialAccelerationStructure::AddIntersectingLeafNodes(SpatialAccelerationStructure::SasNode* node, std::vector<SpatialAccelerationStructure::SasNode*>& collidingNodes, const glm::dvec3& origin, const glm::dvec3& inverse_direction, CollisionLayerSet layers) {
-    if ((node->layers & layers).any() && node->aabb.TestIntersection(origin, inverse_direction)) { // if this node touched the given collider, then its children may as well.
-        if (node->children != nullptr) {
-            //std::cout << "hay " << node->children->size() << "\n";
-            for (auto& child : *(node->children)) {
-                AddIntersectingLeafNodes(child, collidingNodes, origin, inverse_direction, layers);
-            } 
-        }
-        
-        if (!node->objects.empty()) {
-            collidingNodes.push_back(node);
-        }
+unsigned int SpatialAccelerationStructure::ScanLeaves(unsigned int firstSlot, unsigned int nSlots, const AABB& aabb, CollisionLayerSet layers) const {
+    Assert(nSlots <= LEAF_SCAN_SIZE);
+    const unsigned int end = firstSlot + nSlots;
+    unsigned int slot = firstSlot;
+
+    // each step below gets a mask with bit i set if slot + i intersects
+    unsigned int hits = 0;
+    auto addHits = [&hits, firstSlot](unsigned int slot, int mask) {
+        hits |= static_cast<unsigned int>(mask) << (slot - firstSlot);
+    };
+
+    #if SAS_SIMD_WIDTH == 4
+    const __m256d queryMinX = _mm256_set1_pd(aabb.min.x), queryMinY = _mm256_set1_pd(aabb.min.y), queryMinZ = _mm256_set1_pd(aabb.min.z);
+    const __m256d queryMaxX = _mm256_set1_pd(aabb.max.x), queryMaxY = _mm256_set1_pd(aabb.max.y), queryMaxZ = _mm256_set1_pd(aabb.max.z);
+    for (; slot + 4 <= end; slot += 4) {
+        __m256d overlapping = _mm256_and_pd(
+            _mm256_and_pd(
+                _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(&leafBounds.minX[slot]), queryMaxX, _CMP_LE_OQ), _mm256_cmp_pd(_mm256_loadu_pd(&leafBounds.maxX[slot]), queryMinX, _CMP_GE_OQ)),
+                _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(&leafBounds.minY[slot]), queryMaxY, _CMP_LE_OQ), _mm256_cmp_pd(_mm256_loadu_pd(&leafBounds.maxY[slot]), queryMinY, _CMP_GE_OQ))
+            ),
+            _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(&leafBounds.minZ[slot]), queryMaxZ, _CMP_LE_OQ), _mm256_cmp_pd(_mm256_loadu_pd(&leafBounds.maxZ[slot]), queryMinZ, _CMP_GE_OQ))
+        );
+        addHits(slot, _mm256_movemask_pd(overlapping));
     }
+    #elif SAS_SIMD_WIDTH == 2
+    const __m128d queryMinX = _mm_set1_pd(aabb.min.x), queryMinY = _mm_set1_pd(aabb.min.y), queryMinZ = _mm_set1_pd(aabb.min.z);
+    const __m128d queryMaxX = _mm_set1_pd(aabb.max.x), queryMaxY = _mm_set1_pd(aabb.max.y), queryMaxZ = _mm_set1_pd(aabb.max.z);
+    for (; slot + 2 <= end; slot += 2) {
+        __m128d overlapping = _mm_and_pd(
+            _mm_and_pd(
+                _mm_and_pd(_mm_cmple_pd(_mm_loadu_pd(&leafBounds.minX[slot]), queryMaxX), _mm_cmpge_pd(_mm_loadu_pd(&leafBounds.maxX[slot]), queryMinX)),
+                _mm_and_pd(_mm_cmple_pd(_mm_loadu_pd(&leafBounds.minY[slot]), queryMaxY), _mm_cmpge_pd(_mm_loadu_pd(&leafBounds.maxY[slot]), queryMinY))
+            ),
+            _mm_and_pd(_mm_cmple_pd(_mm_loadu_pd(&leafBounds.minZ[slot]), queryMaxZ), _mm_cmpge_pd(_mm_loadu_pd(&leafBounds.maxZ[slot]), queryMinZ))
+        );
+        addHits(slot, _mm_movemask_pd(overlapping));
+    }
+    #endif
+
+    // whatever didn't fit in a full register (or everything, without SIMD)
+    for (; slot < end; slot++) {
+        bool overlapping = leafBounds.minX[slot] <= aabb.max.x && leafBounds.maxX[slot] >= aabb.min.x
+            && leafBounds.minY[slot] <= aabb.max.y && leafBounds.maxY[slot] >= aabb.min.y
+            && leafBounds.minZ[slot] <= aabb.max.z && leafBounds.maxZ[slot] >= aabb.min.z;
+        addHits(slot, overlapping ? 1 : 0);
+    }
+
+    return FilterLayers(firstSlot, hits, layers);
 }
 
-std::vector<ColliderComponent*> SpatialAccelerationStructure::Query(const AABB& collider, CollisionLayerSet layers) {
-    // find leaf nodes whose AABBs intersect the collider
-    std::vector<SpatialAccelerationStructure::SasNode*> collidingNodes;
-    AddIntersectingLeafNodes(&root, collidingNodes, collider, layers);
-    
-    // test the aabbs of the objects inside each node and if so add them to the vector
-    std::vector<ColliderComponent*> collidingComponents;
-    for (auto & node: collidingNodes) {
-        for (auto & obj: node->objects) {
-            if (layers[obj->layer] == true && obj->aabb.TestIntersection(collider)) {
-                collidingComponents.push_back(obj);
+unsigned int SpatialAccelerationStructure::ScanLeaves(unsigned int firstSlot, unsigned int nSlots, const glm::dvec3& origin, const glm::dvec3& inverseDirection, CollisionLayerSet layers) const {
+    Assert(nSlots <= LEAF_SCAN_SIZE);
+    const unsigned int end = firstSlot + nSlots;
+    unsigned int slot = firstSlot;
+
+    unsigned int hits = 0;
+    auto addHits = [&hits, firstSlot](unsigned int slot, int mask) {
+        hits |= static_cast<unsigned int>(mask) << (slot - firstSlot);
+    };
+
+    // Same slab test as AABB::TestIntersection(), just several boxes at a time.
+    // The SIMD min/max instructions return their second operand when either one is NaN (which happens when the ray lies in one of the box's planes), while std::min/max return their first,
+        // so the operands are swapped below to make the results exactly the same as the scalar version's.
+    #if SAS_SIMD_WIDTH == 4
+    const std::array<const std::vector<double>*, 3> mins = {&leafBounds.minX, &leafBounds.minY, &leafBounds.minZ};
+    const std::array<const std::vector<double>*, 3> maxes = {&leafBounds.maxX, &leafBounds.maxY, &leafBounds.maxZ};
+    for (; slot + 4 <= end; slot += 4) {
+        __m256d tmin, tmax;
+        for (int axis = 0; axis < 3; axis++) {
+            const __m256d o = _mm256_set1_pd(origin[axis]), inverse = _mm256_set1_pd(inverseDirection[axis]);
+            __m256d t1 = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(&(*mins[axis])[slot]), o), inverse);
+            __m256d t2 = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(&(*maxes[axis])[slot]), o), inverse);
+            if (axis == 0) {
+                tmin = _mm256_min_pd(t2, t1);
+                tmax = _mm256_max_pd(t2, t1);
+            }
+            else {
+                tmin = _mm256_min_pd(_mm256_max_pd(tmin, t2), _mm256_max_pd(tmin, t1));
+                tmax = _mm256_max_pd(_mm256_min_pd(tmax, t2), _mm256_min_pd(tmax, t1));
             }
         }
-        if (node->objects.size() > NODE_SPLIT_THRESHOLD) {
-            node->Split();
+        addHits(slot, _mm256_movemask_pd(_mm256_cmp_pd(tmax, _mm256_max_pd(_mm256_setzero_pd(), tmin), _CMP_GT_OQ)));
+    }
+    #elif SAS_SIMD_WIDTH == 2
+    const std::array<const std::vector<double>*, 3> mins = {&leafBounds.minX, &leafBounds.minY, &leafBounds.minZ};
+    const std::array<const std::vector<double>*, 3> maxes = {&leafBounds.maxX, &leafBounds.maxY, &leafBounds.maxZ};
+    for (; slot + 2 <= end; slot += 2) {
+        __m128d tmin, tmax;
+        for (int axis = 0; axis < 3; axis++) {
+            const __m128d o = _mm_set1_pd(origin[axis]), inverse = _mm_set1_pd(inverseDirection[axis]);
+            __m128d t1 = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(&(*mins[axis])[slot]), o), inverse);
+            __m128d t2 = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(&(*maxes[axis])[slot]), o), inverse);
+            if (axis == 0) {
+                tmin = _mm_min_pd(t2, t1);
+                tmax = _mm_max_pd(t2, t1);
+            }
+            else {
+                tmin = _mm_min_pd(_mm_max_pd(tmin, t2), _mm_max_pd(tmin, t1));
+                tmax = _mm_max_pd(_mm_min_pd(tmax, t2), _mm_min_pd(tmax, t1));
+            }
         }
+        addHits(slot, _mm_movemask_pd(_mm_cmpgt_pd(tmax, _mm_max_pd(_mm_setzero_pd(), tmin))));
     }
+    #endif
 
-    return collidingComponents;
+    for (; slot < end; slot++) {
+        addHits(slot, GetLeafBounds(slot).TestIntersection(origin, inverseDirection) ? 1 : 0);
+    }
+
+    return FilterLayers(firstSlot, hits, layers);
 }
 
-// TODO: redundant code in these two query functions, could improve
-std::vector<ColliderComponent*> SpatialAccelerationStructure::Query(const glm::dvec3& origin, const glm::dvec3& direction, CollisionLayerSet layers) {
-    glm::dvec3 inverse_direction = glm::dvec3(1.0/direction.x, 1.0/direction.y, 1.0/direction.z); 
+SpatialAccelerationStructure::CastScratch& SpatialAccelerationStructure::GetCastScratch() {
+    thread_local CastScratch scratch; // casts can happen on several threads at once
+    return scratch;
+}
 
-    // find leaf nodes whose AABBs intersect the ray
-    std::vector<SpatialAccelerationStructure::SasNode*> collidingNodes;
-    AddIntersectingLeafNodes(&root, collidingNodes, origin, inverse_direction, layers);
+void SpatialAccelerationStructure::FindOverlappingPairs(std::vector<std::pair<ColliderComponent*, ColliderComponent*>>& pairs, const std::array<CollisionLayerSet, MAX_COLLISION_LAYERS>& layerMatrix) {
+    // Any two leaves have exactly one lowest common ancestor, with one leaf under each of its children.
+    // So testing the two children of every internal node against each other finds every overlapping pair, and finds it exactly once.
+    pairStack.clear();
+    for (NodeIndex i = 0; i < static_cast<NodeIndex>(nodes.size()); i++) {
+        if (nodes[i].height > 0 && nodes[i].awake) { // skips leaves, free nodes and subtrees where everything is asleep
+            pairStack.emplace_back(nodes[i].children[0], nodes[i].children[1]);
+        }
+    }
 
-    // test the aabbs of the objects inside each node and if so add them to the vector
-    std::vector<ColliderComponent*> collidingComponents;
-    for (auto & node: collidingNodes) {
-        for (auto & obj: node->objects) {
-            if (layers[obj->layer] && obj->aabb.TestIntersection(origin, inverse_direction)) {
-                collidingComponents.push_back(obj);
+    while (!pairStack.empty()) {
+        auto [a, b] = pairStack.back();
+        pairStack.pop_back();
+
+        const SasNode& nodeA = nodes[a];
+        const SasNode& nodeB = nodes[b];
+        if ((!nodeA.awake && !nodeB.awake) || !nodeA.aabb.TestIntersection(nodeB.aabb)) {
+            continue;
+        }
+
+        if (nodeA.IsLeaf() && nodeB.IsLeaf()) {
+            // the leaves' aabbs are padded, so test the colliders' real aabbs too
+            if (layerMatrix[nodeA.collider->layer][nodeB.collider->layer] && nodeA.collider->aabb.TestIntersection(nodeB.collider->aabb)) {
+                pairs.emplace_back(nodeA.collider, nodeB.collider);
             }
         }
-        if (node->objects.size() > NODE_SPLIT_THRESHOLD) {
-            node->Split();
+        else if (nodeB.IsLeaf() || (!nodeA.IsLeaf() && nodeA.aabb.SurfaceArea() >= nodeB.aabb.SurfaceArea())) {
+            // descend into the bigger node, since it's the one more likely to have children that miss the other node entirely
+            pairStack.emplace_back(nodeA.children[0], b);
+            pairStack.emplace_back(nodeA.children[1], b);
+        }
+        else {
+            pairStack.emplace_back(a, nodeB.children[0]);
+            pairStack.emplace_back(a, nodeB.children[1]);
         }
     }
-
-    return collidingComponents;
 }
 
-void SpatialAccelerationStructure::DebugVisualizeAddVertexAttributes(SasNode const& node, std::vector<float>& instancedVertexAttributes, unsigned int& numInstances, const Mesh& mesh, unsigned int depth) {
-    if (node.children != nullptr) {
-        for (auto & child: *node.children) {
-            if (child != nullptr) {
-                DebugVisualizeAddVertexAttributes(*child, instancedVertexAttributes, numInstances, mesh, depth + 1);
-            }
+void SpatialAccelerationStructure::DebugVisualizeAddVertexAttributes(NodeIndex index, std::vector<float>& instancedVertexAttributes, unsigned int& numInstances, const Mesh& mesh, unsigned int depth) {
+    const SasNode& node = nodes[index];
+    if (!node.IsLeaf()) {
+        for (auto child: node.children) {
+            DebugVisualizeAddVertexAttributes(child, instancedVertexAttributes, numInstances, mesh, depth + 1);
         }
     }
-    
-    for (auto & object: node.objects) {
+    else {
+        const ColliderComponent* object = node.collider;
         instancedVertexAttributes.resize(instancedVertexAttributes.size() + mesh.vertexFormat.GetInstancedVertexSize()/sizeof(GLfloat));
         auto oldPtr = instancedVertexAttributes.data() + instancedVertexAttributes.size() - mesh.vertexFormat.GetInstancedVertexSize() / sizeof(GLfloat); // gotta set it afterwards bc resizing changes ptr
 
@@ -132,54 +276,36 @@ void SpatialAccelerationStructure::DebugVisualizeAddVertexAttributes(SasNode con
         };
         memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &colors[object->layer], sizeof(glm::vec4));
         memcpy(oldPtr + mesh.vertexFormat.attributes.modelMatrix->offset/sizeof(GLfloat), &model, sizeof(glm::mat4x4));
-       /* if (depth == 0) {
-            constexpr glm::vec4 color = { 1, 1, 1, 1 };
-            memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
-        }
-        else if (depth == 1) {
-            constexpr glm::vec4 color = { 1, 0, 0, 1 };
-            memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
-        }
-        else if (depth == 2) {
-            constexpr glm::vec4 color = { 0, 1, 1, 1 };
-            memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
-        }
-        else {
-            constexpr glm::vec4 color = { 1, 0, 1, 1 };
-            memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
-        }*/
         numInstances++;
     }
 
-    //if (&node != &root) {
-        instancedVertexAttributes.resize(instancedVertexAttributes.size() + mesh.vertexFormat.GetInstancedVertexSize() / sizeof(GLfloat));
-        auto oldPtr = instancedVertexAttributes.data() + instancedVertexAttributes.size() - mesh.vertexFormat.GetInstancedVertexSize() / sizeof(GLfloat); // gotta set it afterwards bc resizing changes ptr;
+    instancedVertexAttributes.resize(instancedVertexAttributes.size() + mesh.vertexFormat.GetInstancedVertexSize() / sizeof(GLfloat));
+    auto oldPtr = instancedVertexAttributes.data() + instancedVertexAttributes.size() - mesh.vertexFormat.GetInstancedVertexSize() / sizeof(GLfloat); // gotta set it afterwards bc resizing changes ptr;
 
-        glm::vec3 position = node.aabb.Center();
-        glm::mat4x4 model = glm::scale(glm::translate(glm::identity<glm::mat4x4>(), position), glm::vec3(node.aabb.max - node.aabb.min)) ;
+    glm::vec3 position = node.aabb.Center();
+    glm::mat4x4 model = glm::scale(glm::translate(glm::identity<glm::mat4x4>(), position), glm::vec3(node.aabb.max - node.aabb.min)) ;
 
-        memcpy(oldPtr + mesh.vertexFormat.attributes.modelMatrix->offset / sizeof(GLfloat), &model, sizeof(glm::mat4x4));
-        if (depth == 0) {
-            constexpr glm::vec4 color = { 1, 1, 1, 1 };
-            memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
-        }
-        else if (depth == 1) {
-            constexpr glm::vec4 color = { 1, 0, 0, 1 };
-            memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
-        }
-        else if (depth == 2) {
-            constexpr glm::vec4 color = { 0, 1, 1, 1 };
-            memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
-        }
-        else {
-            constexpr glm::vec4 color = { 1, 0, 1, 1 };
-            memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
-        }
-        
-        numInstances++;
-    //}
+    memcpy(oldPtr + mesh.vertexFormat.attributes.modelMatrix->offset / sizeof(GLfloat), &model, sizeof(glm::mat4x4));
+    if (depth == 0) {
+        constexpr glm::vec4 color = { 1, 1, 1, 1 };
+        memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
+    }
+    else if (depth == 1) {
+        constexpr glm::vec4 color = { 1, 0, 0, 1 };
+        memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
+    }
+    else if (depth == 2) {
+        constexpr glm::vec4 color = { 0, 1, 1, 1 };
+        memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
+    }
+    else {
+        constexpr glm::vec4 color = { 1, 0, 1, 1 };
+        memcpy(oldPtr + mesh.vertexFormat.attributes.color->offset / sizeof(GLfloat), &color, sizeof(glm::vec4));
+    }
+
+    numInstances++;
 }
-    
+
 
 void SpatialAccelerationStructure::DebugVisualize() {
     static auto crummyDebugShader = ShaderProgram::New("../shaders/debug_simple_vertex.glsl", "../shaders/debug_simple_fragment.glsl", false, false);
@@ -193,7 +319,9 @@ void SpatialAccelerationStructure::DebugVisualize() {
     
     std::vector<float> instancedVertexAttributes; // per object data. format is 4x4 model mat, rgba, 4x4 model mat, rgba...
     unsigned int numInstances = 0; // number of wireframes we're drawing
-    DebugVisualizeAddVertexAttributes(root, instancedVertexAttributes, numInstances, *m);
+    if (root != NULL_NODE) {
+        DebugVisualizeAddVertexAttributes(root, instancedVertexAttributes, numInstances, *m);
+    }
 
     GLuint vao, vbo, ibo, ivbo;
     glGenVertexArrays(1, &vao);
@@ -234,353 +362,332 @@ void SpatialAccelerationStructure::DebugVisualize() {
     glDeleteVertexArrays(1, &vao);
 }
 
-// URGENT TODO: make sure not all objects put in same child node recursively
-void SpatialAccelerationStructure::SasNode::Split() {
-    DebugLogInfo("splitting."); // keep this here so i know what happened when the above TODO i'll never do causes problems
-
-    Assert(objects.size() >= NODE_SPLIT_THRESHOLD);
-    // unsigned int countbefore = objects.size();
-
-    // std::cout << "Before split, node has " << objects.size() << " objects\n";
-    Assert(!split);
-
-    // calculate split point
-    glm::dvec3 meanPosition = {0, 0, 0};
-    for (auto & obj : objects) {
-        meanPosition += obj->aabb.Center()/(double)objects.size();
+namespace {
+    // Returns aabb grown by SAS_AABB_MARGIN of its largest dimension on every side.
+    AABB Fatten(const AABB& aabb) {
+        auto size = aabb.max - aabb.min;
+        double margin = SAS_AABB_MARGIN * std::max(size.x, std::max(size.y, size.z));
+        return AABB(aabb.min - margin, aabb.max + margin);
     }
-    splitPoint = meanPosition;
 
-    // create child nodes
-    children = new std::array<SasNode*, 27> {nullptr};
-    for (int x = -1; x < 2; x++) {
-        for (int y = -1; y < 2; y++) {
-            for (int z = -1; z < 2; z++) {
-                auto node = new SasNode();
-                node->parent = this;
-                (*children).at((x + 1) * 9 + (y + 1) * 3 + z + 1) = node;
-                Assert(node->objects.size() == 0);
-            }
-        }
+    AABB Union(const AABB& a, const AABB& b) {
+        AABB result = a;
+        result.Grow(b);
+        return result;
     }
+}
 
-    
-
-    // determine which child nodes get which objects
-    std::vector<unsigned int> indicesToRemove; // we cant remove the objects while we're iterating cuz that would mess up the iterator
-    unsigned int i = 0;
-    for (auto & obj: objects) { 
-        auto node = SasInsertHeuristic(*this, obj->aabb, obj->layer);
-        if (node != nullptr && node != this) {
-            //std::cout << "aoisjfoijesa " << children << " index " << index << "\n";
-            node->objects.push_back(obj);   
-            obj->node = node;
-            indicesToRemove.push_back(i);
-            //std::cout << "pushing " << i << " \n";
-        }
-        i++;
+SpatialAccelerationStructure::NodeIndex SpatialAccelerationStructure::AllocateNode() {
+    NodeIndex index;
+    if (firstFreeNode != NULL_NODE) {
+        index = firstFreeNode;
+        firstFreeNode = nodes[index].parent;
     }
-
-    // determine child node AABBs
-    for (auto & node: *children) {
-        node->RecalculateAABB();
+    else {
+        index = static_cast<NodeIndex>(nodes.size());
+        nodes.emplace_back();
     }
 
-    //std::cout << indicesToRemove.size() << " is the size\n";
+    SasNode& node = nodes[index];
+    node.aabb = AABB();
+    node.layers.reset();
+    node.awake = false;
+    node.parent = NULL_NODE;
+    node.children = { NULL_NODE, NULL_NODE };
+    node.height = 0;
+    node.nLeaves = 1;
+    node.firstLeafSlot = 0;
+    node.collider = nullptr;
+    return index;
+}
+
+void SpatialAccelerationStructure::FreeNode(NodeIndex index) {
+    nodes[index].collider = nullptr;
+    nodes[index].height = -1;
+    nodes[index].parent = firstFreeNode;
+    firstFreeNode = index;
+}
+
+void SpatialAccelerationStructure::InsertLeaf(NodeIndex leaf) {
+    leafBoundsDirty = true;
 
-    // iterate backwards through indicesToRemove to preserve index correctness
-    for (auto it = indicesToRemove.rbegin(); it != indicesToRemove.rend(); ++it ) {
-        Assert(*it < objects.size());
-        objects.erase(objects.begin() + *it);
+    if (root == NULL_NODE) {
+        root = leaf;
+        nodes[leaf].parent = NULL_NODE;
+        return;
     }
 
-    // unsigned int countafter = objects.size();
-    // for (auto & node: *children) {
-    //     countafter += node->objects.size();
-    //     std::cout << "\tThis node has " << node->objects.size() << "\n";
-    // }
-    // std::cout << "After split, node has " << countafter << " objects\n";
+    // Find the best sibling for the leaf by walking down from the root.
+    // Cost is the total surface area of the nodes we'd have to create or grow; at each node we either pair the leaf with it, or go into whichever child is cheaper,
+        // knowing that going further down grows this node by at least as much as pairing with it would.
+    const AABB leafAabb = nodes[leaf].aabb;
+    NodeIndex sibling = root;
+    while (!nodes[sibling].IsLeaf()) {
+        const SasNode& node = nodes[sibling];
+        double area = node.aabb.SurfaceArea();
+        double combinedArea = Union(node.aabb, leafAabb).SurfaceArea();
 
-    // Assert(countbefore == countafter);
-}
+        // cost of making a new parent for this node and the leaf
+        double cost = 2.0 * combinedArea;
 
-void SpatialAccelerationStructure::SasNode::RecalculateAABB() {
-    // first find a single object or child node that has an aabb, and use that as a starting point
-    if (objects.size() > 0) {
-        aabb = objects[0]->aabb;
-    }
-    else if (children != nullptr) {
-        bool found = false;
-        for (auto & child: *children) {
-            if (child != nullptr) {
-                aabb = child->aabb;
-                found = true;
-                break;
-            }
+        // minimum cost of pushing the leaf further down
+        double inheritanceCost = 2.0 * (combinedArea - area);
+
+        double childCosts[2];
+        for (unsigned int i = 0; i < 2; i++) {
+            const SasNode& child = nodes[node.children[i]];
+            double grownArea = Union(child.aabb, leafAabb).SurfaceArea();
+            childCosts[i] = inheritanceCost + (child.IsLeaf() ? grownArea : grownArea - child.aabb.SurfaceArea());
         }
-        Assert(found);
-    }
 
-    // now aabb is within the real aabb, we get to real aabb by growing aabb to contain every child node and object
-    for (auto & obj: objects) {
-        aabb.Grow(obj->aabb);
-    }
-    if (children != nullptr) {
-        for (auto & child: *children) {
-            if (child != nullptr) {
-                aabb.Grow(child->aabb);
-            }
+        if (cost < childCosts[0] && cost < childCosts[1]) {
+            break;
         }
+
+        sibling = childCosts[0] <= childCosts[1] ? node.children[0] : node.children[1];
     }
 
+    // make a new parent for the sibling and leaf
+    NodeIndex oldParent = nodes[sibling].parent;
+    NodeIndex newParent = AllocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].children = { sibling, leaf };
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
 
-    // if (parent) { // if node gets bigger/smaller its parent should adjust accordingly
-    //     parent->CalculateAABB(); 
-    // }
+    if (oldParent == NULL_NODE) {
+        root = newParent;
+    }
+    else {
+        auto& oldParentChildren = nodes[oldParent].children;
+        oldParentChildren[oldParentChildren[0] == sibling ? 0 : 1] = newParent;
+    }
 
-    
+    Refit(newParent);
 }
 
-SpatialAccelerationStructure::SasNode::SasNode() {
-    split = false;
-    splitPoint = {NAN, NAN, NAN};
-    parent = nullptr;
-    children = nullptr;
-}
+void SpatialAccelerationStructure::RemoveLeaf(NodeIndex leaf) {
+    leafBoundsDirty = true;
+
+    if (leaf == root) {
+        root = NULL_NODE;
+        return;
+    }
 
+    NodeIndex parent = nodes[leaf].parent;
+    NodeIndex grandparent = nodes[parent].parent;
+    NodeIndex sibling = nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
 
-SpatialAccelerationStructure::SasNode* SpatialAccelerationStructure::SasInsertHeuristic(SasNode& node, const AABB& aabb, CollisionLayer layer) {
-    if (node.children == nullptr) {return nullptr;}
-    if (node.aabb.Volume() < aabb.Volume() * 8) {return &node;}
-    auto splitPoint = node.splitPoint;
-    unsigned int x = 1, y = 1, z = 1;
-    if (aabb.min.x > splitPoint.x) {
-        x += 1;
-    } 
-    if (aabb.max.x < splitPoint.x) {
-        x -= 1;
+    // the sibling takes the parent's place
+    nodes[sibling].parent = grandparent;
+    if (grandparent == NULL_NODE) {
+        root = sibling;
     }
-    if (aabb.min.y > splitPoint.y) {
-        y += 1;
-    } 
-    if (aabb.max.y < splitPoint.y) {
-        y -= 1;
+    else {
+        auto& grandparentChildren = nodes[grandparent].children;
+        grandparentChildren[grandparentChildren[0] == parent ? 0 : 1] = sibling;
     }
-    if (aabb.min.z > splitPoint.z) {
-        z += 1;
-    } 
-    if (aabb.max.z < splitPoint.z) {
-        z -= 1;
+
+    FreeNode(parent);
+    nodes[leaf].parent = NULL_NODE;
+
+    if (grandparent != NULL_NODE) {
+        Refit(grandparent);
     }
+}
 
-    Assert(&node != (*node.children)[x * 9 + y * 3 + z]);
-    return (*node.children)[x * 9 + y * 3 + z];
-}  
+void SpatialAccelerationStructure::RecalculateFromChildren(NodeIndex index) {
+    SasNode& node = nodes[index];
+    const SasNode& child0 = nodes[node.children[0]];
+    const SasNode& child1 = nodes[node.children[1]];
+    node.aabb = Union(child0.aabb, child1.aabb);
+    node.layers = child0.layers | child1.layers;
+    node.awake = child0.awake || child1.awake;
+    node.height = 1 + std::max(child0.height, child1.height);
+    node.nLeaves = child0.nLeaves + child1.nLeaves;
+}
 
-void SpatialAccelerationStructure::AddCollider(ColliderComponent* collider, const TransformComponent& transform) {
-    collider->RecalculateAABB(transform);
+void SpatialAccelerationStructure::SetLeafBounds(unsigned int slot, const AABB& aabb) {
+    leafBounds.minX[slot] = aabb.min.x;
+    leafBounds.minY[slot] = aabb.min.y;
+    leafBounds.minZ[slot] = aabb.min.z;
+    leafBounds.maxX[slot] = aabb.max.x;
+    leafBounds.maxY[slot] = aabb.max.y;
+    leafBounds.maxZ[slot] = aabb.max.z;
+}
 
-    // Recursively pick best child node starting from root until we reach leaf node
-    SasNode* currentNode = &root;
-    while (true) {
-        currentNode->layers.set(collider->layer, true);
-        auto childNode = SasInsertHeuristic(*currentNode, collider->aabb, collider->layer);
-        if (childNode == nullptr) {
-            break;
-        }
-        else {
-            currentNode = childNode;
-        }
+void SpatialAccelerationStructure::RebuildLeafBounds() {
+    leafBoundsDirty = false;
+    unsigned int nLeaves = root == NULL_NODE ? 0 : nodes[root].nLeaves;
+    for (auto* v: {&leafBounds.minX, &leafBounds.minY, &leafBounds.minZ, &leafBounds.maxX, &leafBounds.maxY, &leafBounds.maxZ}) {
+        v->resize(nLeaves);
+    }
+    leafBounds.layers.resize(nLeaves);
+    leafBounds.colliders.resize(nLeaves);
+    if (root == NULL_NODE) {
+        return;
     }
 
-    // put collider in that leaf node
-    currentNode->objects.push_back(collider);
-    currentNode->split = false;
-    collider->node = currentNode;
+    // each node's first leaf slot is its parent's, plus the size of its sibling's subtree if it's the second child
+    std::vector<NodeIndex> stack;
+    stack.reserve(64);
+    nodes[root].firstLeafSlot = 0;
+    stack.push_back(root);
+    while (!stack.empty()) {
+        SasNode& node = nodes[stack.back()];
+        stack.pop_back();
 
-    // Expand node and its ancestors to make sure they contain collider
-    while (true) {
-        currentNode->aabb.Grow(collider->aabb);
-        if (currentNode->parent == nullptr) {
-            return;
+        if (node.IsLeaf()) {
+            SetLeafBounds(node.firstLeafSlot, node.collider->aabb);
+            leafBounds.layers[node.firstLeafSlot] = node.collider->layer;
+            leafBounds.colliders[node.firstLeafSlot] = node.collider;
         }
         else {
-            currentNode = currentNode->parent;
+            nodes[node.children[0]].firstLeafSlot = node.firstLeafSlot;
+            nodes[node.children[1]].firstLeafSlot = node.firstLeafSlot + nodes[node.children[0]].nLeaves;
+            stack.push_back(node.children[0]);
+            stack.push_back(node.children[1]);
         }
     }
 }
 
-void ColliderComponent::RemoveFromSas() {
-    //DebugLogInfo("REMOVING");
-    bool layerExists = false; // we need to see if this is the only object with the given layer in this node 
-    // remove object from node
-    for (unsigned int i = 0; i < node->objects.size(); i++) { // todo: could maybe optimize this loop?
-        //DebugLogInfo("layer ", layer, " vs ", node->objects[i]->layer, " (", i, ")", " comp = ", layer == node->objects[i]->layer);
-        if (node->objects[i] == this) {
-            node->objects.erase(node->objects.begin() + i);
-            i--;
-        }
-        else if (layer == node->objects[i]->layer) {
-            //DebugLogInfo("YO");
-            layerExists = true;
-        }
-        //else {
-            //Assert(layer != node->objects[i]->layer);
-        //}
-    }
-
-    if (!layerExists) {
-        node->layers.set(layer, false);
-        auto currentNode = node;
-        while (currentNode->parent) {
-            currentNode = currentNode->parent;
-            for (auto& n : *(currentNode->children)) {
-                if (n->layers[layer]) {
-                    goto done; // escape outer loop
-                }
-            }
-            currentNode->layers.set(layer, false);
-        }
+void SpatialAccelerationStructure::Refit(NodeIndex index) {
+    while (index != NULL_NODE) {
+        Rotate(index);
+        RecalculateFromChildren(index);
+        index = nodes[index].parent;
     }
-    done:;
-
-    // TODO: we need to do something when node is emptied, probably   
 }
 
-void SpatialAccelerationStructure::UpdateCollider(ColliderComponent& collider, const TransformComponent& transform) {
-    collider.RecalculateAABB(transform);
-    const AABB& newAabb = collider.aabb;
+void SpatialAccelerationStructure::Rotate(NodeIndex index) {
+    // A rotation swaps child i of the node with child j of the node's other child, which changes nothing but the area of that other child.
+    // Try every rotation and do the one that shrinks its child the most, if any.
+    const SasNode& node = nodes[index];
+    if (nodes[node.children[0]].IsLeaf() && nodes[node.children[1]].IsLeaf()) {
+        return; // no grandchildren
+    }
 
-    // Go up the tree from the collider's current node to find the first node that fully envelopes the collider.
-    // (if collider's current node still envelops the collider, this will do nothing)
-    
-    //std::cout << " root node at " << &root << "\n";
-    SasNode* const oldNode = collider.node;
-    SasNode* newNodeForCollider = collider.node;
-    while (true) {
-        //std::cout << " current node is " << newNodeForCollider << ", parent is " << newNodeForCollider->parent << "\n";
-        if (!newNodeForCollider->aabb.TestEnvelopes(newAabb)) {
-            //std::cout << "current node doesn't fit\n";
-            // If we reach the root and it doesn't fit, it will grow the root node's aabb to contain the collider.
-            if (newNodeForCollider->parent == nullptr) {
-                //std::cout << "...smallest enveloping node is root\n";
-                newNodeForCollider->aabb.Grow(newAabb);
-                break; //obvi not gonna be any more parent nodes after this
-            }
-            else {
-                newNodeForCollider = newNodeForCollider->parent;
+    double bestAreaReduction = 0;
+    int bestChild = -1, bestGrandchild = -1; // the child that gets swapped, and the index (in the other child's children) of the grandchild it gets swapped with
+    for (int i = 0; i < 2; i++) {
+        const SasNode& child = nodes[node.children[i]];
+        const SasNode& otherChild = nodes[node.children[1 - i]];
+        if (otherChild.IsLeaf()) {
+            continue;
+        }
+
+        double otherChildArea = otherChild.aabb.SurfaceArea();
+        for (int j = 0; j < 2; j++) {
+            // after the swap, the other child contains this child and the grandchild we didn't swap
+            double newArea = Union(child.aabb, nodes[otherChild.children[1 - j]].aabb).SurfaceArea();
+            if (otherChildArea - newArea > bestAreaReduction) {
+                bestAreaReduction = otherChildArea - newArea;
+                bestChild = i;
+                bestGrandchild = j;
             }
         }
-        else {
-            //std::cout << " we win\n";
-            // we found a node that contains the collider
-            break;
-        }
+    }
 
+    if (bestChild == -1) {
+        return;
     }
 
-    //std::cout << "smallest enveloping ancestor is "  << newNodeForCollider << "\n";
-    //std::cout << "find children.\n";
-    // Then, we use the insert heuristic to go down child nodes until we find the best leaf node for the collider
-    while (true) {
-        auto childNode = SasInsertHeuristic(*newNodeForCollider, newAabb, collider.layer);
-        //std::cout << "\tchild is " << childNode << "\n.";
-        // TODO: we might need to grow this 
-        if (childNode == nullptr || childNode == newNodeForCollider) { // then we're at a leaf node, add the collider to it
-            collider.node = newNodeForCollider;
+    NodeIndex child = node.children[bestChild];
+    NodeIndex otherChild = node.children[1 - bestChild];
+    NodeIndex grandchild = nodes[otherChild].children[bestGrandchild];
 
-            break;
-        }
-        else {
-            newNodeForCollider = childNode;
-        }
+    nodes[index].children[bestChild] = grandchild;
+    nodes[grandchild].parent = index;
+    nodes[otherChild].children[bestGrandchild] = child;
+    nodes[child].parent = otherChild;
+    RecalculateFromChildren(otherChild);
+}
 
-    }
+void SpatialAccelerationStructure::AddCollider(ColliderComponent* collider, const TransformComponent& transform) {
+    collider->RecalculateAABB(transform);
 
-    //std::cout << "selected child "  << newNodeForCollider << "\n";
+    NodeIndex leaf = AllocateNode();
+    nodes[leaf].aabb = Fatten(collider->aabb);
+    nodes[leaf].layers.set(collider->layer, true);
+    nodes[leaf].collider = collider;
+    collider->node = leaf;
 
-    //std::cout << "expanding nodes.\n";
-    // Expand node and its ancestors to make sure they fully contain collider (faster than doing recursive RecalculateAABB())
-    auto p1 = newNodeForCollider;
-    while (true) {
-        p1->aabb.Grow(newAabb);
-        if (p1->parent == nullptr) {
-            break;
-        }
-        else {
-            p1 = p1->parent;
-        }
+    InsertLeaf(leaf);
+}
+
+void ColliderComponent::RemoveFromSas() {
+    if (node == SpatialAccelerationStructure::NULL_NODE) {
+        return;
     }
 
+    auto& sas = SpatialAccelerationStructure::Get();
+    sas.RemoveLeaf(node);
+    sas.FreeNode(node);
+    node = SpatialAccelerationStructure::NULL_NODE;
+}
 
-    
-    // if the object is in the same node after all that, we don't need to update parents/children
-    if (oldNode == newNodeForCollider) {
-        //std::cout << "done.\n";
-        return;
+void SpatialAccelerationStructure::UpdateCollider(ColliderComponent& collider, const TransformComponent& transform) {
+    if (collider.node == NULL_NODE) {
+        return; // removed from the SAS
     }
-    else {
-        //std::cout << "not done.\n";
-        // add collider to new node
-        newNodeForCollider->objects.push_back(&collider);
-
-        // remove collider from old node
-        for (unsigned int i = 0; i < oldNode->objects.size(); i++) { // TODO: O(n) time here could actually be an issue
-            if (oldNode->objects[i] == &collider) {
-                oldNode->objects.erase(oldNode->objects.begin() + i);
-            }
-        }
 
-        // with that collider removed, old node (and by extension its parents) might be able to be made tighter
-        oldNode->RecalculateAABB();
-        auto p = oldNode;
-        while (true) {
-            if (p->parent) {
-                p = p->parent;
-                p->RecalculateAABB();
-            }
-            else {
-                return;
-            }
+    collider.RecalculateAABB(transform);
+
+    // As long as the leaf's padded aabb still contains the collider, the tree is still correct, so most small movements don't have to touch the tree at all.
+    // If the collider shrank a lot, we reinsert it anyways so that it doesn't keep producing false positives.
+    const AABB& storedAabb = nodes[collider.node].aabb;
+    AABB fattenedAabb = Fatten(collider.aabb);
+    if (storedAabb.TestEnvelopes(collider.aabb) && storedAabb.SurfaceArea() <= 4.0 * fattenedAabb.SurfaceArea()) {
+        if (!leafBoundsDirty) {
+            SetLeafBounds(nodes[collider.node].firstLeafSlot, collider.aabb);
         }
         return;
     }
 
-    
+    RemoveLeaf(collider.node);
+    nodes[collider.node].aabb = fattenedAabb;
+    InsertLeaf(collider.node);
 }
 
 void SpatialAccelerationStructure::UpdateColliderLayer(ColliderComponent& collider, CollisionLayer oldLayer)
 {
-    auto p = collider.node;
-    while (p && p->layers[collider.layer] == false) {
-        p->layers.set(collider.layer, true);
-        p = p->parent;
+    if (collider.node == NULL_NODE) {
+        return;
     }
 
-    bool layerExists = false; // we need to see if this was the only object with the given layer in this node, and if so we need to remove that layer from the node itself (and possibly its parents too)
-    for (unsigned int i = 0; i < collider.node->objects.size(); i++) { // todo: could maybe optimize this loop?
-        if (oldLayer == collider.node->objects[i]->layer) {
-            layerExists = true;
-        }
+    nodes[collider.node].layers.reset();
+    nodes[collider.node].layers.set(collider.layer, true);
+    if (!leafBoundsDirty) {
+        leafBounds.layers[nodes[collider.node].firstLeafSlot] = collider.layer;
     }
 
-    if (!layerExists) {
-        collider.node->layers.set(oldLayer, false);
-        auto currentNode = collider.node;
-        while (currentNode->parent) {
-            currentNode = currentNode->parent;
-            for (auto& n : *(currentNode->children)) {
-                if (n->layers[oldLayer]) {
-                    return;
-                }
-            }
-            currentNode->layers.set(oldLayer, false);
-        }
+    // ancestors' layers are just the union of their children's
+    NodeIndex p = nodes[collider.node].parent;
+    while (p != NULL_NODE) {
+        RecalculateFromChildren(p);
+        p = nodes[p].parent;
+    }
+}
+
+void SpatialAccelerationStructure::SetColliderAwake(ColliderComponent& collider, bool awake) {
+    if (collider.node == NULL_NODE || nodes[collider.node].awake == awake) {
+        return;
+    }
+
+    nodes[collider.node].awake = awake;
+
+    // like layers, ancestors are awake if either child is
+    NodeIndex p = nodes[collider.node].parent;
+    while (p != NULL_NODE) {
+        RecalculateFromChildren(p);
+        p = nodes[p].parent;
     }
 }
 
 SpatialAccelerationStructure::SpatialAccelerationStructure() {
-    root = SasNode();
+    root = NULL_NODE;
+    firstFreeNode = NULL_NODE;
+    leafBoundsDirty = false;
 }
 
 SpatialAccelerationStructure::~SpatialAccelerationStructure() {
@@ -5,6 +5,9 @@
 #include <memory>
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <bit>
+#include <functional>
 #include <glm/vec3.hpp>
 #include "gameobjects/transform_component.hpp"
 
@@ -13,34 +16,41 @@
 
 class ColliderComponent;
 
-// Once there are more objects in a node than this threshold, the node splits
-static const inline unsigned int NODE_SPLIT_THRESHOLD = 50;
+// The SAS stores each collider's AABB grown by this fraction of its largest dimension on every side,
+    // so that a collider that only moves a little bit stays inside the stored AABB and doesn't need to be reinserted.
+static const inline double SAS_AABB_MARGIN = 0.2;
 
 // A dynamic AABB tree structure that allows for fast queries of objects by position, which is needed for collision detection that isn't O(n^2).
 // Specifically used for broad phase collision detection.
-// based on https://www.cs.nmsu.edu/~joshagam/Solace/papers/master-writeup-print.pdf
+// Every leaf node holds exactly one collider and every other node has exactly two children.
+// Colliders are inserted wherever they add the least surface area to the tree (the surface area heuristic), and nodes are rotated on the way back up to keep the tree from degrading as colliders move around.
+// based on https://box2d.org/files/ErinCatto_DynamicBVH_Full.pdf
+// Queries don't walk all the way down to single leaves; once they reach a subtree with only a few leaves, they test all of its colliders' aabbs at once with SIMD (see LeafBounds).
 class SpatialAccelerationStructure { // (SAS)
     public:
     SpatialAccelerationStructure(SpatialAccelerationStructure const&) = delete; // no copying
     SpatialAccelerationStructure& operator=(SpatialAccelerationStructure const&) = delete; // no assigning
 
     static SpatialAccelerationStructure& Get();
-    
+
     // When modules (shared libraries) get their copy of this code, they need to use a special version of SpatialAccelerationStructure::Get().
-    // This is so that both the module and the main executable have access to the same singleton. 
+    // This is so that both the module and the main executable have access to the same singleton.
     // The executable will provide each shared_library with a pointer to the spatial acceleration structure.
     #ifdef IS_MODULE
     static void SetModuleSpatialAccelerationStructure(SpatialAccelerationStructure* structure);
     #endif
 
 
-    
+
     private:
     friend class ColliderComponent;
-    struct SasNode;
+
+    // Nodes are stored in one vector and refer to each other by index, so that adding/removing colliders doesn't allocate once the vector is big enough.
+    using NodeIndex = int;
+    static constexpr NodeIndex NULL_NODE = -1;
     public:
 
-    
+
 
     // Call every frame. Updates the SAS to use the most up-to-date object transforms.
     void Update();
@@ -53,6 +63,48 @@ class SpatialAccelerationStructure { // (SAS)
     // Will only return colliders with one of the given layers.
     std::vector<ColliderComponent*> Query(const glm::dvec3& origin, const glm::dvec3& direction, CollisionLayerSet layers);
 
+    // Same as above, but appends the colliders to results instead of making a new vector, so if you keep reusing the same vector (clear() it first, that keeps its capacity) queries stop allocating.
+    void Query(const AABB& collider, std::vector<ColliderComponent*>& results, CollisionLayerSet layers = ALL_COLLISION_LAYERS);
+    void Query(const glm::dvec3& origin, const glm::dvec3& direction, std::vector<ColliderComponent*>& results, CollisionLayerSet layers);
+
+    // Calls visit(collider) for every collider the above would return, in no particular order, without allocating anything.
+    // visit() returns a bool; returning false stops the query right there (e.g. if you only wanted to know whether there's anything there at all).
+    // Don't add, remove or move colliders from inside visit().
+    template <typename Visitor>
+    void QueryVisit(const AABB& collider, CollisionLayerSet layers, Visitor&& visit);
+    template <typename Visitor>
+    void QueryVisit(const glm::dvec3& origin, const glm::dvec3& direction, CollisionLayerSet layers, Visitor&& visit);
+
+    // One ray (or shape sweeping along a ray) for CastBatch().
+    struct Cast {
+        glm::dvec3 origin;
+        glm::dvec3 direction; // should be normalized, so that distances are in world units
+        double maxDistance;
+        double padding; // AABBs are grown by this much on every side before testing them against the ray, so that a sweeping shape this big can't miss anything
+        CollisionLayerSet layers;
+    };
+
+    // Walks the tree once for all of the casts, calling hit(castIndex, collider) for every collider whose (padded) AABB the cast touches before its maxDistance.
+    // hit() returns the cast's new maxDistance (usually the distance to the closest thing it's hit so far), so that everything farther than that is skipped from then on.
+    // Casts that start near each other and go in similar directions visit mostly the same nodes, so it's best to pass those in together.
+    // Doesn't allocate once this thread has done a few casts as big as this one. Don't start another cast from inside hit(), since casts on the same thread share their scratch space.
+    template <typename Visitor>
+    void CastBatch(const Cast* casts, unsigned int nCasts, Visitor&& hit);
+    template <typename Visitor>
+    void CastBatch(const std::vector<Cast>& casts, Visitor&& hit) {
+        CastBatch(casts.data(), static_cast<unsigned int>(casts.size()), hit);
+    }
+
+    // Appends every pair of colliders whose AABBs intersect to pairs, once per pair and in no particular order.
+    // Skips pairs whose layers don't collide according to layerMatrix (see PhysicsEngine::GetCollisionLayerMatrix()), and pairs where neither collider is awake (see SetColliderAwake()).
+    // Walks the tree against itself instead of querying it once per collider, so a pair isn't found once from each side.
+    void FindOverlappingPairs(std::vector<std::pair<ColliderComponent*, ColliderComponent*>>& pairs, const std::array<CollisionLayerSet, MAX_COLLISION_LAYERS>& layerMatrix);
+
+    // Sets whether the collider belongs to an awake rigidbody. Colliders start out asleep, since most colliders (those without rigidbodies) never move on their own.
+    // (Update() marks colliders without rigidbodies awake for the step after they move, so moving them still wakes up whatever they run into.)
+    // Subtrees with nothing awake in them are skipped by FindOverlappingPairs(), so resting objects don't cost anything there. Cheap to call when nothing changed.
+    void SetColliderAwake(ColliderComponent& collider, bool awake);
+
     // Adds a collider to the SAS.
     void AddCollider(ColliderComponent* collider, const TransformComponent& transform);
 
@@ -62,48 +114,312 @@ class SpatialAccelerationStructure { // (SAS)
     private:
 
     // Helper function for DebugVisualize(), disregard.
-    void DebugVisualizeAddVertexAttributes(SasNode const& node, std::vector<float>& instancedVertexAttributes, unsigned int& numInstances, const Mesh& mesh, unsigned int depth=0);
-
-    // recursive helper functions for Query(), ignore (member func because SasNode is private)
-    void AddIntersectingLeafNodes(SasNode* node, std::vector<SasNode*>& collidingNodes, const AABB& collider, CollisionLayerSet layers);
-    void AddIntersectingLeafNodes(SasNode* node, std::vector<SasNode*>& collidingNodes, const glm::dvec3& origin, const glm::dvec3& inverse_direction, CollisionLayerSet layers);
+    void DebugVisualizeAddVertexAttributes(NodeIndex index, std::vector<float>& instancedVertexAttributes, unsigned int& numInstances, const Mesh& mesh, unsigned int depth=0);
 
     // call whenever collider moves or changes size
     void UpdateCollider(ColliderComponent& collider, const TransformComponent& transform);
 
     // call IMMEDIATELY when collider changes its collision layer
     void UpdateColliderLayer(ColliderComponent& collider, CollisionLayer oldLayer);
-    
+
     SpatialAccelerationStructure();
     ~SpatialAccelerationStructure();
 
     // Node in the SAS's dynamic AABB tree
     struct SasNode {
-        glm::dvec3 splitPoint; // point that splits the aabb to determine aabbs of children, initialized to (nan, nan, nan) 
-        CollisionLayerSet layers; // layers this node contains are 1
+        AABB aabb; // for a leaf, the collider's AABB grown by SAS_AABB_MARGIN; otherwise the smallest aabb containing both children
+        CollisionLayerSet layers; // layers of the colliders under this node are 1
+        bool awake; // true if any collider under this node is awake
+
+        NodeIndex parent; // NULL_NODE for the root. For nodes in the free list, the next free node instead.
+        std::array<NodeIndex, 2> children; // both NULL_NODE for leaves
+        int height; // 0 for leaves, otherwise 1 + height of the tallest child
+        unsigned int nLeaves; // number of leaves in this subtree (including itself if it's a leaf)
+        unsigned int firstLeafSlot; // where this subtree's leaves start in leafBounds; only valid while leafBoundsDirty is false
 
-        bool split; // when this node is queried and it has more objects than NODE_SPLIT_THRESHOLD and this bool is false, the node will be split.
-            // however, if the node can't be split (because all objects are in same position or something) then we'll just set this bool to true and then set it to false when a new collider is added that might make the node splittable
-        std::array<SasNode*, 27>* children;
-        // children are stored in an icoseptree. index with [x * 9 + y * 3 + z], assuming 0 = lower coord 1 = middle 2 = higher coord
+        ColliderComponent* collider; // nullptr unless this is a leaf
 
-        std::vector<ColliderComponent*> objects;
-        SasNode* parent;
-        AABB aabb; // aabb that contains all objects/children of the node
+        bool IsLeaf() const {
+            return children[0] == NULL_NODE;
+        }
+    };
 
-        SasNode();
+    // Takes a node from the free list (or adds one), and makes it an empty leaf.
+    // May resize nodes, so don't hold references to nodes across calls.
+    NodeIndex AllocateNode();
 
-        // recalculate AABB of node from its contents
-        void RecalculateAABB();
+    // Puts the node in the free list.
+    void FreeNode(NodeIndex index);
 
-        // sets splitPoint, calculated by mean position of objects inside, creates children nodes, and moves objects into children nodes
-        void Split();
+    // Puts a leaf (with its aabb already set) into the tree, next to whichever node the surface area heuristic picks.
+    void InsertLeaf(NodeIndex leaf);
 
+    // Takes a leaf out of the tree (without freeing it). Its parent node is freed and replaced by its sibling.
+    void RemoveLeaf(NodeIndex leaf);
+
+    // Recalculates the aabb, layers, awake and height of the given node and all of its ancestors, rotating each one if that makes the tree smaller.
+    void Refit(NodeIndex index);
+
+    // Swaps one of the given node's children with one of its grandchildren, if doing so reduces the surface area of the tree.
+    // Assumes the node's children and grandchildren are up to date; updates the child that ends up with a new child, but not the given node itself.
+    void Rotate(NodeIndex index);
+
+    // Recalculates an internal node's aabb, layers, awake, height and nLeaves from its children.
+    void RecalculateFromChildren(NodeIndex index);
+
+    // Lays leafBounds out again in the tree's current order and sets every node's firstLeafSlot. Only call if leafBoundsDirty.
+    void RebuildLeafBounds();
+
+    // Queries stop walking down the tree at subtrees with this many leaves or fewer, and scan all of their leaves instead.
+    static constexpr unsigned int LEAF_SCAN_SIZE = 8;
+
+    // The stack queries use to walk the tree. The first few hundred nodes go in an array so that queries don't allocate;
+        // the tree would have to be really badly unbalanced to need more than that, but if it does the rest go in a vector.
+    class TraversalStack {
+        public:
+        TraversalStack(): size(0) {}
+
+        void Push(NodeIndex index) {
+            if (size < fixed.size()) {
+                fixed[size] = index;
+            }
+            else {
+                overflow.push_back(index);
+            }
+            size++;
+        }
+
+        NodeIndex Pop() {
+            size--;
+            if (size < fixed.size()) {
+                return fixed[size];
+            }
+            NodeIndex index = overflow.back();
+            overflow.pop_back();
+            return index;
+        }
+
+        bool Empty() const {
+            return size == 0;
+        }
+
+        private:
+        std::array<NodeIndex, 256> fixed;
+        std::vector<NodeIndex> overflow; // an empty vector doesn't allocate
+        unsigned int size;
     };
 
-    // Returns best child node to insert object into, given the parent node and object's AABB.
-    // Returns nullptr if no child node.    
-    static SasNode* SasInsertHeuristic(SasNode& node, const AABB& aabb, CollisionLayer layer);
+    // Calls visit() on the colliders in leafBounds whose bits in hits (from ScanLeaves()) are set. Returns false if visit() did.
+    template <typename Visitor>
+    bool VisitLeaves(unsigned int firstSlot, unsigned int hits, Visitor& visit) {
+        for (; hits != 0; hits &= hits - 1) {
+            if (!visit(leafBounds.colliders[firstSlot + std::countr_zero(hits)])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // A node CastBatch() still has to visit, with the range of CastScratch::activeCasts that made it through the node's parent.
+    struct CastStackEntry {
+        NodeIndex node;
+        unsigned int begin, end;
+    };
+
+    // What CastBatch() needs for each batch, kept per thread between calls so that casting doesn't allocate.
+    struct CastScratch {
+        std::vector<glm::dvec3> inverseDirections;
+        std::vector<double> maxDistances;
+        std::vector<unsigned int> activeCasts;
+        std::vector<CastStackEntry> stack;
+        bool inUse = false;
+    };
+    static CastScratch& GetCastScratch();
+
+    // Returns the aabb in the given slot of leafBounds.
+    AABB GetLeafBounds(unsigned int slot) const {
+        return AABB({leafBounds.minX[slot], leafBounds.minY[slot], leafBounds.minZ[slot]}, {leafBounds.maxX[slot], leafBounds.maxY[slot], leafBounds.maxZ[slot]});
+    }
+
+    // Overwrites the aabb in the given slot of leafBounds.
+    void SetLeafBounds(unsigned int slot, const AABB& aabb);
+
+    // Tests the colliders in leafBounds slots [firstSlot, firstSlot + nSlots) against the given aabb/ray. nSlots can't be more than LEAF_SCAN_SIZE.
+    // Returns a bitmask where bit i is set if the collider in slot firstSlot + i has one of the given layers and intersects.
+    unsigned int ScanLeaves(unsigned int firstSlot, unsigned int nSlots, const AABB& aabb, CollisionLayerSet layers) const;
+    unsigned int ScanLeaves(unsigned int firstSlot, unsigned int nSlots, const glm::dvec3& origin, const glm::dvec3& inverseDirection, CollisionLayerSet layers) const;
+
+    // clears the bits of hits whose colliders don't have one of the given layers
+    unsigned int FilterLayers(unsigned int firstSlot, unsigned int hits, CollisionLayerSet layers) const;
+
+    // Every collider's real (unpadded) aabb, struct-of-arrays, in the order their leaves are in the tree (depth first), so that each subtree's leaves are next to each other.
+    // That lets queries test a small subtree's colliders several at a time without looking at the colliders themselves.
+    struct LeafBounds {
+        std::vector<double> minX, minY, minZ, maxX, maxY, maxZ;
+        std::vector<CollisionLayer> layers;
+        std::vector<ColliderComponent*> colliders;
+    };
+    LeafBounds leafBounds;
+
+    // Set whenever leaves are added, removed or moved around in the tree, so that leafBounds gets rebuilt before the next query.
+    // Colliders moving without changing the tree just overwrite their slot.
+    bool leafBoundsDirty;
+
+    // pairs of nodes FindOverlappingPairs() still has to test against each other, kept around between calls so it doesn't have to allocate every step
+    std::vector<std::pair<NodeIndex, NodeIndex>> pairStack;
+
+    std::vector<SasNode> nodes;
+    NodeIndex root;
+    NodeIndex firstFreeNode; // singly linked list of unused nodes through SasNode::parent
+};
+
+template <typename Visitor>
+void SpatialAccelerationStructure::QueryVisit(const AABB& collider, CollisionLayerSet layers, Visitor&& visit) {
+    if (root == NULL_NODE) {
+        return;
+    }
+    if (leafBoundsDirty) {
+        RebuildLeafBounds();
+    }
+
+    // walk down every node whose aabb intersects the collider
+    TraversalStack stack;
+    stack.Push(root);
+    while (!stack.Empty()) {
+        const SasNode& node = nodes[stack.Pop()];
+
+        if ((node.layers & layers).none() || !node.aabb.TestIntersection(collider)) {
+            continue;
+        }
+
+        if (node.nLeaves <= LEAF_SCAN_SIZE) {
+            // the leaves' aabbs are padded, so this tests the colliders' real aabbs
+            if (!VisitLeaves(node.firstLeafSlot, ScanLeaves(node.firstLeafSlot, node.nLeaves, collider, layers), visit)) {
+                return;
+            }
+        }
+        else {
+            stack.Push(node.children[0]);
+            stack.Push(node.children[1]);
+        }
+    }
+}
+
+template <typename Visitor>
+void SpatialAccelerationStructure::QueryVisit(const glm::dvec3& origin, const glm::dvec3& direction, CollisionLayerSet layers, Visitor&& visit) {
+    if (root == NULL_NODE) {
+        return;
+    }
+    if (leafBoundsDirty) {
+        RebuildLeafBounds();
+    }
+
+    glm::dvec3 inverse_direction = glm::dvec3(1.0/direction.x, 1.0/direction.y, 1.0/direction.z);
+
+    // walk down every node whose aabb intersects the ray
+    TraversalStack stack;
+    stack.Push(root);
+    while (!stack.Empty()) {
+        const SasNode& node = nodes[stack.Pop()];
+
+        if ((node.layers & layers).none() || !node.aabb.TestIntersection(origin, inverse_direction)) {
+            continue;
+        }
+
+        if (node.nLeaves <= LEAF_SCAN_SIZE) {
+            if (!VisitLeaves(node.firstLeafSlot, ScanLeaves(node.firstLeafSlot, node.nLeaves, origin, inverse_direction, layers), visit)) {
+                return;
+            }
+        }
+        else {
+            stack.Push(node.children[0]);
+            stack.Push(node.children[1]);
+        }
+    }
+}
+
+template <typename Visitor>
+void SpatialAccelerationStructure::CastBatch(const Cast* casts, unsigned int nCasts, Visitor&& hit) {
+    if (root == NULL_NODE || nCasts == 0) {
+        return;
+    }
+    if (leafBoundsDirty) {
+        RebuildLeafBounds();
+    }
+
+    CastScratch& scratch = GetCastScratch();
+    Assert(!scratch.inUse); // hit() started another cast
+    scratch.inUse = true;
+    auto& inverseDirections = scratch.inverseDirections;
+    auto& maxDistances = scratch.maxDistances;
+    auto& activeCasts = scratch.activeCasts;
+    auto& stack = scratch.stack;
+
+    inverseDirections.clear();
+    maxDistances.clear();
+    for (unsigned int i = 0; i < nCasts; i++) {
+        inverseDirections.push_back(glm::dvec3(1.0/casts[i].direction.x, 1.0/casts[i].direction.y, 1.0/casts[i].direction.z));
+        maxDistances.push_back(casts[i].maxDistance);
+    }
+
+    // how far along the cast it enters the aabb, padded for the cast
+    auto castDistance = [casts, &inverseDirections](unsigned int castIndex, const AABB& aabb) {
+        const Cast& cast = casts[castIndex];
+        AABB padded(aabb.min - glm::dvec3(cast.padding), aabb.max + glm::dvec3(cast.padding));
+        return padded.RayDistance(cast.origin, inverseDirections[castIndex]);
+    };
+
+    // Every node on the stack comes with the casts that made it through its parent, as a range of activeCasts.
+    // The tree is walked depth first, so by the time a node is popped everything in activeCasts after its range was left by subtrees that are already done, and can be thrown away.
+    activeCasts.clear();
+    for (unsigned int i = 0; i < nCasts; i++) {
+        activeCasts.push_back(i);
+    }
+
+    stack.clear();
+    stack.push_back({root, 0, nCasts});
+
+    while (!stack.empty()) {
+        CastStackEntry entry = stack.back();
+        stack.pop_back();
+        activeCasts.resize(entry.end);
+        const SasNode& node = nodes[entry.node];
+
+        // keep the casts that still reach this node
+        unsigned int begin = activeCasts.size();
+        for (unsigned int i = entry.begin; i < entry.end; i++) {
+            unsigned int castIndex = activeCasts[i];
+            if ((node.layers & casts[castIndex].layers).any() && castDistance(castIndex, node.aabb) < maxDistances[castIndex]) {
+                activeCasts.push_back(castIndex);
+            }
+        }
+        unsigned int end = activeCasts.size();
+        if (begin == end) {
+            continue;
+        }
+
+        if (node.nLeaves <= LEAF_SCAN_SIZE) {
+            // like queries, small subtrees just go through their leaves' real (unpadded) aabbs in leafBounds
+            for (unsigned int slot = node.firstLeafSlot; slot < node.firstLeafSlot + node.nLeaves; slot++) {
+                AABB aabb = GetLeafBounds(slot);
+                for (unsigned int i = begin; i < end; i++) {
+                    unsigned int castIndex = activeCasts[i];
+                    if (casts[castIndex].layers[leafBounds.layers[slot]] && castDistance(castIndex, aabb) < maxDistances[castIndex]) {
+                        maxDistances[castIndex] = std::min(maxDistances[castIndex], hit(castIndex, leafBounds.colliders[slot]));
+                    }
+                }
+            }
+        }
+        else {
+            // visit whichever child is nearer first (going by the first cast, they're hopefully all going about the same way) so that hits there can shrink maxDistances before the farther child is looked at
+            NodeIndex nearChild = node.children[0], farChild = node.children[1];
+            if (castDistance(activeCasts[begin], nodes[farChild].aabb) < castDistance(activeCasts[begin], nodes[nearChild].aabb)) {
+                std::swap(nearChild, farChild);
+            }
+            stack.push_back({farChild, begin, end});
+            stack.push_back({nearChild, begin, end});
+        }
+    }
 
-    SasNode root;
-};
\ No newline at end of file
+    scratch.inUse = false;
+}
@@ -0,0 +1,74 @@
+#include "gameobject_benchmarks.hpp"
+#include "gameobjects/gameobject.hpp"
+#include "gameobjects/transform_component.hpp"
+#include "debug/log.hpp"
+#include "utility/utility.hpp"
+#include <memory>
+
+namespace {
+	constexpr unsigned int N_PAGES = 64;
+	constexpr unsigned int N_ITERATIONS = 20;
+
+	// Fills N_PAGES pages of a transform-only pool, then returns every object that keep() says not to keep.
+	// Iterates through what's left N_ITERATIONS times and logs the average time per pass.
+	template <typename KeepFunc>
+	void BenchmarkDensity(const char* name, KeepFunc keep) {
+		std::bitset<N_COMPONENT_TYPES> archetype;
+		archetype[ComponentBitIndex::Transform] = true;
+		ComponentPool pool(archetype);
+		auto& transformInfo = pool.componentLayout.at(0);
+
+		// fill every slot before returning any, since GetObject() would just hand a returned slot right back out
+		std::vector<std::pair<int, int>> slots;
+		for (unsigned int i = 0; i < N_PAGES * ComponentPool::COMPONENTS_PER_PAGE; i++) {
+			auto [page, objectIndex] = pool.GetObject(nullptr);
+			std::construct_at((TransformComponent*)pool.GetComponent(transformInfo, page, objectIndex));
+			slots.emplace_back(page, objectIndex);
+		}
+		Assert(pool.PageCount() == N_PAGES);
+
+		std::vector<std::pair<int, int>> live;
+		for (auto& [page, objectIndex] : slots) {
+			if (keep(page, objectIndex)) {
+				live.emplace_back(page, objectIndex);
+			}
+			else {
+				std::destroy_at((TransformComponent*)pool.GetComponent(transformInfo, page, objectIndex));
+				pool.ReturnObject(page, objectIndex);
+			}
+		}
+
+		// the pool isn't in GameObject's pool list, so iterate it directly instead of through a SystemQuery
+		std::vector<ComponentPool*> pools = { &pool };
+		std::vector<std::array<int, 1>> offsets = { { pool.columnOffsets[ComponentBitIndex::Transform] } };
+
+		// sum positions so the compiler can't skip the loop
+		double sum = 0;
+		unsigned int visited = 0;
+		auto start = Time();
+		for (unsigned int i = 0; i < N_ITERATIONS; i++) {
+			for (auto it = GameObject::SystemForwardIterator<TransformComponent>(pools, offsets); it.Valid(); it++) {
+				auto& [transform] = *it;
+				sum += transform->Position().x;
+				visited++;
+			}
+		}
+		double elapsed = (Time() - start) / N_ITERATIONS;
+
+		Assert(visited == live.size() * N_ITERATIONS);
+		DebugLogInfo(name, ": ", live.size(), " live of ", N_PAGES * ComponentPool::COMPONENTS_PER_PAGE, " slots, ", elapsed * 1000.0, "ms per pass, ",
+			live.empty() ? 0.0 : elapsed * 1e9 / live.size(), "ns per live object (checksum ", sum, ")");
+
+		for (auto& [page, objectIndex] : live) {
+			std::destroy_at((TransformComponent*)pool.GetComponent(transformInfo, page, objectIndex));
+			pool.ReturnObject(page, objectIndex);
+		}
+	}
+}
+
+void BenchmarkComponentPoolIteration() {
+	BenchmarkDensity("Dense", [](int, int) { return true; });
+	BenchmarkDensity("Sparse (1 in 64 live)", [](int, int objectIndex) { return objectIndex % 64 == 0; });
+	BenchmarkDensity("Mostly empty pages (1 in 8 pages has anything live)", [](int page, int) { return page % 8 == 0; });
+	BenchmarkDensity("Empty", [](int, int) { return false; });
+}
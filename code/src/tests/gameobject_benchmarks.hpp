@@ -0,0 +1,4 @@
+#pragma once
+
+// Times SystemForwardIterator over a standalone ComponentPool of transforms at several densities (full pages, sparse pages, and mostly empty pages) and logs the results.
+void BenchmarkComponentPoolIteration();
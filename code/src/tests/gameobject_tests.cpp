@@ -111,17 +111,19 @@ void TestCubeArray(glm::uvec3 stride, glm::uvec3 start, glm::uvec3 dim, bool phy
 {
     auto m = CubeMesh();
 
+    GameobjectCreateParams params = physics ? 
+        GameobjectCreateParams({ ComponentBitIndex::Transform, ComponentBitIndex::Render, ComponentBitIndex::Collider , ComponentBitIndex::Rigidbody }) : 
+        GameobjectCreateParams({ ComponentBitIndex::Transform, ComponentBitIndex::Render, ComponentBitIndex::Collider });
+    params.meshId = m->meshId;
+    Assert(params.materialId == 0);
+    //params.materialId = brickMaterial->id;
+    auto gameobjects = GameObject::NewBatch(params, dim.x * dim.y * dim.z);
+
     int nObjs = 0;
     for (int x = 0; x < dim.x; x++) {
         for (int y = 0; y < dim.y; y++) {
             for (int z = 0; z < dim.z; z++) {
-                GameobjectCreateParams params = physics ? 
-                    GameobjectCreateParams({ ComponentBitIndex::Transform, ComponentBitIndex::Render, ComponentBitIndex::Collider , ComponentBitIndex::Rigidbody }) : 
-                    GameobjectCreateParams({ ComponentBitIndex::Transform, ComponentBitIndex::Render, ComponentBitIndex::Collider });
-                params.meshId = m->meshId;
-                Assert(params.materialId == 0);
-                //params.materialId = brickMaterial->id;
-                auto g = GameObject::New(params);
+                auto& g = gameobjects[(x * dim.y + y) * dim.z + z];
                 g->Get<TransformComponent>()->SetPos(glm::dvec3(start + stride * glm::uvec3(x, y, z)));
                 g->Get<ColliderComponent>()->elasticity = 0.3;
                 g->Get<ColliderComponent>()->friction = 1.0;
@@ -180,6 +182,7 @@ void TestSphere(int x, int y, int z, bool physics)
 {
     GameobjectCreateParams params = physics ? GameobjectCreateParams({ ComponentBitIndex::Transform, ComponentBitIndex::Render, ComponentBitIndex::Collider , ComponentBitIndex::Rigidbody }) : GameobjectCreateParams({ ComponentBitIndex::Transform, ComponentBitIndex::Render, ComponentBitIndex::Collider });
     params.meshId = SphereMesh()->meshId;
+    params.colliderShape = ColliderShapeSphere;
     //params.materialId = brickMaterial->id;
     auto g = GameObject::New(params);
     g->Get<TransformComponent>()->SetPos({ x, y, z });
@@ -201,6 +204,25 @@ void TestSphere(int x, int y, int z, bool physics)
     }
 }
 
+void TestProjectile(glm::dvec3 position, glm::dvec3 velocity)
+{
+    GameobjectCreateParams params({ ComponentBitIndex::Transform, ComponentBitIndex::Render, ComponentBitIndex::Collider, ComponentBitIndex::Rigidbody });
+    params.meshId = SphereMesh()->meshId;
+    params.colliderShape = ColliderShapeSphere;
+    auto g = GameObject::New(params);
+    g->Get<TransformComponent>()->SetPos(position);
+    g->Get<TransformComponent>()->SetScl(glm::dvec3(0.1, 0.1, 0.1));
+    g->Get<ColliderComponent>()->elasticity = 0.3;
+    g->Get<ColliderComponent>()->friction = 1.0;
+    g->Get<RenderComponent>()->SetColor(glm::vec4(1, 0, 0, 1));
+    g->Get<RenderComponent>()->SetTextureZ(-1);
+    g->name = std::string("Projectile");
+
+    g->RawGet<RigidbodyComponent>()->SetMass(0.1, *g->RawGet<TransformComponent>());
+    g->RawGet<RigidbodyComponent>()->continuousCollision = true;
+    g->RawGet<RigidbodyComponent>()->velocity = velocity; // at 1/60 of a second per step, anything over 6 m/s would go through walls without continuous collision
+}
+
 void TestBrickWall()
 {
     auto m = CubeMesh();
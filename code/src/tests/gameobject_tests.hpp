@@ -20,6 +20,8 @@ void MakeFPSTracker();
 
 void TestCubeArray(glm::uvec3 stride, glm::uvec3 start, glm::uvec3 dim, bool physics, glm::vec3 scale = {1, 1, 1});
 void TestSphere(int x, int y, int z, bool physics);
+// A small, fast sphere with continuous collision (see RigidbodyComponent::continuousCollision), for shooting at walls to make sure it doesn't go through them.
+void TestProjectile(glm::dvec3 position, glm::dvec3 velocity);
 void TestBrickWall();
 void TestGrassFloor();
 void TestVoxelTerrain();
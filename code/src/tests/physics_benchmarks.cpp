@@ -0,0 +1,754 @@
+#include "physics_benchmarks.hpp"
+#include "gameobject_tests.hpp"
+#include "gameobjects/gameobject.hpp"
+#include "gameobjects/collider_component.hpp"
+#include "gameobjects/rigidbody_component.hpp"
+#include "physics/spatial_acceleration_structure.hpp"
+#include "physics/gjk.hpp"
+#include "physics/physics_mesh.hpp"
+#include "physics/mesh_simplification.hpp"
+#include "physics/raycast.hpp"
+#include "physics/heightfield.hpp"
+#include "physics/pengine.hpp"
+#include "debug/log.hpp"
+#include "utility/utility.hpp"
+#include "glm/gtx/string_cast.hpp"
+#include <algorithm>
+#include <random>
+
+namespace {
+	constexpr unsigned int N_FRAMES = 20;
+
+	// Params for unit cubes with nothing but a collider of the given shape, which is what most of these benchmarks fill their scenes with.
+	GameobjectCreateParams CubeParams(ColliderShape shape = ColliderShapeMesh) {
+		GameobjectCreateParams params({ ComponentBitIndex::Transform, ComponentBitIndex::Collider });
+		params.meshId = CubeMesh()->meshId;
+		params.colliderShape = shape;
+		return params;
+	}
+
+	// The gameobjects a benchmark is run on, with their transforms and colliders pulled out so that timed loops don't have to look them up. Destroys them when it goes out of scope.
+	// rng has a fixed seed, so that every run (and every implementation being compared) gets the same scene; benchmarks use it for placing the gameobjects and anything else they randomize.
+	struct BenchmarkObjects {
+		std::mt19937 rng;
+		std::vector<std::shared_ptr<GameObject>> gameobjects;
+		std::vector<TransformComponent*> transforms;
+		std::vector<ColliderComponent*> colliders;
+
+		BenchmarkObjects(unsigned int count, const GameobjectCreateParams& params = CubeParams()):
+			rng(1234),
+			gameobjects(GameObject::NewBatch(params, count))
+		{
+			for (auto& g : gameobjects) {
+				transforms.push_back(g->RawGet<TransformComponent>());
+				colliders.push_back(g->RawGet<ColliderComponent>());
+			}
+		}
+
+		BenchmarkObjects(const BenchmarkObjects&) = delete;
+		BenchmarkObjects& operator=(const BenchmarkObjects&) = delete;
+
+		~BenchmarkObjects() {
+			GameObject::DestroyBatch(gameobjects);
+		}
+	};
+
+	// Puts the objects in pairs that mostly overlap, each pair randomly rotated and far away from the others (not that it matters when the narrowphase is called directly).
+	// Pair i is objects i * 2 and i * 2 + 1.
+	void PlaceOverlappingPairs(BenchmarkObjects& objects) {
+		std::uniform_real_distribution<double> offset(-1.0, 1.0);
+		std::uniform_real_distribution<float> angle(0, 2.0f * glm::pi<float>());
+		for (unsigned int i = 0; i < objects.transforms.size(); i++) {
+			glm::dvec3 pairPosition(i / 2 * 10.0, 0, 0);
+			objects.transforms[i]->SetPos(i % 2 == 0 ? pairPosition : pairPosition + glm::dvec3(offset(objects.rng), offset(objects.rng), offset(objects.rng)));
+			objects.transforms[i]->SetRot(glm::quat(glm::vec3(angle(objects.rng), angle(objects.rng), angle(objects.rng))));
+		}
+	}
+
+	// Creates nObjects unit cubes scattered randomly through a cube with the given half-width, then for N_FRAMES frames jiggles movingFraction of them around a little
+		// and times SpatialAccelerationStructure::Update() and one Query() per collider.
+	void BenchmarkScene(const char* name, unsigned int nObjects, double halfWidth, double movingFraction) {
+		auto& sas = SpatialAccelerationStructure::Get();
+
+		std::uniform_real_distribution<double> position(-halfWidth, halfWidth);
+		std::uniform_real_distribution<double> jiggle(-0.1, 0.1);
+		std::bernoulli_distribution moves(movingFraction);
+
+		auto buildStart = Time();
+		BenchmarkObjects objects(nObjects);
+		auto& rng = objects.rng;
+		auto& transforms = objects.transforms;
+		auto& colliders = objects.colliders;
+		for (auto& transform : transforms) {
+			transform->SetPos({ position(rng), position(rng), position(rng) });
+		}
+		sas.Update();
+		double buildTime = Time() - buildStart;
+
+		double updateTime = 0, queryTime = 0;
+		size_t nPairs = 0;
+		for (unsigned int frame = 0; frame < N_FRAMES; frame++) {
+			for (auto& transform : transforms) {
+				if (moves(rng)) {
+					transform->SetPos(transform->Position() + glm::dvec3(jiggle(rng), jiggle(rng), jiggle(rng)));
+				}
+			}
+
+			auto updateStart = Time();
+			sas.Update();
+			updateTime += Time() - updateStart;
+
+			auto queryStart = Time();
+			nPairs = 0;
+			for (auto& collider : colliders) {
+				nPairs += sas.Query(collider->GetAABB()).size();
+			}
+			queryTime += Time() - queryStart;
+		}
+
+		// every collider tested against every other one, on the last frame's positions
+		auto bruteForceStart = Time();
+		size_t nBruteForcePairs = 0;
+		for (auto& a : colliders) {
+			for (auto& b : colliders) {
+				if (a->GetAABB().TestIntersection(b->GetAABB())) {
+					nBruteForcePairs++;
+				}
+			}
+		}
+		double bruteForceTime = Time() - bruteForceStart;
+
+		Assert(nPairs == nBruteForcePairs);
+		DebugLogInfo(name, ": ", nObjects, " colliders, ", nPairs, " overlapping pairs. Build ", buildTime * 1000.0, "ms, update ", updateTime * 1000.0 / N_FRAMES, "ms per frame, query ",
+			queryTime * 1000.0 / N_FRAMES, "ms per frame, brute force ", bruteForceTime * 1000.0, "ms per frame");
+	}
+
+	// Times one SAS Query() for each of the given aabbs (returning a new vector, appending to a reused one, and with QueryVisit()) against testing every collider's aabb,
+		// checks that they all find the same number of colliders, and logs the results.
+	void BenchmarkAabbQueries(const char* name, const std::vector<ColliderComponent*>& colliders, const std::vector<AABB>& queries) {
+		auto& sas = SpatialAccelerationStructure::Get();
+
+		auto queryStart = Time();
+		size_t nFound = 0;
+		for (auto& query : queries) {
+			nFound += sas.Query(query).size();
+		}
+		double queryTime = Time() - queryStart;
+
+		// the same queries without allocating: into one reused vector, then with a visitor that just counts
+		auto bufferStart = Time();
+		std::vector<ColliderComponent*> buffer;
+		size_t nBufferFound = 0;
+		for (auto& query : queries) {
+			buffer.clear();
+			sas.Query(query, buffer);
+			nBufferFound += buffer.size();
+		}
+		double bufferTime = Time() - bufferStart;
+
+		auto visitStart = Time();
+		size_t nVisited = 0;
+		for (auto& query : queries) {
+			sas.QueryVisit(query, ALL_COLLISION_LAYERS, [&nVisited](ColliderComponent*) {
+				nVisited++;
+				return true;
+			});
+		}
+		double visitTime = Time() - visitStart;
+
+		auto bruteForceStart = Time();
+		size_t nBruteForceFound = 0;
+		for (auto& query : queries) {
+			for (auto& collider : colliders) {
+				if (collider->GetAABB().TestIntersection(query)) {
+					nBruteForceFound++;
+				}
+			}
+		}
+		double bruteForceTime = Time() - bruteForceStart;
+
+		Assert(nFound == nBruteForceFound);
+		Assert(nBufferFound == nBruteForceFound);
+		Assert(nVisited == nBruteForceFound);
+		DebugLogInfo(name, ": ", queries.size(), " queries found ", nFound, " colliders in ", queryTime * 1000.0, "ms (", queryTime * 1e9 / queries.size(), "ns per query), ", bufferTime * 1000.0,
+			"ms into a reused vector, ", visitTime * 1000.0, "ms with QueryVisit(), brute force ", bruteForceTime * 1000.0, "ms");
+	}
+
+	// Times IsColliding() on pairs of gameobjects made with params, each pair randomly rotated and mostly overlapping, and logs the results.
+	void BenchmarkPairs(const char* name, const GameobjectCreateParams& params) {
+		constexpr unsigned int N_PAIRS = 10000;
+		constexpr unsigned int N_REPEATS = 10;
+
+		// (every shape gets the same positions/rotations)
+		BenchmarkObjects objects(N_PAIRS * 2, params);
+		PlaceOverlappingPairs(objects);
+		auto& transforms = objects.transforms;
+		auto& colliders = objects.colliders;
+
+		auto start = Time();
+		size_t nColliding = 0;
+		for (unsigned int repeat = 0; repeat < N_REPEATS; repeat++) {
+			nColliding = 0;
+			for (unsigned int i = 0; i < N_PAIRS; i++) {
+				if (IsColliding(*transforms[i * 2], *colliders[i * 2], *transforms[i * 2 + 1], *colliders[i * 2 + 1])) {
+					nColliding++;
+				}
+			}
+		}
+		double elapsed = (Time() - start) / N_REPEATS;
+
+		DebugLogInfo(name, ": ", N_PAIRS, " pairs, ", nColliding, " colliding. IsColliding() on every pair took ", elapsed * 1000.0, "ms");
+	}
+
+	using Triangles = std::vector<std::array<glm::vec3, 3>>;
+
+	// How MakeConvexMesh() used to merge triangles into faces, comparing every triangle's normal to every face's normal (copied as is, other than the formatting).
+	std::vector<std::pair<glm::vec3, std::vector<glm::vec3>>> ReferenceFaces(const Triangles& triangles, glm::vec3 center) {
+		std::vector<std::pair<glm::vec3, std::vector<glm::vec3>>> faces;
+		for (auto& [vertex1, vertex2, vertex3] : triangles) {
+			auto normal = glm::cross(vertex1 - vertex2, vertex1 - vertex3);
+
+			double distance = glm::dot(normal, vertex1 - center);
+			if (distance < 0) {
+				normal *= -1;
+				distance *= -1;
+			}
+
+			bool foundFace = false;
+			for (auto& f : faces) {
+				if (glm::dot(f.first, normal) > 0.99f) {
+					foundFace = true;
+
+					bool containsVertex1 = false;
+					bool containsVertex2 = false;
+					bool containsVertex3 = false;
+					for (auto& v : f.second) {
+						if (v == vertex1) {
+							containsVertex1 = true;
+						}
+						else if (v == vertex2) {
+							containsVertex2 = true;
+						}
+						else if (v == vertex3) {
+							containsVertex3 = true;
+						}
+					}
+
+					if (!containsVertex1) {
+						f.second.push_back(vertex1);
+					}
+					if (!containsVertex2) {
+						f.second.push_back(vertex2);
+					}
+					if (!containsVertex3) {
+						f.second.push_back(vertex3);
+					}
+
+					break;
+				}
+			}
+			if (!foundFace) {
+				faces.push_back({ normal, { vertex1, vertex2, vertex3 } });
+			}
+		}
+		return faces;
+	}
+
+	// How MakeConvexMesh() used to find edges, checking every edge found so far for each edge of each face (also copied as is).
+	std::vector<std::pair<glm::vec3, glm::vec3>> ReferenceEdges(const std::vector<std::pair<glm::vec3, std::vector<glm::vec3>>>& faces) {
+		std::vector<std::pair<glm::vec3, glm::vec3>> edges;
+		for (auto& f : faces) {
+			for (unsigned int i = 0; i < f.second.size(); i++) {
+				auto vertex1 = f.second[i];
+				auto vertex2 = f.second[(i + 1 == f.second.size() ? 0 : i + 1)];
+				bool foundEdge = false;
+				for (auto& [a, b] : edges) {
+					if (a == vertex1 && b == vertex2) { foundEdge = true; }
+					if (a == vertex2 && b == vertex1) { foundEdge = true; }
+				}
+				if (!foundEdge) {
+					edges.emplace_back(vertex1, vertex2);
+				}
+			}
+		}
+		return edges;
+	}
+
+	// A 1x1x1 cube centered on the origin, with each side split into a subdivisions x subdivisions grid of squares (2 triangles each).
+	Triangles SubdividedCube(unsigned int subdivisions) {
+		Triangles triangles;
+		for (unsigned int axis = 0; axis < 3; axis++) {
+			for (float side : { -0.5f, 0.5f }) {
+				auto point = [&](unsigned int i, unsigned int j) {
+					glm::vec3 p;
+					p[axis] = side;
+					p[(axis + 1) % 3] = -0.5f + float(i) / subdivisions;
+					p[(axis + 2) % 3] = -0.5f + float(j) / subdivisions;
+					return p;
+				};
+				for (unsigned int i = 0; i < subdivisions; i++) {
+					for (unsigned int j = 0; j < subdivisions; j++) {
+						triangles.push_back({ point(i, j), point(i + 1, j), point(i + 1, j + 1) });
+						triangles.push_back({ point(i, j), point(i + 1, j + 1), point(i, j + 1) });
+					}
+				}
+			}
+		}
+		return triangles;
+	}
+
+	// A sphere with a diameter of 1 centered on the origin, made of rings of quads (2 triangles each, which share a face) with triangles at the poles.
+	Triangles UvSphere(unsigned int nSegments, unsigned int nRings) {
+		auto point = [&](unsigned int segment, unsigned int ring) {
+			float theta = 2.0f * glm::pi<float>() * (segment % nSegments) / nSegments;
+			float phi = glm::pi<float>() * ring / nRings;
+			return 0.5f * glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+		};
+
+		Triangles triangles;
+		for (unsigned int segment = 0; segment < nSegments; segment++) {
+			for (unsigned int ring = 0; ring < nRings; ring++) {
+				if (ring != 0) {
+					triangles.push_back({ point(segment, ring), point(segment + 1, ring), point(segment + 1, ring + 1) });
+				}
+				if (ring != nRings - 1) {
+					triangles.push_back({ point(segment, ring), point(segment + 1, ring + 1), point(segment, ring + 1) });
+				}
+			}
+		}
+		return triangles;
+	}
+
+	// Face normals aren't normalized, so whether triangles merge depends on how big they are. Scaling meshes up makes their triangles merge more.
+	Triangles Scaled(Triangles triangles, float scale) {
+		for (auto& triangle : triangles) {
+			for (auto& vertex : triangle) {
+				vertex *= scale;
+			}
+		}
+		return triangles;
+	}
+
+	// Times MakeConvexMesh() and the old way of doing the same thing on the given triangles, checks that they made the same faces and edges, and logs the results.
+	void BenchmarkFaces(const char* name, const Triangles& triangles) {
+		auto start = Time();
+		auto convexMesh = MakeConvexMesh(triangles, { 0, 0, 0 });
+		double time = Time() - start;
+
+		auto referenceStart = Time();
+		auto referenceFaces = ReferenceFaces(triangles, { 0, 0, 0 });
+		SortFaceVertices(referenceFaces, { 0, 0, 0 }); // the sorting didn't change, so both use the same one
+		auto referenceEdges = ReferenceEdges(referenceFaces);
+		double referenceTime = Time() - referenceStart;
+
+		// the bucketing is supposed to find exactly the faces the old way did, in the same order
+		Assert(convexMesh.faces == referenceFaces);
+		Assert(convexMesh.edges == referenceEdges);
+
+		DebugLogInfo(name, ": ", triangles.size(), " triangles, ", convexMesh.faces.size(), " faces, ", convexMesh.edges.size(), " edges. MakeConvexMesh() took ", time * 1000.0,
+			"ms, the old way took ", referenceTime * 1000.0, "ms");
+	}
+}
+
+void BenchmarkBroadphase() {
+	BenchmarkScene("Sparse, mostly still", 10000, 200.0, 0.1);
+	BenchmarkScene("Sparse, all moving", 10000, 200.0, 1.0);
+	BenchmarkScene("Dense, mostly still", 10000, 25.0, 0.1);
+	BenchmarkScene("Dense, all moving", 10000, 25.0, 1.0);
+}
+
+void BenchmarkNarrowphase() {
+	constexpr unsigned int N_PAIRS = 10000;
+	constexpr unsigned int N_REPEATS = 10;
+
+	BenchmarkObjects objects(N_PAIRS * 2);
+	PlaceOverlappingPairs(objects);
+	auto& transforms = objects.transforms;
+	auto& colliders = objects.colliders;
+
+	auto gjkStart = Time();
+	std::vector<unsigned int> collidingPairs;
+	size_t nContactPoints = 0;
+	for (unsigned int repeat = 0; repeat < N_REPEATS; repeat++) {
+		collidingPairs.clear();
+		nContactPoints = 0;
+		for (unsigned int i = 0; i < N_PAIRS; i++) {
+			auto collision = IsColliding(*transforms[i * 2], *colliders[i * 2], *transforms[i * 2 + 1], *colliders[i * 2 + 1]);
+			if (collision) {
+				collidingPairs.push_back(i);
+				nContactPoints += collision->contactPoints.size();
+			}
+		}
+	}
+	double gjkTime = (Time() - gjkStart) / N_REPEATS;
+
+	auto satStart = Time();
+	size_t nSatContactPoints = 0;
+	for (unsigned int repeat = 0; repeat < N_REPEATS; repeat++) {
+		nSatContactPoints = 0;
+		for (auto i : collidingPairs) {
+			auto collision = FindContactSat(*transforms[i * 2], *colliders[i * 2], *transforms[i * 2 + 1], *colliders[i * 2 + 1]);
+			if (collision) {
+				nSatContactPoints += collision->contactPoints.size();
+			}
+		}
+	}
+	double satTime = (Time() - satStart) / N_REPEATS;
+
+	DebugLogInfo(N_PAIRS, " pairs of cubes, ", collidingPairs.size(), " colliding. IsColliding() on every pair took ", gjkTime * 1000.0, "ms (", nContactPoints, " contact points), FindContactSat() on the colliding pairs took ",
+		satTime * 1000.0, "ms (", nSatContactPoints, " contact points)");
+}
+
+void BenchmarkPrimitiveColliders() {
+	GameobjectCreateParams params({ ComponentBitIndex::Transform, ComponentBitIndex::Collider });
+
+	params.meshId = SphereMesh()->meshId;
+	params.colliderShape = ColliderShapeMesh;
+	BenchmarkPairs("Sphere meshes", params);
+	params.colliderShape = ColliderShapeSphere;
+	BenchmarkPairs("Sphere primitives", params);
+
+	params.meshId = CubeMesh()->meshId;
+	params.colliderShape = ColliderShapeMesh;
+	BenchmarkPairs("Cube meshes", params);
+	params.colliderShape = ColliderShapeBox;
+	BenchmarkPairs("Box primitives", params);
+	params.colliderShape = ColliderShapeCapsule;
+	BenchmarkPairs("Capsule primitives", params);
+}
+
+void BenchmarkPhysicsMeshFaces() {
+	BenchmarkFaces("Cube", SubdividedCube(1));
+	BenchmarkFaces("Subdivided cube", SubdividedCube(32));
+	BenchmarkFaces("Low poly sphere", UvSphere(16, 8));
+	BenchmarkFaces("High poly sphere", UvSphere(128, 64));
+	BenchmarkFaces("Subdivided cube, scaled up (triangles merge)", Scaled(SubdividedCube(32), 32));
+	BenchmarkFaces("High poly sphere, scaled up (triangles merge)", Scaled(UvSphere(128, 64), 80));
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> coordinate(-0.5f, 0.5f);
+	std::vector<glm::vec3> points(20000);
+	for (auto& p : points) {
+		p = { coordinate(rng), coordinate(rng), coordinate(rng) };
+	}
+	BenchmarkFaces("Convex hull of random points", ConvexHull(points));
+	BenchmarkFaces("Convex hull of random points, scaled up (triangles merge)", Scaled(ConvexHull(points), 10));
+}
+
+void BenchmarkRaycasts() {
+	constexpr unsigned int N_OBJECTS = 5000;
+	constexpr unsigned int N_RAYS = 10000;
+
+	std::uniform_real_distribution<double> position(-50.0, 50.0);
+	std::uniform_real_distribution<double> spread(-0.3, 0.3);
+	std::uniform_real_distribution<float> angle(0, 2.0f * glm::pi<float>());
+
+	BenchmarkObjects objects(N_OBJECTS);
+	auto& rng = objects.rng;
+	for (auto& transform : objects.transforms) {
+		transform->SetPos({ position(rng), position(rng), position(rng) });
+		transform->SetRot(glm::quat(glm::vec3(angle(rng), angle(rng), angle(rng))));
+	}
+	SpatialAccelerationStructure::Get().Update();
+
+	// rays fanning out from a few points at the edge of the scene into it, like a bunch of shotguns going off
+	std::vector<RayQuery> rays;
+	for (unsigned int i = 0; i < N_RAYS; i++) {
+		glm::dvec3 origin(-60.0, (i % 10) * 10.0 - 45.0, 0);
+		rays.push_back({ .origin = origin, .direction = glm::normalize(glm::dvec3(1, spread(rng), spread(rng))) });
+	}
+
+	auto singleStart = Time();
+	std::vector<RaycastResult> singleResults;
+	for (auto& ray : rays) {
+		singleResults.push_back(Raycast(ray.origin, ray.direction));
+	}
+	double singleTime = Time() - singleStart;
+
+	auto batchStart = Time();
+	std::vector<RaycastResult> batchResults;
+	BatchRaycast(rays, batchResults);
+	double batchTime = Time() - batchStart;
+
+	unsigned int nHits = 0;
+	for (unsigned int i = 0; i < N_RAYS; i++) {
+		Assert(singleResults[i].hitObject == batchResults[i].hitObject);
+		if (batchResults[i].hitObject) {
+			nHits++;
+		}
+	}
+
+	// the same rays, but not going past 20 units
+	for (auto& ray : rays) {
+		ray.maxDistance = 20.0;
+	}
+	auto shortStart = Time();
+	BatchRaycast(rays, batchResults);
+	double shortTime = Time() - shortStart;
+	unsigned int nShortHits = 0;
+	for (unsigned int i = 0; i < N_RAYS; i++) {
+		Assert(batchResults[i].hitDistance <= 20.0 || batchResults[i].hitObject == nullptr);
+		if (batchResults[i].hitObject) {
+			nShortHits++;
+			Assert(batchResults[i].hitObject == singleResults[i].hitObject);
+		}
+	}
+
+	std::vector<SphereCastQuery> sphereCasts;
+	std::vector<BoxCastQuery> boxCasts;
+	for (auto& ray : rays) {
+		sphereCasts.push_back({ .origin = ray.origin, .direction = ray.direction, .radius = 0.5 });
+		boxCasts.push_back({ .origin = ray.origin, .direction = ray.direction, .halfExtents = {0.5, 0.25, 0.5}, .rotation = glm::quat(glm::vec3(angle(rng), angle(rng), angle(rng))) });
+	}
+
+	auto sphereStart = Time();
+	std::vector<RaycastResult> sphereResults;
+	BatchSphereCast(sphereCasts, sphereResults);
+	double sphereTime = Time() - sphereStart;
+
+	auto boxStart = Time();
+	std::vector<RaycastResult> boxResults;
+	BatchBoxCast(boxCasts, boxResults);
+	double boxTime = Time() - boxStart;
+
+	// a fat shape can't get farther than a ray before hitting something
+	unsigned int nSphereHits = 0, nBoxHits = 0;
+	for (unsigned int i = 0; i < N_RAYS; i++) {
+		Assert(sphereResults[i].hitDistance <= singleResults[i].hitDistance + 1e-6);
+		Assert(boxResults[i].hitDistance <= singleResults[i].hitDistance + 1e-6);
+		nSphereHits += sphereResults[i].hitObject != nullptr;
+		nBoxHits += boxResults[i].hitObject != nullptr;
+	}
+
+	DebugLogInfo(N_RAYS, " rays against ", N_OBJECTS, " cubes, ", nHits, " hits. Raycast() on each ray took ", singleTime * 1000.0, "ms, BatchRaycast() took ", batchTime * 1000.0, "ms, or ",
+		shortTime * 1000.0, "ms with a max distance of 20 (", nShortHits, " hits). BatchSphereCast() took ", sphereTime * 1000.0, "ms (", nSphereHits, " hits), BatchBoxCast() took ", boxTime * 1000.0, "ms (", nBoxHits, " hits)");
+}
+
+void BenchmarkSpatialQueries() {
+	constexpr unsigned int N_OBJECTS = 10000;
+	constexpr unsigned int N_QUERIES = 10000;
+	constexpr double HALF_WIDTH = 100.0;
+
+	auto& sas = SpatialAccelerationStructure::Get();
+
+	std::uniform_real_distribution<double> position(-HALF_WIDTH, HALF_WIDTH);
+	std::uniform_real_distribution<double> jiggle(-0.1, 0.1);
+	std::uniform_real_distribution<double> direction(-1.0, 1.0);
+
+	BenchmarkObjects objects(N_OBJECTS);
+	auto& rng = objects.rng;
+	auto& transforms = objects.transforms;
+	auto& colliders = objects.colliders;
+	for (auto& transform : transforms) {
+		transform->SetPos({ position(rng), position(rng), position(rng) });
+	}
+	sas.Update();
+
+	// some of them move a little, like they would between frames, so that the leaves have to be updated and some reinserted
+	for (auto& transform : transforms) {
+		if (rng() % 10 == 0) {
+			transform->SetPos(transform->Position() + glm::dvec3(jiggle(rng), jiggle(rng), jiggle(rng)));
+		}
+	}
+	auto updateStart = Time();
+	sas.Update();
+	double updateTime = Time() - updateStart;
+	DebugLogInfo("SAS update after moving 10% of ", N_OBJECTS, " colliders took ", updateTime * 1000.0, "ms");
+
+	// trigger volumes: small boxes about the size of the colliders
+	std::vector<AABB> queries;
+	for (unsigned int i = 0; i < N_QUERIES; i++) {
+		glm::dvec3 center(position(rng), position(rng), position(rng));
+		queries.emplace_back(center - glm::dvec3(1.0), center + glm::dvec3(1.0));
+	}
+	BenchmarkAabbQueries("Small aabbs", colliders, queries);
+
+	// ai perception: big boxes around some of the colliders
+	queries.clear();
+	for (unsigned int i = 0; i < N_QUERIES / 10; i++) {
+		glm::dvec3 center = transforms[i]->Position();
+		queries.emplace_back(center - glm::dvec3(20.0), center + glm::dvec3(20.0));
+	}
+	BenchmarkAabbQueries("Big aabbs", colliders, queries);
+
+	// lines of sight
+	size_t nFound = 0, nBruteForceFound = 0;
+	std::vector<std::pair<glm::dvec3, glm::dvec3>> rays;
+	for (unsigned int i = 0; i < N_QUERIES; i++) {
+		rays.emplace_back(glm::dvec3(position(rng), position(rng), position(rng)), glm::normalize(glm::dvec3(direction(rng), direction(rng), direction(rng))));
+	}
+	auto rayStart = Time();
+	for (auto& [origin, rayDirection] : rays) {
+		nFound += sas.Query(origin, rayDirection, ALL_COLLISION_LAYERS).size();
+	}
+	double rayTime = Time() - rayStart;
+
+	auto bruteForceStart = Time();
+	for (auto& [origin, rayDirection] : rays) {
+		glm::dvec3 inverseDirection(1.0 / rayDirection.x, 1.0 / rayDirection.y, 1.0 / rayDirection.z);
+		for (auto& collider : colliders) {
+			if (collider->GetAABB().TestIntersection(origin, inverseDirection)) {
+				nBruteForceFound++;
+			}
+		}
+	}
+	double bruteForceTime = Time() - bruteForceStart;
+
+	Assert(nFound == nBruteForceFound);
+	DebugLogInfo("Rays: ", rays.size(), " queries found ", nFound, " colliders in ", rayTime * 1000.0, "ms (", rayTime * 1e9 / rays.size(), "ns per query), brute force ", bruteForceTime * 1000.0, "ms");
+}
+
+void BenchmarkTerrainColliders() {
+	constexpr unsigned int N_BOXES = 10000;
+	constexpr unsigned int SIZE = 16; // same as a terrain chunk
+	constexpr unsigned int N_CELL_CHANGES = 1000;
+
+	// the same flat ground as a heightfield, and as a cube mesh with its top at y = 0
+	auto heightfield = std::make_shared<Heightfield>(SIZE, SIZE);
+	for (int x = -1; x <= (int)SIZE; x++) {
+		for (int z = -1; z <= (int)SIZE; z++) {
+			heightfield->SetHeight(x, z, 0);
+		}
+	}
+	GameobjectCreateParams heightfieldParams({ ComponentBitIndex::Transform, ComponentBitIndex::Collider });
+	heightfieldParams.colliderShape = ColliderShapeHeightfield;
+	heightfieldParams.heightfield = heightfield;
+	auto heightfieldGround = GameObject::New(heightfieldParams);
+
+	auto meshGround = GameObject::New(CubeParams());
+	meshGround->RawGet<TransformComponent>()->SetPos({ SIZE / 2.0, -0.5, SIZE / 2.0 });
+	meshGround->RawGet<TransformComponent>()->SetScl({ SIZE, 1, SIZE });
+
+	// boxes sunk a little into the ground, away from its edges
+	std::uniform_real_distribution<double> position(1.0, SIZE - 1.0);
+	std::uniform_real_distribution<float> tilt(-0.05f, 0.05f);
+	std::uniform_real_distribution<float> angle(0, 2.0f * glm::pi<float>());
+
+	BenchmarkObjects boxes(N_BOXES, CubeParams(ColliderShapeBox));
+	auto& rng = boxes.rng;
+	for (auto& transform : boxes.transforms) {
+		transform->SetPos({ position(rng), 0.45, position(rng) });
+		transform->SetRot(glm::quat(glm::vec3(tilt(rng), angle(rng), tilt(rng))));
+	}
+	SpatialAccelerationStructure::Get().Update();
+
+	auto timeCollisions = [&boxes](const std::shared_ptr<GameObject>& ground, unsigned int& nColliding, unsigned int& nContactPoints) {
+		const auto& groundTransform = *ground->RawGet<TransformComponent>();
+		const auto& groundCollider = *ground->RawGet<ColliderComponent>();
+		nColliding = 0;
+		nContactPoints = 0;
+		auto start = Time();
+		for (unsigned int i = 0; i < N_BOXES; i++) {
+			auto collision = IsColliding(groundTransform, groundCollider, *boxes.transforms[i], *boxes.colliders[i]);
+			if (collision) {
+				Assert(groundCollider.shape != ColliderShapeHeightfield || collision->collisionNormal.y > 0.99);
+				nColliding++;
+				nContactPoints += collision->contactPoints.size();
+			}
+		}
+		return Time() - start;
+	};
+
+	unsigned int nHeightfieldColliding, nHeightfieldPoints, nMeshColliding, nMeshPoints;
+	double heightfieldTime = timeCollisions(heightfieldGround, nHeightfieldColliding, nHeightfieldPoints);
+	double meshTime = timeCollisions(meshGround, nMeshColliding, nMeshPoints);
+	Assert(nHeightfieldColliding == N_BOXES);
+
+	// raising and lowering cells under the boxes, which also wakes up anything near them
+	auto changeStart = Time();
+	auto& heightfieldCollider = *heightfieldGround->RawGet<ColliderComponent>();
+	for (unsigned int i = 0; i < N_CELL_CHANGES; i++) {
+		heightfieldCollider.SetHeightfieldCell(i % SIZE, (i / SIZE) % SIZE, (i / (SIZE * SIZE)) % 2 == 0 ? 0.5f : 0.0f);
+	}
+	double changeTime = Time() - changeStart;
+
+	DebugLogInfo(N_BOXES, " boxes on flat ground. IsColliding() against a heightfield took ", heightfieldTime * 1000.0, "ms (", nHeightfieldColliding, " colliding, ", nHeightfieldPoints, " contact points), against a cube mesh took ",
+		meshTime * 1000.0, "ms (", nMeshColliding, " colliding, ", nMeshPoints, " contact points). ", N_CELL_CHANGES, " SetHeightfieldCell() calls took ", changeTime * 1000.0, "ms");
+
+	heightfieldGround->Destroy();
+	meshGround->Destroy();
+}
+
+void BenchmarkContinuousCollision() {
+	constexpr unsigned int N_PER_GROUP = 20;
+	constexpr unsigned int N_STEPS = 60;
+	constexpr double TIMESTEP = 1.0 / 60.0; // same as main.cpp
+	constexpr double SPEED = 300; // 5 units per step, against a wall and floor 0.1 thick
+	constexpr double RADIUS = 0.05;
+
+	auto& physics = PhysicsEngine::Get();
+	auto& sas = SpatialAccelerationStructure::Get();
+
+	// a thin wall at x = 0 standing on a thin floor with its top at y = 0.05
+	auto wall = GameObject::New(CubeParams());
+	wall->RawGet<TransformComponent>()->SetPos({ 0, 5, 0 });
+	wall->RawGet<TransformComponent>()->SetScl({ 0.1, 20, 20 });
+	auto floor = GameObject::New(CubeParams());
+	floor->RawGet<TransformComponent>()->SetPos({ 0, 0, 0 });
+	floor->RawGet<TransformComponent>()->SetScl({ 40, 0.1, 40 });
+
+	GameobjectCreateParams projectileParams({ ComponentBitIndex::Transform, ComponentBitIndex::Collider, ComponentBitIndex::Rigidbody });
+	projectileParams.meshId = SphereMesh()->meshId;
+	projectileParams.colliderShape = ColliderShapeSphere;
+
+	// Each group is a row of small fast spheres along z, far enough apart not to touch each other:
+		// flying at the wall from the air, already pressed against the wall and moving into it, sliding along the floor at the wall, and resting on the floor and moving down into it.
+		// The ones that start out touching what they're going into are the ones a sweep can miss if it ignores everything the body starts out touching.
+	struct Group {
+		const char* name;
+		glm::dvec3 position;
+		glm::dvec3 velocity;
+		std::vector<std::shared_ptr<GameObject>> projectiles;
+	};
+	std::array<Group, 4> groups = {
+		Group { .name = "flying into the wall", .position = { 10, 5, 0 }, .velocity = { -SPEED, 0, 0 } },
+		Group { .name = "pressed against the wall", .position = { 0.05 + RADIUS - 0.001, 3, 0.5 }, .velocity = { -SPEED, 0, 0 } }, // between the flying ones, so they don't land on these
+		Group { .name = "sliding into the wall", .position = { 10, 0.05 + RADIUS - 0.001, 0 }, .velocity = { -SPEED, 0, 0 } },
+		Group { .name = "pushed into the floor", .position = { 15, 0.05 + RADIUS - 0.001, 0 }, .velocity = { 0, -SPEED, 0 } },
+	};
+	for (auto& group : groups) {
+		group.projectiles = GameObject::NewBatch(projectileParams, N_PER_GROUP);
+		for (unsigned int i = 0; i < N_PER_GROUP; i++) {
+			auto& transform = *group.projectiles[i]->RawGet<TransformComponent>();
+			transform.SetPos(group.position + glm::dvec3(0, 0, i - N_PER_GROUP / 2.0 + 0.5));
+			transform.SetScl(glm::dvec3(RADIUS * 2));
+			auto& rigidbody = *group.projectiles[i]->RawGet<RigidbodyComponent>();
+			rigidbody.SetMass(0.1, transform);
+			rigidbody.continuousCollision = true;
+			rigidbody.velocity = group.velocity;
+			group.projectiles[i]->RawGet<ColliderComponent>()->elasticity = 0; // so they stop where they hit instead of bouncing off the floor's edge
+		}
+	}
+
+	// stepped the same way main.cpp does
+	auto start = Time();
+	for (unsigned int step = 0; step < N_STEPS; step++) {
+		sas.Update();
+		physics.Step(TIMESTEP);
+
+		// Nothing may ever end up on the far side of the wall or under the floor. Anything sunk in further than its radius went (at least halfway) through.
+		for (auto& group : groups) {
+			for (auto& p : group.projectiles) {
+				glm::dvec3 position = p->RawGet<TransformComponent>()->Position();
+				if (position.x < 0.05 || position.y < 0.05) {
+					DebugLogError("Continuous collision let a sphere ", group.name, " through, it's at ", glm::to_string(position), " after ", step + 1, " steps");
+				}
+				Assert(position.x >= 0.05 && position.y >= 0.05);
+			}
+		}
+	}
+	double stepTime = Time() - start;
+
+	// the ones sliding along the floor shouldn't get stuck on it either
+	for (auto& p : groups[2].projectiles) {
+		Assert(p->RawGet<TransformComponent>()->Position().x < 1);
+	}
+
+	DebugLogInfo(groups.size() * N_PER_GROUP, " fast spheres against a thin wall and floor, nothing tunneled. ", N_STEPS, " steps took ", stepTime * 1000.0 / N_STEPS, "ms per step");
+
+	for (auto& group : groups) {
+		GameObject::DestroyBatch(group.projectiles);
+	}
+	wall->Destroy();
+	floor->Destroy();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Times the spatial acceleration structure on scenes of colliders at several densities: building it, updating it after some of the colliders move, and querying it once per collider
+	// (which is what the physics engine does every step). Also times a brute force O(n^2) pass over the same colliders as a baseline, checks that it finds the same pairs, and logs the results.
+// Only uses SpatialAccelerationStructure's public interface, so the numbers are comparable across different SAS implementations.
+void BenchmarkBroadphase();
+
+// Times the narrowphase on pairs of randomly rotated unit cubes that mostly overlap: IsColliding() (GJK, then EPA plus face clipping for contact points) on every pair,
+	// and FindContactSat() (how IsColliding() used to find contact points after GJK) on the pairs that collide. Logs the results.
+void BenchmarkNarrowphase();
+
+// Times IsColliding() on pairs of mesh colliders and on the same pairs as primitive colliders (spheres vs sphere meshes, boxes vs cube meshes, and capsules), and logs the results.
+void BenchmarkPrimitiveColliders();
+
+// Times building a PhysicsMesh's faces and edges (MakeConvexMesh()) on a few convex meshes, from a cube to thousands of triangles, against the O(n^2) way it used to be done,
+	// checks that both ways make the same faces and edges, and logs the results.
+void BenchmarkPhysicsMeshFaces();
+
+// Times lots of rays cast one at a time with Raycast() against the same rays cast all at once with BatchRaycast(), through a scene of randomly placed cubes, and checks that they hit the same things.
+	// Also times the rays with a max distance, and as sphere and box casts. Logs the results.
+void BenchmarkRaycasts();
+
+// Times SAS Query() calls on a scene of colliders, right after some of them moved: lots of small aabbs (like trigger volumes), fewer big ones (like what an AI can see), and rays (like lines of sight).
+	// The aabb queries are also timed without allocating (a reused result vector, and QueryVisit()).
+	// Checks each against testing every collider's aabb, and logs the results.
+void BenchmarkSpatialQueries();
+
+// Times IsColliding() on slightly tilted boxes resting on flat ground, with the ground as a heightfield (like terrain chunks use) and as a cube mesh, and checks that the heightfield pushes them all straight up.
+	// Also times changing heightfield cells with SetHeightfieldCell() (like World::SetTile() does) while the boxes are on top of it. Logs the results.
+void BenchmarkTerrainColliders();
+
+// Steps the physics engine on rows of small spheres with continuousCollision, moving fast enough to go through a thin wall or floor in one step: flying into the wall,
+	// already touching the wall or floor and moving into it, and sliding along the floor into the wall. Checks that none of them ever get through (or get stuck sliding), and logs how long the steps took.
+void BenchmarkContinuousCollision();
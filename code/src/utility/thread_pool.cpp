@@ -0,0 +1,90 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+ThreadPool& ThreadPool::Get() {
+	static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+	return pool;
+}
+
+ThreadPool::ThreadPool(unsigned int nWorkers) {
+	for (unsigned int i = 0; i < nWorkers; i++) {
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	jobStarted.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func) {
+	if (count == 0) {
+		return;
+	}
+
+	// not worth waking anyone up
+	if (count == 1 || workers.empty()) {
+		for (unsigned int i = 0; i < count; i++) {
+			func(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard lock(mutex);
+		job = &func;
+		jobCount = count;
+		nextIndex = 0;
+		jobGeneration++;
+		nWorkersBusy = static_cast<unsigned int>(workers.size());
+	}
+	jobStarted.notify_all();
+
+	// might as well help instead of just waiting
+	RunJob();
+
+	// every worker has to check in, even if there was nothing left for it to do, so that none of them are still looking at job after we return
+	std::unique_lock lock(mutex);
+	jobFinished.wait(lock, [this]() { return nWorkersBusy == 0; });
+	job = nullptr;
+}
+
+void ThreadPool::WorkerLoop() {
+	unsigned int lastGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock lock(mutex);
+			jobStarted.wait(lock, [this, lastGeneration]() { return stopping || jobGeneration != lastGeneration; });
+			if (stopping) {
+				return;
+			}
+			lastGeneration = jobGeneration;
+		}
+
+		RunJob();
+
+		{
+			std::lock_guard lock(mutex);
+			nWorkersBusy--;
+		}
+		jobFinished.notify_one();
+	}
+}
+
+void ThreadPool::RunJob() {
+	// job and jobCount can't change until every worker has finished, so reading them without the lock is fine
+	while (true) {
+		unsigned int i = nextIndex.fetch_add(1);
+		if (i >= jobCount) {
+			return;
+		}
+		(*job)(i);
+	}
+}
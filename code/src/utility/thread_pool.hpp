@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// A fixed set of worker threads (one less than the number of cores) for splitting up work that would otherwise leave most of the cpu idle.
+// Meant for short parallel loops inside a frame; ParallelFor() blocks until all the work it was given is done.
+class ThreadPool {
+public:
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	static ThreadPool& Get();
+
+	// Calls func(i) for every i in [0, count), spread across the worker threads and the calling thread, and returns once every call has returned.
+	// Which thread runs which index is up to chance, so to get deterministic results func should write its results to slot i of something instead of (for example) appending to a shared vector.
+	// Only call from one thread at a time, and not from inside func.
+	void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func);
+
+	// Returns the number of worker threads, not counting the thread that calls ParallelFor().
+	unsigned int WorkerCount() const {
+		return static_cast<unsigned int>(workers.size());
+	}
+
+private:
+	ThreadPool(unsigned int nWorkers);
+	~ThreadPool();
+
+	// What each worker thread runs until the pool is destroyed.
+	void WorkerLoop();
+
+	// Calls the current job's function for indices taken from nextIndex until there are none left.
+	void RunJob();
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable jobStarted;
+	std::condition_variable jobFinished;
+
+	// protected by mutex
+	const std::function<void(unsigned int)>* job = nullptr;
+	unsigned int jobCount = 0;
+	unsigned int jobGeneration = 0; // incremented by every ParallelFor() so that workers can tell that there's a new job
+	unsigned int nWorkersBusy = 0;
+	bool stopping = false;
+
+	// next index of the current job that nobody has taken yet
+	std::atomic<unsigned int> nextIndex = 0;
+};
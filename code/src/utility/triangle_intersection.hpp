@@ -1,10 +1,11 @@
 #pragma once
+#include <cmath>
 #include <glm/vec3.hpp>
 // Turns out more than one file needed to test where/if rays intersect triangles, so here it is.
 
 // copy pasted from https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm#C++_implementation
-// If the ray intersects the triangle, sets intersection point and returns true, else returns false
-inline bool IsTriangleColliding(glm::dvec3 origin, glm::dvec3 direction, glm::dvec3 triVertex0, glm::dvec3 triVertex1, glm::dvec3 triVertex2, glm::dvec3& intersectionPoint) {
+// If the ray intersects the triangle, returns how far along the ray it does so (in multiples of direction, which doesn't have to be normalized), else returns INFINITY.
+inline double TriangleRayDistance(glm::dvec3 origin, glm::dvec3 direction, glm::dvec3 triVertex0, glm::dvec3 triVertex1, glm::dvec3 triVertex2) {
     const double EPSILON = 0.0000001;
     glm::dvec3 edge1, edge2, h, s, q;
     double a, f, u, v;
@@ -14,14 +15,14 @@ inline bool IsTriangleColliding(glm::dvec3 origin, glm::dvec3 direction, glm::dv
     a = glm::dot(edge1, h);
 
     if (a > -EPSILON && a < EPSILON)
-        return false;    // This ray is parallel to this triangle.
+        return INFINITY;    // This ray is parallel to this triangle.
 
     f = 1.0 / a;
     s = origin - triVertex0;
     u = f * glm::dot(s, h);
 
     if (u < 0.0 || u > 1.0)
-        return false;
+        return INFINITY;
 
     q = glm::cross(s, edge1);
     v = f * glm::dot(direction, q);
@@ -29,17 +30,26 @@ inline bool IsTriangleColliding(glm::dvec3 origin, glm::dvec3 direction, glm::dv
     // std::cout << "Test of t is " << t << "\n";
 
     if (v < 0.0 || u + v > 1.0)
-        return false;
+        return INFINITY;
 
     // At this stage we can compute t to find out where the intersection point is on the line.
     double t = f * glm::dot(edge2, q);
 
     if (t > EPSILON) // ray intersection
     {
-        intersectionPoint = origin + direction * t;
-        return true;
+        return t;
     }
     else {// This means that there is a line intersection but not a ray intersection.
+        return INFINITY;
+    }
+}
+
+// If the ray intersects the triangle, sets intersection point and returns true, else returns false
+inline bool IsTriangleColliding(glm::dvec3 origin, glm::dvec3 direction, glm::dvec3 triVertex0, glm::dvec3 triVertex1, glm::dvec3 triVertex2, glm::dvec3& intersectionPoint) {
+    double t = TriangleRayDistance(origin, direction, triVertex0, triVertex1, triVertex2);
+    if (t == INFINITY) {
         return false;
     }
-}
\ No newline at end of file
+    intersectionPoint = origin + direction * t;
+    return true;
+}